@@ -0,0 +1,834 @@
+/*
+ * pcapbin: bin captured bytes per flow into fixed time intervals.
+ *
+ * Reads any number of pcap / pcapng files (mmap'ed, parsed in place, one file
+ * per worker thread), decodes Ethernet / VLAN / Linux cooked / raw IP framing,
+ * IPv4 and IPv6 (with extension headers) and TCP / UDP ports, and adds every
+ * frame's wire length to the bin of its flow. Output is one CSV row per
+ * non-empty (flow, bin):
+ *
+ *   src,dst,proto,sport,dport,time_s,bytes,packets
+ *
+ * With -k pair / -k src the key is coarsened to (src, dst) / src and the
+ * unused columns are left empty. With -f flows are kept apart per input file
+ * and a leading file column (index on the command line) is added; otherwise
+ * the files are merged. Timestamps are relative to the first counted frame of
+ * each file, as in get_data_transfer_intervals().
+ *
+ * Live mode (-L iface, or -R file to replay a capture at recorded speed)
+ * keeps a rolling window per client instead, in fixed memory, and prints one
+ * block of rows per interval as it closes:
+ *
+ *   time_s,client,window_mbps,share_pct,jain
+ *
+ * where share is the client's part of all bytes in the window and jain is
+ * Jain's fairness index over the clients active in it. Live capture uses an
+ * AF_PACKET TPACKET_V3 ring mapped into our memory (needs CAP_NET_RAW).
+ *
+ * Build: gcc -O2 -pthread -o pcapbin pcapbin.c
+ * Usage: pcapbin [-i interval_ms] [-d duration_s] [-k flow|pair|src] [-l frame_len]
+ *                [-s src_ip]... [-f] [-j threads] [-o out.csv] file...
+ *        pcapbin -L iface | -R file [-i interval_ms] [-w window_s] [-c src|dst]
+ *                [-l frame_len] [-s client_ip]... [-d duration_s]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+#define MAX_FILTERS 64
+#define MAX_THREADS 64
+#define MAX_INTERFACES 32       // pcapng interfaces per section
+#define INITIAL_FLOWS 1024      // per table, power of two
+#define INITIAL_BINS 64
+#define MAX_CLIENTS 256         // live mode: clients tracked at once
+#define MAX_WINDOW_BINS 600     // live mode: intervals per rolling window
+#define RING_BLOCK_SIZE (1 << 22)
+#define RING_BLOCKS 64
+#define RING_FRAME_SIZE 2048
+#define RING_TIMEOUT_MS 50      // hand partially filled ring blocks over after this long
+
+#define KEY_FLOW 0
+#define KEY_PAIR 1
+#define KEY_SRC 2
+
+// Flow key: addresses are 16 bytes, IPv4 stored as ::ffff:a.b.c.d
+typedef struct {
+    uint8_t src[16], dst[16];
+    uint16_t sport, dport;
+    uint8_t proto, family;      // family 4 or 6
+    uint16_t file;              // input file index with -f, else 0
+} FlowKey;
+
+typedef struct {
+    FlowKey key;
+    int used;
+    uint32_t nbins;
+    uint64_t *bytes;
+    uint32_t *packets;
+} Flow;
+
+typedef struct {
+    Flow *flows;
+    uint32_t capacity, count;
+} FlowTable;
+
+typedef struct {
+    const char *path;
+    FlowTable table;
+    uint64_t packets, counted, bytes_read;
+    int error;
+} FileJob;
+
+// Options
+long long interval_ns = 100 * 1000000LL;
+long long duration_ns = 0;      // 0 = no limit
+int key_mode = KEY_FLOW;
+int per_file = 0;
+uint32_t frame_len = 0;         // 0 = count every frame
+uint8_t filters[MAX_FILTERS][16];
+int filter_count = 0;
+
+FileJob *jobs;
+int job_count;
+int next_job = 0;
+
+// Function to hash a flow key
+static uint64_t hash_key(const FlowKey *k) {
+    uint64_t w[5];
+    memcpy(w, k, sizeof(w));
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for(int i = 0; i < 5; i++) {
+        h = (h ^ w[i]) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+// Function to find (or add) the flow for a key
+static Flow *get_flow(FlowTable *t, const FlowKey *k) {
+    if((t->count + 1) * 2 > t->capacity) {
+        // Grow at 50% load
+        uint32_t old_cap = t->capacity;
+        Flow *old = t->flows;
+        t->capacity = old_cap ? old_cap * 2 : INITIAL_FLOWS;
+        t->flows = calloc(t->capacity, sizeof(Flow));
+        if(!t->flows) {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+        for(uint32_t i = 0; i < old_cap; i++) {
+            if(!old[i].used) continue;
+            uint32_t j = hash_key(&old[i].key) & (t->capacity - 1);
+            while(t->flows[j].used) j = (j + 1) & (t->capacity - 1);
+            t->flows[j] = old[i];
+        }
+        free(old);
+    }
+
+    uint32_t i = hash_key(k) & (t->capacity - 1);
+    while(t->flows[i].used) {
+        if(memcmp(&t->flows[i].key, k, sizeof(*k)) == 0) return &t->flows[i];
+        i = (i + 1) & (t->capacity - 1);
+    }
+    Flow *f = &t->flows[i];
+    f->key = *k;
+    f->used = 1;
+    t->count++;
+    return f;
+}
+
+// Function to add bytes/packets to a bin of a flow, growing its bin arrays
+static void add_to_bin(Flow *f, uint64_t bin, uint64_t bytes, uint32_t packets) {
+    if(bin >= f->nbins) {
+        uint32_t n = f->nbins ? f->nbins : INITIAL_BINS;
+        while(n <= bin) n *= 2;
+        f->bytes = realloc(f->bytes, n * sizeof(uint64_t));
+        f->packets = realloc(f->packets, n * sizeof(uint32_t));
+        if(!f->bytes || !f->packets) {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+        memset(f->bytes + f->nbins, 0, (n - f->nbins) * sizeof(uint64_t));
+        memset(f->packets + f->nbins, 0, (n - f->nbins) * sizeof(uint32_t));
+        f->nbins = n;
+    }
+    f->bytes[bin] += bytes;
+    f->packets[bin] += packets;
+}
+
+static uint16_t rd16be(const uint8_t *p) { return p[0] << 8 | p[1]; }
+
+static uint16_t rd16(const uint8_t *p, int swap) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return swap ? __builtin_bswap16(v) : v;
+}
+
+static uint32_t rd32(const uint8_t *p, int swap) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+// Function to decode one frame into a flow key. Returns 0 for non-IP frames.
+static int parse_frame(const uint8_t *p, uint32_t caplen, int linktype, FlowKey *k) {
+    const uint8_t *end = p + caplen;
+    int ethertype;
+
+    switch(linktype) {
+    case 1:     // Ethernet
+        if(caplen < 14) return 0;
+        ethertype = rd16be(p + 12);
+        p += 14;
+        while((ethertype == 0x8100 || ethertype == 0x88a8) && p + 4 <= end) {
+            ethertype = rd16be(p + 2);
+            p += 4;
+        }
+        break;
+    case 113:   // Linux cooked capture
+        if(caplen < 16) return 0;
+        ethertype = rd16be(p + 14);
+        p += 16;
+        break;
+    case 276:   // Linux cooked capture v2
+        if(caplen < 20) return 0;
+        ethertype = rd16be(p);
+        p += 20;
+        break;
+    case 12: case 14: case 101: case 228: case 229:     // raw IP
+        if(caplen < 1) return 0;
+        ethertype = (p[0] >> 4) == 6 ? 0x86dd : 0x0800;
+        break;
+    default:
+        return 0;
+    }
+
+    memset(k, 0, sizeof(*k));
+    int l4_ok = 1;
+    if(ethertype == 0x0800) {
+        if(p + 20 > end || (p[0] >> 4) != 4) return 0;
+        int ihl = (p[0] & 0x0f) * 4;
+        if(ihl < 20 || p + ihl > end) return 0;    // malformed header: skip the frame
+        k->family = 4;
+        k->proto = p[9];
+        k->src[10] = k->src[11] = k->dst[10] = k->dst[11] = 0xff;
+        memcpy(k->src + 12, p + 12, 4);
+        memcpy(k->dst + 12, p + 16, 4);
+        l4_ok = (rd16be(p + 6) & 0x1fff) == 0;     // ports only in the first fragment
+        p += ihl;
+    } else if(ethertype == 0x86dd) {
+        if(p + 40 > end) return 0;
+        k->family = 6;
+        int next = p[6];
+        memcpy(k->src, p + 8, 16);
+        memcpy(k->dst, p + 24, 16);
+        p += 40;
+        // Skip hop-by-hop, routing, fragment and destination option headers
+        while((next == 0 || next == 43 || next == 44 || next == 60) && p + 8 <= end) {
+            if(next == 44) {
+                l4_ok = (rd16be(p + 2) & 0xfff8) == 0;
+                next = p[0];
+                p += 8;
+            } else {
+                next = p[0];
+                p += (p[1] + 1) * 8;
+            }
+        }
+        k->proto = next;
+    } else {
+        return 0;
+    }
+
+    if(l4_ok && (k->proto == 6 || k->proto == 17) && p + 4 <= end) {
+        k->sport = rd16be(p);
+        k->dport = rd16be(p + 2);
+    }
+    return 1;
+}
+
+// Function to check a source address against the -s filters
+static int passes_filter(const FlowKey *k) {
+    if(filter_count == 0) return 1;
+    for(int i = 0; i < filter_count; i++) {
+        if(memcmp(filters[i], k->src, 16) == 0) return 1;
+    }
+    return 0;
+}
+
+// Function to count one frame
+static void count_frame(FileJob *job, long long *origin, long long ts_ns, const uint8_t *data,
+                        uint32_t caplen, uint32_t origlen, int linktype) {
+    job->packets++;
+    if(frame_len && origlen != frame_len) return;
+
+    FlowKey k;
+    if(!parse_frame(data, caplen, linktype, &k) || !passes_filter(&k)) return;
+
+    if(*origin < 0) *origin = ts_ns;
+    long long rel = ts_ns - *origin;
+    if(rel < 0 || (duration_ns && rel >= duration_ns)) return;
+
+    if(per_file) k.file = job - jobs;
+    if(key_mode != KEY_FLOW) {
+        k.sport = k.dport = 0;
+        k.proto = 0;
+        if(key_mode == KEY_SRC) memset(k.dst, 0, 16);
+    }
+    add_to_bin(get_flow(&job->table, &k), rel / interval_ns, origlen, 1);
+    job->counted++;
+}
+
+// What scan_pcap / scan_pcapng do with every frame (count_frame, or the live replay)
+static void (*handle_frame)(FileJob *, long long *, long long, const uint8_t *, uint32_t, uint32_t, int) = count_frame;
+
+// Function to walk a classic pcap file
+static int scan_pcap(FileJob *job, const uint8_t *p, size_t size) {
+    uint32_t magic;
+    memcpy(&magic, p, 4);
+    int swap = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+    int nanos = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+    if(size < 24) return -1;
+    int linktype = rd32(p + 20, swap) & 0xffff;
+
+    long long origin = -1;
+    size_t off = 24;
+    while(off + 16 <= size) {
+        uint32_t sec = rd32(p + off, swap), frac = rd32(p + off + 4, swap);
+        uint32_t caplen = rd32(p + off + 8, swap), origlen = rd32(p + off + 12, swap);
+        off += 16;
+        if(caplen > size - off) break;      // truncated capture
+        long long ts = sec * 1000000000LL + (nanos ? frac : frac * 1000LL);
+        handle_frame(job, &origin, ts, p + off, caplen, origlen, linktype);
+        off += caplen;
+    }
+    job->bytes_read = off;
+    return 0;
+}
+
+// Function to walk a pcapng file (SHB, IDB, EPB and obsolete packet blocks)
+static int scan_pcapng(FileJob *job, const uint8_t *p, size_t size) {
+    int swap = 0;
+    int linktype[MAX_INTERFACES];
+    long long ticks_per_sec[MAX_INTERFACES];
+    int interfaces = 0;
+    long long origin = -1;
+
+    size_t off = 0;
+    while(off + 12 <= size) {
+        uint32_t type = rd32(p + off, swap);
+        if(type == 0x0a0d0d0a) {
+            // Section header: byte order may change, interfaces restart
+            uint32_t bom;
+            memcpy(&bom, p + off + 8, 4);
+            swap = bom == 0x4d3c2b1a;
+            interfaces = 0;
+        }
+        uint32_t len = rd32(p + off + 4, swap);
+        if(len < 12 || len > size - off) break;
+        const uint8_t *body = p + off + 8;
+        uint32_t body_len = len - 12;
+
+        if(type == 1 && body_len >= 8 && interfaces < MAX_INTERFACES) {
+            linktype[interfaces] = rd16(body, swap);
+            ticks_per_sec[interfaces] = 1000000;
+            // Options: look for if_tsresol (code 9)
+            uint32_t o = 8;
+            while(o + 4 <= body_len) {
+                uint16_t code = rd16(body + o, swap), olen = rd16(body + o + 2, swap);
+                if(code == 0) break;
+                if(code == 9 && olen >= 1 && o + 5 <= body_len) {
+                    uint8_t res = body[o + 4];
+                    long long t = 1;
+                    for(int i = 0; i < (res & 0x7f) && t < 1000000000000000000LL / 10; i++) t *= (res & 0x80) ? 2 : 10;
+                    ticks_per_sec[interfaces] = t;
+                }
+                o += 4 + ((olen + 3) & ~3u);
+            }
+            interfaces++;
+        } else if((type == 6 || type == 2) && body_len >= 20) {
+            // Enhanced packet block (6) and the obsolete packet block (2, 16-bit interface id)
+            uint32_t ifc = type == 6 ? rd32(body, swap) : rd16(body, swap);
+            uint64_t ts = (uint64_t)rd32(body + 4, swap) << 32 | rd32(body + 8, swap);
+            uint32_t caplen = rd32(body + 12, swap), origlen = rd32(body + 16, swap);
+            if(ifc < (uint32_t)interfaces && caplen <= body_len - 20) {
+                long long tps = ticks_per_sec[ifc];
+                long long ts_ns = (long long)(ts / tps) * 1000000000LL + (long long)((ts % tps) * 1000000000ULL / tps);
+                handle_frame(job, &origin, ts_ns, body + 20, caplen, origlen, linktype[ifc]);
+            }
+        }
+        off += len;
+    }
+    job->bytes_read = off;
+    return 0;
+}
+
+// Function to map and scan one capture file
+static void scan_file(FileJob *job) {
+    int fd = open(job->path, O_RDONLY);
+    if(fd < 0) {
+        perror(job->path);
+        job->error = 1;
+        return;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size < 4) {
+        fprintf(stderr, "%s: not a capture file\n", job->path);
+        close(fd);
+        job->error = 1;
+        return;
+    }
+    uint8_t *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        perror("mmap failed");
+        job->error = 1;
+        return;
+    }
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+    uint32_t magic;
+    memcpy(&magic, p, 4);
+    if(magic == 0xa1b2c3d4 || magic == 0xd4c3b2a1 || magic == 0xa1b23c4d || magic == 0x4d3cb2a1) {
+        scan_pcap(job, p, st.st_size);
+    } else if(magic == 0x0a0d0d0a) {
+        scan_pcapng(job, p, st.st_size);
+    } else {
+        fprintf(stderr, "%s: unknown capture format\n", job->path);
+        job->error = 1;
+    }
+    munmap(p, st.st_size);
+}
+
+void *worker(void *arg) {
+    int i;
+    while((i = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED)) < job_count) {
+        scan_file(&jobs[i]);
+    }
+    return NULL;
+}
+
+// Function to format a key address (empty for coarsened keys)
+static void format_addr(const FlowKey *k, const uint8_t *addr, char *out) {
+    if(k->family == 4) inet_ntop(AF_INET, addr + 12, out, INET6_ADDRSTRLEN);
+    else inet_ntop(AF_INET6, addr, out, INET6_ADDRSTRLEN);
+}
+
+static int cmp_flows(const void *a, const void *b) {
+    return memcmp(&((const Flow *)a)->key, &((const Flow *)b)->key, sizeof(FlowKey));
+}
+
+// Function to parse -s: IPv4 or IPv6 into the 16-byte key form
+static int parse_filter(const char *ip, uint8_t *out) {
+    memset(out, 0, 16);
+    if(inet_pton(AF_INET, ip, out + 12) == 1) {
+        out[10] = out[11] = 0xff;
+        return 0;
+    }
+    return inet_pton(AF_INET6, ip, out) == 1 ? 0 : -1;
+}
+
+/*
+ * Live mode. One thread: frames come either from the TPACKET_V3 ring or from a
+ * replayed capture, and every time a frame (or the clock) crosses an interval
+ * boundary the closed interval is published. Each client has a ring of the
+ * last window_bins intervals and a running sum over it.
+ */
+typedef struct {
+    uint8_t addr[16];
+    uint8_t family;
+    int used;
+    uint64_t sum;                   // bytes in the window
+    uint64_t bins[MAX_WINDOW_BINS]; // by interval % window_bins
+} Client;
+
+Client clients[MAX_CLIENTS];
+int window_bins = 100;              // 10 s of 100 ms intervals
+int client_is_dst = 0;
+long long live_origin = -1;         // start of interval 0, capture clock
+long long live_bin = 0;             // interval being filled
+long long live_untracked = 0;       // frames of clients beyond MAX_CLIENTS
+volatile sig_atomic_t live_running = 1;
+
+void handle_stop(int sig) {
+    live_running = 0;
+}
+
+// Function to find (or start tracking) a client
+static Client *get_client(const uint8_t *addr, int family) {
+    Client *free_slot = NULL;
+    for(int i = 0; i < MAX_CLIENTS; i++) {
+        if(!clients[i].used) {
+            if(!free_slot) free_slot = &clients[i];
+        } else if(memcmp(clients[i].addr, addr, 16) == 0) {
+            return &clients[i];
+        }
+    }
+    if(!free_slot) return NULL;
+    memset(free_slot, 0, sizeof(*free_slot));
+    memcpy(free_slot->addr, addr, 16);
+    free_slot->family = family;
+    free_slot->used = 1;
+    return free_slot;
+}
+
+// Function to publish the window ending with the interval being closed
+static void publish_window() {
+    uint64_t total = 0;
+    double sum_sq = 0;
+    int active = 0;
+    for(int i = 0; i < MAX_CLIENTS; i++) {
+        if(!clients[i].used || clients[i].sum == 0) continue;
+        total += clients[i].sum;
+        sum_sq += (double)clients[i].sum * clients[i].sum;
+        active++;
+    }
+    double jain = active ? (double)total * total / (active * sum_sq) : 0;
+
+    // A window is shorter than window_bins until that many intervals have passed
+    long long bins = live_bin + 1 < window_bins ? live_bin + 1 : window_bins;
+    double window_s = bins * (interval_ns / 1e9);
+    double time_s = (live_bin + 1) * (interval_ns / 1e9);
+    for(int i = 0; i < MAX_CLIENTS; i++) {
+        Client *c = &clients[i];
+        if(!c->used || c->sum == 0) continue;
+        char addr[INET6_ADDRSTRLEN];
+        if(c->family == 4) inet_ntop(AF_INET, c->addr + 12, addr, sizeof(addr));
+        else inet_ntop(AF_INET6, c->addr, addr, sizeof(addr));
+        printf("%.3f,%s,%.3f,%.2f,%.4f\n", time_s, addr, c->sum * 8 / window_s / 1e6,
+               100.0 * c->sum / total, jain);
+    }
+    fflush(stdout);
+}
+
+// Function to close intervals until the one holding ts is current
+static void advance_to(long long ts) {
+    if(live_origin < 0) return;
+    long long bin = (ts - live_origin) / interval_ns;
+    while(live_bin < bin) {
+        publish_window();
+        live_bin++;
+        // The slot of the new interval drops out of every window
+        int slot = live_bin % window_bins;
+        for(int i = 0; i < MAX_CLIENTS; i++) {
+            Client *c = &clients[i];
+            if(!c->used) continue;
+            c->sum -= c->bins[slot];
+            c->bins[slot] = 0;
+            if(c->sum == 0) c->used = 0;    // idle for a whole window: free the slot
+        }
+    }
+}
+
+// Function to account one live or replayed frame
+static void live_frame(long long ts, const uint8_t *data, uint32_t caplen, uint32_t origlen, int linktype) {
+    if(frame_len && origlen != frame_len) return;
+    FlowKey k;
+    if(!parse_frame(data, caplen, linktype, &k)) return;
+    const uint8_t *addr = client_is_dst ? k.dst : k.src;
+    if(filter_count) {
+        int match = 0;
+        for(int i = 0; i < filter_count && !match; i++) match = memcmp(filters[i], addr, 16) == 0;
+        if(!match) return;
+    }
+
+    if(live_origin < 0) live_origin = ts;
+    advance_to(ts);
+    if(ts < live_origin + live_bin * interval_ns) return;   // late frame from a closed interval
+
+    Client *c = get_client(addr, k.family);
+    if(!c) {
+        live_untracked++;
+        return;
+    }
+    c->bins[live_bin % window_bins] += origlen;
+    c->sum += origlen;
+}
+
+static long long realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Replay: hold each frame back until its offset in the capture has passed on our clock
+long long replay_start_ns = -1;     // wall clock (monotonic) at the first frame
+long long replay_first_ts = -1;     // capture time of the first frame
+
+static void replay_frame(FileJob *job, long long *origin, long long ts_ns, const uint8_t *data,
+                         uint32_t caplen, uint32_t origlen, int linktype) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long now_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+    if(replay_first_ts < 0) {
+        replay_first_ts = ts_ns;
+        replay_start_ns = now_ns;
+    }
+    job->packets++;
+    if(!live_running || (duration_ns && ts_ns - replay_first_ts >= duration_ns)) return;
+
+    // Sleep in steps of at most one interval so quiet stretches still get published
+    long long due = replay_start_ns + (ts_ns - replay_first_ts);
+    while(live_running && now_ns < due) {
+        long long step = due - now_ns < interval_ns ? due - now_ns : interval_ns;
+        struct timespec d = {step / 1000000000LL, step % 1000000000LL};
+        nanosleep(&d, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        now_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+        advance_to(replay_first_ts + (now_ns - replay_start_ns));
+    }
+    live_frame(ts_ns, data, caplen, origlen, linktype);
+    job->counted++;
+}
+
+// Function to run live capture on an interface through a TPACKET_V3 ring
+static int run_capture(const char *iface) {
+    int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if(fd < 0) {
+        perror("AF_PACKET socket failed");
+        return 1;
+    }
+    int version = TPACKET_V3;
+    if(setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        perror("TPACKET_V3 not supported");
+        close(fd);
+        return 1;
+    }
+    struct tpacket_req3 req = {
+        .tp_block_size = RING_BLOCK_SIZE,
+        .tp_block_nr = RING_BLOCKS,
+        .tp_frame_size = RING_FRAME_SIZE,
+        .tp_frame_nr = (RING_BLOCK_SIZE / RING_FRAME_SIZE) * RING_BLOCKS,
+        .tp_retire_blk_tov = RING_TIMEOUT_MS,
+    };
+    if(setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+        perror("PACKET_RX_RING failed");
+        close(fd);
+        return 1;
+    }
+    size_t ring_size = (size_t)RING_BLOCK_SIZE * RING_BLOCKS;
+    uint8_t *ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+    if(ring == MAP_FAILED) ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(ring == MAP_FAILED) {
+        perror("mmap failed");
+        close(fd);
+        return 1;
+    }
+    struct sockaddr_ll ll = {
+        .sll_family = AF_PACKET,
+        .sll_protocol = htons(ETH_P_ALL),
+        .sll_ifindex = if_nametoindex(iface),
+    };
+    if(ll.sll_ifindex == 0 || bind(fd, (struct sockaddr*)&ll, sizeof(ll)) < 0) {
+        perror(iface);
+        munmap(ring, ring_size);
+        close(fd);
+        return 1;
+    }
+
+    long long start = realtime_ns();
+    unsigned long long frames = 0;
+    int block = 0;
+    while(live_running) {
+        struct tpacket_block_desc *desc = (struct tpacket_block_desc *)(ring + (size_t)block * RING_BLOCK_SIZE);
+        if(!(__atomic_load_n(&desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+            // Nothing ready: wait for the kernel, publishing intervals on the way
+            struct pollfd pfd = {fd, POLLIN | POLLERR, 0};
+            if(poll(&pfd, 1, interval_ns / 1000000 > 0 ? interval_ns / 1000000 : 1) < 0 && errno != EINTR) {
+                perror("Poll failed");
+                break;
+            }
+            advance_to(realtime_ns());
+            if(duration_ns && realtime_ns() - start >= duration_ns) break;
+            continue;
+        }
+
+        // Walk the frames of the block in place, then hand it back
+        struct tpacket3_hdr *hdr = (struct tpacket3_hdr *)((uint8_t *)desc + desc->hdr.bh1.offset_to_first_pkt);
+        for(uint32_t i = 0; i < desc->hdr.bh1.num_pkts; i++) {
+            long long ts = hdr->tp_sec * 1000000000LL + hdr->tp_nsec;
+            live_frame(ts, (uint8_t *)hdr + hdr->tp_mac, hdr->tp_snaplen, hdr->tp_len, 1);
+            frames++;
+            hdr = (struct tpacket3_hdr *)((uint8_t *)hdr + hdr->tp_next_offset);
+        }
+        __atomic_store_n(&desc->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        block = (block + 1) % RING_BLOCKS;
+    }
+
+    struct tpacket_stats_v3 stats;
+    socklen_t len = sizeof(stats);
+    if(getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0) {
+        fprintf(stderr, "%llu frames, %u dropped by the kernel, %u ring freezes, %lld untracked\n",
+                frames, stats.tp_drops, stats.tp_freeze_q_cnt, live_untracked);
+    }
+    munmap(ring, ring_size);
+    close(fd);
+    return 0;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-i interval_ms] [-d duration_s] [-k flow|pair|src] [-l frame_len]\n"
+                    "          [-s src_ip]... [-f] [-j threads] [-o out.csv] file...\n"
+                    "       %s -L iface | -R file [-i interval_ms] [-w window_s] [-c src|dst]\n"
+                    "          [-l frame_len] [-s client_ip]... [-d duration_s]\n", prog, prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = NULL, *live_iface = NULL, *replay_path = NULL;
+    double window_s = 10;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while((opt = getopt(argc, argv, "i:d:k:l:s:fj:o:L:R:w:c:")) != -1) {
+        switch(opt) {
+        case 'i': interval_ns = (long long)(atof(optarg) * 1000000); break;
+        case 'd': duration_ns = (long long)(atof(optarg) * 1000000000); break;
+        case 'k':
+            if(strcmp(optarg, "flow") == 0) key_mode = KEY_FLOW;
+            else if(strcmp(optarg, "pair") == 0) key_mode = KEY_PAIR;
+            else if(strcmp(optarg, "src") == 0) key_mode = KEY_SRC;
+            else usage(argv[0]);
+            break;
+        case 'l': frame_len = atoi(optarg); break;
+        case 's':
+            if(filter_count == MAX_FILTERS || parse_filter(optarg, filters[filter_count]) < 0) {
+                fprintf(stderr, "Bad source filter %s\n", optarg);
+                return 1;
+            }
+            filter_count++;
+            break;
+        case 'f': per_file = 1; break;
+        case 'j': threads = atoi(optarg); break;
+        case 'o': out_path = optarg; break;
+        case 'L': live_iface = optarg; break;
+        case 'R': replay_path = optarg; break;
+        case 'w': window_s = atof(optarg); break;
+        case 'c':
+            if(strcmp(optarg, "src") == 0) client_is_dst = 0;
+            else if(strcmp(optarg, "dst") == 0) client_is_dst = 1;
+            else usage(argv[0]);
+            break;
+        default: usage(argv[0]);
+        }
+    }
+
+    if(live_iface || replay_path) {
+        if(interval_ns <= 0 || (live_iface && replay_path)) usage(argv[0]);
+        window_bins = (int)(window_s * 1e9 / interval_ns + 0.5);
+        if(window_bins < 1 || window_bins > MAX_WINDOW_BINS) {
+            fprintf(stderr, "The window must be 1-%d intervals long\n", MAX_WINDOW_BINS);
+            return 1;
+        }
+        signal(SIGINT, handle_stop);
+        signal(SIGTERM, handle_stop);
+        printf("time_s,client,window_mbps,share_pct,jain\n");
+        if(live_iface) return run_capture(live_iface);
+
+        // Replay through the ordinary file scanner
+        FileJob job = {.path = replay_path};
+        jobs = &job;
+        handle_frame = replay_frame;
+        scan_file(&job);
+        if(live_origin >= 0) publish_window();  // the last, partial interval
+        return job.error;
+    }
+    if(optind >= argc || interval_ns <= 0) usage(argv[0]);
+    if(threads < 1) threads = 1;
+    if(threads > MAX_THREADS) threads = MAX_THREADS;
+
+    job_count = argc - optind;
+    jobs = calloc(job_count, sizeof(FileJob));
+    if(!jobs) {
+        perror("Memory allocation failed");
+        return 1;
+    }
+    for(int i = 0; i < job_count; i++) jobs[i].path = argv[optind + i];
+    if(threads > job_count) threads = job_count;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_t tids[MAX_THREADS];
+    for(int i = 0; i < threads; i++) pthread_create(&tids[i], NULL, worker, NULL);
+    for(int i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+
+    // Merge the per-file tables (files may share flows)
+    FlowTable merged = {0};
+    uint64_t packets = 0, counted = 0, bytes_read = 0;
+    int errors = 0;
+    for(int i = 0; i < job_count; i++) {
+        FileJob *job = &jobs[i];
+        packets += job->packets;
+        counted += job->counted;
+        bytes_read += job->bytes_read;
+        errors += job->error;
+        for(uint32_t j = 0; j < job->table.capacity; j++) {
+            Flow *f = &job->table.flows[j];
+            if(!f->used) continue;
+            Flow *m = get_flow(&merged, &f->key);
+            for(uint32_t b = f->nbins; b-- > 0; ) {
+                if(f->packets[b]) add_to_bin(m, b, f->bytes[b], f->packets[b]);
+            }
+            free(f->bytes);
+            free(f->packets);
+        }
+        free(job->table.flows);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    // Compact and sort the flows so the output is deterministic
+    Flow *flows = malloc((merged.count + 1) * sizeof(Flow));
+    uint32_t n = 0;
+    for(uint32_t j = 0; j < merged.capacity; j++) {
+        if(merged.flows[j].used) flows[n++] = merged.flows[j];
+    }
+    qsort(flows, n, sizeof(Flow), cmp_flows);
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if(!out) {
+        perror(out_path);
+        return 1;
+    }
+    fprintf(out, "%ssrc,dst,proto,sport,dport,time_s,bytes,packets\n", per_file ? "file," : "");
+    for(uint32_t j = 0; j < n; j++) {
+        Flow *f = &flows[j];
+        char src[INET6_ADDRSTRLEN], dst[INET6_ADDRSTRLEN], ports[32];
+        format_addr(&f->key, f->key.src, src);
+        if(key_mode == KEY_SRC) dst[0] = 0;
+        else format_addr(&f->key, f->key.dst, dst);
+        if(key_mode == KEY_FLOW) snprintf(ports, sizeof(ports), "%d,%d,%d", f->key.proto, f->key.sport, f->key.dport);
+        else strcpy(ports, ",,");
+        for(uint32_t b = 0; b < f->nbins; b++) {
+            if(!f->packets[b]) continue;
+            if(per_file) fprintf(out, "%d,", f->key.file);
+            fprintf(out, "%s,%s,%s,%.6f,%llu,%u\n", src, dst, ports, b * (interval_ns / 1e9),
+                    (unsigned long long)f->bytes[b], f->packets[b]);
+        }
+        free(f->bytes);
+        free(f->packets);
+    }
+    if(out != stdout) fclose(out);
+
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr, "%d files, %llu frames (%llu counted), %u keys, %.1f MB in %.3f s (%.0f MB/s)\n",
+            job_count, (unsigned long long)packets, (unsigned long long)counted, n,
+            bytes_read / 1e6, secs, secs > 0 ? bytes_read / 1e6 / secs : 0);
+    free(flows);
+    free(merged.flows);
+    free(jobs);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,805 @@
+/*
+ * httpreasm: TCP reassembly and HTTP/1.1 response decoding straight from a capture.
+ *
+ * Reads a pcap / pcapng file (mmap'ed), keeps a hash table of open TCP flows
+ * (freed once both sides sent FIN, or on RST), puts each direction back in
+ * sequence order (retransmits trimmed, out-of-order segments held in a bounded
+ * buffer), parses HTTP/1.1 messages on top (Content-Length, chunked, or until
+ * close) and streams gzip / deflate bodies through zlib as they arrive. One CSV row per response:
+ *
+ *   client,server,method,uri,status,content_type,encoding,framing,body_bytes,decoded_bytes,ratio,state
+ *
+ * body_bytes is the entity as sent (without chunk framing), decoded_bytes the
+ * size after decompression; state is "ok", "gap" (bytes missing from the
+ * capture), "truncated" (connection or capture ended mid-body) or "error" (bad framing or
+ * a corrupt stream).
+ *
+ * Build: gcc -O2 -o httpreasm httpreasm.c -lz
+ * Usage: httpreasm [-o out.csv] capture.pcap
+ */
+
+#define _GNU_SOURCE     // strcasestr
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <zlib.h>
+
+#define INITIAL_FLOWS 4096      // power of two
+#define MAX_OOO_SEGMENTS 64     // out-of-order segments held per direction
+#define MAX_OOO_BYTES (1 << 20) // ... and their total size
+#define MAX_HEADER_BYTES 65536
+#define MAX_PENDING_REQUESTS 16 // pipelined requests awaiting a response
+#define MAX_FIELD 256
+#define INFLATE_CHUNK 65536
+
+// Parser states for one direction of an HTTP connection
+#define HTTP_UNKNOWN 0      // nothing seen yet
+#define HTTP_HEADERS 1      // collecting a header block
+#define HTTP_BODY_LENGTH 2  // Content-Length bytes left
+#define HTTP_CHUNK_SIZE 3   // reading a chunk-size line
+#define HTTP_CHUNK_DATA 4
+#define HTTP_CHUNK_END 5    // CRLF after chunk data
+#define HTTP_TRAILERS 6     // after the last chunk, until an empty line
+#define HTTP_BODY_CLOSE 7   // body runs until the connection closes
+#define HTTP_NOT_HTTP 8     // some other protocol: ignore the stream
+
+typedef struct Segment {
+    uint32_t seq;
+    uint32_t len;
+    struct Segment *next;
+    uint8_t data[];
+} Segment;
+
+typedef struct {
+    char method[16];
+    char uri[MAX_FIELD];
+} Request;
+
+// One direction of a connection: reassembly plus the HTTP parser on top
+typedef struct {
+    int started;            // next_seq is valid
+    uint32_t next_seq;
+    Segment *ooo;           // sorted by seq
+    int ooo_count;
+    uint32_t ooo_bytes;
+    int gap;                // bytes were skipped since the current message started
+    int closed;             // FIN or RST seen
+
+    int state;
+    int is_response;
+    char header[MAX_HEADER_BYTES];
+    uint32_t header_len;
+    uint64_t remaining;     // body or chunk bytes left
+    char line[64];          // chunk-size line
+    int line_len;
+
+    // Current response
+    Request request;
+    int status;
+    char content_type[MAX_FIELD];
+    char encoding[32];
+    const char *framing;
+    uint64_t body_bytes, decoded_bytes;
+    int inflating;          // zs is initialised
+    int inflate_error;
+    int raw_deflate_tried;
+    z_stream zs;
+} Stream;
+
+typedef struct {
+    uint8_t addr[2][16];
+    uint16_t port[2];
+    uint8_t family;
+    uint8_t pad[3];
+} FlowKey;
+
+#define FLOW_FREE 0
+#define FLOW_USED 1
+#define FLOW_DEAD 2         // closed flow: keeps probe chains intact until the next rehash
+
+// dir[0] carries data from addr[0]:port[0] to addr[1]:port[1]
+typedef struct {
+    FlowKey key;
+    int used;
+    Stream *dir[2];
+    Request pending[MAX_PENDING_REQUESTS];
+    int pending_head, pending_count;
+} Flow;
+
+Flow *flows;
+uint32_t flow_capacity = 0, flow_count = 0;
+uint32_t flows_live = 0, flows_dead = 0;
+FILE *out;
+
+// Statistics
+unsigned long long frames = 0, segments = 0, retransmitted = 0, reordered = 0;
+unsigned long long gaps = 0, responses = 0, total_body = 0, total_decoded = 0;
+
+uint8_t inflate_buf[INFLATE_CHUNK];
+
+static uint64_t hash_key(const FlowKey *k) {
+    uint64_t w[5];
+    memcpy(w, k, sizeof(w));
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for(int i = 0; i < 5; i++) {
+        h = (h ^ w[i]) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+// Function to find (or, if create is set, add) a flow; both directions map to the same entry.
+// *dir is set to the direction of the given (src, dst) within the flow. Returns NULL if not found.
+static Flow *get_flow(const uint8_t *src, uint16_t sport, const uint8_t *dst, uint16_t dport, int family, int create, int *dir) {
+    FlowKey k;
+    memset(&k, 0, sizeof(k));
+    // Canonical order: lower (addr, port) first
+    int c = memcmp(src, dst, 16);
+    int swap = c > 0 || (c == 0 && sport > dport);
+    memcpy(k.addr[swap], src, 16);
+    memcpy(k.addr[!swap], dst, 16);
+    k.port[swap] = sport;
+    k.port[!swap] = dport;
+    k.family = family;
+    *dir = swap;
+
+    // Rehash once live and dead entries fill half the table; it only grows if the live ones need it
+    if((flows_live + flows_dead + 1) * 2 > flow_capacity) {
+        uint32_t old_cap = flow_capacity;
+        Flow *old = flows;
+        flow_capacity = old_cap ? old_cap : INITIAL_FLOWS;
+        if((flows_live + 1) * 4 > flow_capacity) flow_capacity *= 2;
+        flows = calloc(flow_capacity, sizeof(Flow));
+        if(!flows) {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+        for(uint32_t i = 0; i < old_cap; i++) {
+            if(old[i].used != FLOW_USED) continue;
+            uint32_t j = hash_key(&old[i].key) & (flow_capacity - 1);
+            while(flows[j].used) j = (j + 1) & (flow_capacity - 1);
+            flows[j] = old[i];
+        }
+        free(old);
+        flows_dead = 0;
+    }
+
+    uint32_t i = hash_key(&k) & (flow_capacity - 1);
+    int64_t reuse = -1;
+    while(flows[i].used) {
+        if(flows[i].used == FLOW_DEAD) {
+            if(reuse < 0) reuse = i;
+        } else if(memcmp(&flows[i].key, &k, sizeof(k)) == 0) {
+            return &flows[i];
+        }
+        i = (i + 1) & (flow_capacity - 1);
+    }
+    if(!create) return NULL;
+    if(reuse >= 0) {
+        i = reuse;
+        flows_dead--;
+    }
+    memset(&flows[i], 0, sizeof(Flow));
+    flows[i].key = k;
+    flows[i].used = FLOW_USED;
+    flow_count++;
+    flows_live++;
+    return &flows[i];
+}
+
+static void format_endpoint(const FlowKey *k, int side, char *out, size_t size) {
+    char ip[INET6_ADDRSTRLEN];
+    if(k->family == 4) inet_ntop(AF_INET, k->addr[side] + 12, ip, sizeof(ip));
+    else inet_ntop(AF_INET6, k->addr[side], ip, sizeof(ip));
+    snprintf(out, size, k->family == 4 ? "%s:%d" : "[%s]:%d", ip, k->port[side]);
+}
+
+// Function to write a CSV field, quoted if needed
+static void put_field(const char *s) {
+    if(strpbrk(s, ",\"\n")) {
+        fputc('"', out);
+        for(; *s; s++) {
+            if(*s == '"') fputc('"', out);
+            fputc(*s, out);
+        }
+        fputc('"', out);
+    } else {
+        fputs(s, out);
+    }
+    fputc(',', out);
+}
+
+// Function to report the current response and reset the body state
+static void finish_response(Flow *f, int dir, const char *state) {
+    Stream *s = f->dir[dir];
+    if(s->inflating) {
+        inflateEnd(&s->zs);
+        s->inflating = 0;
+    }
+    if(s->inflate_error && strcmp(state, "ok") == 0) state = "error";
+    if(s->gap && strcmp(state, "ok") == 0) state = "gap";
+
+    char client[64], server[64], status[16], body[32], decoded[32], ratio[32];
+    format_endpoint(&f->key, !dir, client, sizeof(client));
+    format_endpoint(&f->key, dir, server, sizeof(server));
+    snprintf(status, sizeof(status), "%d", s->status);
+    snprintf(body, sizeof(body), "%llu", (unsigned long long)s->body_bytes);
+    snprintf(decoded, sizeof(decoded), "%llu", (unsigned long long)s->decoded_bytes);
+    if(s->body_bytes) snprintf(ratio, sizeof(ratio), "%.2f", (double)s->decoded_bytes / s->body_bytes);
+    else ratio[0] = 0;
+
+    put_field(client);
+    put_field(server);
+    put_field(s->request.method);
+    put_field(s->request.uri);
+    put_field(status);
+    put_field(s->content_type);
+    put_field(s->encoding);
+    put_field(s->framing);
+    put_field(body);
+    put_field(decoded);
+    put_field(ratio);
+    fprintf(out, "%s\n", state);
+
+    responses++;
+    total_body += s->body_bytes;
+    total_decoded += s->decoded_bytes;
+    s->gap = 0;
+    s->state = HTTP_HEADERS;
+    s->header_len = 0;
+}
+
+// Function to feed entity bytes (chunk framing removed) to the decoder
+static void body_data(Stream *s, const uint8_t *p, uint32_t n) {
+    s->body_bytes += n;
+    if(!s->inflating || s->inflate_error) {
+        if(!s->inflating) s->decoded_bytes += n;   // identity
+        return;
+    }
+    s->zs.next_in = (uint8_t *)p;
+    s->zs.avail_in = n;
+    while(s->zs.avail_in > 0) {
+        s->zs.next_out = inflate_buf;
+        s->zs.avail_out = sizeof(inflate_buf);
+        int ret = inflate(&s->zs, Z_NO_FLUSH);
+        s->decoded_bytes += sizeof(inflate_buf) - s->zs.avail_out;
+        if(ret == Z_DATA_ERROR && !s->raw_deflate_tried && s->body_bytes == n && strcasecmp(s->encoding, "deflate") == 0) {
+            // Some servers send raw deflate for "deflate": restart the first segment without a header
+            s->raw_deflate_tried = 1;
+            s->decoded_bytes = 0;
+            inflateEnd(&s->zs);
+            memset(&s->zs, 0, sizeof(s->zs));
+            if(inflateInit2(&s->zs, -15) != Z_OK) {
+                s->inflating = 0;
+                s->inflate_error = 1;
+                return;
+            }
+            s->zs.next_in = (uint8_t *)p;
+            s->zs.avail_in = n;
+            continue;
+        }
+        if(ret == Z_STREAM_END) {
+            // gzip allows several members back to back
+            if(s->zs.avail_in > 0 && inflateReset(&s->zs) == Z_OK) continue;
+            break;
+        }
+        if(ret != Z_OK && ret != Z_BUF_ERROR) {
+            s->inflate_error = 1;
+            return;
+        }
+        if(ret == Z_BUF_ERROR && s->zs.avail_out != 0) break;
+    }
+}
+
+// Function to find a header value in a header block (case-insensitive name)
+static int header_value(const char *block, const char *name, char *out, size_t size) {
+    size_t name_len = strlen(name);
+    const char *p = strstr(block, "\r\n");
+    while(p) {
+        p += 2;
+        if(strncasecmp(p, name, name_len) == 0 && p[name_len] == ':') {
+            const char *v = p + name_len + 1;
+            while(*v == ' ' || *v == '\t') v++;
+            const char *end = strstr(v, "\r\n");
+            size_t len = end ? (size_t)(end - v) : strlen(v);
+            while(len > 0 && (v[len - 1] == ' ' || v[len - 1] == '\t')) len--;
+            if(len >= size) len = size - 1;
+            memcpy(out, v, len);
+            out[len] = 0;
+            return 1;
+        }
+        p = strstr(p, "\r\n");
+    }
+    out[0] = 0;
+    return 0;
+}
+
+// Function to act on a complete header block
+static void headers_done(Flow *f, int dir) {
+    Stream *s = f->dir[dir];
+    s->header[s->header_len] = 0;
+    char value[MAX_FIELD];
+
+    if(!s->is_response) {
+        // Request: remember method and target for the response coming back
+        Request r = {{0}, {0}};
+        sscanf(s->header, "%15s %255s", r.method, r.uri);
+        char host[MAX_FIELD];
+        size_t host_len = header_value(s->header, "Host", host, sizeof(host)) ? strlen(host) : 0;
+        size_t uri_len = strlen(r.uri);
+        if(host_len && r.uri[0] == '/' && host_len + uri_len < sizeof(r.uri)) {
+            memmove(r.uri + host_len, r.uri, uri_len + 1);
+            memcpy(r.uri, host, host_len);
+        }
+        if(f->pending_count < MAX_PENDING_REQUESTS) {
+            f->pending[(f->pending_head + f->pending_count++) % MAX_PENDING_REQUESTS] = r;
+        }
+        // Request bodies are skipped, not reported
+        s->header_len = 0;
+        if(header_value(s->header, "Content-Length", value, sizeof(value)) && (s->remaining = strtoull(value, NULL, 10)) > 0) {
+            s->state = HTTP_BODY_LENGTH;
+        } else {
+            s->state = HTTP_HEADERS;
+        }
+        return;
+    }
+
+    // Response: pair it with the oldest outstanding request (1xx interim ones leave it pending)
+    s->status = 0;
+    sscanf(s->header, "HTTP/%*s %d", &s->status);
+    memset(&s->request, 0, sizeof(s->request));
+    if(f->pending_count > 0) {
+        s->request = f->pending[f->pending_head];
+        if(s->status >= 200 || s->status == 101) {
+            f->pending_head = (f->pending_head + 1) % MAX_PENDING_REQUESTS;
+            f->pending_count--;
+        }
+    }
+    header_value(s->header, "Content-Type", s->content_type, sizeof(s->content_type));
+    header_value(s->header, "Content-Encoding", s->encoding, sizeof(s->encoding));
+    s->body_bytes = s->decoded_bytes = 0;
+    s->inflate_error = 0;
+    s->raw_deflate_tried = 0;
+    s->header_len = 0;
+
+    int no_body = (s->status >= 100 && s->status < 200) || s->status == 204 || s->status == 304 ||
+                  strcmp(s->request.method, "HEAD") == 0;
+    if(no_body) {
+        s->framing = "none";
+        if(s->status >= 200) finish_response(f, dir, "ok");
+        else s->state = HTTP_HEADERS;   // interim response: not reported
+        return;
+    }
+
+    if(strcasecmp(s->encoding, "gzip") == 0 || strcasecmp(s->encoding, "x-gzip") == 0 || strcasecmp(s->encoding, "deflate") == 0) {
+        memset(&s->zs, 0, sizeof(s->zs));
+        s->inflating = inflateInit2(&s->zs, 15 + 32) == Z_OK;  // zlib or gzip header, detected
+        s->inflate_error = !s->inflating;
+    }
+
+    if(header_value(s->header, "Transfer-Encoding", value, sizeof(value)) && strcasestr(value, "chunked")) {
+        s->framing = "chunked";
+        s->state = HTTP_CHUNK_SIZE;
+        s->line_len = 0;
+    } else if(header_value(s->header, "Content-Length", value, sizeof(value))) {
+        s->framing = "length";
+        s->remaining = strtoull(value, NULL, 10);
+        s->state = HTTP_BODY_LENGTH;
+        if(s->remaining == 0) finish_response(f, dir, "ok");
+    } else {
+        s->framing = "close";
+        s->state = HTTP_BODY_CLOSE;
+    }
+}
+
+// Function to run the HTTP parser over in-order stream bytes
+static void http_data(Flow *f, int dir, const uint8_t *p, uint32_t n) {
+    Stream *s = f->dir[dir];
+    while(n > 0) {
+        switch(s->state) {
+        case HTTP_NOT_HTTP:
+            return;
+
+        case HTTP_UNKNOWN:
+            // Decide once per direction: responses start with "HTTP/", requests with a method
+            if(n >= 5 && memcmp(p, "HTTP/", 5) == 0) s->is_response = 1;
+            else if(n >= 4 && (memcmp(p, "GET ", 4) == 0 || memcmp(p, "POST", 4) == 0 || memcmp(p, "HEAD", 4) == 0 ||
+                               memcmp(p, "PUT ", 4) == 0 || memcmp(p, "DELE", 4) == 0 || memcmp(p, "OPTI", 4) == 0 ||
+                               memcmp(p, "PATC", 4) == 0 || memcmp(p, "CONN", 4) == 0 || memcmp(p, "TRAC", 4) == 0)) s->is_response = 0;
+            else {
+                s->state = HTTP_NOT_HTTP;
+                return;
+            }
+            s->state = HTTP_HEADERS;
+            s->header_len = 0;
+            break;
+
+        case HTTP_HEADERS: {
+            // Copy until the blank line; the terminator may straddle segments
+            uint32_t take = 0;
+            int done = 0;
+            while(take < n) {
+                if(s->header_len == MAX_HEADER_BYTES - 1) {
+                    s->state = HTTP_NOT_HTTP;   // runaway header block
+                    return;
+                }
+                s->header[s->header_len++] = p[take++];
+                if(s->header_len >= 4 && memcmp(s->header + s->header_len - 4, "\r\n\r\n", 4) == 0) {
+                    done = 1;
+                    break;
+                }
+            }
+            p += take;
+            n -= take;
+            if(done) headers_done(f, dir);
+            break;
+        }
+
+        case HTTP_BODY_LENGTH: {
+            uint32_t take = s->remaining < n ? s->remaining : n;
+            if(s->is_response) body_data(s, p, take);
+            p += take;
+            n -= take;
+            s->remaining -= take;
+            if(s->remaining == 0) {
+                if(s->is_response) finish_response(f, dir, "ok");
+                else s->state = HTTP_HEADERS;
+            }
+            break;
+        }
+
+        case HTTP_CHUNK_SIZE:
+        case HTTP_CHUNK_END:
+        case HTTP_TRAILERS: {
+            // Line-oriented states
+            uint8_t c = *p++;
+            n--;
+            if(s->line_len < (int)sizeof(s->line) - 1) s->line[s->line_len++] = c;
+            if(c != '\n') break;
+            s->line[s->line_len] = 0;
+            int empty = s->line_len <= 2;
+            s->line_len = 0;
+
+            if(s->state == HTTP_CHUNK_END) {
+                s->state = HTTP_CHUNK_SIZE;
+            } else if(s->state == HTTP_TRAILERS) {
+                if(empty) finish_response(f, dir, "ok");
+            } else {
+                char *end;
+                s->remaining = strtoull(s->line, &end, 16);
+                if(end == s->line) {
+                    finish_response(f, dir, "error");
+                    s->state = HTTP_NOT_HTTP;
+                    return;
+                }
+                s->state = s->remaining ? HTTP_CHUNK_DATA : HTTP_TRAILERS;
+            }
+            break;
+        }
+
+        case HTTP_CHUNK_DATA: {
+            uint32_t take = s->remaining < n ? s->remaining : n;
+            body_data(s, p, take);
+            p += take;
+            n -= take;
+            s->remaining -= take;
+            if(s->remaining == 0) s->state = HTTP_CHUNK_END;
+            break;
+        }
+
+        case HTTP_BODY_CLOSE:
+            body_data(s, p, n);
+            return;
+        }
+    }
+}
+
+// Function to hand over bytes that were lost from the capture. Messages with a
+// known length can skip them; anything else loses its framing.
+static void http_gap(Flow *f, int dir, uint32_t n) {
+    Stream *s = f->dir[dir];
+    gaps++;
+    s->gap = 1;
+    if(s->inflating) s->inflate_error = 1;    // the compressed stream cannot resume
+    if((s->state == HTTP_BODY_LENGTH || s->state == HTTP_CHUNK_DATA) && n <= s->remaining) {
+        s->remaining -= n;
+        s->body_bytes += n;
+        if(s->remaining == 0) {
+            if(s->state == HTTP_CHUNK_DATA) s->state = HTTP_CHUNK_END;
+            else if(s->is_response) finish_response(f, dir, "gap");
+            else s->state = HTTP_HEADERS;
+        }
+    } else if(s->state == HTTP_BODY_CLOSE) {
+        s->body_bytes += n;
+    } else if(s->state != HTTP_NOT_HTTP && s->state != HTTP_UNKNOWN) {
+        if(s->is_response && s->state != HTTP_HEADERS) finish_response(f, dir, "gap");
+        s->state = HTTP_NOT_HTTP;
+    }
+}
+
+// Function to deliver in-order bytes, then anything buffered that now fits
+static void deliver(Flow *f, int dir, const uint8_t *p, uint32_t n) {
+    Stream *s = f->dir[dir];
+    http_data(f, dir, p, n);
+    s->next_seq += n;
+
+    while(s->ooo && (int32_t)(s->ooo->seq - s->next_seq) <= 0) {
+        Segment *seg = s->ooo;
+        s->ooo = seg->next;
+        s->ooo_count--;
+        s->ooo_bytes -= seg->len;
+        uint32_t skip = s->next_seq - seg->seq;
+        if(skip < seg->len) {
+            http_data(f, dir, seg->data + skip, seg->len - skip);
+            s->next_seq += seg->len - skip;
+        }
+        free(seg);
+    }
+}
+
+// Function to give up waiting for a hole: skip to the first buffered segment
+static void skip_hole(Flow *f, int dir) {
+    Stream *s = f->dir[dir];
+    Segment *seg = s->ooo;
+    http_gap(f, dir, seg->seq - s->next_seq);
+    s->next_seq = seg->seq;
+    deliver(f, dir, NULL, 0);
+}
+
+// Function to flush and free one direction once no more data can arrive for it
+static void close_stream(Flow *f, int dir) {
+    Stream *s = f->dir[dir];
+    if(!s) return;
+    while(s->ooo) skip_hole(f, dir);
+    if(s->is_response && s->state == HTTP_BODY_CLOSE) finish_response(f, dir, "ok");
+    else if(s->is_response && s->state != HTTP_HEADERS && s->state != HTTP_NOT_HTTP && s->state != HTTP_UNKNOWN) {
+        finish_response(f, dir, "truncated");
+    }
+    if(s->inflating) inflateEnd(&s->zs);
+    free(s);
+    f->dir[dir] = NULL;
+}
+
+// Function to free a finished connection and leave a dead entry in its slot
+static void release_flow(Flow *f) {
+    close_stream(f, 0);
+    close_stream(f, 1);
+    f->used = FLOW_DEAD;
+    flows_live--;
+    flows_dead++;
+}
+
+// Function to process one TCP segment
+static void tcp_segment(const uint8_t *src, const uint8_t *dst, int family, const uint8_t *tcp, uint32_t len) {
+    if(len < 20) return;
+    uint32_t hdr_len = (tcp[12] >> 4) * 4;
+    if(hdr_len < 20 || hdr_len > len) return;
+    uint16_t sport = tcp[0] << 8 | tcp[1], dport = tcp[2] << 8 | tcp[3];
+    uint32_t seq = (uint32_t)tcp[4] << 24 | tcp[5] << 16 | tcp[6] << 8 | tcp[7];
+    uint8_t flags = tcp[13];
+    const uint8_t *data = tcp + hdr_len;
+    uint32_t n = len - hdr_len;
+    segments++;
+
+    // A bare ACK (or FIN/RST) of an unknown connection has nothing to reassemble; not adding
+    // it also keeps the last ACK of a released connection from bringing its flow back
+    int dir;
+    Flow *f = get_flow(src, sport, dst, dport, family, n > 0 || (flags & 0x02), &dir);
+    if(!f) return;
+    if(!f->dir[dir]) {
+        f->dir[dir] = calloc(1, sizeof(Stream));
+        if(!f->dir[dir]) {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+    }
+    Stream *s = f->dir[dir];
+
+    if(flags & 0x02) {      // SYN: data starts right after it
+        s->started = 1;
+        s->next_seq = seq + 1;
+        return;
+    }
+    if(!s->started) {       // joined mid-stream: take the first segment as the start
+        if(n == 0) return;
+        s->started = 1;
+        s->next_seq = seq;
+    }
+
+    if(n > 0) {
+        int32_t ahead = seq - s->next_seq;
+        if(ahead <= 0) {
+            // In order, or a retransmit overlapping what we have: trim the old part
+            uint32_t old = -ahead;
+            if(old >= n) {
+                retransmitted++;
+            } else {
+                if(old) retransmitted++;
+                deliver(f, dir, data + old, n - old);
+            }
+        } else {
+            // Out of order: hold it (sorted, no duplicates) until the hole fills
+            reordered++;
+            Segment **pos = &s->ooo;
+            while(*pos && (int32_t)((*pos)->seq - seq) < 0) pos = &(*pos)->next;
+            if(!(*pos && (*pos)->seq == seq && (*pos)->len >= n)) {
+                Segment *seg = malloc(sizeof(Segment) + n);
+                if(!seg) {
+                    perror("Memory allocation failed");
+                    exit(1);
+                }
+                seg->seq = seq;
+                seg->len = n;
+                memcpy(seg->data, data, n);
+                seg->next = *pos;
+                *pos = seg;
+                s->ooo_count++;
+                s->ooo_bytes += n;
+            }
+            // Bounded: if the hole is not filled in time, count it lost and move on
+            while(s->ooo && (s->ooo_count > MAX_OOO_SEGMENTS || s->ooo_bytes > MAX_OOO_BYTES)) skip_hole(f, dir);
+        }
+    }
+
+    if(flags & 0x05) {      // FIN or RST: whatever is still held will never be completed
+        while(s->ooo) skip_hole(f, dir);
+        if(s->state == HTTP_BODY_CLOSE) finish_response(f, dir, "ok");
+        s->closed = 1;
+        // RST ends both directions; otherwise wait for the other side's FIN
+        if((flags & 0x04) || !f->dir[!dir] || f->dir[!dir]->closed) release_flow(f);
+    }
+}
+
+// Function to decode one frame down to TCP
+static void handle_frame(const uint8_t *p, uint32_t caplen, int linktype) {
+    const uint8_t *end = p + caplen;
+    int ethertype;
+    frames++;
+    if(linktype == 1) {
+        if(caplen < 14) return;
+        ethertype = p[12] << 8 | p[13];
+        p += 14;
+        while((ethertype == 0x8100 || ethertype == 0x88a8) && p + 4 <= end) {
+            ethertype = p[2] << 8 | p[3];
+            p += 4;
+        }
+    } else if(linktype == 113) {
+        if(caplen < 16) return;
+        ethertype = p[14] << 8 | p[15];
+        p += 16;
+    } else if(linktype == 101 || linktype == 228 || linktype == 229 || linktype == 12) {
+        if(caplen < 1) return;
+        ethertype = (p[0] >> 4) == 6 ? 0x86dd : 0x0800;
+    } else {
+        return;
+    }
+
+    uint8_t src[16] = {0}, dst[16] = {0};
+    if(ethertype == 0x0800) {
+        if(p + 20 > end) return;
+        uint32_t ihl = (p[0] & 0x0f) * 4, total = p[2] << 8 | p[3];
+        if(p[9] != 6 || (p[6] << 8 | p[7]) & 0x3fff) return;     // TCP, unfragmented
+        if(total < ihl || p + total > end) total = end - p;      // trailer padding or snaplen
+        src[10] = src[11] = dst[10] = dst[11] = 0xff;
+        memcpy(src + 12, p + 12, 4);
+        memcpy(dst + 12, p + 16, 4);
+        if(ihl < 20 || ihl > total) return;
+        tcp_segment(src, dst, 4, p + ihl, total - ihl);
+    } else if(ethertype == 0x86dd) {
+        if(p + 40 > end || p[6] != 6) return;     // TCP directly after the fixed header
+        uint32_t payload = p[4] << 8 | p[5];
+        if(p + 40 + payload > end) payload = end - p - 40;
+        memcpy(src, p + 8, 16);
+        memcpy(dst, p + 24, 16);
+        tcp_segment(src, dst, 6, p + 40, payload);
+    }
+}
+
+static uint32_t rd32(const uint8_t *p, int swap) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "o:")) != -1) {
+        if(opt == 'o') out_path = optarg;
+        else {
+            fprintf(stderr, "Usage: %s [-o out.csv] capture.pcap\n", argv[0]);
+            return 1;
+        }
+    }
+    if(optind != argc - 1) {
+        fprintf(stderr, "Usage: %s [-o out.csv] capture.pcap\n", argv[0]);
+        return 1;
+    }
+
+    int fd = open(argv[optind], O_RDONLY);
+    if(fd < 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size < 24) {
+        fprintf(stderr, "%s: not a capture file\n", argv[optind]);
+        return 1;
+    }
+    const uint8_t *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        perror("mmap failed");
+        return 1;
+    }
+    madvise((void *)p, st.st_size, MADV_SEQUENTIAL);
+
+    out = out_path ? fopen(out_path, "w") : stdout;
+    if(!out) {
+        perror(out_path);
+        return 1;
+    }
+    fprintf(out, "client,server,method,uri,status,content_type,encoding,framing,body_bytes,decoded_bytes,ratio,state\n");
+
+    size_t size = st.st_size, off;
+    uint32_t magic;
+    memcpy(&magic, p, 4);
+    if(magic == 0xa1b2c3d4 || magic == 0xd4c3b2a1 || magic == 0xa1b23c4d || magic == 0x4d3cb2a1) {
+        int swap = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+        int linktype = rd32(p + 20, swap) & 0xffff;
+        for(off = 24; off + 16 <= size; ) {
+            uint32_t caplen = rd32(p + off + 8, swap);
+            off += 16;
+            if(caplen > size - off) break;
+            handle_frame(p + off, caplen, linktype);
+            off += caplen;
+        }
+    } else if(magic == 0x0a0d0d0a) {
+        // pcapng: section headers, interface descriptions and (enhanced) packet blocks
+        int swap = 0, linktype[32], interfaces = 0;
+        for(off = 0; off + 12 <= size; ) {
+            uint32_t type = rd32(p + off, swap);
+            if(type == 0x0a0d0d0a) {
+                uint32_t bom;
+                memcpy(&bom, p + off + 8, 4);
+                swap = bom == 0x4d3c2b1a;
+                interfaces = 0;
+            }
+            uint32_t len = rd32(p + off + 4, swap);
+            if(len < 12 || len > size - off) break;
+            const uint8_t *body = p + off + 8;
+            if(type == 1 && len >= 20 && interfaces < 32) {
+                linktype[interfaces++] = swap ? body[0] << 8 | body[1] : body[1] << 8 | body[0];
+            } else if((type == 6 || type == 2) && len >= 32) {
+                uint32_t ifc = type == 6 ? rd32(body, swap) : (swap ? body[0] << 8 | body[1] : body[1] << 8 | body[0]);
+                uint32_t caplen = rd32(body + 12, swap);
+                if(ifc < (uint32_t)interfaces && caplen <= len - 32) handle_frame(body + 20, caplen, linktype[ifc]);
+            }
+            off += len;
+        }
+    } else {
+        fprintf(stderr, "%s: unknown capture format\n", argv[optind]);
+        return 1;
+    }
+
+    // End of capture: flush what can be flushed, report bodies still open
+    for(uint32_t i = 0; i < flow_capacity; i++) {
+        if(flows[i].used == FLOW_USED) release_flow(&flows[i]);
+    }
+    if(out != stdout) fclose(out);
+
+    fprintf(stderr, "%llu frames, %llu TCP segments in %u flows, %llu retransmitted, %llu out of order, %llu gaps\n",
+            frames, segments, flow_count, retransmitted, reordered, gaps);
+    fprintf(stderr, "%llu responses, %llu body bytes -> %llu decoded (ratio %.2f)\n",
+            responses, total_body, total_decoded, total_body ? (double)total_decoded / total_body : 0);
+    free(flows);
+    munmap((void *)p, st.st_size);
+    return 0;
+}
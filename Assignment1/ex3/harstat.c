@@ -0,0 +1,661 @@
+/*
+ * harstat: one-pass HAR summaries over many files, grouped by throttling config.
+ *
+ * Each HAR file is mmap'ed and walked once by a small on-demand JSON parser
+ * that never builds a tree: it follows only the paths the ex3 notebook reads
+ * and skips everything else (headers, cookies, base64 bodies) with memchr.
+ * For the first page of every file it computes
+ *
+ *   - page load time (pageTimings.onLoad), as HarPage.page_load_time
+ *   - request count and total response._transferSize, as request_summary()
+ *   - count / bytes per content class, as content_type_analysis()
+ *   - quantile sketches of timings.receive and _transferSize (the CDF cells)
+ *
+ * Files are spread over worker threads and merged per config. The config is
+ * the part of the file name after the last '_' (IndiaPost_Config1.har ->
+ * Config1), or with -g dir the name of the directory holding the file.
+ *
+ * The sketches are log-bucketed histograms with 1% relative error, so they
+ * merge exactly across files; -c writes them out as CDF points.
+ *
+ * Build: gcc -O2 -pthread -o harstat harstat.c -lm
+ * Usage: harstat [-g suffix|dir] [-j threads] [-o summary.csv] [-c cdf.csv] file.har...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define MAX_THREADS 64
+#define MAX_PAGES 16            // pages tracked per file (only the first is reported)
+#define MAX_ID 128
+#define MAX_CONFIG 128
+#define MAX_CONFIGS 256
+#define SKETCH_ALPHA 0.01       // relative accuracy of the quantile sketches
+#define SKETCH_MIN 1e-3         // smallest value told apart from zero
+#define SKETCH_BUCKETS 2048     // covers SKETCH_MIN .. ~1e15
+
+// Content classes, as content_type_analysis()
+#define CLASS_HTML 0
+#define CLASS_CSS 1
+#define CLASS_JS 2
+#define CLASS_IMAGE 3
+#define CLASS_COUNT 4
+const char *class_names[CLASS_COUNT] = {"text/html", "text/css", "application/javascript", "image"};
+
+// Nodes of the JSON paths we care about; everything else is NODE_OTHER
+enum {
+    NODE_OTHER, NODE_ROOT, NODE_LOG,
+    NODE_PAGES, NODE_PAGE, NODE_PAGE_ID, NODE_PAGE_TIMINGS, NODE_ONLOAD,
+    NODE_ENTRIES, NODE_ENTRY, NODE_PAGEREF, NODE_RESPONSE, NODE_TRANSFER_SIZE,
+    NODE_CONTENT, NODE_MIME, NODE_TIMINGS, NODE_RECEIVE
+};
+
+typedef struct {
+    uint64_t zero;          // values below SKETCH_MIN
+    uint64_t count;
+    uint32_t buckets[SKETCH_BUCKETS];
+} Sketch;
+
+typedef struct {
+    char id[MAX_ID];        // pageref of the entries counted here
+    uint64_t requests, transfer;
+    uint64_t class_count[CLASS_COUNT], class_bytes[CLASS_COUNT];
+    Sketch *receive, *size;
+} PageStats;
+
+typedef struct {
+    const char *path;
+    char config[MAX_CONFIG];
+    char first_page[MAX_ID];    // id of log.pages[0]
+    double onload;              // its pageTimings.onLoad, NAN if absent
+    int page_count;             // pages listed in log.pages
+    PageStats pages[MAX_PAGES]; // entries grouped by pageref
+    int slot_count;
+    int error;
+} FileJob;
+
+// Fields of the entry being parsed
+typedef struct {
+    char pageref[MAX_ID];
+    double transfer_size;
+    double receive;
+    int content_class;
+} Entry;
+
+// Parser state for one file
+typedef struct {
+    const char *p, *end;
+    FileJob *job;
+    Entry entry;
+    int page_index;         // index in log.pages of the page being parsed
+    int error;
+} Parser;
+
+double sketch_gamma_log;
+
+FileJob *jobs;
+int job_count;
+int next_job = 0;
+int group_by_dir = 0;
+
+// Function to add a value to a sketch
+static void sketch_add(Sketch *s, double v) {
+    s->count++;
+    if(!(v >= SKETCH_MIN)) {        // also catches NAN and negative "not available" values
+        s->zero++;
+        return;
+    }
+    int i = (int)ceil(log(v / SKETCH_MIN) / sketch_gamma_log);
+    if(i >= SKETCH_BUCKETS) i = SKETCH_BUCKETS - 1;
+    s->buckets[i]++;
+}
+
+static void sketch_merge(Sketch *into, const Sketch *from) {
+    into->zero += from->zero;
+    into->count += from->count;
+    for(int i = 0; i < SKETCH_BUCKETS; i++) into->buckets[i] += from->buckets[i];
+}
+
+// Representative value of a bucket (within SKETCH_ALPHA of everything in it)
+static double sketch_value(int i) {
+    return SKETCH_MIN * 2 * exp(i * sketch_gamma_log) / (exp(sketch_gamma_log) + 1);
+}
+
+static double sketch_quantile(const Sketch *s, double q) {
+    if(s->count == 0) return NAN;
+    uint64_t rank = (uint64_t)(q * (s->count - 1)), seen = s->zero;
+    if(rank < seen) return 0;
+    for(int i = 0; i < SKETCH_BUCKETS; i++) {
+        seen += s->buckets[i];
+        if(rank < seen) return sketch_value(i);
+    }
+    return sketch_value(SKETCH_BUCKETS - 1);
+}
+
+// Function to find (or add) the stats slot of a page id
+static PageStats *page_slot(FileJob *job, const char *id) {
+    for(int i = 0; i < job->slot_count; i++) {
+        if(strcmp(job->pages[i].id, id) == 0) return &job->pages[i];
+    }
+    if(job->slot_count == MAX_PAGES) return NULL;
+    PageStats *ps = &job->pages[job->slot_count++];
+    snprintf(ps->id, sizeof(ps->id), "%s", id);
+    ps->receive = calloc(1, sizeof(Sketch));
+    ps->size = calloc(1, sizeof(Sketch));
+    if(!ps->receive || !ps->size) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    return ps;
+}
+
+// Function to step from a node to the child under an object key
+static int child_node(int node, const char *key, size_t len) {
+#define KEY(s) (len == sizeof(s) - 1 && memcmp(key, s, len) == 0)
+    switch(node) {
+    case NODE_ROOT: return KEY("log") ? NODE_LOG : NODE_OTHER;
+    case NODE_LOG:
+        if(KEY("pages")) return NODE_PAGES;
+        if(KEY("entries")) return NODE_ENTRIES;
+        return NODE_OTHER;
+    case NODE_PAGE:
+        if(KEY("id")) return NODE_PAGE_ID;
+        if(KEY("pageTimings")) return NODE_PAGE_TIMINGS;
+        return NODE_OTHER;
+    case NODE_PAGE_TIMINGS: return KEY("onLoad") ? NODE_ONLOAD : NODE_OTHER;
+    case NODE_ENTRY:
+        if(KEY("pageref")) return NODE_PAGEREF;
+        if(KEY("response")) return NODE_RESPONSE;
+        if(KEY("timings")) return NODE_TIMINGS;
+        return NODE_OTHER;
+    case NODE_RESPONSE:
+        if(KEY("_transferSize")) return NODE_TRANSFER_SIZE;
+        if(KEY("content")) return NODE_CONTENT;
+        return NODE_OTHER;
+    case NODE_CONTENT: return KEY("mimeType") ? NODE_MIME : NODE_OTHER;
+    case NODE_TIMINGS: return KEY("receive") ? NODE_RECEIVE : NODE_OTHER;
+    }
+    return NODE_OTHER;
+#undef KEY
+}
+
+static void skip_ws(Parser *ps) {
+    while(ps->p < ps->end && (*ps->p == ' ' || *ps->p == '\n' || *ps->p == '\r' || *ps->p == '\t')) ps->p++;
+}
+
+// Function to skip a string (ps->p on the opening quote). Returns its raw contents.
+static const char *scan_string(Parser *ps, size_t *len) {
+    const char *start = ++ps->p;
+    for(;;) {
+        const char *q = memchr(ps->p, '"', ps->end - ps->p);
+        if(!q) {
+            ps->error = 1;
+            ps->p = ps->end;
+            *len = 0;
+            return start;
+        }
+        // Escaped if preceded by an odd number of backslashes
+        const char *b = q;
+        while(b > start && b[-1] == '\\') b--;
+        ps->p = q + 1;
+        if((q - b) % 2 == 0) {
+            *len = q - start;
+            return start;
+        }
+    }
+}
+
+// Function to copy a string value, decoding the simple escapes
+static void copy_string(const char *s, size_t len, char *out, size_t size) {
+    size_t n = 0;
+    for(size_t i = 0; i < len && n + 1 < size; i++) {
+        if(s[i] == '\\' && i + 1 < len) {
+            i++;
+            if(s[i] == 'u') { out[n++] = '?'; i += 4; continue; }
+            out[n++] = s[i] == 'n' ? '\n' : s[i] == 't' ? '\t' : s[i];
+        } else {
+            out[n++] = s[i];
+        }
+    }
+    out[n] = 0;
+}
+
+// Function to find the next '"', '{', '}', '[' or ']' (16 bytes at a time with SSE2)
+static const char *next_structural(const char *p, const char *end) {
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i open_brace = _mm_set1_epi8('{'), close_brace = _mm_set1_epi8('}');
+    const __m128i open_bracket = _mm_set1_epi8('['), close_bracket = _mm_set1_epi8(']');
+    while(end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                      _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, open_brace), _mm_cmpeq_epi8(v, close_brace)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, open_bracket), _mm_cmpeq_epi8(v, close_bracket))));
+        int mask = _mm_movemask_epi8(hit);
+        if(mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while(p < end && *p != '"' && *p != '{' && *p != '}' && *p != '[' && *p != ']') p++;
+    return p;
+}
+
+// Function to skip any value without looking inside it
+static void skip_value(Parser *ps) {
+    char c = *ps->p;
+    if(c == '"') {
+        size_t len;
+        scan_string(ps, &len);
+        return;
+    }
+    if(c != '{' && c != '[') {
+        // Scalar: runs to the next separator
+        while(ps->p < ps->end && *ps->p != ',' && *ps->p != '}' && *ps->p != ']') ps->p++;
+        return;
+    }
+    int depth = 0;
+    for(;;) {
+        ps->p = next_structural(ps->p, ps->end);
+        if(ps->p >= ps->end) {
+            ps->error = 1;
+            return;
+        }
+        c = *ps->p;
+        if(c == '"') {
+            size_t len;
+            scan_string(ps, &len);
+            continue;
+        }
+        ps->p++;
+        if(c == '{' || c == '[') depth++;
+        else if(--depth == 0) return;
+    }
+}
+
+static double parse_number(Parser *ps) {
+    char buf[64];
+    size_t n = 0;
+    while(ps->p < ps->end && n < sizeof(buf) - 1 && strchr("+-0123456789.eE", *ps->p)) buf[n++] = *ps->p++;
+    buf[n] = 0;
+    if(n == 0) {
+        skip_value(ps);     // null, true, false
+        return NAN;
+    }
+    return strtod(buf, NULL);
+}
+
+// Function to classify a mime type as content_type_analysis() does
+static int content_class(const char *mime) {
+    for(int i = 0; i < CLASS_IMAGE; i++) {
+        if(strcmp(mime, class_names[i]) == 0) return i;
+    }
+    if(strncmp(mime, "image/", 6) == 0) return CLASS_IMAGE;
+    return -1;
+}
+
+// Function to account the entry that was just parsed
+static void commit_entry(Parser *ps) {
+    Entry *e = &ps->entry;
+    PageStats *page = page_slot(ps->job, e->pageref);
+    if(!page) return;
+    uint64_t size = e->transfer_size > 0 ? (uint64_t)e->transfer_size : 0;
+    page->requests++;
+    page->transfer += size;
+    if(e->content_class >= 0) {
+        page->class_count[e->content_class]++;
+        page->class_bytes[e->content_class] += size;
+    }
+    sketch_add(page->receive, e->receive);
+    sketch_add(page->size, e->transfer_size);
+}
+
+// Function to parse a value at a node of interest, descending only where needed
+static void parse_value(Parser *ps, int node) {
+    skip_ws(ps);
+    if(ps->p >= ps->end || ps->error) {
+        ps->error = 1;
+        return;
+    }
+    if(node == NODE_OTHER) {
+        skip_value(ps);
+        return;
+    }
+
+    char c = *ps->p;
+    if(c == '{') {
+        if(node == NODE_ENTRY) {
+            memset(&ps->entry, 0, sizeof(ps->entry));
+            ps->entry.transfer_size = NAN;
+            ps->entry.receive = NAN;
+            ps->entry.content_class = -1;
+        }
+        ps->p++;
+        for(;;) {
+            skip_ws(ps);
+            if(ps->p >= ps->end) { ps->error = 1; return; }
+            if(*ps->p == '}') { ps->p++; break; }
+            if(*ps->p == ',') { ps->p++; continue; }
+            if(*ps->p != '"') { ps->error = 1; return; }
+            size_t len;
+            const char *key = scan_string(ps, &len);
+            skip_ws(ps);
+            if(ps->p >= ps->end || *ps->p != ':') { ps->error = 1; return; }
+            ps->p++;
+            parse_value(ps, child_node(node, key, len));
+            if(ps->error) return;
+        }
+        if(node == NODE_ENTRY) commit_entry(ps);
+        return;
+    }
+    if(c == '[') {
+        int element = node == NODE_PAGES ? NODE_PAGE : node == NODE_ENTRIES ? NODE_ENTRY : NODE_OTHER;
+        ps->p++;
+        for(;;) {
+            skip_ws(ps);
+            if(ps->p >= ps->end) { ps->error = 1; return; }
+            if(*ps->p == ']') { ps->p++; break; }
+            if(*ps->p == ',') { ps->p++; continue; }
+            if(node == NODE_PAGES) ps->page_index = ps->job->page_count++;
+            parse_value(ps, element);
+            if(ps->error) return;
+        }
+        return;
+    }
+    if(c == '"') {
+        size_t len;
+        const char *s = scan_string(ps, &len);
+        char value[MAX_ID];
+        if(node == NODE_PAGE_ID) {
+            if(ps->page_index == 0) copy_string(s, len, ps->job->first_page, sizeof(ps->job->first_page));
+        } else if(node == NODE_PAGEREF) {
+            copy_string(s, len, ps->entry.pageref, sizeof(ps->entry.pageref));
+        } else if(node == NODE_MIME) {
+            copy_string(s, len, value, sizeof(value));
+            ps->entry.content_class = content_class(value);
+        }
+        return;
+    }
+
+    double v = parse_number(ps);
+    if(node == NODE_ONLOAD) {
+        if(ps->page_index == 0) ps->job->onload = v;
+    } else if(node == NODE_TRANSFER_SIZE) {
+        ps->entry.transfer_size = v;
+    } else if(node == NODE_RECEIVE) {
+        ps->entry.receive = v;
+    }
+}
+
+// Function to derive the throttling config of a file from its path
+static void config_name(const char *path, char *out) {
+    const char *base = strrchr(path, '/');
+    if(group_by_dir) {
+        if(!base) { strcpy(out, "."); return; }
+        const char *dir = base;
+        while(dir > path && dir[-1] != '/') dir--;
+        snprintf(out, MAX_CONFIG, "%.*s", (int)(base - dir), dir);
+        return;
+    }
+    base = base ? base + 1 : path;
+    const char *us = strrchr(base, '_');
+    const char *start = us ? us + 1 : base;
+    const char *dot = strrchr(start, '.');
+    snprintf(out, MAX_CONFIG, "%.*s", (int)(dot ? dot - start : (long)strlen(start)), start);
+}
+
+// Function to map and parse one HAR file
+static void scan_file(FileJob *job) {
+    config_name(job->path, job->config);
+    job->onload = NAN;
+    int fd = open(job->path, O_RDONLY);
+    if(fd < 0) {
+        perror(job->path);
+        job->error = 1;
+        return;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size == 0) {
+        fprintf(stderr, "%s: empty file\n", job->path);
+        close(fd);
+        job->error = 1;
+        return;
+    }
+    const char *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        perror("mmap failed");
+        job->error = 1;
+        return;
+    }
+    madvise((void *)p, st.st_size, MADV_SEQUENTIAL);
+
+    Parser ps = {.p = p, .end = p + st.st_size, .job = job};
+    if(ps.p + 3 <= ps.end && memcmp(ps.p, "\xef\xbb\xbf", 3) == 0) ps.p += 3;     // UTF-8 BOM
+    parse_value(&ps, NODE_ROOT);
+    if(ps.error) {
+        fprintf(stderr, "%s: malformed JSON near byte %ld\n", job->path, (long)(ps.p - p));
+        job->error = 1;
+    }
+    munmap((void *)p, st.st_size);
+}
+
+void *worker(void *arg) {
+    int i;
+    while((i = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED)) < job_count) {
+        scan_file(&jobs[i]);
+    }
+    return NULL;
+}
+
+// Per-config aggregate
+typedef struct {
+    char name[MAX_CONFIG];
+    int files;
+    double onload_sum;
+    int onload_count;
+    Sketch *onload;
+    uint64_t requests, transfer;
+    uint64_t class_count[CLASS_COUNT], class_bytes[CLASS_COUNT];
+    Sketch *receive, *size;
+} Config;
+
+Config configs[MAX_CONFIGS];
+int config_count = 0;
+
+static Config *get_config(const char *name) {
+    for(int i = 0; i < config_count; i++) {
+        if(strcmp(configs[i].name, name) == 0) return &configs[i];
+    }
+    if(config_count == MAX_CONFIGS) return NULL;
+    Config *c = &configs[config_count++];
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    c->onload = calloc(1, sizeof(Sketch));
+    c->receive = calloc(1, sizeof(Sketch));
+    c->size = calloc(1, sizeof(Sketch));
+    if(!c->onload || !c->receive || !c->size) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    return c;
+}
+
+static int cmp_configs(const void *a, const void *b) {
+    return strcmp(((const Config *)a)->name, ((const Config *)b)->name);
+}
+
+// Function to write a sketch as CDF points (one per non-empty bucket)
+static void write_cdf(FILE *f, const char *config, const char *metric, const Sketch *s) {
+    if(s->count == 0) return;
+    uint64_t seen = s->zero;
+    if(s->zero) fprintf(f, "%s,%s,0,%.6f\n", config, metric, (double)seen / s->count);
+    for(int i = 0; i < SKETCH_BUCKETS; i++) {
+        if(!s->buckets[i]) continue;
+        seen += s->buckets[i];
+        fprintf(f, "%s,%s,%.6g,%.6f\n", config, metric, sketch_value(i), (double)seen / s->count);
+    }
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-g suffix|dir] [-j threads] [-o summary.csv] [-c cdf.csv] file.har...\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *summary_path = NULL, *cdf_path = NULL;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while((opt = getopt(argc, argv, "g:j:o:c:")) != -1) {
+        switch(opt) {
+        case 'g':
+            if(strcmp(optarg, "dir") == 0) group_by_dir = 1;
+            else if(strcmp(optarg, "suffix") == 0) group_by_dir = 0;
+            else usage(argv[0]);
+            break;
+        case 'j': threads = atoi(optarg); break;
+        case 'o': summary_path = optarg; break;
+        case 'c': cdf_path = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if(optind >= argc) usage(argv[0]);
+    if(threads < 1) threads = 1;
+    if(threads > MAX_THREADS) threads = MAX_THREADS;
+    sketch_gamma_log = log((1 + SKETCH_ALPHA) / (1 - SKETCH_ALPHA));
+
+    job_count = argc - optind;
+    jobs = calloc(job_count, sizeof(FileJob));
+    if(!jobs) {
+        perror("Memory allocation failed");
+        return 1;
+    }
+    for(int i = 0; i < job_count; i++) jobs[i].path = argv[optind + i];
+    if(threads > job_count) threads = job_count;
+
+    pthread_t tids[MAX_THREADS];
+    for(int i = 0; i < threads; i++) pthread_create(&tids[i], NULL, worker, NULL);
+    for(int i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+
+    // Merge the first page of every file into its config (HarParser.pages[0].entries)
+    int errors = 0;
+    for(int i = 0; i < job_count; i++) {
+        FileJob *job = &jobs[i];
+        errors += job->error;
+        Config *c = job->error ? NULL : get_config(job->config);
+        if(c) {
+            c->files++;
+            if(!isnan(job->onload)) {
+                c->onload_sum += job->onload;
+                c->onload_count++;
+                sketch_add(c->onload, job->onload);
+            }
+        }
+        for(int k = 0; c && k < job->slot_count; k++) {
+            PageStats *page = &job->pages[k];
+            // Without log.pages every entry counts
+            if(job->page_count == 0 || strcmp(page->id, job->first_page) == 0) {
+                c->requests += page->requests;
+                c->transfer += page->transfer;
+                for(int j = 0; j < CLASS_COUNT; j++) {
+                    c->class_count[j] += page->class_count[j];
+                    c->class_bytes[j] += page->class_bytes[j];
+                }
+                sketch_merge(c->receive, page->receive);
+                sketch_merge(c->size, page->size);
+            }
+        }
+        for(int k = 0; k < job->slot_count; k++) {
+            free(job->pages[k].receive);
+            free(job->pages[k].size);
+        }
+    }
+    qsort(configs, config_count, sizeof(Config), cmp_configs);
+
+    // Report in the order of the notebook
+    printf("Page Load Times (mean / median over files):\n");
+    for(int i = 0; i < config_count; i++) {
+        Config *c = &configs[i];
+        if(c->onload_count) printf("%s: %.2f ms / %.2f ms (%d files)\n", c->name, c->onload_sum / c->onload_count,
+                                   sketch_quantile(c->onload, 0.5), c->files);
+        else printf("%s: n/a (%d files)\n", c->name, c->files);
+    }
+    printf("\nRequest and Data Transfer Summary (per file):\n");
+    for(int i = 0; i < config_count; i++) {
+        Config *c = &configs[i];
+        printf("%s: %.1f requests, %.2f KB transferred\n", c->name, (double)c->requests / c->files,
+               c->transfer / 1024.0 / c->files);
+    }
+    printf("\nContent-Type Analysis (per file):\n");
+    for(int i = 0; i < config_count; i++) {
+        Config *c = &configs[i];
+        printf("\n%s:\n", c->name);
+        for(int k = 0; k < CLASS_COUNT; k++) {
+            printf("%s: %.1f requests, %.2f KB\n", class_names[k], (double)c->class_count[k] / c->files,
+                   c->class_bytes[k] / 1024.0 / c->files);
+        }
+    }
+    printf("\nDownload Time / Response Size quantiles (p10 p50 p90 p99):\n");
+    for(int i = 0; i < config_count; i++) {
+        Config *c = &configs[i];
+        printf("%s: %.1f %.1f %.1f %.1f ms / %.0f %.0f %.0f %.0f bytes\n", c->name,
+               sketch_quantile(c->receive, 0.1), sketch_quantile(c->receive, 0.5),
+               sketch_quantile(c->receive, 0.9), sketch_quantile(c->receive, 0.99),
+               sketch_quantile(c->size, 0.1), sketch_quantile(c->size, 0.5),
+               sketch_quantile(c->size, 0.9), sketch_quantile(c->size, 0.99));
+    }
+
+    if(summary_path) {
+        FILE *f = fopen(summary_path, "w");
+        if(!f) {
+            perror(summary_path);
+            return 1;
+        }
+        fprintf(f, "config,files,onload_mean_ms,onload_p50_ms,requests,transfer_bytes");
+        for(int k = 0; k < CLASS_COUNT; k++) fprintf(f, ",%s_count,%s_bytes", class_names[k], class_names[k]);
+        fprintf(f, ",receive_p50_ms,receive_p90_ms,receive_p99_ms,size_p50,size_p90,size_p99\n");
+        for(int i = 0; i < config_count; i++) {
+            Config *c = &configs[i];
+            fprintf(f, "%s,%d,%.3f,%.3f,%llu,%llu", c->name, c->files,
+                    c->onload_count ? c->onload_sum / c->onload_count : NAN, sketch_quantile(c->onload, 0.5),
+                    (unsigned long long)c->requests, (unsigned long long)c->transfer);
+            for(int k = 0; k < CLASS_COUNT; k++) {
+                fprintf(f, ",%llu,%llu", (unsigned long long)c->class_count[k], (unsigned long long)c->class_bytes[k]);
+            }
+            fprintf(f, ",%.3f,%.3f,%.3f,%.0f,%.0f,%.0f\n",
+                    sketch_quantile(c->receive, 0.5), sketch_quantile(c->receive, 0.9), sketch_quantile(c->receive, 0.99),
+                    sketch_quantile(c->size, 0.5), sketch_quantile(c->size, 0.9), sketch_quantile(c->size, 0.99));
+        }
+        fclose(f);
+    }
+    if(cdf_path) {
+        FILE *f = fopen(cdf_path, "w");
+        if(!f) {
+            perror(cdf_path);
+            return 1;
+        }
+        fprintf(f, "config,metric,value,cdf\n");
+        for(int i = 0; i < config_count; i++) {
+            write_cdf(f, configs[i].name, "receive_ms", configs[i].receive);
+            write_cdf(f, configs[i].name, "transfer_bytes", configs[i].size);
+        }
+        fclose(f);
+    }
+
+    for(int i = 0; i < config_count; i++) {
+        free(configs[i].onload);
+        free(configs[i].receive);
+        free(configs[i].size);
+    }
+    free(jobs);
+    return errors ? 1 : 0;
+}
@@ -11,10 +11,22 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
 
 #define PORT 8080
 #define BUFFER_SIZE 1024
 #define SERVER_IP "127.0.0.1"
+#define MAX_QUEUED_UPDATES 4096     // receive thread blocks once this many updates are pending
+#define MAX_BATCH_UPDATES 64        // updates (and fixed-file slots) per io_uring submission
+#define RING_ENTRIES 256            // enough for MAX_BATCH_UPDATES * openat/write/close
+#define DIR_CACHE_SIZE 4096         // power of two
+#define MAX_RELAY_CLIENTS 64
+#define RELAY_SEND_TIMEOUT_S 2      // a downstream client that accepts nothing for this long is dropped
+#define MAX_IGNORE_ENTRIES 100
 
 int sock;
 
@@ -63,169 +75,602 @@ int recv_all(int sock, void *buffer, int length) {
     return total_received;
 }
 
+// Cache of directories known to exist, so repeated paths cost no mkdir calls.
+// Only directories this client created or found existing are added, and always
+// together with their ancestors, so a path missing from the cache has no cached children.
+char *dir_cache[DIR_CACHE_SIZE];
+int dir_cache_count = 0;
+
+unsigned int hash_path(const char *path) {
+    unsigned int h = 2166136261u;
+    while (*path) {
+        h = (h ^ (unsigned char)*path++) * 16777619u;
+    }
+    return h;
+}
+
+int dir_cache_contains(const char *path) {
+    unsigned int i = hash_path(path) & (DIR_CACHE_SIZE - 1);
+    while (dir_cache[i]) {
+        if (strcmp(dir_cache[i], path) == 0) return 1;
+        i = (i + 1) & (DIR_CACHE_SIZE - 1);
+    }
+    return 0;
+}
+
+void dir_cache_clear() {
+    for (int i = 0; i < DIR_CACHE_SIZE; i++) {
+        free(dir_cache[i]);
+        dir_cache[i] = NULL;
+    }
+    dir_cache_count = 0;
+}
+
+void dir_cache_add(const char *path) {
+    if (dir_cache_contains(path)) return;
+    if (dir_cache_count >= DIR_CACHE_SIZE * 3 / 4) {
+        dir_cache_clear();
+    }
+    unsigned int i = hash_path(path) & (DIR_CACHE_SIZE - 1);
+    while (dir_cache[i]) {
+        i = (i + 1) & (DIR_CACHE_SIZE - 1);
+    }
+    dir_cache[i] = strdup(path);
+    dir_cache_count++;
+}
+
 // Function to create all directories in a path
 void create_directories(const char *path) {
     char temp[512];
     char *p = NULL;
-    
+
     // Copy path to avoid modifying the original
     strncpy(temp, path, sizeof(temp) - 1);
     temp[sizeof(temp) - 1] = '\0';
-    
+
     // Remove trailing slash if present
     size_t len = strlen(temp);
     if (len > 0 && temp[len - 1] == '/') {
         temp[len - 1] = '\0';
     }
-    
+    if (temp[0] == '\0' || dir_cache_contains(temp)) {
+        return;
+    }
+
     // Create each directory in the path
     for (p = temp + 1; *p; p++) {
         if (*p == '/') {
             *p = '\0';
-            if (mkdir(temp, 0700) != 0 && errno != EEXIST) {
-                printf("Failed to create directory: %s (errno: %d)\n", temp, errno);
+            if (!dir_cache_contains(temp)) {
+                if (mkdir(temp, 0700) != 0 && errno != EEXIST) {
+                    printf("Failed to create directory: %s (errno: %d)\n", temp, errno);
+                } else {
+                    dir_cache_add(temp);
+                }
             }
             *p = '/';
         }
     }
-    
+
     // Create the final directory
     if (mkdir(temp, 0700) != 0 && errno != EEXIST) {
         printf("Failed to create final directory: %s (errno: %d)\n", temp, errno);
+    } else {
+        dir_cache_add(temp);
+    }
+}
+
+// Function to create the parent directories of a path
+void create_parent_directories(const char *path) {
+    char parent_dir[512];
+    strncpy(parent_dir, path, sizeof(parent_dir) - 1);
+    parent_dir[sizeof(parent_dir) - 1] = '\0';
+    char *last_slash = strrchr(parent_dir, '/');
+    if (last_slash) {
+        *last_slash = '\0';
+        create_directories(parent_dir);
+    }
+}
+
+// Relay mode: downstream clients connect to this client exactly as they would to
+// the server, and every update received from upstream is re-sent to them
+typedef struct {
+    int socket;
+    char **ignore_list;
+    int ignore_count;
+} ClientInfo;
+
+ClientInfo relay_clients[MAX_RELAY_CLIENTS];
+int relay_sock = -1;
+pthread_mutex_t relay_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Function to check if a file is in the ignore list
+int is_ignored(const char *filename, char **ignore_list, int ignore_count) {
+    for (int i = 0; i < ignore_count; i++) {
+        if (strstr(filename, ignore_list[i]) != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Function to send a whole buffer
+int send_all(int sock, const void *buffer, int length) {
+    int total_sent = 0;
+    while (total_sent < length) {
+        int sent_now = send(sock, (const char *)buffer + total_sent, length - total_sent, MSG_NOSIGNAL);
+        if (sent_now <= 0) return -1;
+        total_sent += sent_now;
+    }
+    return total_sent;
+}
+
+// Function to encode an update frame (type, src, filename, size, payload) into one buffer
+char *encode_update(const char *type, const char *src, const char *filename, int file_size, const char *file_data, int *frame_size) {
+    *frame_size = 10 + 256 + 256 + sizeof(int) + file_size;
+    char *frame = calloc(1, *frame_size);
+    if (!frame) {
+        perror("Memory allocation failed");
+        return NULL;
+    }
+    strncpy(frame, type, 9);
+    strncpy(frame + 10, src, 255);
+    strncpy(frame + 10 + 256, filename, 255);
+    int file_size_n = htonl(file_size);
+    memcpy(frame + 10 + 512, &file_size_n, sizeof(file_size_n));
+    if (file_size > 0) {
+        memcpy(frame + 10 + 512 + sizeof(file_size_n), file_data, file_size);
+    }
+    return frame;
+}
+
+// Function to forward an update to the downstream clients that do not ignore it
+void relay_update(const char *type, const char *src, const char *filename, int file_size, const char *file_data) {
+    if (relay_sock < 0) return;
+
+    int frame_size, delete_size;
+    char *frame = encode_update(type, src, filename, file_size, file_data, &frame_size);
+    char *delete_frame = NULL;
+    if (!frame) return;
+
+    // For renames the destination name decides too, as on the server
+    const char *new_name = NULL;
+    if (strcmp(type, "RENAME") == 0 && file_size > 0) {
+        new_name = strrchr(file_data, '/');
+        new_name = new_name ? new_name + 1 : file_data;
+    }
+
+    // Pick the targets under the lock but send outside it, so a slow downstream client
+    // does not hold up the others; dup() keeps each socket valid if its client leaves meanwhile
+    int targets[MAX_RELAY_CLIENTS], as_delete[MAX_RELAY_CLIENTS], target_count = 0;
+    pthread_mutex_lock(&relay_mutex);
+    for (int i = 0; i < MAX_RELAY_CLIENTS; i++) {
+        ClientInfo *client = &relay_clients[i];
+        if (client->socket <= 0 || is_ignored(filename, client->ignore_list, client->ignore_count))
+            continue;
+        int fd = dup(client->socket);
+        if (fd < 0) {
+            perror("dup failed");
+            continue;
+        }
+        targets[target_count] = fd;
+        as_delete[target_count++] = new_name && is_ignored(new_name, client->ignore_list, client->ignore_count);
+    }
+    pthread_mutex_unlock(&relay_mutex);
+
+    for (int i = 0; i < target_count; i++) {
+        if (as_delete[i] && !delete_frame) delete_frame = encode_update("DELETE", src, filename, 0, NULL, &delete_size);
+        int sent = as_delete[i] ? (delete_frame ? send_all(targets[i], delete_frame, delete_size) : 0)
+                                : send_all(targets[i], frame, frame_size);
+        if (sent < 0) {
+            // Gone, or stalled past RELAY_SEND_TIMEOUT_S: drop it (its thread then cleans up)
+            perror("Relay send failed, dropping downstream client");
+            shutdown(targets[i], SHUT_RDWR);
+        }
+        close(targets[i]);
+    }
+
+    free(frame);
+    free(delete_frame);
+}
+
+// Function to receive ignore list file from a downstream client
+void receive_ignore_list(ClientInfo *client) {
+    int sock = client->socket;
+
+    char filename[256];
+    int file_size;
+
+    // Receive filename
+    if (recv_all(sock, filename, sizeof(filename)) < 0) {
+        perror("Filename receive error");
+        return;
+    }
+
+    // Receive file size
+    if (recv_all(sock, &file_size, sizeof(file_size)) < 0) {
+        perror("File size receive error");
+        return;
+    }
+    file_size = ntohl(file_size);
+
+    // Receive file data
+    char *file_data = malloc(file_size + 1);
+    if (!file_data) {
+        perror("Memory allocation failed");
+        return;
+    }
+    if (recv_all(sock, file_data, file_size) < 0) {
+        perror("File data receive error");
+        free(file_data);
+        return;
+    }
+    file_data[file_size] = '\0';  // Null-terminate for string operations
+
+    // Parse CSV data into client's ignore_list
+    char **ignore_list = malloc(MAX_IGNORE_ENTRIES * sizeof(char*));
+    int ignore_count = 0;
+    char *token = strtok(file_data, ",\n");
+    while (token != NULL && ignore_count < MAX_IGNORE_ENTRIES) {
+        ignore_list[ignore_count++] = strdup(token);
+        token = strtok(NULL, ",\n");
     }
+
+    pthread_mutex_lock(&relay_mutex);
+    client->ignore_list = ignore_list;
+    client->ignore_count = ignore_count;
+    pthread_mutex_unlock(&relay_mutex);
+
+    printf("Loaded %d entries into downstream client's ignore list\n", ignore_count);
+    free(file_data);
 }
 
-// Function to handle updates from server
-int handle_update() {
+// Thread function to handle a downstream client
+void *handle_relay_client(void *arg) {
+    ClientInfo *client = arg;
+    int client_sock = client->socket;
+
+    receive_ignore_list(client);
+
+    // Keep the connection alive until the client goes away
+    char buffer[BUFFER_SIZE];
+    while (recv(client_sock, buffer, sizeof(buffer), 0) > 0)
+        ;
+
+    pthread_mutex_lock(&relay_mutex);
+    for (int j = 0; j < client->ignore_count; j++) {
+        free(client->ignore_list[j]);
+    }
+    free(client->ignore_list);
+    client->ignore_list = NULL;
+    client->ignore_count = 0;
+    client->socket = -1;  // Mark slot as available
+    pthread_mutex_unlock(&relay_mutex);
+
+    printf("Downstream client disconnected (socket: %d).\n", client_sock);
+    close(client_sock);
+    return NULL;
+}
+
+// Thread function to accept downstream clients
+void *accept_relay_clients(void *arg) {
+    while (1) {
+        int new_client = accept(relay_sock, NULL, NULL);
+        if (new_client < 0) {
+            if (errno == EINTR) continue;
+            perror("Accept failed");
+            break;
+        }
+
+        // Find available client slot; the ignore list is filled in by its thread
+        ClientInfo *client = NULL;
+        pthread_mutex_lock(&relay_mutex);
+        for (int i = 0; i < MAX_RELAY_CLIENTS; i++) {
+            if (relay_clients[i].socket <= 0) {
+                client = &relay_clients[i];
+                client->socket = new_client;
+                client->ignore_list = NULL;
+                client->ignore_count = 0;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&relay_mutex);
+
+        if (!client) {
+            printf("Maximum downstream clients reached. Connection rejected.\n");
+            close(new_client);
+            continue;
+        }
+        printf("New downstream client connected (socket: %d)\n", new_client);
+
+        struct timeval send_timeout = {.tv_sec = RELAY_SEND_TIMEOUT_S, .tv_usec = 0};
+        setsockopt(new_client, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
+        pthread_t client_thread;
+        if (pthread_create(&client_thread, NULL, handle_relay_client, client) != 0) {
+            perror("Thread creation failed");
+            pthread_mutex_lock(&relay_mutex);
+            client->socket = -1;
+            pthread_mutex_unlock(&relay_mutex);
+            close(new_client);
+            continue;
+        }
+        pthread_detach(client_thread);
+    }
+    return NULL;
+}
+
+// Function to start listening for downstream clients on the given port
+int relay_init(int port) {
+    for (int i = 0; i < MAX_RELAY_CLIENTS; i++) {
+        relay_clients[i].socket = -1;
+        relay_clients[i].ignore_list = NULL;
+        relay_clients[i].ignore_count = 0;
+    }
+
+    relay_sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (relay_sock == -1) {
+        perror("Socket creation failed");
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(relay_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in relay_addr = {0};
+    relay_addr.sin_family = AF_INET;
+    relay_addr.sin_port = htons(port);
+    relay_addr.sin_addr.s_addr = INADDR_ANY;
+
+    if (bind(relay_sock, (struct sockaddr*)&relay_addr, sizeof(relay_addr)) < 0) {
+        perror("Bind failed");
+        return -1;
+    }
+    if (listen(relay_sock, MAX_RELAY_CLIENTS) < 0) {
+        perror("Listen failed");
+        return -1;
+    }
+
+    pthread_t accept_thread;
+    if (pthread_create(&accept_thread, NULL, accept_relay_clients, NULL) != 0) {
+        perror("Thread creation failed");
+        return -1;
+    }
+    pthread_detach(accept_thread);
+
+    printf("Relaying updates to downstream clients on port %d...\n", port);
+    return 0;
+}
+
+// A parsed update, handed from the receive thread to the apply stage
+typedef struct Update {
     char type[10];
+    char full_path[512];
+    char new_path[512];         // RENAME destination
+    unsigned long long offset;  // APPEND offset
+    char *data;
+    int size;
+    int stages_left;            // io_uring completions still expected
+    int opened;                 // openat completed, so the file exists
+    struct Update *next;
+} Update;
+
+// Bounded queue between the receive thread and the apply stage
+Update *queue_head = NULL, *queue_tail = NULL;
+int queue_count = 0;
+int queue_closed = 0;
+pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+pthread_cond_t queue_not_full = PTHREAD_COND_INITIALIZER;
+
+void queue_push(Update *update) {
+    pthread_mutex_lock(&queue_mutex);
+    while (queue_count >= MAX_QUEUED_UPDATES) {
+        pthread_cond_wait(&queue_not_full, &queue_mutex);
+    }
+    update->next = NULL;
+    if (queue_tail) queue_tail->next = update;
+    else queue_head = update;
+    queue_tail = update;
+    queue_count++;
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+void queue_close() {
+    pthread_mutex_lock(&queue_mutex);
+    queue_closed = 1;
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+// Pops the next update; blocks only if wait is set. Returns NULL when empty (or closed).
+Update *queue_pop(int wait) {
+    pthread_mutex_lock(&queue_mutex);
+    while (wait && !queue_head && !queue_closed) {
+        pthread_cond_wait(&queue_not_empty, &queue_mutex);
+    }
+    Update *update = queue_head;
+    if (update) {
+        queue_head = update->next;
+        if (!queue_head) queue_tail = NULL;
+        queue_count--;
+        pthread_cond_signal(&queue_not_full);
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    return update;
+}
+
+void free_update(Update *update) {
+    free(update->data);
+    free(update);
+}
+
+// Function to receive one update from the server (header and payload)
+Update *receive_update() {
     char src[256];
     char filename[256];
     int file_size;
-    
+
+    Update *update = calloc(1, sizeof(Update));
+    if (!update) {
+        perror("Memory allocation failed");
+        return NULL;
+    }
+
     // Receive update type
-    if (recv_all(sock, type, 10) < 0) {
+    if (recv_all(sock, update->type, 10) < 0) {
         perror("Error receiving update type");
-        return -1;  // Return error code to indicate disconnection
+        free(update);
+        return NULL;  // Return NULL to indicate disconnection
     }
-    
+
     // Receive source path
     if (recv_all(sock, src, 256) < 0) {
         perror("Error receiving source path");
-        return -1;
+        free(update);
+        return NULL;
     }
-    
+
     // Receive filename
     if (recv_all(sock, filename, 256) < 0) {
         perror("Error receiving filename");
-        return -1;
+        free(update);
+        return NULL;
     }
-    
+
     // Receive file size
     if (recv_all(sock, &file_size, sizeof(file_size)) < 0) {
         perror("Error receiving file size");
-        return -1;
+        free(update);
+        return NULL;
     }
-    
+
     file_size = ntohl(file_size);
-    
-    printf("Received update: %s %s %s (size: %d)\n", type, src, filename, file_size);
-    
+    update->type[9] = '\0';
+    src[255] = '\0';
+    filename[255] = '\0';
+
+    printf("Received update: %s %s %s (size: %d)\n", update->type, src, filename, file_size);
+
     // Create full path
-    char full_path[512];
-    char dir_path[512];
-    
-    // Handle the case where filename contains directory structure
-    char *last_slash = strrchr(filename, '/');
-    if (last_slash) {
-        // Extract directory part from filename
-        strncpy(dir_path, filename, last_slash - filename);
-        dir_path[last_slash - filename] = '\0';
-        
-        // Create the full directory path
-        char full_dir_path[512];
-        if (strcmp(src, ".") == 0) {
-            snprintf(full_dir_path, sizeof(full_dir_path), "%s", dir_path);
-        } else {
-            snprintf(full_dir_path, sizeof(full_dir_path), "%s/%s", src, dir_path);
+    if (strcmp(src, ".") == 0) {
+        snprintf(update->full_path, sizeof(update->full_path), "%s", filename);
+    } else {
+        snprintf(update->full_path, sizeof(update->full_path), "%s/%s", src, filename);
+    }
+
+    // Receive the payload, whatever the update type
+    if (file_size < 0) {
+        printf("Invalid payload size: %d\n", file_size);
+        free(update);
+        return NULL;
+    }
+    if (file_size > 0) {
+        update->data = malloc(file_size + 1);
+        if (!update->data) {
+            perror("Memory allocation failed");
+            free(update);
+            return NULL;
         }
-        
-        // Create all directories in the path
-        create_directories(full_dir_path);
-        
-        // Set the full path for the file
-        if (strcmp(src, ".") == 0) {
-            snprintf(full_path, sizeof(full_path), "%s", filename);
-        } else {
-            snprintf(full_path, sizeof(full_path), "%s/%s", src, filename);
+        if (recv_all(sock, update->data, file_size) < 0) {
+            perror("Error receiving file data");
+            free_update(update);
+            return NULL;
         }
-    } else {
-        // No directory structure in filename
-        if (strcmp(src, ".") == 0) {
-            snprintf(full_path, sizeof(full_path), "%s", filename);
-        } else {
-            // Create the directory if it doesn't exist
-            create_directories(src);
-            snprintf(full_path, sizeof(full_path), "%s/%s", src, filename);
+        update->data[file_size] = '\0';  // RENAME payloads are used as strings (relay_update)
+    }
+    update->size = file_size;
+
+    // Downstream clients get the frame as received, before it is decoded
+    relay_update(update->type, src, filename, file_size, update->data);
+
+    if (strcmp(update->type, "APPEND") == 0) {
+        // Payload: 8-byte big-endian offset followed by the appended bytes
+        uint64_t offset_n;
+        if (file_size < (int)sizeof(offset_n)) {
+            printf("Invalid append payload for %s\n", update->full_path);
+            free_update(update);
+            return NULL;
         }
+        memcpy(&offset_n, update->data, sizeof(offset_n));
+        update->offset = be64toh(offset_n);
+        memmove(update->data, update->data + sizeof(offset_n), file_size - sizeof(offset_n));
+        update->size = file_size - sizeof(offset_n);
+    } else if (strcmp(update->type, "RENAME") == 0) {
+        // Payload: NUL-terminated destination path
+        if (file_size <= 0 || file_size > (int)sizeof(update->new_path)) {
+            printf("Invalid rename payload for %s\n", update->full_path);
+            free_update(update);
+            return NULL;
+        }
+        memcpy(update->new_path, update->data, file_size);
+        update->new_path[file_size - 1] = '\0';
     }
-    
-    // Handle different update types
-    if (strncmp(type, "CREAT", 5) == 0) {
-        struct stat st = {0};
-    
-        // Check if the path already exists
-        if (stat(full_path, &st) == 0) {
-            printf("Path already exists: %s\n", full_path);
+
+    return update;
+}
+
+// Thread function: parse frames off the socket and queue them for the apply stage
+void *receive_updates(void *arg) {
+    Update *update;
+    while ((update = receive_update()) != NULL) {
+        queue_push(update);
+    }
+    queue_close();
+    return NULL;
+}
+
+// Function to apply an update with plain system calls
+void apply_update_sync(Update *update) {
+    const char *full_path = update->full_path;
+
+    if (strncmp(update->type, "CREAT", 5) == 0) {
+        create_parent_directories(full_path);
+        if (update->type[5] == 'D') {
+            if (mkdir(full_path, 0777) == -1) {
+                if (errno == EEXIST) printf("Path already exists: %s\n", full_path);
+                else perror("Error creating directory");
+                return;
+            }
+            dir_cache_add(full_path);
+            printf("Created directory: %s\n", full_path);
         } else {
-            if (type[5] == 'D') {
-                if (mkdir(full_path, 0777) == -1) {
-                    perror("Error creating directory");
-                    return -1;
-                }
-                printf("Created directory: %s\n", full_path);
-            } else {
-                // Ensure parent directories exist
-                char parent_dir[512];
-                strncpy(parent_dir, full_path, sizeof(parent_dir));
-                char *last_slash = strrchr(parent_dir, '/');
-                if (last_slash) {
-                    *last_slash = '\0';
-                    create_directories(parent_dir);
-                }
-    
-                // Create the file
-                FILE *file = fopen(full_path, "wb");
-                if (!file) {
-                    perror("Error creating file");
-                    printf("Failed to create file: %s\n", full_path);
-                    return -1;
-                }
-    
-                // Receive and write file data
-                if (file_size > 0) {
-                    char *buffer = malloc(file_size);
-                    if (!buffer) {
-                        perror("Memory allocation failed");
-                        fclose(file);
-                        return -1;
-                    }
-    
-                    if (recv_all(sock, buffer, file_size) < 0) {
-                        perror("Error receiving file data");
-                        free(buffer);
-                        fclose(file);
-                        return -1;
-                    }
-    
-                    fwrite(buffer, 1, file_size, file);
-                    free(buffer);
-                }
-    
-                fclose(file);
-                printf("Created file: %s (%d bytes)\n", full_path, file_size);
+            // O_EXCL keeps the old rule of never overwriting an existing path
+            int fd = open(full_path, O_WRONLY | O_CREAT | O_EXCL, 0666);
+            if (fd < 0) {
+                if (errno == EEXIST) printf("Path already exists: %s\n", full_path);
+                else perror("Error creating file");
+                return;
+            }
+            if (update->size > 0 && write(fd, update->data, update->size) != update->size) {
+                perror("Error writing file");
             }
+            close(fd);
+            printf("Created file: %s (%d bytes)\n", full_path, update->size);
+        }
+    } else if (strcmp(update->type, "APPEND") == 0) {
+        create_parent_directories(full_path);
+        // Writing at the given offset keeps replays and late joins consistent;
+        // offset 0 means the server file was rewritten from the start, so drop the old tail
+        int fd = open(full_path, O_WRONLY | O_CREAT | (update->offset == 0 ? O_TRUNC : 0), 0644);
+        if (fd < 0) {
+            perror("Error opening file for append");
+            return;
+        }
+        if (pwrite(fd, update->data, update->size, update->offset) != update->size) {
+            perror("Error appending to file");
+        } else {
+            printf("Appended to file: %s (%d bytes at offset %llu)\n", full_path, update->size, update->offset);
         }
-    } else if (strcmp(type, "DELETE") == 0) {
+        close(fd);
+    } else if (strcmp(update->type, "RENAME") == 0) {
+        create_parent_directories(update->new_path);
+        if (rename(full_path, update->new_path) == -1) {
+            perror("Error renaming path");
+        } else {
+            printf("Renamed: %s -> %s\n", full_path, update->new_path);
+        }
+    } else if (strcmp(update->type, "DELETE") == 0) {
         struct stat st = {0};
         if (stat(full_path, &st) == 0) {
             if (S_ISDIR(st.st_mode)) {
@@ -245,41 +690,394 @@ int handle_update() {
             perror("Path does not exist");
         }
     }
-    
-    
-    return 0;  // Success
+}
+
+// Minimal io_uring ring (raw syscalls, no liburing)
+typedef struct {
+    int fd;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned sq_local_tail;     // SQEs prepared but not yet published
+    unsigned to_submit;
+} Ring;
+
+Ring ring;
+int ring_enabled = 0;
+
+// Function to check that the kernel supports every opcode the batches use.
+// MKDIRAT and openat/close on fixed-file slots both arrived in 5.15, so this also
+// rules out kernels where setup works but every staged update fails with -EINVAL.
+int ring_probe() {
+    static const int required[] = {IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE,
+                                   IORING_OP_MKDIRAT, IORING_OP_RENAMEAT, IORING_OP_UNLINKAT};
+    struct io_uring_probe *probe = calloc(1, sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op));
+    if (!probe) {
+        perror("Memory allocation failed");
+        return -1;
+    }
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+        perror("io_uring probe failed");
+        free(probe);
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(required) / sizeof(required[0]); i++) {
+        int op = required[i];
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            printf("io_uring opcode %d not supported by this kernel\n", op);
+            free(probe);
+            return -1;
+        }
+    }
+    free(probe);
+    return 0;
+}
+
+// Function to set up the ring with MAX_BATCH_UPDATES sparse fixed-file slots.
+// Returns -1 if io_uring is unavailable, in which case updates are applied synchronously.
+int ring_init() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring.fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (ring.fd < 0) {
+        perror("io_uring_setup failed");
+        return -1;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (cq_size > sq_size) sq_size = cq_size;
+        cq_size = sq_size;
+    }
+
+    char *sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) {
+        perror("io_uring mmap failed");
+        close(ring.fd);
+        return -1;
+    }
+    char *cq_ptr = sq_ptr;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) {
+            perror("io_uring mmap failed");
+            close(ring.fd);
+            return -1;
+        }
+    }
+    ring.sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED) {
+        perror("io_uring mmap failed");
+        close(ring.fd);
+        return -1;
+    }
+
+    ring.sq_tail = (unsigned *)(sq_ptr + params.sq_off.tail);
+    ring.sq_mask = (unsigned *)(sq_ptr + params.sq_off.ring_mask);
+    ring.sq_array = (unsigned *)(sq_ptr + params.sq_off.array);
+    ring.cq_head = (unsigned *)(cq_ptr + params.cq_off.head);
+    ring.cq_tail = (unsigned *)(cq_ptr + params.cq_off.tail);
+    ring.cq_mask = (unsigned *)(cq_ptr + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+    ring.sq_local_tail = *ring.sq_tail;
+    ring.to_submit = 0;
+
+    // Sparse fixed-file table: openat installs into a slot, write/close use it directly
+    int slots[MAX_BATCH_UPDATES];
+    for (int i = 0; i < MAX_BATCH_UPDATES; i++) slots[i] = -1;
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_FILES, slots, MAX_BATCH_UPDATES) < 0) {
+        perror("io_uring file registration failed");
+        close(ring.fd);
+        return -1;
+    }
+    if (ring_probe() < 0) {
+        close(ring.fd);
+        return -1;
+    }
+    return 0;
+}
+
+struct io_uring_sqe *ring_get_sqe(Update *update) {
+    update->stages_left++;
+    unsigned index = ring.sq_local_tail & *ring.sq_mask;
+    struct io_uring_sqe *sqe = &ring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring.sq_array[index] = index;
+    ring.sq_local_tail++;
+    ring.to_submit++;
+    return sqe;
+}
+
+// Update stages encoded in the low bits of user_data
+#define STAGE_OPEN 0
+#define STAGE_WRITE 1
+#define STAGE_CLOSE 2
+#define STAGE_OTHER 3
+
+// Batch of updates in flight; conflicting updates never share a batch
+Update *batch[MAX_BATCH_UPDATES];
+int batch_count = 0;
+
+// Function to check whether two paths are equal or one contains the other
+int paths_overlap(const char *a, const char *b) {
+    size_t la = strlen(a), lb = strlen(b);
+    size_t n = la < lb ? la : lb;
+    if (strncmp(a, b, n) != 0) return 0;
+    return la == lb || (la < lb ? b[la] == '/' : a[lb] == '/');
+}
+
+int update_conflicts(const Update *a, const Update *b) {
+    if (paths_overlap(a->full_path, b->full_path)) return 1;
+    if (a->new_path[0] && paths_overlap(a->new_path, b->full_path)) return 1;
+    if (b->new_path[0] && paths_overlap(a->full_path, b->new_path)) return 1;
+    if (a->new_path[0] && b->new_path[0] && paths_overlap(a->new_path, b->new_path)) return 1;
+    return 0;
+}
+
+// Function to queue the SQEs for one update (slot = its index in the batch)
+void prepare_update(Update *update, int slot) {
+    unsigned long long tag = (unsigned long long)slot << 2;
+    struct io_uring_sqe *sqe;
+
+    if (strncmp(update->type, "CREAT", 5) == 0 && update->type[5] == 'D') {
+        sqe = ring_get_sqe(update);
+        sqe->opcode = IORING_OP_MKDIRAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long)update->full_path;
+        sqe->len = 0777;
+        sqe->user_data = tag | STAGE_OTHER;
+    } else if (strncmp(update->type, "CREAT", 5) == 0 || strcmp(update->type, "APPEND") == 0) {
+        int is_append = update->type[0] == 'A';
+
+        // openat -> write -> close, linked and sharing one fixed-file slot
+        sqe = ring_get_sqe(update);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long)update->full_path;
+        sqe->len = is_append ? 0644 : 0666;
+        if (!is_append) sqe->open_flags = O_WRONLY | O_CREAT | O_EXCL;
+        else sqe->open_flags = O_WRONLY | O_CREAT | (update->offset == 0 ? O_TRUNC : 0);
+        sqe->file_index = slot + 1;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = tag | STAGE_OPEN;
+
+        if (update->size > 0) {
+            sqe = ring_get_sqe(update);
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = slot;
+            sqe->addr = (unsigned long)update->data;
+            sqe->len = update->size;
+            sqe->off = is_append ? update->offset : 0;
+            sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+            sqe->user_data = tag | STAGE_WRITE;
+        }
+
+        sqe = ring_get_sqe(update);
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->file_index = slot + 1;
+        sqe->user_data = tag | STAGE_CLOSE;
+    } else if (strcmp(update->type, "RENAME") == 0) {
+        sqe = ring_get_sqe(update);
+        sqe->opcode = IORING_OP_RENAMEAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long)update->full_path;
+        sqe->len = AT_FDCWD;
+        sqe->addr2 = (unsigned long)update->new_path;
+        sqe->user_data = tag | STAGE_OTHER;
+    } else if (strcmp(update->type, "DELETE") == 0) {
+        sqe = ring_get_sqe(update);
+        sqe->opcode = IORING_OP_UNLINKAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long)update->full_path;
+        sqe->user_data = tag | STAGE_OTHER;
+    }
+}
+
+// Function to report the completion of one stage of an update
+void complete_stage(Update *update, int stage, int res) {
+    const char *full_path = update->full_path;
+
+    if (stage == STAGE_OPEN) {
+        if (res >= 0) update->opened = 1;
+        if (res == -EEXIST) printf("Path already exists: %s\n", full_path);
+        else if (res < 0) printf("Error opening file: %s (%s)\n", full_path, strerror(-res));
+    } else if (stage == STAGE_WRITE) {
+        if (res != update->size && res != -ECANCELED) {
+            printf("Error writing file: %s (%s)\n", full_path, res < 0 ? strerror(-res) : "short write");
+        }
+    } else if (stage == STAGE_CLOSE) {
+        if (res < 0) return;   // cancelled because the open failed
+        if (update->type[0] == 'A') {
+            printf("Appended to file: %s (%d bytes at offset %llu)\n", full_path, update->size, update->offset);
+        } else {
+            printf("Created file: %s (%d bytes)\n", full_path, update->size);
+        }
+    } else if (strncmp(update->type, "CREAT", 5) == 0) {
+        if (res == -EEXIST) printf("Path already exists: %s\n", full_path);
+        else if (res < 0) printf("Error creating directory: %s (%s)\n", full_path, strerror(-res));
+        else printf("Created directory: %s\n", full_path);
+        if (res < 0 && res != -EEXIST) dir_cache_clear();
+    } else if (strcmp(update->type, "RENAME") == 0) {
+        if (res < 0) printf("Error renaming path: %s (%s)\n", full_path, strerror(-res));
+        else printf("Renamed: %s -> %s\n", full_path, update->new_path);
+    } else if (strcmp(update->type, "DELETE") == 0) {
+        if (res == -EISDIR) {
+            apply_update_sync(update);   // directories need rmdir
+        } else if (res < 0) {
+            printf("Error removing path: %s (%s)\n", full_path, strerror(-res));
+        } else {
+            printf("Removed file: %s\n", full_path);
+        }
+    }
+}
+
+// Function to report every completion currently in the CQ ring; returns how many there were
+unsigned ring_reap() {
+    unsigned count = 0;
+    unsigned head = *ring.cq_head;
+    unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+        Update *update = batch[cqe->user_data >> 2];
+        update->stages_left--;
+        complete_stage(update, cqe->user_data & 3, cqe->res);
+        head++;
+        count++;
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+// Function to give up on the ring after io_uring_enter failed: SQEs the kernel already
+// took still reference the batch, so wait for them before anything is freed. The ring
+// is then closed (dropping the SQEs never taken) and later updates are applied synchronously.
+void ring_abort(unsigned in_flight) {
+    while (in_flight > 0) {
+        int ret = syscall(__NR_io_uring_enter, ring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno != EINTR) usleep(1000);
+        in_flight -= ring_reap();
+    }
+    close(ring.fd);
+    ring_enabled = 0;
+    dir_cache_clear();
+    printf("io_uring disabled, applying updates synchronously.\n");
+}
+
+// Function to submit the current batch and wait for all of its completions
+void flush_batch() {
+    if (batch_count == 0) return;
+
+    unsigned expected = ring.to_submit;
+    __atomic_store_n(ring.sq_tail, ring.sq_local_tail, __ATOMIC_RELEASE);
+
+    unsigned completed = 0;
+    while (completed < expected) {
+        int ret = syscall(__NR_io_uring_enter, ring.fd, ring.to_submit, expected - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            perror("io_uring_enter failed");
+            ring_abort(expected - ring.to_submit - completed);
+            break;
+        }
+        ring.to_submit -= ret;
+        completed += ring_reap();
+    }
+    ring.to_submit = 0;
+
+    for (int i = 0; i < batch_count; i++) {
+        Update *update = batch[i];
+        if (update->stages_left > 0) {
+            // Never completed: redo it with plain system calls. A file that openat
+            // already created is rewritten from offset 0 instead of failing on O_EXCL.
+            if (update->opened && strncmp(update->type, "CREAT", 5) == 0) {
+                strcpy(update->type, "APPEND");
+                update->offset = 0;
+            }
+            apply_update_sync(update);
+        }
+        free_update(update);
+    }
+    batch_count = 0;
+}
+
+// Function to schedule an update: it joins the current batch unless it touches
+// a path (or a parent/child of one) that an update already in the batch touches
+void schedule_update(Update *update) {
+    for (int i = 0; i < batch_count; i++) {
+        if (update_conflicts(batch[i], update)) {
+            flush_batch();
+            break;
+        }
+    }
+    if (batch_count == MAX_BATCH_UPDATES) {
+        flush_batch();
+    }
+
+    // Directory removals and renames invalidate the cache
+    if ((strcmp(update->type, "DELETE") == 0 || strcmp(update->type, "RENAME") == 0) && dir_cache_contains(update->full_path)) {
+        dir_cache_clear();
+    }
+
+    // Parents come from the directory cache, so usually no syscall is needed. A delete
+    // must not recreate them, and a rename only needs the destination's parents.
+    if (strcmp(update->type, "RENAME") == 0) {
+        create_parent_directories(update->new_path);
+    } else if (strcmp(update->type, "DELETE") != 0) {
+        create_parent_directories(update->full_path);
+    }
+
+    if (!ring_enabled) {
+        apply_update_sync(update);
+        free_update(update);
+        return;
+    }
+
+    if (strncmp(update->type, "CREATD", 6) == 0) {
+        dir_cache_add(update->full_path);
+    }
+    batch[batch_count] = update;
+    prepare_update(update, batch_count);
+    batch_count++;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <path_to_local_directory> <path_to_ignore_list_file>\n", argv[0]);
+    if (argc < 3 || argc > 6) {
+        fprintf(stderr, "Usage: %s <path_to_local_directory> <path_to_ignore_list_file> [relay_port] [server_ip] [server_port]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
 
     char *local_directory = argv[1];
     char *ignore_list_file = argv[2];
+    int relay_port = argc > 3 ? atoi(argv[3]) : 0;     // 0: no relay
+    const char *server_ip = argc > 4 ? argv[4] : SERVER_IP;
+    int server_port = argc > 5 ? atoi(argv[5]) : PORT;
 
     struct sockaddr_in server_addr;
-    
+
     // Create socket
     sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock == -1) {
         perror("Socket creation failed");
         exit(EXIT_FAILURE);
     }
-    
+
     // Connect to server
     server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(PORT);
-    inet_pton(AF_INET, SERVER_IP, &server_addr.sin_addr);
-    
+    server_addr.sin_port = htons(server_port);
+    if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "Invalid server address: %s\n", server_ip);
+        exit(EXIT_FAILURE);
+    }
+
     if (connect(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         perror("Connection failed");
         exit(EXIT_FAILURE);
     }
-    
+
     printf("Connected to server.\n");
-    
+
     // Send ignore list file first
     send_file(sock, ignore_list_file);
 
@@ -287,37 +1085,38 @@ int main(int argc, char *argv[]) {
         perror("Failed to change directory");
         exit(EXIT_FAILURE);
     }
-    
+
+    if (relay_port > 0 && relay_init(relay_port) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (ring_init() == 0) {
+        ring_enabled = 1;
+    } else {
+        printf("io_uring unavailable, applying updates synchronously.\n");
+    }
+
     // Enter persistent mode to receive updates
     printf("Entering persistent mode to receive updates...\n");
-    
-    // Loop to receive updates from server
-    while (1) {
-        // Use select to check if socket is still connected
-        fd_set read_fds;
-        FD_ZERO(&read_fds);
-        FD_SET(sock, &read_fds);
-        
-        struct timeval timeout;
-        timeout.tv_sec = 1;  // Check every second
-        timeout.tv_usec = 0;
-        
-        int ready = select(sock + 1, &read_fds, NULL, NULL, &timeout);
-        
-        if (ready < 0) {
-            perror("select failed");
-            break;
-        }
-        
-        if (ready > 0) {
-            // Socket has data, try to handle the update
-            if (handle_update() < 0) {
-                printf("Server disconnected.\n");
-                break;
-            }
-        }
+
+    pthread_t recv_thread;
+    if (pthread_create(&recv_thread, NULL, receive_updates, NULL) != 0) {
+        perror("Thread creation failed");
+        exit(EXIT_FAILURE);
     }
-    
+
+    // Apply stage: batch whatever is queued, flush once the queue runs dry
+    Update *update;
+    while ((update = queue_pop(1)) != NULL) {
+        do {
+            schedule_update(update);
+        } while ((update = queue_pop(0)) != NULL);
+        flush_batch();
+    }
+    printf("Server disconnected.\n");
+
+    pthread_join(recv_thread, NULL);
+    dir_cache_clear();
     close(sock);
     return 0;
 }
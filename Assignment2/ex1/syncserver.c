@@ -14,6 +14,9 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <signal.h>
+#include <time.h>
+#include <stdint.h>
+#include <endian.h>
 
 #define BUFFER_SIZE 1024
 #define MAX_EVENTS 1024
@@ -21,6 +24,12 @@
 #define EVENT_BUF_LEN (MAX_EVENTS * (EVENT_SIZE + 16))
 #define MAX_IGNORE_ENTRIES 100
 #define MAX_PATH_LENGTH 256
+#define MAX_FOLLOW_ENTRIES 100
+#define MAX_FOLLOWED_FILES 256
+#define FOLLOW_BATCH_BYTES 4096     // flush an append batch once this many bytes are pending
+#define FOLLOW_BATCH_MS 20          // ... or once the oldest pending byte is this old
+#define MAX_PENDING_MOVES 64
+#define MOVE_PAIR_MS 10             // unpaired IN_MOVED_FROM after this long means moved out of the tree
 
 int PORT;
 int MAX_CLIENTS;
@@ -40,6 +49,32 @@ typedef struct {
 
 ClientInfo* clients;
 
+// Paths matching an entry of the follow list are streamed as appends
+char **follow_list = NULL;
+int follow_count = 0;
+
+// Per-file state for followed (append-only) files
+typedef struct {
+    char path[PATH_MAX];
+    long long offset;           // bytes already sent to clients
+    long long pending_since;    // ms timestamp of the first unsent byte, 0 if none
+} FollowInfo;
+
+FollowInfo followed[MAX_FOLLOWED_FILES];
+int followed_count = 0;
+
+// IN_MOVED_FROM events waiting for the IN_MOVED_TO with the same cookie
+typedef struct {
+    uint32_t cookie;
+    int is_dir;
+    char base_path[PATH_MAX];
+    char name[NAME_MAX + 1];
+    long long expires;          // ms timestamp after which it is treated as a delete
+} PendingMove;
+
+PendingMove pending_moves[MAX_PENDING_MOVES];
+int pending_move_count = 0;
+
 // Function to check if a file is in the ignore list
 int is_ignored(const char *filename, char **ignore_list, int ignore_count) {
     for (int i = 0; i < ignore_count; i++) {
@@ -62,7 +97,7 @@ int watch_count = 0;
 
 // Function to add a watch for a directory
 int add_watch(int fd, const char *path) {
-    int wd = inotify_add_watch(fd, path, IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+    int wd = inotify_add_watch(fd, path, IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY);
     if (wd == -1) {
         perror("inotify_add_watch failed");
         return -1;
@@ -250,6 +285,141 @@ void broadcast_update(const char *type, const char *src, const char *filename, i
     pthread_mutex_unlock(&clients_mutex);
 }
 
+// Current time in milliseconds (monotonic)
+long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Function to check if a path is in follow (append streaming) mode
+int is_followed(const char *path) {
+    return is_ignored(path, follow_list, follow_count);
+}
+
+// Function to find (or start tracking) a followed file
+FollowInfo *get_follow_info(const char *path, int create) {
+    for (int i = 0; i < followed_count; i++) {
+        if (strcmp(followed[i].path, path) == 0) {
+            return &followed[i];
+        }
+    }
+    if (!create) return NULL;
+    if (followed_count >= MAX_FOLLOWED_FILES) {
+        printf("Maximum number of followed files reached. Cannot follow: %s\n", path);
+        return NULL;
+    }
+    FollowInfo *info = &followed[followed_count++];
+    strncpy(info->path, path, PATH_MAX - 1);
+    info->path[PATH_MAX - 1] = '\0';
+    info->offset = 0;
+    info->pending_since = 0;
+    return info;
+}
+
+// Function to stop tracking a followed file
+void forget_follow_info(const char *path) {
+    for (int i = 0; i < followed_count; i++) {
+        if (strcmp(followed[i].path, path) == 0) {
+            followed[i] = followed[followed_count - 1];
+            followed_count--;
+            return;
+        }
+    }
+}
+
+// Function to send the bytes appended to a followed file since the last flush.
+// APPEND payload: 8-byte big-endian offset followed by the appended bytes.
+void flush_follow(FollowInfo *info) {
+    info->pending_since = 0;
+
+    int fd = open(info->path, O_RDONLY);
+    if (fd < 0) {
+        perror("[ERROR] Followed file open error");
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("[ERROR] fstat failed");
+        close(fd);
+        return;
+    }
+
+    // Truncated (e.g. log rotation): start over from the beginning. An APPEND at
+    // offset 0 truncates the client copy, so it is sent even if nothing was written yet.
+    int truncated = st.st_size < info->offset;
+    if (truncated) {
+        printf("Followed file truncated: %s\n", info->path);
+        info->offset = 0;
+    }
+
+    long long length = st.st_size - info->offset;
+    if (length <= 0 && !truncated) {
+        close(fd);
+        return;
+    }
+
+    char *payload = malloc(sizeof(uint64_t) + length);
+    if (!payload) {
+        perror("[ERROR] Memory allocation failed");
+        close(fd);
+        return;
+    }
+    uint64_t offset_n = htobe64(info->offset);
+    memcpy(payload, &offset_n, sizeof(offset_n));
+
+    ssize_t read_size = length > 0 ? pread(fd, payload + sizeof(offset_n), length, info->offset) : 0;
+    close(fd);
+    if (read_size < 0 || (read_size == 0 && length > 0)) {
+        perror("[ERROR] pread failed");
+        free(payload);
+        return;
+    }
+
+    // Split into directory and name the same way inotify reports them
+    char dir[PATH_MAX];
+    strncpy(dir, info->path, PATH_MAX - 1);
+    dir[PATH_MAX - 1] = '\0';
+    char *name = strrchr(dir, '/');
+    *name++ = '\0';
+
+    broadcast_update("APPEND", dir, name, sizeof(offset_n) + read_size, payload);
+    info->offset += read_size;
+    free(payload);
+}
+
+// Function to flush followed files whose oldest pending byte exceeded FOLLOW_BATCH_MS.
+// Returns the number of milliseconds until the next flush is due, or -1 if nothing is pending.
+long long flush_follow_due() {
+    long long now = now_ms();
+    long long next = -1;
+    for (int i = 0; i < followed_count; i++) {
+        if (followed[i].pending_since == 0) continue;
+        long long due = followed[i].pending_since + FOLLOW_BATCH_MS - now;
+        if (due <= 0) {
+            flush_follow(&followed[i]);
+        } else if (next < 0 || due < next) {
+            next = due;
+        }
+    }
+    return next;
+}
+
+// Function to record a write to a followed file, flushing once a batch is full
+void follow_modified(const char *path) {
+    FollowInfo *info = get_follow_info(path, 1);
+    if (!info) return;
+
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return;
+
+    if (st.st_size - info->offset >= FOLLOW_BATCH_BYTES || st.st_size < info->offset) {
+        flush_follow(info);
+    } else if (info->pending_since == 0) {
+        info->pending_since = now_ms();
+    }
+}
+
 void send_watches_recursive(int fd, const char *dir_path) {
     DIR *dir = opendir(dir_path);
     if (dir == NULL) {
@@ -288,22 +458,244 @@ void send_watches_recursive(int fd, const char *dir_path) {
     closedir(dir);
 }
 
+// Function to send a directory tree to a single client (used when a rename exposes it)
+void send_tree(ClientInfo *client, const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL) {
+        perror("Failed to open directory");
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        char new_path[PATH_MAX];
+        snprintf(new_path, sizeof(new_path), "%s/%s", dir_path, entry->d_name);
+        if (is_ignored(new_path, client->ignore_list, client->ignore_count))
+            continue;
+
+        struct stat statbuf;
+        if (stat(new_path, &statbuf) == -1) {
+            perror("stat failed");
+            continue;
+        }
+
+        if (S_ISDIR(statbuf.st_mode)) {
+            send_update(client->socket, "CREATD", ".", new_path, 0, NULL);
+            send_tree(client, new_path);
+        } else {
+            int file_size;
+            char *file_data = read_file(new_path, &file_size);
+            send_update(client->socket, "CREATF", ".", new_path, file_size, file_data);
+            free(file_data);
+        }
+    }
+
+    closedir(dir);
+}
+
+// Function to broadcast a rename. RENAME payload: NUL-terminated destination path.
+// Clients that ignore only one side of the rename get a DELETE or a full create instead.
+void broadcast_rename(const char *old_base, const char *old_name, const char *new_base, const char *new_name, int is_dir) {
+    char new_path[PATH_MAX];
+    snprintf(new_path, PATH_MAX, "%s/%s", new_base, new_name);
+
+    pthread_mutex_lock(&clients_mutex);
+    for (int i = 0; i < client_count; i++) {
+        ClientInfo *client = &clients[i];
+        if (client->socket <= 0) continue;
+
+        int old_ignored = is_ignored(old_name, client->ignore_list, client->ignore_count);
+        int new_ignored = is_ignored(new_name, client->ignore_list, client->ignore_count);
+
+        if (!old_ignored && !new_ignored) {
+            send_update(client->socket, "RENAME", old_base, old_name, strlen(new_path) + 1, new_path);
+        } else if (!old_ignored) {
+            send_update(client->socket, "DELETE", old_base, old_name, 0, NULL);
+        } else if (!new_ignored) {
+            if (is_dir) {
+                send_update(client->socket, "CREATD", new_base, new_name, 0, NULL);
+                send_tree(client, new_path);
+            } else {
+                int file_size;
+                char *file_data = read_file(new_path, &file_size);
+                send_update(client->socket, "CREATF", new_base, new_name, file_size, file_data);
+                free(file_data);
+            }
+        }
+    }
+    pthread_mutex_unlock(&clients_mutex);
+}
+
+// Function to rewrite a path prefix (old -> new) in place; returns 1 if it matched
+int rename_prefix(char *path, const char *old_path, const char *new_path) {
+    size_t old_len = strlen(old_path);
+    if (strncmp(path, old_path, old_len) != 0 || (path[old_len] != '\0' && path[old_len] != '/'))
+        return 0;
+
+    char renamed[PATH_MAX];
+    snprintf(renamed, PATH_MAX, "%s%s", new_path, path + old_len);
+    strncpy(path, renamed, PATH_MAX - 1);
+    path[PATH_MAX - 1] = '\0';
+    return 1;
+}
+
+// Function to handle a completed move inside the watched tree
+void apply_move(const PendingMove *from, const char *new_base, const char *new_name) {
+    char old_path[PATH_MAX], new_path[PATH_MAX];
+    if (snprintf(old_path, PATH_MAX, "%s/%s", from->base_path, from->name) >= PATH_MAX ||
+        snprintf(new_path, PATH_MAX, "%s/%s", new_base, new_name) >= PATH_MAX) {
+        printf("[ERROR] Path too long, rename ignored: %s\n", from->name);
+        return;
+    }
+    printf("Renamed: %s -> %s\n", old_path, new_path);
+
+    // inotify watches follow the inode, only the recorded paths change
+    if (from->is_dir) {
+        for (int i = 0; i < watch_count; i++) {
+            rename_prefix(watches[i].path, old_path, new_path);
+        }
+    }
+    for (int i = 0; i < followed_count; i++) {
+        rename_prefix(followed[i].path, old_path, new_path);
+    }
+
+    broadcast_rename(from->base_path, from->name, new_base, new_name, from->is_dir);
+}
+
+// Function to handle a move out of the watched tree (same as a delete)
+void expire_move(int fd, const PendingMove *from) {
+    char path[PATH_MAX];
+    if (snprintf(path, PATH_MAX, "%s/%s", from->base_path, from->name) >= PATH_MAX) {
+        printf("[ERROR] Path too long, delete ignored: %s\n", from->name);
+        return;
+    }
+    printf("Deleted: %s\n", path);
+
+    if (from->is_dir) {
+        for (int i = watch_count - 1; i >= 0; i--) {
+            char tmp[PATH_MAX];
+            strcpy(tmp, watches[i].path);
+            if (rename_prefix(tmp, path, path)) {
+                remove_watch(fd, watches[i].wd);
+            }
+        }
+    }
+    forget_follow_info(path);
+    broadcast_update("DELETE", from->base_path, from->name, 0, NULL);
+}
+
+// Function to expire unpaired moves. Returns ms until the next expiry, or -1 if none pending.
+long long expire_moves_due(int fd) {
+    long long now = now_ms();
+    long long next = -1;
+    int i = 0;
+    while (i < pending_move_count) {
+        long long due = pending_moves[i].expires - now;
+        if (due <= 0) {
+            PendingMove from = pending_moves[i];
+            pending_moves[i] = pending_moves[--pending_move_count];
+            expire_move(fd, &from);
+            continue;
+        }
+        if (next < 0 || due < next) next = due;
+        i++;
+    }
+    return next;
+}
+
+// Function to expire unpaired moves out of the given path before the path is reused,
+// so their DELETE reaches clients ahead of the new entry (skip_cookie: the move being paired)
+void expire_moves_of(int fd, const char *base_path, const char *name, uint32_t skip_cookie) {
+    int i = 0;
+    while (i < pending_move_count) {
+        PendingMove *move = &pending_moves[i];
+        if (move->cookie != skip_cookie && strcmp(move->name, name) == 0 && strcmp(move->base_path, base_path) == 0) {
+            PendingMove from = *move;
+            *move = pending_moves[--pending_move_count];
+            expire_move(fd, &from);
+            continue;
+        }
+        i++;
+    }
+}
+
 void watch_directory(int fd, const char *dir_path, int *wd_count);
 // Function to process inotify events
 void process_event(int fd, struct inotify_event *event, const char *base_path) {
     char path[PATH_MAX];
     snprintf(path, PATH_MAX, "%s/%s", base_path, event->name);
 
+    // e.g. "mv a ../elsewhere; touch a": the old a is still waiting as an unpaired move
+    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+        expire_moves_of(fd, base_path, event->name, event->mask & IN_MOVED_TO ? event->cookie : 0);
+    }
+
+    // Followed files stream their appended bytes instead of being re-sent
+    if (!(event->mask & IN_ISDIR) && is_followed(path)) {
+        if (event->mask & IN_MODIFY) {
+            follow_modified(path);
+            return;
+        }
+        if (event->mask & IN_CLOSE_WRITE) {
+            FollowInfo *info = get_follow_info(path, 0);
+            if (info && info->pending_since != 0) flush_follow(info);
+            return;
+        }
+        if (event->mask & IN_CREATE) {
+            // Content follows as APPENDs starting at offset 0
+            get_follow_info(path, 1);
+            broadcast_update("CREATF", base_path, event->name, 0, NULL);
+            return;
+        }
+        if (event->mask & IN_DELETE) {
+            forget_follow_info(path);
+        }
+    }
+
+    // Hold moves back until the matching half arrives, so renames cost no content bytes
+    if (event->mask & IN_MOVED_FROM) {
+        if (pending_move_count == MAX_PENDING_MOVES) {
+            PendingMove from = pending_moves[0];
+            pending_moves[0] = pending_moves[--pending_move_count];
+            expire_move(fd, &from);
+        }
+        PendingMove *move = &pending_moves[pending_move_count++];
+        move->cookie = event->cookie;
+        move->is_dir = (event->mask & IN_ISDIR) != 0;
+        strncpy(move->base_path, base_path, PATH_MAX - 1);
+        move->base_path[PATH_MAX - 1] = '\0';
+        strncpy(move->name, event->name, NAME_MAX);
+        move->name[NAME_MAX] = '\0';
+        move->expires = now_ms() + MOVE_PAIR_MS;
+        return;
+    }
+
+    if (event->mask & IN_MOVED_TO) {
+        for (int i = 0; i < pending_move_count; i++) {
+            if (pending_moves[i].cookie == event->cookie) {
+                PendingMove from = pending_moves[i];
+                pending_moves[i] = pending_moves[--pending_move_count];
+                apply_move(&from, base_path, event->name);
+                return;
+            }
+        }
+    }
+
     if (event->mask & IN_CREATE || event->mask & IN_MOVED_TO) {
         sync();
 
         struct stat statbuf;
-                
-        if (stat(path, &statbuf) == 0 && S_ISDIR(statbuf.st_mode)) {
+        int have_stat = stat(path, &statbuf) == 0;
+        if (have_stat && S_ISDIR(statbuf.st_mode)) {
             add_watches_recursive(fd, path);
             broadcast_update("CREATD", base_path, event->name, 0, NULL);
             send_watches_recursive(fd, path);
         } else {
+            // Moved-in followed files are sent whole; appends continue from their end
+            FollowInfo *info = is_followed(path) ? get_follow_info(path, 1) : NULL;
+            if (info) info->offset = have_stat ? statbuf.st_size : 0;     // already gone again: start over
             int file_size;
             char *file_data = read_file(path, &file_size);
             broadcast_update("CREATF", base_path, event->name, file_size, file_data);
@@ -311,7 +703,7 @@ void process_event(int fd, struct inotify_event *event, const char *base_path) {
         }
     }
 
-    if (event->mask & IN_DELETE || event->mask & IN_MOVED_FROM) {
+    if (event->mask & IN_DELETE) {
         sync();
         printf("Deleted: %s\n", path);
         struct stat statbuf;
@@ -334,7 +726,7 @@ void watch_directory(int fd, const char *dir_path, int *wd_count) {
     struct dirent *entry;
     char path[PATH_MAX];
 
-    int wd = inotify_add_watch(fd, dir_path, IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO);
+    int wd = inotify_add_watch(fd, dir_path, IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY);
     if (wd == -1) {
         perror("inotify_add_watch failed");
         return;
@@ -383,6 +775,17 @@ void *monitor_directory(void *arg) {
         timeout.tv_sec = 1;  // 1-second timeout
         timeout.tv_usec = 0;
 
+        // Wake up early when an append batch or an unpaired move is due
+        long long next_flush = flush_follow_due();
+        long long next_move = expire_moves_due(fd);
+        if (next_move >= 0 && (next_flush < 0 || next_move < next_flush)) {
+            next_flush = next_move;
+        }
+        if (next_flush >= 0) {
+            timeout.tv_sec = 0;
+            timeout.tv_usec = next_flush * 1000;
+        }
+
         int ret = select(fd + 1, &rfds, NULL, NULL, &timeout);
         if (ret < 0) {
             perror("select failed");
@@ -472,6 +875,30 @@ void receive_ignore_list(ClientInfo *client) {
     free(file_data);
 }
 
+// Function to load the follow list (same CSV format as the ignore list)
+void load_follow_list(const char *filename) {
+    int file_size;
+    char *file_data = read_file(filename, &file_size);
+    if (!file_data) {
+        return;
+    }
+
+    char *text = malloc(file_size + 1);
+    memcpy(text, file_data, file_size);
+    text[file_size] = '\0';
+    free(file_data);
+
+    follow_list = malloc(MAX_FOLLOW_ENTRIES * sizeof(char*));
+    char *token = strtok(text, ",\n");
+    while (token != NULL && follow_count < MAX_FOLLOW_ENTRIES) {
+        follow_list[follow_count++] = strdup(token);
+        token = strtok(NULL, ",\n");
+    }
+
+    printf("Loaded %d entries into follow list\n", follow_count);
+    free(text);
+}
+
 // Thread function to handle client
 void *handle_client(void *arg) {
     int client_sock = *((int *)arg);
@@ -571,11 +998,16 @@ void handle_signal(int sig) {
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s <path_to_local_directory> <port> <max_clients>\n", argv[0]);
+    if (argc != 4 && argc != 5) {
+        fprintf(stderr, "Usage: %s <path_to_local_directory> <port> <max_clients> [follow_list_file]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
 
+    // Follow list is read before chdir so relative paths work as expected
+    if (argc == 5) {
+        load_follow_list(argv[4]);
+    }
+
     char *local_directory = argv[1];
     PORT = atoi(argv[2]);
     MAX_CLIENTS = atoi(argv[3]);
@@ -596,6 +1028,9 @@ int main(int argc, char *argv[]) {
     // Initialize client sockets array
     for (int i = 0; i < MAX_CLIENTS; i++) {
         client_sockets[i] = -1;
+        clients[i].socket = -1;
+        clients[i].ignore_list = NULL;
+        clients[i].ignore_count = 0;
     }
     
     // Create socket
@@ -745,6 +1180,11 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    for (int i = 0; i < follow_count; i++) {
+        free(follow_list[i]);
+    }
+    free(follow_list);
+
     printf("Server shutdown complete.\n");
     return 0;
 }
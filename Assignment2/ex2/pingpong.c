@@ -6,6 +6,7 @@
  * CS22B007, CS22B008
  **/
 
+#define _GNU_SOURCE     // recvmmsg / sendmmsg
 #include <ncurses.h>
 #include <string.h>
 #include <pthread.h>
@@ -14,13 +15,80 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <poll.h>
 
 #define WIDTH 80
 #define HEIGHT 30
 #define OFFSETX 10
 #define OFFSETY 5
 #define PADDLE_WIDTH 10
-#define UPDATE_INTERVAL 40000 // 40ms
+#define UPDATE_INTERVAL 40000 // 40ms, client input resend / ack pacing
+#define DEFAULT_SIM_HZ 60   // fixed simulation rate (server <PORT> [SIM_HZ] [SEND_HZ])
+#define DEFAULT_SEND_HZ 25  // snapshot rate
+#define BALL_SPEED 10       // ball steps per second, independent of SIM_HZ
+#define MAX_CATCHUP_TICKS 5 // ticks run back to back after a stall before the backlog is dropped
+
+// UDP message types (first byte of every datagram)
+#define MSG_HELLO 1     // client -> server: join
+#define MSG_INPUT 2     // client -> server: input seq, snapshot ack, paddleB.x
+#define MSG_SNAPSHOT 3  // server -> client: state delta against an acked snapshot
+#define MSG_BYE 4       // either way: quit
+#define MSG_WAIT 5      // multi-room server -> client: queued for an opponent
+#define MAX_MSG_SIZE 64
+#define INPUT_SIZE 10
+#define SNAP_HISTORY 32 // snapshots kept for delta baselines (power of two)
+#define INPUT_QUEUE_SIZE 64 // paddle moves in flight to the simulation (power of two)
+
+// Headless multi-room server (rooms <PORT> [THREADS] [SIM_HZ] [SEND_HZ])
+#define MAX_ROOMS 1024
+#define ROOM_BATCH 32           // rooms stepped per work item
+#define MAX_WAITING 64          // matchmaking queue length
+#define PLAYER_TABLE_SIZE 4096  // address -> player hash table (power of two, > 2 * MAX_ROOMS)
+#define PLAYER_TIMEOUT_MS 10000 // players silent this long are dropped
+#define NET_BATCH 32            // datagrams per recvmmsg / sendmmsg
+#define DEFAULT_ROOM_THREADS 4
+
+// Latency histograms (client, printed on exit) and the impairment proxy
+#define HIST_BUCKETS 500        // 1 ms buckets; the last one collects everything slower
+#define INPUT_HISTORY 64        // key presses remembered until the server confirms them
+#define MAX_PROXY_SESSIONS 64
+#define MAX_PROXY_QUEUE 4096    // datagrams held back by the proxy
+#define PROXY_IDLE_MS 30000     // proxy sessions silent this long are closed
+
+/*
+ * Wire format. All multi-bit fields are written MSB first into a bit stream that
+ * is zero-padded to a whole byte; nothing depends on struct layout or host order.
+ *
+ * MSG_INPUT (10 bytes):
+ *   u8 type | 16 input seq (low bits) | 16 snapshot ack (low bits) | 7 paddleB.x | 1 pad
+ *   32 client send time (microseconds, low bits)
+ *
+ * MSG_SNAPSHOT (4 byte header + bits):
+ *   u8 type | 16 seq (low bits) | 8 baseline distance (0 = keyframe against the zero state)
+ *   7 change mask, then for each set bit, in order:
+ *     bit 0  tick        zigzag exp-Golomb delta
+ *     bit 1  ball pos    7 x, 5 y
+ *     bit 2  ball dir    1 dx<0, 1 dy<0
+ *     bit 3  paddleA     7 x
+ *     bit 4  scores      zigzag exp-Golomb delta A, B
+ *     bit 5  input ack   zigzag exp-Golomb delta
+ *     bit 6  echo        32 send time of the newest input received, 24 microseconds
+ *                        the server held it (not delta coded; only set when new)
+ * paddleB is owned by the client and never sent back. Sequence numbers are 32-bit
+ * on both ends; only the low 16 bits travel and are re-expanded near the last seen value.
+ */
+#define DELTA_TICK 0x01
+#define DELTA_BALL_POS 0x02
+#define DELTA_BALL_DIR 0x04
+#define DELTA_PADDLE 0x08
+#define DELTA_SCORES 0x10
+#define DELTA_ACK 0x20
+#define DELTA_ECHO 0x40
 
 typedef struct {
     int x, y;
@@ -39,27 +107,124 @@ typedef struct {
 
 
 GameState prevState;
-GameState state;
+GameState state;    // what the main thread draws
 int game_running = 1;
 int is_server = 0;
-int sockfd;
-int client_sock;
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+int sockfd;     // UDP socket, connected to the peer once known
+int sim_hz = DEFAULT_SIM_HZ;
+int send_hz = DEFAULT_SEND_HZ;
+
+// A snapshot as sent by the server / decoded by the client
+typedef struct {
+    GameState state;
+    uint32_t seq, tick;     // tick counts ball steps
+    uint32_t input_ack;
+    long long recv_ms;
+    int has_echo;           // echo_us/hold_us are valid for this snapshot only
+    uint32_t echo_us, hold_us;
+} Snapshot;
+
+// Lock-free handoff of the newest snapshots from one writer thread to any readers.
+// The writer fills the slot that is not published and then flips `published`;
+// each slot is also a seqlock, so a reader overtaken by two writes retries
+// instead of returning a torn copy. Nobody ever waits on a lock.
+typedef struct {
+    unsigned seq;   // odd while the slot is being written, 0 if never written
+    Snapshot last, prev;
+} StateSlot;
+
+typedef struct {
+    StateSlot slot[2];
+    unsigned published;
+} StateBuffer;
+
+// Server: simulation -> sender and renderer. Client: receiver -> renderer.
+StateBuffer published_state;
+
+// Both sides keep recent snapshots (indexed by seq % SNAP_HISTORY) as delta baselines
+Snapshot snap_history[SNAP_HISTORY];
+
+// Paddle moves handed to the simulation thread. Single producer, single consumer:
+// the producer only writes head, the consumer only writes tail, so neither side
+// ever waits; a full queue drops the move (the client resends until it is acked).
+typedef struct {
+    uint32_t seq;   // client input seq (0 for local keys)
+    int x;          // absolute paddle position
+} InputEvent;
+
+typedef struct {
+    InputEvent events[INPUT_QUEUE_SIZE];
+    unsigned head __attribute__((aligned(64)));
+    unsigned tail __attribute__((aligned(64)));
+} InputQueue;
+
+// Server side: main thread -> simulation (paddleA), server_recv -> simulation (paddleB)
+InputQueue local_inputs, remote_inputs;
+int paddleA_target = WIDTH/2 - PADDLE_WIDTH/2;  // main thread: where our paddle is going
+uint32_t input_received = 0;    // server_recv: newest input seq queued
+uint32_t input_ack = 0;         // simulation: newest client input applied
+uint32_t snap_acked = 0;    // server_recv: newest snapshot the client confirmed
+uint64_t input_echo = 0;    // server_recv: newest input send time << 32 | local arrival time (us)
+
+// Client side: owned by client_recv
+Snapshot snap_last, snap_prev;
+int snap_count = 0;
+
+// Client side: owned by the main thread
+GameState predicted;        // last snapshot re-simulated up to the estimated current tick
+uint32_t predicted_tick = 0;
+uint32_t predicted_seq = 0; // snapshot the prediction was last reconciled with
+uint32_t input_seq = 0;     // client input sequence number
+uint32_t snap_ack_sent = 0; // newest snapshot seq reported back to the server
+long long input_press_us[INPUT_HISTORY];   // key press time of input seq, by seq % INPUT_HISTORY
+uint32_t input_confirmed = 0;   // newest input seq whose latency was recorded
+
+// Client latency measurements, printed on exit
+typedef struct {
+    uint32_t bucket[HIST_BUCKETS];
+    uint32_t count;
+    long long sum_us, min_us, max_us;
+} Histogram;
+
+Histogram rtt_hist;     // client_recv: snapshot echo of our input timestamps
+Histogram input_hist;   // main thread: key press until a snapshot confirms it was applied
 
 void network_setup(int argc, char *argv[]);
+long long now_ms();
+long long now_ns();
+void sleep_until(long long deadline_ns);
+void publish_state(StateBuffer *b, const Snapshot *last, const Snapshot *prev);
+int read_state(StateBuffer *b, Snapshot *last, Snapshot *prev);
+void step_ball(GameState *s);
+void predict_state(const Snapshot *last, const Snapshot *prev);
+void send_input(uint32_t snap_ack);
 void init_ncurses();
 void draw_permanent(WINDOW *win);
-void erase_tmp(WINDOW *win);
 void draw(WINDOW *win);
-void *move_ball(void *arg);
+void *simulate(void *arg);
 void *server_send(void *arg);
 void *server_recv(void *arg);
 void *client_recv(void *arg);
-void reset_ball();
+void reset_ball(GameState *s);
 void end_game();
+int run_rooms(int argc, char *argv[]);
+int input_push(InputQueue *q, uint32_t seq, int x);
+int input_pop(InputQueue *q, InputEvent *ev);
+int run_proxy(int argc, char *argv[]);
+void hist_add(Histogram *h, long long us);
+void hist_print(const char *name, const Histogram *h);
 
 int main(int argc, char *argv[]) {
 
+    // Headless multi-room server: no terminal, no local player
+    if(argc >= 2 && strcmp(argv[1], "rooms") == 0) {
+        return run_rooms(argc, argv);
+    }
+    // Local impairment proxy for benchmarking the netcode
+    if(argc >= 2 && strcmp(argv[1], "proxy") == 0) {
+        return run_proxy(argc, argv);
+    }
+
     // Game init
     state.ball = (Ball){WIDTH/2, HEIGHT/2, 1, 1};
     state.paddleA = (Paddle){WIDTH/2 - PADDLE_WIDTH/2};
@@ -81,11 +246,15 @@ int main(int argc, char *argv[]) {
     draw_permanent(stdscr);
     
     if(is_server){
-        pthread_t ball_thread, send_thread, recv_thread;
-        pthread_create(&ball_thread, NULL, move_ball, NULL);
+        Snapshot init = {state, 0, 0, 0, 0};
+        publish_state(&published_state, &init, &init);
+
+        pthread_t sim_thread, send_thread, recv_thread;
+        pthread_create(&sim_thread, NULL, simulate, NULL);
         pthread_create(&send_thread, NULL, server_send, NULL);
         pthread_create(&recv_thread, NULL, server_recv, NULL);
 
+        int x = paddleA_target;     // where the keys put our paddle
         while(game_running) {
             int ch = getch();
             if(ch == 'q'){
@@ -93,18 +262,22 @@ int main(int argc, char *argv[]) {
                 break;
             }
             
-            pthread_mutex_lock(&mutex);
-            if(ch == KEY_LEFT && state.paddleA.x > 1) state.paddleA.x-=2;
-            if(ch == KEY_RIGHT && state.paddleA.x < WIDTH-PADDLE_WIDTH-1) state.paddleA.x+=2;
-            pthread_mutex_unlock(&mutex);
+            if(ch == KEY_LEFT && x > 1) x-=2;
+            if(ch == KEY_RIGHT && x < WIDTH-PADDLE_WIDTH-1) x+=2;
+            // A full queue keeps the move for the next tick, so the simulation never misses it
+            if(x != paddleA_target && input_push(&local_inputs, 0, x)) paddleA_target = x;
             
-            pthread_mutex_lock(&mutex);
+            // Render the newest published tick; our own paddle shows up once it is queued
+            Snapshot last;
+            read_state(&published_state, &last, NULL);
+            state = last.state;
+            state.paddleA.x = paddleA_target;
             draw(stdscr);
-            pthread_mutex_unlock(&mutex);
         }
 
-        close(client_sock);
-        pthread_join(ball_thread, NULL);
+        unsigned char bye = MSG_BYE;
+        send(sockfd, &bye, 1, 0);
+        pthread_join(sim_thread, NULL);
         pthread_join(send_thread, NULL);
         pthread_join(recv_thread, NULL);
 
@@ -112,48 +285,78 @@ int main(int argc, char *argv[]) {
         pthread_t recv_thread;
         pthread_create(&recv_thread, NULL, client_recv, NULL);
 
+        long long last_input_ms = 0;
         while(game_running) {
             int ch = getch();
             if(ch == 'q') game_running = 0;
             
             int new_x = state.paddleB.x;
 
-
             if(ch == KEY_LEFT && state.paddleB.x > 1) state.paddleB.x-=2;
             if(ch == KEY_RIGHT && state.paddleB.x < WIDTH-PADDLE_WIDTH-1) state.paddleB.x+=2;
             
+            Snapshot last, prev;
+            int have_snapshot = read_state(&published_state, &last, &prev);
+
+            // Input latency: key press until a snapshot shows the server applied it
+            while((int32_t)(last.input_ack - input_confirmed) > 0) {
+                input_confirmed++;
+                if(input_seq - input_confirmed < INPUT_HISTORY && input_press_us[input_confirmed % INPUT_HISTORY]) {
+                    hist_add(&input_hist, now_ns() / 1000 - input_press_us[input_confirmed % INPUT_HISTORY]);
+                }
+            }
+
+            // Send on change, and keep resending until the server acks it (UDP may drop it)
             if(new_x != state.paddleB.x) {
-                int paddleB_x = htons(state.paddleB.x);
-                send(sockfd, &paddleB_x, sizeof(paddleB_x), 0);
+                input_seq++;
+                input_press_us[input_seq % INPUT_HISTORY] = now_ns() / 1000;
+            }
+            // ... and report received snapshots so the server can delta against them
+            int resend = (int32_t)(input_seq - last.input_ack) > 0 || snap_ack_sent != last.seq;
+            if(new_x != state.paddleB.x || (resend && now_ms() - last_input_ms >= UPDATE_INTERVAL/1000)) {
+                send_input(last.seq);
+                last_input_ms = now_ms();
             }
             
-            pthread_mutex_lock(&mutex);
+            if(have_snapshot) predict_state(&last, &prev);
             draw(stdscr);
-            pthread_mutex_unlock(&mutex);
         }
 
+        unsigned char bye = MSG_BYE;
+        send(sockfd, &bye, 1, 0);
         pthread_join(recv_thread, NULL);
     }
     close(sockfd);
     end_game();
+    if(!is_server) {
+        hist_print("Round-trip time", &rtt_hist);
+        hist_print("Input latency (key press to confirming snapshot)", &input_hist);
+    }
     return 0;
 }
 
 void network_setup(int argc, char *argv[]) {
     if(argc < 2) {
-        fprintf(stderr, "Usage: %s server <PORT>\n      %s client <SERVER_IP>\n", argv[0], argv[0]);
+        fprintf(stderr, "Usage: %s server <PORT> [SIM_HZ] [SEND_HZ]\n      %s client <SERVER_IP>\n      %s rooms <PORT> [THREADS] [SIM_HZ] [SEND_HZ]\n"
+                        "      %s proxy <LISTEN_PORT> <SERVER_PORT> [DELAY_MS] [JITTER_MS] [LOSS_PCT] [REORDER_PCT]\n", argv[0], argv[0], argv[0], argv[0]);
         exit(1);
     }
     if(strcmp(argv[1], "server") == 0) {
         is_server = 1;
         // Check if the server port is provided
-        if(argc != 3) {
-            fprintf(stderr, "Usage: %s server <PORT>\n", argv[0]);
+        if(argc < 3 || argc > 5) {
+            fprintf(stderr, "Usage: %s server <PORT> [SIM_HZ] [SEND_HZ]\n", argv[0]);
+            exit(1);
+        }
+        if(argc > 3) sim_hz = atoi(argv[3]);
+        if(argc > 4) send_hz = atoi(argv[4]);
+        if(sim_hz < 1 || sim_hz > 1000 || send_hz < 1 || send_hz > sim_hz) {
+            fprintf(stderr, "SIM_HZ must be 1-1000 and SEND_HZ 1-SIM_HZ\n");
             exit(1);
         }
         // Network setup
         int port = atoi(argv[2]);
-        sockfd = socket(AF_INET, SOCK_STREAM, 0);   // TCP socket creation
+        sockfd = socket(AF_INET, SOCK_DGRAM, 0);   // UDP socket creation
         if(sockfd < 0) {
             perror("Socket creation failed");
             exit(1);
@@ -169,16 +372,22 @@ void network_setup(int argc, char *argv[]) {
             close(sockfd);
             exit(1);
         }
-        if(listen(sockfd, 1) < 0) {
-            perror("Listen failed");
-            close(sockfd);
-            exit(1);
-        }
 
+        // Wait for a HELLO and lock the socket onto that client
         printf("Server listening on port %d...\n", port);
-        client_sock = accept(sockfd, NULL, NULL);
-        if(client_sock < 0) {
-            perror("Accept failed");
+        struct sockaddr_in client_addr;
+        socklen_t addr_len = sizeof(client_addr);
+        unsigned char msg;
+        do {
+            addr_len = sizeof(client_addr);
+            if(recvfrom(sockfd, &msg, 1, 0, (struct sockaddr*)&client_addr, &addr_len) < 0) {
+                perror("Receive failed");
+                close(sockfd);
+                exit(1);
+            }
+        } while(msg != MSG_HELLO);
+        if(connect(sockfd, (struct sockaddr*)&client_addr, addr_len) < 0) {
+            perror("Connect failed");
             close(sockfd);
             exit(1);
         }
@@ -193,7 +402,7 @@ void network_setup(int argc, char *argv[]) {
         }
 
         // Network setup
-        sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        sockfd = socket(AF_INET, SOCK_DGRAM, 0);
         if(sockfd < 0) {
             perror("Socket creation failed");
             exit(1);
@@ -208,11 +417,43 @@ void network_setup(int argc, char *argv[]) {
             close(sockfd);
             exit(1);
         }
+
+        // Say HELLO until the first snapshot shows up
+        struct timeval tv = {.tv_sec = 0, .tv_usec = 200000};
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        unsigned char hello = MSG_HELLO, reply[MAX_MSG_SIZE];
+        int attempts = 0, waiting = 0;
+        do {
+            if(++attempts > 50) {
+                fprintf(stderr, "Connection failed: no reply from %s:8080\n", argv[2]);
+                close(sockfd);
+                exit(1);
+            }
+            send(sockfd, &hello, 1, 0);
+            reply[0] = 0;
+            int n = recv(sockfd, reply, sizeof(reply), 0);
+            if(n < 0 && errno == ECONNREFUSED) {
+                usleep(200000);     // nobody listening yet: refused at once, so pace the retries
+                continue;
+            }
+            if(n > 0 && reply[0] == MSG_WAIT) {
+                // A multi-room server is matching us with an opponent
+                if(!waiting) printf("Waiting for an opponent...\n");
+                waiting = 1;
+                attempts = 0;
+                usleep(200000);
+                reply[0] = 0;
+            }
+        } while(reply[0] != MSG_SNAPSHOT);
         printf("Connected to server %s:8080.\n", argv[2]);
     } else {
         fprintf(stderr, "Invalid argument. Use 'server' or 'client'.\n");
         exit(1);
     }
+
+    // Receive timeout so network threads notice game_running going to 0
+    struct timeval tv = {.tv_sec = 0, .tv_usec = 100000};
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 }
 
 void init_ncurses() {
@@ -232,178 +473,1217 @@ void init_ncurses() {
     noecho();   // Don't echo user input
 }
 
+// Off-screen frame: the score row (OFFSETY-1) and the field, plus room for the score text
+#define FRAME_ROWS (HEIGHT + 1)
+#define FRAME_COLS (WIDTH + 8)
+
+typedef struct {
+    char ch;
+    unsigned char pair;
+} Cell;
+
+Cell background[FRAME_ROWS][FRAME_COLS];    // title, borders and net
+Cell shown[FRAME_ROWS][FRAME_COLS];         // what the terminal currently shows
+
+// Function to write a string into a frame buffer, at screen coordinates
+void frame_puts(Cell frame[FRAME_ROWS][FRAME_COLS], int y, int x, const char *str, int pair) {
+    int row = y - (OFFSETY - 1);
+    for(int col = x - OFFSETX; *str; str++, col++) {
+        if(row >= 0 && row < FRAME_ROWS && col >= 0 && col < FRAME_COLS) {
+            frame[row][col] = (Cell){*str, pair};
+        }
+    }
+}
+
+// Function to paint every cell that differs from what is on screen, in one update
+void flush_frame(WINDOW *win, Cell frame[FRAME_ROWS][FRAME_COLS]) {
+    for(int row = 0; row < FRAME_ROWS; row++) {
+        for(int col = 0; col < FRAME_COLS; col++) {
+            Cell c = frame[row][col];
+            if(c.ch == shown[row][col].ch && c.pair == shown[row][col].pair) continue;
+            mvwaddch(win, OFFSETY - 1 + row, OFFSETX + col, (unsigned char)c.ch | COLOR_PAIR(c.pair));
+            shown[row][col] = c;
+        }
+    }
+    wnoutrefresh(win);
+    doupdate();
+}
+
 void draw_permanent(WINDOW *win){
     clear();
 
+    for(int row = 0; row < FRAME_ROWS; row++) {
+        for(int col = 0; col < FRAME_COLS; col++) {
+            background[row][col] = shown[row][col] = (Cell){' ', 0};
+        }
+    }
+
     // Draw Title
-    attron(COLOR_PAIR(1));
-    if(is_server) mvprintw(OFFSETY-1, OFFSETX, "CS3205 NetPong (Server)");
-    else mvprintw(OFFSETY-1, OFFSETX, "CS3205 NetPong (Client)");
-    attroff(COLOR_PAIR(1));
+    if(is_server) frame_puts(background, OFFSETY-1, OFFSETX, "CS3205 NetPong (Server)", 1);
+    else frame_puts(background, OFFSETY-1, OFFSETX, "CS3205 NetPong (Client)", 1);
 
     // Draw borders
-    attron(COLOR_PAIR(5));
     for(int i=OFFSETX; i<OFFSETX+WIDTH; i++) {
-        mvprintw(OFFSETY, i, " ");
-        mvprintw(OFFSETY+HEIGHT-1, i, " ");
+        frame_puts(background, OFFSETY, i, " ", 5);
+        frame_puts(background, OFFSETY+HEIGHT-1, i, " ", 5);
     }
     for(int i=OFFSETY; i<OFFSETY+HEIGHT; i++) {
-        mvprintw(i, OFFSETX, " ");
-        mvprintw(i, OFFSETX+WIDTH-1, " ");
+        frame_puts(background, i, OFFSETX, " ", 5);
+        frame_puts(background, i, OFFSETX+WIDTH-1, " ", 5);
     }
     // Draw the net
     for(int i=OFFSETX+1; i<OFFSETX+WIDTH-1; i+=2) {
-        mvprintw(OFFSETY+HEIGHT/2, i, "-");
+        frame_puts(background, OFFSETY+HEIGHT/2, i, "-", 5);
     }
-    attroff(COLOR_PAIR(5));
-    refresh();   
+    flush_frame(win, background);
 }
 
-void erase_tmp(WINDOW *win){
-    // erase old ball
-    mvprintw(OFFSETY + prevState.ball.y, OFFSETX + prevState.ball.x, " ");
-
-    // erase old paddle A
-    for(int i=0; i<PADDLE_WIDTH; i++) { // Bottom paddle
-        mvprintw(OFFSETY + HEIGHT -4, OFFSETX + prevState.paddleA.x + i, " ");
-    }
-
-    // erase old paddle B
-    for(int i=0; i<PADDLE_WIDTH; i++) { // Top paddle
-        mvprintw(OFFSETY + 3, OFFSETX + prevState.paddleB.x + i, " ");
-    }
-
-    // erase old scores
-    mvprintw(OFFSETY-1, OFFSETX+WIDTH-20, "                               ");
+// Function to check whether anything visible changed since the last frame
+int frame_changed() {
+    return state.ball.x != prevState.ball.x || state.ball.y != prevState.ball.y ||
+           state.paddleA.x != prevState.paddleA.x || state.paddleB.x != prevState.paddleB.x ||
+           state.scoreA != prevState.scoreA || state.scoreB != prevState.scoreB;
 }
 
 void draw(WINDOW *win) {
-    erase_tmp(win);
+    // Nothing new (no snapshot, input or predicted move): leave the terminal alone
+    if(!frame_changed()) return;
+
+    Cell frame[FRAME_ROWS][FRAME_COLS];
+    memcpy(frame, background, sizeof(frame));
 
     // Draw score panel
-    attron(COLOR_PAIR(1));
-    mvprintw(OFFSETY-1, OFFSETX+WIDTH-27, "Player A: %d  Player B: %d", state.scoreA, state.scoreB);
-    attroff(COLOR_PAIR(1));
-    
+    char score[48];
+    snprintf(score, sizeof(score), "Player A: %d  Player B: %d", state.scoreA, state.scoreB);
+    frame_puts(frame, OFFSETY-1, OFFSETX+WIDTH-27, score, 1);
+
     // Draw ball
-    attron(COLOR_PAIR(4));
-    mvprintw(OFFSETY + state.ball.y, OFFSETX + state.ball.x, "o");
-    attroff(COLOR_PAIR(4));
-    
+    frame_puts(frame, OFFSETY + state.ball.y, OFFSETX + state.ball.x, "o", 4);
+
     // Draw paddles
-    attron(COLOR_PAIR(2));
-    for(int i=0; i<PADDLE_WIDTH; i++) { // Bottom paddle
-        mvprintw(OFFSETY + HEIGHT -4, OFFSETX + state.paddleA.x + i, " ");
+    for(int i=0; i<PADDLE_WIDTH; i++) {
+        frame_puts(frame, OFFSETY + HEIGHT -4, OFFSETX + state.paddleA.x + i, " ", 2);  // Bottom paddle
+        frame_puts(frame, OFFSETY + 3, OFFSETX + state.paddleB.x + i, " ", 3);          // Top paddle
     }
-    attroff(COLOR_PAIR(2));
 
-    attron(COLOR_PAIR(3));
-    for(int i=0; i<PADDLE_WIDTH; i++) { // Top paddle
-        mvprintw(OFFSETY + 3, OFFSETX + state.paddleB.x + i, " ");
-    }
-    attroff(COLOR_PAIR(3));
-    
+    flush_frame(win, frame);
     prevState = state;
-    refresh();
 }
 
-void *move_ball(void *arg) {
+long long now_ms() {
+    return now_ns() / 1000000;
+}
+
+long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Sleep until an absolute CLOCK_MONOTONIC deadline, so periodic loops do not drift
+void sleep_until(long long deadline_ns) {
+    struct timespec ts = {deadline_ns / 1000000000LL, deadline_ns % 1000000000LL};
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+void publish_state(StateBuffer *b, const Snapshot *last, const Snapshot *prev) {
+    unsigned next = __atomic_load_n(&b->published, __ATOMIC_RELAXED) ^ 1;
+    StateSlot *slot = &b->slot[next];
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->last = *last;
+    slot->prev = *prev;
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&b->published, next, __ATOMIC_RELEASE);
+}
+
+// Copy out the newest published snapshots. Returns 0 if nothing was published yet.
+int read_state(StateBuffer *b, Snapshot *last, Snapshot *prev) {
+    for(;;) {
+        StateSlot *slot = &b->slot[__atomic_load_n(&b->published, __ATOMIC_ACQUIRE)];
+        unsigned seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if(seq & 1) continue;
+        Snapshot l = slot->last, p = slot->prev;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) continue;
+        *last = l;
+        if(prev) *prev = p;
+        return seq != 0;
+    }
+}
+
+// One ball step; shared by the server simulation and client prediction
+void step_ball(GameState *s) {
+    s->ball.x += s->ball.dx;
+    s->ball.y += s->ball.dy;
+
+    // Top paddle collision (paddleB)
+    if(s->ball.y == 3 && s->ball.x >= s->paddleB.x && 
+       s->ball.x < s->paddleB.x + PADDLE_WIDTH) {
+        s->ball.dy = -s->ball.dy;
+    }
+
+    // Bottom paddle collision (paddleA)
+    if(s->ball.y == HEIGHT-5 && s->ball.x >= s->paddleA.x && 
+       s->ball.x < s->paddleA.x + PADDLE_WIDTH) {
+        s->ball.dy = -s->ball.dy;
+    }
+
+    // Score handling
+    if(s->ball.y <= 1) { s->scoreA++; reset_ball(s); }
+    if(s->ball.y >= HEIGHT-3) { s->scoreB++; reset_ball(s); }
+
+    // Wall collisions
+    if(s->ball.x <= 2 || s->ball.x >= WIDTH-2) s->ball.dx = -s->ball.dx;
+}
+
+// Server simulation: fixed timestep on an absolute clock. Each wake-up runs every tick
+// that is due (accumulator), so the tick rate does not drift with scheduling jitter.
+void *simulate(void *arg) {
+    GameState sim = state;
+    uint32_t ball_steps = 0;
+    int ball_accum = 0;
+    long long tick_ns = 1000000000LL / sim_hz;
+    long long next = now_ns();
+
     while(game_running) {
-        pthread_mutex_lock(&mutex);
-        
-        state.ball.x += state.ball.dx;
-        state.ball.y += state.ball.dy;
+        sleep_until(next);
+        long long now = now_ns();
+        int steps = 0;
+        while(next <= now && steps < MAX_CATCHUP_TICKS) {
+            // Apply every move queued since the last tick, in order
+            InputEvent ev;
+            while(input_pop(&local_inputs, &ev)) sim.paddleA.x = ev.x;
+            while(input_pop(&remote_inputs, &ev)) {
+                sim.paddleB.x = ev.x;
+                __atomic_store_n(&input_ack, ev.seq, __ATOMIC_RELEASE);
+            }
+            uint32_t ack = input_ack;
 
-        // Top paddle collision (paddleB)
-        if(state.ball.y == 3 && state.ball.x >= state.paddleB.x && 
-           state.ball.x < state.paddleB.x + PADDLE_WIDTH) {
-            state.ball.dy = -state.ball.dy;
-        }
+            // The ball keeps BALL_SPEED steps per second whatever the tick rate
+            ball_accum += BALL_SPEED;
+            while(ball_accum >= sim_hz) {
+                ball_accum -= sim_hz;
+                step_ball(&sim);
+                ball_steps++;
+            }
 
-        // Bottom paddle collision (paddleA)
-        if(state.ball.y == HEIGHT-5 && state.ball.x >= state.paddleA.x && 
-           state.ball.x < state.paddleA.x + PADDLE_WIDTH) {
-            state.ball.dy = -state.ball.dy;
+            Snapshot snap = {sim, 0, ball_steps, ack, 0};
+            publish_state(&published_state, &snap, &snap);
+            next += tick_ns;
+            steps++;
         }
+        if(next <= now) next = now + tick_ns;   // too far behind: drop the backlog
+    }
+    return NULL;
+}
 
-        // Score handling
-        if(state.ball.y <= 1) { state.scoreA++; reset_ball(); }
-        if(state.ball.y >= HEIGHT-3) { state.scoreB++; reset_ball(); }
+// Function to queue a paddle move for the simulation. Returns 0 if the queue is full.
+int input_push(InputQueue *q, uint32_t seq, int x) {
+    unsigned head = q->head;
+    if(head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == INPUT_QUEUE_SIZE) return 0;
+    q->events[head % INPUT_QUEUE_SIZE] = (InputEvent){seq, x};
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
 
-        // Wall collisions
-        if(state.ball.x <= 2 || state.ball.x >= WIDTH-2) state.ball.dx = -state.ball.dx;
+// Function to take the oldest queued paddle move. Returns 0 if there is none.
+int input_pop(InputQueue *q, InputEvent *ev) {
+    unsigned tail = q->tail;
+    if(tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) return 0;
+    *ev = q->events[tail % INPUT_QUEUE_SIZE];
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Bit stream helpers (MSB first)
+typedef struct {
+    unsigned char *buf;
+    int pos, len;   // in bits
+} BitStream;
 
-        pthread_mutex_unlock(&mutex);
-        usleep(100000);  // slow down the ball
+void put_bits(BitStream *bs, uint32_t value, int nbits) {
+    for(int i = nbits - 1; i >= 0; i--, bs->pos++) {
+        if(value >> i & 1) bs->buf[bs->pos >> 3] |= 0x80 >> (bs->pos & 7);
+        else bs->buf[bs->pos >> 3] &= ~(0x80 >> (bs->pos & 7));
     }
-    return NULL;
+}
+
+uint32_t get_bits(BitStream *bs, int nbits) {
+    uint32_t value = 0;
+    for(int i = 0; i < nbits; i++, bs->pos++) {
+        int bit = bs->pos < bs->len ? bs->buf[bs->pos >> 3] >> (7 - (bs->pos & 7)) & 1 : 0;
+        value = value << 1 | bit;
+    }
+    return value;
+}
+
+// Signed value as zigzag exp-Golomb: 0 -> "1", -1 -> "010", 1 -> "011", ...
+void put_delta(BitStream *bs, int32_t delta) {
+    uint32_t v = ((uint32_t)delta << 1 ^ (uint32_t)(delta >> 31)) + 1;
+    int nbits = 32 - __builtin_clz(v);
+    put_bits(bs, 0, nbits - 1);
+    put_bits(bs, v, nbits);
+}
+
+int32_t get_delta(BitStream *bs) {
+    int zeros = 0;
+    while(zeros < 32 && get_bits(bs, 1) == 0) zeros++;
+    uint32_t v = (zeros ? get_bits(bs, zeros) : 0) | (uint32_t)1 << zeros;
+    v -= 1;
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Expand the low 16 bits of a sequence number to the 32-bit value closest to near
+uint32_t expand_seq(uint16_t low, uint32_t near) {
+    return near + (int16_t)(low - (uint16_t)near);
+}
+
+// Encode cur as a delta against base (seq distance dist, 0 = keyframe). Returns bytes written.
+int encode_snapshot(unsigned char *buf, const Snapshot *cur, const Snapshot *base, int dist) {
+    static const Snapshot zero;
+    if(dist == 0) base = &zero;
+
+    BitStream bs = {buf, 0, MAX_MSG_SIZE * 8};
+    put_bits(&bs, MSG_SNAPSHOT, 8);
+    put_bits(&bs, cur->seq & 0xffff, 16);
+    put_bits(&bs, dist, 8);
+
+    const GameState *c = &cur->state, *b = &base->state;
+    int mask = 0;
+    if(cur->tick != base->tick) mask |= DELTA_TICK;
+    if(c->ball.x != b->ball.x || c->ball.y != b->ball.y) mask |= DELTA_BALL_POS;
+    if((c->ball.dx < 0) != (b->ball.dx < 0) || (c->ball.dy < 0) != (b->ball.dy < 0) || dist == 0) mask |= DELTA_BALL_DIR;
+    if(c->paddleA.x != b->paddleA.x) mask |= DELTA_PADDLE;
+    if(c->scoreA != b->scoreA || c->scoreB != b->scoreB) mask |= DELTA_SCORES;
+    if(cur->input_ack != base->input_ack) mask |= DELTA_ACK;
+    if(cur->has_echo) mask |= DELTA_ECHO;
+    put_bits(&bs, mask, 7);
+
+    if(mask & DELTA_TICK) put_delta(&bs, cur->tick - base->tick);
+    if(mask & DELTA_BALL_POS) {
+        put_bits(&bs, c->ball.x, 7);
+        put_bits(&bs, c->ball.y, 5);
+    }
+    if(mask & DELTA_BALL_DIR) {
+        put_bits(&bs, c->ball.dx < 0, 1);
+        put_bits(&bs, c->ball.dy < 0, 1);
+    }
+    if(mask & DELTA_PADDLE) put_bits(&bs, c->paddleA.x, 7);
+    if(mask & DELTA_SCORES) {
+        put_delta(&bs, c->scoreA - b->scoreA);
+        put_delta(&bs, c->scoreB - b->scoreB);
+    }
+    if(mask & DELTA_ACK) put_delta(&bs, cur->input_ack - base->input_ack);
+    if(mask & DELTA_ECHO) {
+        put_bits(&bs, cur->echo_us, 32);
+        put_bits(&bs, cur->hold_us < 0xffffff ? cur->hold_us : 0xffffff, 24);
+    }
+
+    int bytes = (bs.pos + 7) / 8;
+    put_bits(&bs, 0, bytes * 8 - bs.pos);   // zero padding
+    return bytes;
+}
+
+// Decode a snapshot; baselines come from history. Returns -1 if the baseline is unknown.
+int decode_snapshot(const unsigned char *buf, int len, uint32_t last_seq, const Snapshot *history, Snapshot *out) {
+    static const Snapshot zero;
+    BitStream bs = {(unsigned char *)buf, 0, len * 8};
+    if(len < 4 || get_bits(&bs, 8) != MSG_SNAPSHOT) return -1;
+    uint32_t seq = expand_seq(get_bits(&bs, 16), last_seq);
+    int dist = get_bits(&bs, 8);
+
+    const Snapshot *base = &zero;
+    if(dist) {
+        base = &history[(seq - dist) % SNAP_HISTORY];
+        if(base->seq != seq - dist) return -1;
+    }
+
+    *out = *base;
+    out->seq = seq;
+    out->has_echo = 0;
+    GameState *c = &out->state;
+    int mask = get_bits(&bs, 7);
+    if(mask & DELTA_TICK) out->tick = base->tick + get_delta(&bs);
+    if(mask & DELTA_BALL_POS) {
+        c->ball.x = get_bits(&bs, 7);
+        c->ball.y = get_bits(&bs, 5);
+    }
+    if(mask & DELTA_BALL_DIR) {
+        c->ball.dx = get_bits(&bs, 1) ? -1 : 1;
+        c->ball.dy = get_bits(&bs, 1) ? -1 : 1;
+    }
+    if(mask & DELTA_PADDLE) c->paddleA.x = get_bits(&bs, 7);
+    if(mask & DELTA_SCORES) {
+        c->scoreA = base->state.scoreA + get_delta(&bs);
+        c->scoreB = base->state.scoreB + get_delta(&bs);
+    }
+    if(mask & DELTA_ACK) out->input_ack = base->input_ack + get_delta(&bs);
+    if(mask & DELTA_ECHO) {
+        out->has_echo = 1;
+        out->echo_us = get_bits(&bs, 32);
+        out->hold_us = get_bits(&bs, 24);
+    }
+    return bs.pos <= bs.len ? 0 : -1;
 }
 
 void *server_send(void *arg) {
-    GameState send_state;
+    unsigned char buf[MAX_MSG_SIZE];
+    uint32_t seq = 0;
+    uint64_t echo_sent = 0;
+    long long interval_ns = 1000000000LL / send_hz;
+    long long next = now_ns();
     while(game_running) {
-        pthread_mutex_lock(&mutex);
-        send_state.ball.x = htons(state.ball.x);
-        send_state.ball.y = htons(state.ball.y);
-        send_state.ball.dx = htons(state.ball.dx);
-        send_state.ball.dy = htons(state.ball.dy);
-        send_state.paddleA.x = htons(state.paddleA.x);
-        send_state.scoreA = htons(state.scoreA);
-        send_state.scoreB = htons(state.scoreB);
-        pthread_mutex_unlock(&mutex);
+        Snapshot cur;
+        read_state(&published_state, &cur, NULL);
+        cur.seq = ++seq;
+        uint32_t acked = __atomic_load_n(&snap_acked, __ATOMIC_ACQUIRE);
+
+        // Echo the newest input timestamp once, with how long we sat on it
+        uint64_t echo = __atomic_load_n(&input_echo, __ATOMIC_ACQUIRE);
+        cur.has_echo = echo != echo_sent;
+        if(cur.has_echo) {
+            cur.echo_us = echo >> 32;
+            cur.hold_us = (uint32_t)(now_ns() / 1000) - (uint32_t)echo;
+            echo_sent = echo;
+        }
+
+        // Delta against the newest snapshot the client has confirmed, if still in history
+        int dist = acked && cur.seq - acked < SNAP_HISTORY ? cur.seq - acked : 0;
+        int len = encode_snapshot(buf, &cur, &snap_history[acked % SNAP_HISTORY], dist);
+        snap_history[cur.seq % SNAP_HISTORY] = cur;
         
-        send(client_sock, &send_state, sizeof(send_state), 0);
-        usleep(UPDATE_INTERVAL);
+        send(sockfd, buf, len, 0);
+        next += interval_ns;
+        sleep_until(next);
     }
     return NULL;
 }
 
 void *server_recv(void *arg) {
-    int tmp;
+    unsigned char buf[MAX_MSG_SIZE];
     while(game_running) {
-        if(recv(client_sock, &tmp, sizeof(tmp), 0) > 0) {
-            pthread_mutex_lock(&mutex);
-            state.paddleB.x = ntohs(tmp);
-            pthread_mutex_unlock(&mutex);
+        int n = recv(sockfd, buf, sizeof(buf), 0);
+        if(n <= 0) continue;
+        if(buf[0] == MSG_BYE) { game_running = 0; break; }
+        if(buf[0] != MSG_INPUT || n != INPUT_SIZE) continue;
+
+        BitStream bs = {buf, 8, n * 8};
+        uint16_t seq_low = get_bits(&bs, 16);
+        uint16_t ack_low = get_bits(&bs, 16);
+        int x = get_bits(&bs, 7);
+        get_bits(&bs, 1);
+        uint32_t sent_us = get_bits(&bs, 32);
+        __atomic_store_n(&input_echo, (uint64_t)sent_us << 32 | (uint32_t)(now_ns() / 1000), __ATOMIC_RELEASE);
+
+        // Inputs carry the absolute paddle position: newer ones are queued for the
+        // simulation, stale/duplicate ones are dropped. It acks them once applied.
+        uint32_t seq = expand_seq(seq_low, input_received);
+        if((int32_t)(seq - input_received) > 0 && x >= 1 && x <= WIDTH-PADDLE_WIDTH-1) {
+            if(input_push(&remote_inputs, seq, x)) input_received = seq;
         }
+        uint32_t ack = expand_seq(ack_low, snap_acked);
+        if((int32_t)(ack - snap_acked) > 0) __atomic_store_n(&snap_acked, ack, __ATOMIC_RELEASE);
     }
     return NULL;
 }
 
+// Client: send the current paddle position tagged with input_seq, plus the snapshot ack
+void send_input(uint32_t snap_ack) {
+    unsigned char buf[INPUT_SIZE];
+    BitStream bs = {buf, 0, INPUT_SIZE * 8};
+    put_bits(&bs, MSG_INPUT, 8);
+    put_bits(&bs, input_seq & 0xffff, 16);
+    put_bits(&bs, snap_ack & 0xffff, 16);
+    put_bits(&bs, state.paddleB.x, 7);
+    put_bits(&bs, 0, 1);
+    put_bits(&bs, (uint32_t)(now_ns() / 1000), 32);
+    snap_ack_sent = snap_ack;
+    send(sockfd, buf, sizeof(buf), 0);
+}
+
 void *client_recv(void *arg) {
-    GameState recv_state;
+    unsigned char buf[MAX_MSG_SIZE];
+    while(game_running) {
+        int n = recv(sockfd, buf, sizeof(buf), 0);
+        if(n <= 0) continue;
+        if(buf[0] == MSG_BYE) { game_running = 0; break; }
+        if(buf[0] != MSG_SNAPSHOT) continue;
+
+        Snapshot snap;
+        if(decode_snapshot(buf, n, snap_last.seq, snap_history, &snap) == 0) {
+            snap.recv_ms = now_ms();
+            if(snap.has_echo) {
+                hist_add(&rtt_hist, (int32_t)((uint32_t)(now_ns() / 1000) - snap.echo_us - snap.hold_us));
+            }
+            // Out-of-order or duplicate snapshots are simply dropped
+            if(snap_count == 0 || (int32_t)(snap.seq - snap_last.seq) > 0) {
+                snap_history[snap.seq % SNAP_HISTORY] = snap;
+                snap_prev = snap_count ? snap_last : snap;
+                snap_last = snap;
+                snap_count++;
+                publish_state(&published_state, &snap_last, &snap_prev);
+            }
+        }
+    }
+    return NULL;
+}
+
+// Client: build the state to draw from the last two snapshots.
+// Ball: prediction from the last snapshot, re-simulated with our own paddle up to the
+// estimated current server tick. Remote paddle: interpolated between the last two
+// snapshots, rendered one observed snapshot interval behind.
+void predict_state(const Snapshot *last, const Snapshot *prev) {
+    long long now = now_ms();
+    uint32_t target = last->tick + (now - last->recv_ms) * BALL_SPEED / 1000;
+
+    // Reconcile: restart from the authoritative state whenever a snapshot arrives
+    if(last->seq != predicted_seq || target < predicted_tick) {
+        predicted = last->state;
+        predicted_tick = last->tick;
+        predicted_seq = last->seq;
+    }
+    predicted.paddleB = state.paddleB;
+    while(predicted_tick < target) {
+        step_ball(&predicted);
+        predicted_tick++;
+    }
+    state.ball = predicted.ball;
+
+    long long span = last->recv_ms - prev->recv_ms;
+    long long t = now - span - prev->recv_ms;
+    if(span <= 0 || t >= span) {
+        state.paddleA = last->state.paddleA;
+    } else if(t <= 0) {
+        state.paddleA = prev->state.paddleA;
+    } else {
+        int a = prev->state.paddleA.x, b = last->state.paddleA.x;
+        state.paddleA.x = a + (int)((b - a) * t / span);
+    }
+
+    // Scores only change authoritatively
+    state.scoreA = last->state.scoreA;
+    state.scoreB = last->state.scoreB;
+}
+
+/*
+ * Headless multi-room server.
+ *
+ * One UDP socket serves every match. A network thread (epoll + recvmmsg) owns
+ * matchmaking and the address -> player table; the main thread runs the fixed
+ * timestep and, on every tick, hands out batches of ROOM_BATCH consecutive rooms
+ * to a small pool of workers that step them and send their snapshots.
+ *
+ * Both players are remote. Role 1 plays paddleB (top) and sees the room as is;
+ * role 0 plays paddleA (bottom) and is sent a vertically mirrored view, so the
+ * ordinary client always controls the top paddle and needs no changes.
+ */
+
+// Hot per-room state, stepped every tick: kept small and contiguous
+typedef struct {
+    GameState state;
+    uint32_t ball_steps;
+    int ball_accum;
+    int send_accum;
+    int active;                 // set by the network thread once the room is set up
+    uint64_t input[2];          // [role] newest input, seq << 32 | x, written by the network thread
+    uint32_t input_ack[2];      // [role] seq of the input the last step applied
+} Room;
+
+// Cold per-room state, touched on send ticks only
+typedef struct {
+    struct sockaddr_in addr[2];
+    uint32_t seq[2];
+    uint32_t snap_acked[2];     // written by the network thread
+    uint64_t input_echo[2];     // written by the network thread, as input_echo
+    uint64_t echo_sent[2];
+    Snapshot history[2][SNAP_HISTORY];
+} RoomNet;
+
+typedef struct {
+    struct sockaddr_in addr;    // sin_port == 0: empty, sin_family == AF_UNSPEC: deleted
+    int room, role;
+    long long last_seen_ms;
+} Player;
+
+Room *rooms;
+RoomNet *room_net;
+int room_count = 0;             // high-water mark of room slots in use
+uint64_t room_ticks = 0;        // ticks completed, read by the network thread
+uint64_t room_free_after[MAX_ROOMS];    // a released slot is reused only after this tick
+Player players[PLAYER_TABLE_SIZE];
+struct sockaddr_in waiting_players[MAX_WAITING];
+int waiting_count = 0;
+int room_sock;
+
+// Worker pool: the tick thread opens a round, everybody drains batches, round closes
+pthread_barrier_t round_start, round_done;
+int round_batches = 0;
+int next_batch = 0;
+int round_sim_hz;
+int rounds_over = 0;            // set by the tick thread only, so every worker sees the same rounds
+
+void handle_stop(int sig) {
+    game_running = 0;
+}
+
+unsigned hash_addr(const struct sockaddr_in *addr) {
+    uint32_t h = addr->sin_addr.s_addr * 2654435761u ^ addr->sin_port * 40503u;
+    return h & (PLAYER_TABLE_SIZE - 1);
+}
+
+int same_addr(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+Player *find_player(const struct sockaddr_in *addr, int create) {
+    Player *deleted = NULL;
+    unsigned i = hash_addr(addr);
+    for(int probes = 0; probes < PLAYER_TABLE_SIZE; probes++, i = (i + 1) & (PLAYER_TABLE_SIZE - 1)) {
+        Player *p = &players[i];
+        if(p->addr.sin_port == 0) {
+            if(!create) return NULL;
+            if(!deleted) deleted = p;
+            break;
+        }
+        if(p->addr.sin_family == AF_UNSPEC) {
+            if(!deleted) deleted = p;
+            continue;
+        }
+        if(same_addr(&p->addr, addr)) return p;
+    }
+    if(!create || !deleted) return NULL;
+    deleted->addr = *addr;
+    return deleted;
+}
+
+void remove_player(Player *p) {
+    p->addr.sin_family = AF_UNSPEC;     // tombstone keeps probe chains intact
+}
+
+void send_to(const struct sockaddr_in *addr, const void *buf, int len) {
+    sendto(room_sock, buf, len, 0, (const struct sockaddr*)addr, sizeof(*addr));
+}
+
+// View of a room for one player: role 0 gets the mirrored game (own paddle on top)
+void player_view(const Room *r, int role, GameState *view) {
+    *view = r->state;
+    if(role == 1) return;
+    view->ball.y = HEIGHT - 2 - view->ball.y;   // swaps paddle rows 3 and HEIGHT-5
+    view->ball.dy = -view->ball.dy;
+    view->paddleA = r->state.paddleB;
+    view->paddleB = r->state.paddleA;
+    view->scoreA = r->state.scoreB;
+    view->scoreB = r->state.scoreA;
+}
+
+// Network thread: start a match for the two longest-waiting players
+void start_room(long long now) {
+    uint64_t ticks = __atomic_load_n(&room_ticks, __ATOMIC_ACQUIRE);
+    int slot = -1;
+    for(int i = 0; i < MAX_ROOMS; i++) {
+        if(!rooms[i].active && (i >= room_count || room_free_after[i] < ticks)) {
+            slot = i;
+            break;
+        }
+    }
+    if(slot < 0) return;    // full: players stay queued
+
+    Room *r = &rooms[slot];
+    RoomNet *net = &room_net[slot];
+    memset(r, 0, sizeof(*r));
+    memset(net, 0, sizeof(*net));
+    r->state.ball = (Ball){WIDTH/2, HEIGHT/2, 1, 1};
+    r->state.paddleA = r->state.paddleB = (Paddle){WIDTH/2 - PADDLE_WIDTH/2};
+    for(int role = 0; role < 2; role++) {
+        r->input[role] = WIDTH/2 - PADDLE_WIDTH/2;
+        net->addr[role] = waiting_players[role];
+        Player *p = find_player(&waiting_players[role], 1);
+        if(p) {
+            p->room = slot;
+            p->role = role;
+            p->last_seen_ms = now;
+        }
+    }
+    waiting_count -= 2;
+    memmove(waiting_players, waiting_players + 2, waiting_count * sizeof(waiting_players[0]));
+
+    if(slot >= room_count) __atomic_store_n(&room_count, slot + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->active, 1, __ATOMIC_RELEASE);
+}
+
+// Network thread: end a match, telling whoever is still there
+void end_room(int slot, const struct sockaddr_in *leaving) {
+    Room *r = &rooms[slot];
+    if(!r->active) return;
+    __atomic_store_n(&r->active, 0, __ATOMIC_RELEASE);
+    // A worker may still be stepping it this tick; keep the slot for two more ticks
+    room_free_after[slot] = __atomic_load_n(&room_ticks, __ATOMIC_ACQUIRE) + 2;
+
+    unsigned char bye = MSG_BYE;
+    for(int role = 0; role < 2; role++) {
+        Player *p = find_player(&room_net[slot].addr[role], 0);
+        if(p) remove_player(p);
+        if(!leaving || !same_addr(leaving, &room_net[slot].addr[role])) {
+            send_to(&room_net[slot].addr[role], &bye, 1);
+        }
+    }
+}
+
+// Network thread: handle one datagram
+void room_datagram(const unsigned char *buf, int n, const struct sockaddr_in *from, long long now) {
+    Player *p = find_player(from, 0);
+
+    if(!p) {
+        if(buf[0] != MSG_HELLO) return;
+        int queued = 0;
+        for(int i = 0; i < waiting_count; i++) {
+            if(same_addr(&waiting_players[i], from)) queued = 1;
+        }
+        if(!queued && waiting_count < MAX_WAITING) {
+            waiting_players[waiting_count++] = *from;
+        }
+        if(waiting_count >= 2) {
+            start_room(now);
+        }
+        if(!find_player(from, 0)) {
+            unsigned char wait = MSG_WAIT;
+            send_to(from, &wait, 1);
+        }
+        return;
+    }
+
+    p->last_seen_ms = now;
+    Room *r = &rooms[p->room];
+    if(buf[0] == MSG_BYE) {
+        end_room(p->room, from);
+        return;
+    }
+    if(buf[0] != MSG_INPUT || n != INPUT_SIZE) return;
+
+    BitStream bs = {(unsigned char *)buf, 8, n * 8};
+    uint16_t seq_low = get_bits(&bs, 16);
+    uint16_t ack_low = get_bits(&bs, 16);
+    int x = get_bits(&bs, 7);
+    get_bits(&bs, 1);
+    uint32_t sent_us = get_bits(&bs, 32);
+    __atomic_store_n(&room_net[p->room].input_echo[p->role], (uint64_t)sent_us << 32 | (uint32_t)(now_ns() / 1000), __ATOMIC_RELEASE);
+
+    // Same rules as server_recv, per role; the worker acks the input once a step applies it
+    uint64_t *input = &r->input[p->role];
+    uint32_t received = *input >> 32;
+    uint32_t seq = expand_seq(seq_low, received);
+    if((int32_t)(seq - received) > 0 && x >= 1 && x <= WIDTH-PADDLE_WIDTH-1) {
+        __atomic_store_n(input, (uint64_t)seq << 32 | (uint32_t)x, __ATOMIC_RELEASE);
+    }
+    uint32_t *snap_acked = &room_net[p->room].snap_acked[p->role];
+    uint32_t ack = expand_seq(ack_low, *snap_acked);
+    if((int32_t)(ack - *snap_acked) > 0) __atomic_store_n(snap_acked, ack, __ATOMIC_RELEASE);
+}
+
+void *room_network(void *arg) {
+    int ep = epoll_create1(0);
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = room_sock};
+    epoll_ctl(ep, EPOLL_CTL_ADD, room_sock, &ev);
+
+    unsigned char bufs[NET_BATCH][MAX_MSG_SIZE];
+    struct sockaddr_in addrs[NET_BATCH];
+    struct iovec iov[NET_BATCH];
+    struct mmsghdr msgs[NET_BATCH];
+    long long last_sweep = now_ms();
+
     while(game_running) {
-        if(recv(sockfd, &recv_state, sizeof(recv_state), 0) > 0) {
-            pthread_mutex_lock(&mutex);
-            state.ball.x = ntohs(recv_state.ball.x);
-            state.ball.y = ntohs(recv_state.ball.y);
-            state.ball.dx = ntohs(recv_state.ball.dx);
-            state.ball.dy = ntohs(recv_state.ball.dy);
-            state.paddleA.x = ntohs(recv_state.paddleA.x);
-            state.scoreA = ntohs(recv_state.scoreA);
-            state.scoreB = ntohs(recv_state.scoreB);
-            pthread_mutex_unlock(&mutex);
+        struct epoll_event events[1];
+        int ready = epoll_wait(ep, events, 1, 100);
+        long long now = now_ms();
+
+        while(ready > 0) {
+            for(int i = 0; i < NET_BATCH; i++) {
+                iov[i] = (struct iovec){bufs[i], MAX_MSG_SIZE};
+                msgs[i].msg_hdr = (struct msghdr){.msg_name = &addrs[i], .msg_namelen = sizeof(addrs[i]), .msg_iov = &iov[i], .msg_iovlen = 1};
+            }
+            int n = recvmmsg(room_sock, msgs, NET_BATCH, MSG_DONTWAIT, NULL);
+            if(n <= 0) break;
+            for(int i = 0; i < n; i++) {
+                if(msgs[i].msg_len > 0) room_datagram(bufs[i], msgs[i].msg_len, &addrs[i], now);
+            }
+        }
+
+        // Drop silent players once a second
+        if(now - last_sweep >= 1000) {
+            last_sweep = now;
+            for(int i = 0; i < PLAYER_TABLE_SIZE; i++) {
+                Player *p = &players[i];
+                if(p->addr.sin_port && p->addr.sin_family != AF_UNSPEC && now - p->last_seen_ms > PLAYER_TIMEOUT_MS) {
+                    end_room(p->room, NULL);
+                }
+            }
+        }
+    }
+    close(ep);
+    return NULL;
+}
+
+// Worker: one room tick, same physics as simulate()
+void step_room(Room *r) {
+    // Seq and x come in one load, so the ack matches the move applied (as in simulate())
+    uint64_t a = __atomic_load_n(&r->input[0], __ATOMIC_ACQUIRE), b = __atomic_load_n(&r->input[1], __ATOMIC_ACQUIRE);
+    r->state.paddleA.x = (uint32_t)a;
+    r->state.paddleB.x = (uint32_t)b;
+    r->input_ack[0] = a >> 32;
+    r->input_ack[1] = b >> 32;
+    r->ball_accum += BALL_SPEED;
+    while(r->ball_accum >= round_sim_hz) {
+        r->ball_accum -= round_sim_hz;
+        step_ball(&r->state);
+        r->ball_steps++;
+    }
+}
+
+// Worker: step a batch of rooms and send the snapshots that are due, one sendmmsg per batch
+void run_room_batch(int batch, int send_hz) {
+    unsigned char bufs[2 * ROOM_BATCH][MAX_MSG_SIZE];
+    struct iovec iov[2 * ROOM_BATCH];
+    struct mmsghdr msgs[2 * ROOM_BATCH];
+    int count = 0;
+
+    int end = (batch + 1) * ROOM_BATCH;
+    int limit = __atomic_load_n(&room_count, __ATOMIC_ACQUIRE);
+    if(end > limit) end = limit;
+
+    for(int i = batch * ROOM_BATCH; i < end; i++) {
+        Room *r = &rooms[i];
+        if(!__atomic_load_n(&r->active, __ATOMIC_ACQUIRE)) continue;
+        step_room(r);
+
+        r->send_accum += send_hz;
+        if(r->send_accum < round_sim_hz) continue;
+        r->send_accum -= round_sim_hz;
+
+        RoomNet *net = &room_net[i];
+        for(int role = 0; role < 2; role++) {
+            Snapshot cur = {{{0}}, ++net->seq[role], r->ball_steps, r->input_ack[role], 0};
+            player_view(r, role, &cur.state);
+            uint64_t echo = __atomic_load_n(&net->input_echo[role], __ATOMIC_ACQUIRE);
+            cur.has_echo = echo != net->echo_sent[role];
+            if(cur.has_echo) {
+                cur.echo_us = echo >> 32;
+                cur.hold_us = (uint32_t)(now_ns() / 1000) - (uint32_t)echo;
+                net->echo_sent[role] = echo;
+            }
+            uint32_t acked = __atomic_load_n(&net->snap_acked[role], __ATOMIC_ACQUIRE);
+            int dist = acked && cur.seq - acked < SNAP_HISTORY ? cur.seq - acked : 0;
+            int len = encode_snapshot(bufs[count], &cur, &net->history[role][acked % SNAP_HISTORY], dist);
+            net->history[role][cur.seq % SNAP_HISTORY] = cur;
+
+            iov[count] = (struct iovec){bufs[count], len};
+            msgs[count].msg_hdr = (struct msghdr){.msg_name = &net->addr[role], .msg_namelen = sizeof(net->addr[role]), .msg_iov = &iov[count], .msg_iovlen = 1};
+            count++;
         }
     }
+
+    for(int sent = 0; sent < count; ) {
+        int n = sendmmsg(room_sock, msgs + sent, count - sent, 0);
+        if(n <= 0) break;
+        sent += n;
+    }
+}
+
+typedef struct {
+    int send_hz;
+} RoomWorkerArgs;
+
+void drain_batches(int send_hz) {
+    int batch;
+    while((batch = __atomic_fetch_add(&next_batch, 1, __ATOMIC_ACQ_REL)) < round_batches) {
+        run_room_batch(batch, send_hz);
+    }
+}
+
+void *room_worker(void *arg) {
+    int send_hz = ((RoomWorkerArgs *)arg)->send_hz;
+    while(1) {
+        pthread_barrier_wait(&round_start);
+        if(rounds_over) break;
+        drain_batches(send_hz);
+        pthread_barrier_wait(&round_done);
+    }
     return NULL;
 }
 
-// void *client_send(void *arg) {
-//     while(game_running) {
-//         pthread_mutex_lock(&mutex);
-//         send(sockfd, &paddleB.x, sizeof(paddleB.x), 0);
-//         pthread_mutex_unlock(&mutex);
-//         usleep(UPDATE_INTERVAL);
-//     }
-//     return NULL;
-// }
+int run_rooms(int argc, char *argv[]) {
+    if(argc < 3 || argc > 6) {
+        fprintf(stderr, "Usage: %s rooms <PORT> [THREADS] [SIM_HZ] [SEND_HZ]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[2]);
+    int threads = argc > 3 ? atoi(argv[3]) : DEFAULT_ROOM_THREADS;
+    if(argc > 4) sim_hz = atoi(argv[4]);
+    if(argc > 5) send_hz = atoi(argv[5]);
+    if(threads < 1 || threads > 64 || sim_hz < 1 || sim_hz > 1000 || send_hz < 1 || send_hz > sim_hz) {
+        fprintf(stderr, "THREADS must be 1-64, SIM_HZ 1-1000 and SEND_HZ 1-SIM_HZ\n");
+        return 1;
+    }
+    round_sim_hz = sim_hz;
+
+    room_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if(room_sock < 0) {
+        perror("Socket creation failed");
+        return 1;
+    }
+    struct sockaddr_in server_addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = INADDR_ANY
+    };
+    if(bind(room_sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        perror("Bind failed");
+        close(room_sock);
+        return 1;
+    }
+
+    rooms = calloc(MAX_ROOMS, sizeof(Room));
+    room_net = calloc(MAX_ROOMS, sizeof(RoomNet));
+    if(!rooms || !room_net) {
+        perror("Memory allocation failed");
+        return 1;
+    }
+
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+
+    // The tick thread (this one) takes part in every round too
+    pthread_barrier_init(&round_start, NULL, threads);
+    pthread_barrier_init(&round_done, NULL, threads);
+    RoomWorkerArgs worker_args = {send_hz};
+    pthread_t workers[64], net_thread;
+    for(int i = 0; i < threads - 1; i++) {
+        pthread_create(&workers[i], NULL, room_worker, &worker_args);
+    }
+    pthread_create(&net_thread, NULL, room_network, NULL);
+
+    printf("Multi-room server on port %d: %d threads, %d Hz simulation, %d Hz snapshots\n", port, threads, sim_hz, send_hz);
+
+    long long tick_ns = 1000000000LL / sim_hz;
+    long long next = now_ns();
+    long long last_report = now_ms();
+    uint64_t late_ticks = 0;
+    while(game_running) {
+        sleep_until(next);
+        long long now = now_ns();
+        int steps = 0;
+        while(next <= now && steps < MAX_CATCHUP_TICKS) {
+            round_batches = (__atomic_load_n(&room_count, __ATOMIC_ACQUIRE) + ROOM_BATCH - 1) / ROOM_BATCH;
+            __atomic_store_n(&next_batch, 0, __ATOMIC_RELEASE);
+            pthread_barrier_wait(&round_start);
+            drain_batches(send_hz);
+            pthread_barrier_wait(&round_done);
+            __atomic_store_n(&room_ticks, room_ticks + 1, __ATOMIC_RELEASE);
+            next += tick_ns;
+            if(++steps > 1) late_ticks++;
+        }
+        if(next <= now) next = now + tick_ns;   // too far behind: drop the backlog
+
+        if(now / 1000000 - last_report >= 5000) {
+            last_report = now / 1000000;
+            int active = 0;
+            for(int i = 0; i < room_count; i++) active += rooms[i].active;
+            printf("rooms: %d active, %d waiting players, %llu ticks, %llu late\n",
+                   active, waiting_count, (unsigned long long)room_ticks, (unsigned long long)late_ticks);
+            fflush(stdout);
+        }
+    }
+
+    // Release the workers into an empty final round; the network thread sees game_running == 0
+    rounds_over = 1;
+    pthread_barrier_wait(&round_start);
+    for(int i = 0; i < threads - 1; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_join(net_thread, NULL);
+
+    unsigned char bye = MSG_BYE;
+    for(int i = 0; i < room_count; i++) {
+        if(!rooms[i].active) continue;
+        send_to(&room_net[i].addr[0], &bye, 1);
+        send_to(&room_net[i].addr[1], &bye, 1);
+    }
+    close(room_sock);
+    free(rooms);
+    free(room_net);
+    printf("Multi-room server stopped.\n");
+    return 0;
+}
+
+// Function to record one latency sample
+void hist_add(Histogram *h, long long us) {
+    if(us < 0) us = 0;
+    long long ms = us / 1000;
+    h->bucket[ms < HIST_BUCKETS ? ms : HIST_BUCKETS - 1]++;
+    if(h->count == 0 || us < h->min_us) h->min_us = us;
+    if(us > h->max_us) h->max_us = us;
+    h->sum_us += us;
+    h->count++;
+}
+
+// Function to find the bucket (ms) holding the given fraction of the samples
+int hist_percentile(const Histogram *h, double fraction) {
+    uint32_t rank = (uint32_t)(h->count * fraction), seen = 0;
+    for(int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->bucket[i];
+        if(seen > rank) return i;
+    }
+    return HIST_BUCKETS - 1;
+}
+
+// Function to print a histogram with summary statistics
+void hist_print(const char *name, const Histogram *h) {
+    printf("%s: %u samples", name, h->count);
+    if(h->count == 0) {
+        printf("\n");
+        return;
+    }
+    printf(", min %.2f ms, avg %.2f ms, p50 <%d ms, p90 <%d ms, p99 <%d ms, max %.2f ms\n",
+           h->min_us / 1000.0, h->sum_us / 1000.0 / h->count, hist_percentile(h, 0.5) + 1,
+           hist_percentile(h, 0.9) + 1, hist_percentile(h, 0.99) + 1, h->max_us / 1000.0);
+
+    uint32_t peak = 0;
+    for(int i = 0; i < HIST_BUCKETS; i++) {
+        if(h->bucket[i] > peak) peak = h->bucket[i];
+    }
+    for(int i = 0; i < HIST_BUCKETS; i++) {
+        if(h->bucket[i] == 0) continue;
+        int bar = (int)((h->bucket[i] * 40ULL + peak - 1) / peak);
+        if(i == HIST_BUCKETS - 1) printf("  >=%3d ms %7u ", i, h->bucket[i]);
+        else printf("  %3d-%-3d ms %6u ", i, i + 1, h->bucket[i]);
+        for(int j = 0; j < bar; j++) putchar('#');
+        putchar('\n');
+    }
+}
+
+/*
+ * Impairment proxy: proxy <LISTEN_PORT> <SERVER_PORT> [DELAY_MS] [JITTER_MS] [LOSS_PCT] [REORDER_PCT]
+ *
+ * Sits between clients and a server on loopback and impairs both directions:
+ * every datagram is dropped with LOSS_PCT, otherwise held for DELAY_MS plus a
+ * uniform +-JITTER_MS. With REORDER_PCT a datagram skips the queue and goes out
+ * at once, overtaking those still held. Each client gets its own upstream
+ * socket, so the server sees one address per client as usual.
+ */
+typedef struct {
+    struct sockaddr_in client;
+    int upstream;               // connected to the server; -1 if the slot is free
+    long long last_seen_ms;
+} ProxySession;
+
+typedef struct {
+    long long release_ns;
+    int session;
+    int to_server;
+    int len;
+    unsigned char data[MAX_MSG_SIZE];
+} ProxyPacket;
+
+ProxySession proxy_sessions[MAX_PROXY_SESSIONS];
+ProxyPacket proxy_queue[MAX_PROXY_QUEUE];   // binary min-heap on release_ns
+int proxy_queued = 0;
+int proxy_listen;
+
+void proxy_heap_push(const ProxyPacket *pkt) {
+    int i = proxy_queued++;
+    while(i > 0 && proxy_queue[(i - 1) / 2].release_ns > pkt->release_ns) {
+        proxy_queue[i] = proxy_queue[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    proxy_queue[i] = *pkt;
+}
+
+void proxy_heap_pop() {
+    ProxyPacket last = proxy_queue[--proxy_queued];
+    int i = 0;
+    for(;;) {
+        int child = 2 * i + 1;
+        if(child >= proxy_queued) break;
+        if(child + 1 < proxy_queued && proxy_queue[child + 1].release_ns < proxy_queue[child].release_ns) child++;
+        if(proxy_queue[child].release_ns >= last.release_ns) break;
+        proxy_queue[i] = proxy_queue[child];
+        i = child;
+    }
+    if(proxy_queued > 0) proxy_queue[i] = last;
+}
+
+void proxy_deliver(const ProxyPacket *pkt) {
+    ProxySession *sess = &proxy_sessions[pkt->session];
+    if(sess->upstream < 0) return;  // session closed meanwhile
+    if(pkt->to_server) send(sess->upstream, pkt->data, pkt->len, 0);
+    else sendto(proxy_listen, pkt->data, pkt->len, 0, (struct sockaddr*)&sess->client, sizeof(sess->client));
+}
+
+int proxy_session(const struct sockaddr_in *client, const struct sockaddr_in *server, long long now) {
+    int free_slot = -1;
+    for(int i = 0; i < MAX_PROXY_SESSIONS; i++) {
+        if(proxy_sessions[i].upstream < 0) {
+            if(free_slot < 0) free_slot = i;
+        } else if(same_addr(&proxy_sessions[i].client, client)) {
+            return i;
+        }
+    }
+    if(free_slot < 0) return -1;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(fd < 0 || connect(fd, (const struct sockaddr*)server, sizeof(*server)) < 0) {
+        perror("Proxy upstream socket failed");
+        if(fd >= 0) close(fd);
+        return -1;
+    }
+    proxy_sessions[free_slot] = (ProxySession){*client, fd, now};
+    printf("Proxy: new client %s:%d\n", inet_ntoa(client->sin_addr), ntohs(client->sin_port));
+    return free_slot;
+}
+
+int run_proxy(int argc, char *argv[]) {
+    if(argc < 4 || argc > 8) {
+        fprintf(stderr, "Usage: %s proxy <LISTEN_PORT> <SERVER_PORT> [DELAY_MS] [JITTER_MS] [LOSS_PCT] [REORDER_PCT]\n", argv[0]);
+        return 1;
+    }
+    int listen_port = atoi(argv[2]);
+    int server_port = atoi(argv[3]);
+    int delay_ms = argc > 4 ? atoi(argv[4]) : 0;
+    int jitter_ms = argc > 5 ? atoi(argv[5]) : 0;
+    double loss_pct = argc > 6 ? atof(argv[6]) : 0;
+    double reorder_pct = argc > 7 ? atof(argv[7]) : 0;
+    if(delay_ms < 0 || jitter_ms < 0 || loss_pct < 0 || loss_pct > 100 || reorder_pct < 0 || reorder_pct > 100) {
+        fprintf(stderr, "Delay and jitter must be >= 0, percentages 0-100\n");
+        return 1;
+    }
+
+    proxy_listen = socket(AF_INET, SOCK_DGRAM, 0);
+    if(proxy_listen < 0) {
+        perror("Socket creation failed");
+        return 1;
+    }
+    struct sockaddr_in listen_addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(listen_port),
+        .sin_addr.s_addr = INADDR_ANY
+    };
+    if(bind(proxy_listen, (struct sockaddr*)&listen_addr, sizeof(listen_addr)) < 0) {
+        perror("Bind failed");
+        close(proxy_listen);
+        return 1;
+    }
+    struct sockaddr_in server_addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(server_port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+    for(int i = 0; i < MAX_PROXY_SESSIONS; i++) proxy_sessions[i].upstream = -1;
+
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+    srand(time(NULL));
+    printf("Proxy %d -> 127.0.0.1:%d: delay %d ms, jitter %d ms, loss %.1f%%, reorder %.1f%%\n",
+           listen_port, server_port, delay_ms, jitter_ms, loss_pct, reorder_pct);
+
+    unsigned long long forwarded = 0, dropped = 0, reordered = 0, overflow = 0;
+    while(game_running) {
+        // Wake up for the next datagram due, or at least every 100 ms
+        long long now = now_ns();
+        int wait_ms = 100;
+        if(proxy_queued > 0) {
+            long long due_ms = (proxy_queue[0].release_ns - now + 999999) / 1000000;
+            if(due_ms < wait_ms) wait_ms = due_ms > 0 ? due_ms : 0;
+        }
+
+        struct pollfd fds[MAX_PROXY_SESSIONS + 1];
+        int owner[MAX_PROXY_SESSIONS + 1];
+        int nfds = 0;
+        fds[nfds] = (struct pollfd){proxy_listen, POLLIN, 0};
+        owner[nfds++] = -1;
+        for(int i = 0; i < MAX_PROXY_SESSIONS; i++) {
+            if(proxy_sessions[i].upstream < 0) continue;
+            fds[nfds] = (struct pollfd){proxy_sessions[i].upstream, POLLIN, 0};
+            owner[nfds++] = i;
+        }
+        if(poll(fds, nfds, wait_ms) < 0 && errno != EINTR) {
+            perror("Poll failed");
+            break;
+        }
+
+        now = now_ns();
+        for(int i = 0; i < nfds; i++) {
+            if(!(fds[i].revents & POLLIN)) continue;
+            ProxyPacket pkt;
+            if(owner[i] < 0) {
+                struct sockaddr_in from;
+                socklen_t len = sizeof(from);
+                pkt.len = recvfrom(proxy_listen, pkt.data, sizeof(pkt.data), MSG_DONTWAIT, (struct sockaddr*)&from, &len);
+                if(pkt.len <= 0) continue;
+                pkt.session = proxy_session(&from, &server_addr, now / 1000000);
+                if(pkt.session < 0) continue;
+                pkt.to_server = 1;
+            } else {
+                pkt.len = recv(fds[i].fd, pkt.data, sizeof(pkt.data), MSG_DONTWAIT);
+                if(pkt.len <= 0) continue;
+                pkt.session = owner[i];
+                pkt.to_server = 0;
+            }
+            proxy_sessions[pkt.session].last_seen_ms = now / 1000000;
+
+            if(rand() < loss_pct / 100 * RAND_MAX) {
+                dropped++;
+                continue;
+            }
+            long long hold_ms = delay_ms;
+            if(jitter_ms > 0) hold_ms += rand() % (2 * jitter_ms + 1) - jitter_ms;
+            if(rand() < reorder_pct / 100 * RAND_MAX) {
+                hold_ms = 0;
+                reordered++;
+            }
+            if(hold_ms <= 0) {
+                proxy_deliver(&pkt);
+                forwarded++;
+                continue;
+            }
+            if(proxy_queued == MAX_PROXY_QUEUE) {
+                overflow++;
+                continue;
+            }
+            pkt.release_ns = now + hold_ms * 1000000;
+            proxy_heap_push(&pkt);
+        }
+
+        // Release everything that is due
+        while(proxy_queued > 0 && proxy_queue[0].release_ns <= now) {
+            proxy_deliver(&proxy_queue[0]);
+            proxy_heap_pop();
+            forwarded++;
+        }
+
+        for(int i = 0; i < MAX_PROXY_SESSIONS; i++) {
+            if(proxy_sessions[i].upstream >= 0 && now / 1000000 - proxy_sessions[i].last_seen_ms > PROXY_IDLE_MS) {
+                close(proxy_sessions[i].upstream);
+                proxy_sessions[i].upstream = -1;
+            }
+        }
+    }
+
+    for(int i = 0; i < MAX_PROXY_SESSIONS; i++) {
+        if(proxy_sessions[i].upstream >= 0) close(proxy_sessions[i].upstream);
+    }
+    close(proxy_listen);
+    printf("Proxy stopped: %llu forwarded, %llu dropped, %llu reordered, %llu queue overflows\n",
+           forwarded, dropped, reordered, overflow);
+    return 0;
+}
 
-void reset_ball() {
-    state.ball.x = WIDTH/2;
-    state.ball.y = HEIGHT/2;
+void reset_ball(GameState *s) {
+    s->ball.x = WIDTH/2;
+    s->ball.y = HEIGHT/2;
     // from middle, along any diagonal direction
-    state.ball.dx = ((rand() % 2) == 0) ? 1 : -1;
-    state.ball.dy = ((rand() % 2) == 0) ? 1 : -1;
+    s->ball.dx = ((rand() % 2) == 0) ? 1 : -1;
+    s->ball.dy = ((rand() % 2) == 0) ? 1 : -1;
 }
 
 
@@ -0,0 +1,453 @@
+/*
+ * geocluster: merge router locations within a radius and map hops onto the merged vertices.
+ *
+ * Does the work of merge_close_locs and find_edges in task1.ipynb without
+ * their all-pairs loops. Input is one "lat lon" per line (hop locations in
+ * log order; duplicates allowed). As in the notebook:
+ *   - exact duplicate locations are dropped, first occurrence kept;
+ *   - locations within the radius (50 km) are joined with union-find;
+ *   - each cluster becomes one merged vertex at the mean of its
+ *     coordinates, listed in order of first appearance;
+ *   - each input location is assigned the nearest merged vertex if that
+ *     one is within the radius.
+ * The pairs come from a GeoGrid radius index (../ex2/geoindex.h), and the
+ * distance tests run on its SIMD kernels, so the cost grows with the number
+ * of locations and their close neighbours, not with its square.
+ *
+ * -b N times the grid against the all-pairs versions (scalar libm haversine
+ * and the SIMD row kernel) on N synthetic locations clustered around cities,
+ * checking that all of them agree.
+ *
+ * Build: gcc -O2 -Wall -o geocluster geocluster.c -lm
+ * Usage: geocluster [-r 50] [-o merged.txt] [-a assign.txt] points.txt
+ *        geocluster -b 20000 [-r 50] [-S seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "../ex2/geoindex.h"
+
+typedef struct {
+    size_t n;               // input locations
+    size_t unique;          // after dropping duplicates
+    double *lat, *lon;      // unique locations in first-appearance order
+    uint32_t *rep;          // input location -> unique location
+    uint32_t clusters;
+    uint32_t *cluster;      // unique location -> merged vertex
+    double *clat, *clon;    // merged vertices
+    int32_t *assign;        // input location -> nearest merged vertex within the radius, or -1
+    double *assign_km;
+} Clustering;
+
+typedef struct {
+    double lat, lon;
+    uint32_t idx;
+} Loc;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double haversine_km(double lat1, double lon1, double lat2, double lon2) {
+    double to_rad = M_PI / 180.0;
+    double dlat = (lat2 - lat1) * to_rad, dlon = (lon2 - lon1) * to_rad;
+    double a = sin(dlat / 2) * sin(dlat / 2) + cos(lat1 * to_rad) * cos(lat2 * to_rad) * sin(dlon / 2) * sin(dlon / 2);
+    return 2 * GEO_EARTH_RADIUS_KM * asin(sqrt(a > 1 ? 1 : a));
+}
+
+static uint32_t uf_find(uint32_t *parent, uint32_t x) {
+    while(parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+static void uf_union(uint32_t *parent, uint32_t a, uint32_t b) {
+    a = uf_find(parent, a);
+    b = uf_find(parent, b);
+    // The smaller index stays the root, so roots are first appearances
+    if(a < b) parent[b] = a;
+    else if(b < a) parent[a] = b;
+}
+
+static int cmp_loc(const void *a, const void *b) {
+    const Loc *x = a, *y = b;
+    if(x->lat != y->lat) return x->lat < y->lat ? -1 : 1;
+    if(x->lon != y->lon) return x->lon < y->lon ? -1 : 1;
+    return x->idx < y->idx ? -1 : x->idx > y->idx;
+}
+
+// Function to read "lat lon" lines ('#' comments). Returns the count.
+size_t read_points(const char *path, double **lat_out, double **lon_out) {
+    FILE *f = fopen(path, "r");
+    if(!f) {
+        perror(path);
+        exit(1);
+    }
+    size_t n = 0, cap = 1024;
+    double *lat = geo_alloc(cap * sizeof(double)), *lon = geo_alloc(cap * sizeof(double));
+    char line[256];
+    while(fgets(line, sizeof(line), f)) {
+        double a, b;
+        if(line[0] == '#' || sscanf(line, "%lf %lf", &a, &b) != 2) continue;
+        if(n == cap) {
+            cap *= 2;
+            lat = realloc(lat, cap * sizeof(double));
+            lon = realloc(lon, cap * sizeof(double));
+            if(!lat || !lon) {
+                perror("Memory allocation failed");
+                exit(1);
+            }
+        }
+        lat[n] = a;
+        lon[n] = b;
+        n++;
+    }
+    fclose(f);
+    *lat_out = lat;
+    *lon_out = lon;
+    return n;
+}
+
+// Function to drop exact duplicate locations, keeping first appearances in order
+void dedupe(Clustering *c, const double *lat, const double *lon, size_t n) {
+    Loc *loc = geo_alloc(n * sizeof(Loc));
+    for(size_t i = 0; i < n; i++) loc[i] = (Loc){lat[i], lon[i], i};
+    qsort(loc, n, sizeof(Loc), cmp_loc);
+    uint32_t *first = geo_alloc(n * sizeof(uint32_t));
+    for(size_t i = 0; i < n; i++)
+        first[loc[i].idx] = i > 0 && loc[i].lat == loc[i - 1].lat && loc[i].lon == loc[i - 1].lon
+                                ? first[loc[i - 1].idx] : loc[i].idx;
+    free(loc);
+
+    memset(c, 0, sizeof(*c));
+    c->n = n;
+    c->rep = geo_alloc(n * sizeof(uint32_t));
+    c->lat = geo_alloc(n * sizeof(double));
+    c->lon = geo_alloc(n * sizeof(double));
+    c->unique = 0;
+    for(size_t i = 0; i < n; i++) {
+        if(first[i] == i) {
+            c->lat[c->unique] = lat[i];
+            c->lon[c->unique] = lon[i];
+            c->rep[i] = c->unique++;
+        } else {
+            c->rep[i] = c->rep[first[i]];
+        }
+    }
+    free(first);
+}
+
+// Function to turn union-find roots into merged vertices at the mean of their members
+void finish_clusters(Clustering *c, uint32_t *parent) {
+    size_t u = c->unique;
+    c->cluster = geo_alloc(u * sizeof(uint32_t));
+    c->clusters = 0;
+    for(size_t i = 0; i < u; i++) {
+        uint32_t root = uf_find(parent, i);
+        c->cluster[i] = root == i ? c->clusters++ : c->cluster[root];
+    }
+    c->clat = calloc(c->clusters ? c->clusters : 1, sizeof(double));
+    c->clon = calloc(c->clusters ? c->clusters : 1, sizeof(double));
+    uint32_t *size = calloc(c->clusters ? c->clusters : 1, sizeof(uint32_t));
+    if(!c->clat || !c->clon || !size) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    for(size_t i = 0; i < u; i++) {
+        c->clat[c->cluster[i]] += c->lat[i];
+        c->clon[c->cluster[i]] += c->lon[i];
+        size[c->cluster[i]]++;
+    }
+    for(uint32_t k = 0; k < c->clusters; k++) {
+        c->clat[k] /= size[k];
+        c->clon[k] /= size[k];
+    }
+    free(size);
+}
+
+// Function to merge locations within radius_km using the grid index
+void cluster_grid(Clustering *c, double radius_km) {
+    size_t u = c->unique, cap = 0;
+    uint32_t *parent = geo_alloc(u * sizeof(uint32_t)), *hits = NULL;
+    for(size_t i = 0; i < u; i++) parent[i] = i;
+    GeoGrid grid;
+    geo_grid_build(&grid, c->lat, c->lon, u, radius_km);
+    for(size_t i = 0; i < u; i++) {
+        size_t found = geo_grid_query(&grid, c->lat[i], c->lon[i], radius_km, &hits, &cap);
+        for(size_t k = 0; k < found; k++)
+            if(hits[k] > i) uf_union(parent, i, hits[k]);
+    }
+    geo_grid_free(&grid);
+    free(hits);
+    finish_clusters(c, parent);
+    free(parent);
+}
+
+// Function to merge locations by testing every pair, with the SIMD row kernel or libm haversine
+void cluster_pairs(Clustering *c, double radius_km, int simd) {
+    size_t u = c->unique;
+    uint32_t *parent = geo_alloc(u * sizeof(uint32_t));
+    double *row = geo_alloc(u * sizeof(double));
+    for(size_t i = 0; i < u; i++) parent[i] = i;
+    GeoPoints pts;
+    geo_points_init(&pts, c->lat, c->lon, u);
+    for(size_t i = 0; i < u; i++) {
+        if(simd) {
+            geo_dist_row(&pts, i, i + 1, u, row);
+        } else {
+            for(size_t j = i + 1; j < u; j++) row[j - i - 1] = haversine_km(c->lat[i], c->lon[i], c->lat[j], c->lon[j]);
+        }
+        for(size_t j = i + 1; j < u; j++)
+            if(row[j - i - 1] <= radius_km) uf_union(parent, i, j);
+    }
+    geo_points_free(&pts);
+    free(row);
+    finish_clusters(c, parent);
+    free(parent);
+}
+
+/*
+ * Function to give every input location the nearest merged vertex within
+ * radius_km (-1 if none), earliest vertex on ties as min() does in
+ * find_edges. Locations sharing coordinates are looked up once; with the
+ * grid only the vertices it returns are measured.
+ */
+void assign_nearest(Clustering *c, double radius_km, int use_grid) {
+    size_t u = c->unique, cap = 0;
+    int32_t *best = geo_alloc(u * sizeof(int32_t));
+    double *best_km = geo_alloc(u * sizeof(double));
+    uint32_t *hits = NULL;
+    GeoGrid grid;
+    if(use_grid) geo_grid_build(&grid, c->clat, c->clon, c->clusters, radius_km);
+    for(size_t i = 0; i < u; i++) {
+        size_t found = use_grid ? geo_grid_query(&grid, c->lat[i], c->lon[i], radius_km, &hits, &cap) : c->clusters;
+        best[i] = -1;
+        best_km[i] = INFINITY;
+        for(size_t k = 0; k < found; k++) {
+            uint32_t v = use_grid ? hits[k] : k;
+            double d = haversine_km(c->lat[i], c->lon[i], c->clat[v], c->clon[v]);
+            if(d <= radius_km && (d < best_km[i] || (d == best_km[i] && (int32_t)v < best[i]))) {
+                best_km[i] = d;
+                best[i] = v;
+            }
+        }
+    }
+    free(hits);
+    if(use_grid) geo_grid_free(&grid);
+
+    c->assign = geo_alloc(c->n * sizeof(int32_t));
+    c->assign_km = geo_alloc(c->n * sizeof(double));
+    for(size_t i = 0; i < c->n; i++) {
+        c->assign[i] = best[c->rep[i]];
+        c->assign_km[i] = best_km[c->rep[i]];
+    }
+    free(best);
+    free(best_km);
+}
+
+void clustering_free(Clustering *c) {
+    free(c->lat);
+    free(c->lon);
+    free(c->rep);
+    free(c->cluster);
+    free(c->clat);
+    free(c->clon);
+    free(c->assign);
+    free(c->assign_km);
+    memset(c, 0, sizeof(*c));
+}
+
+// splitmix64, as in ../ex2/graph.h
+static uint64_t next_rand(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static double uniform(uint64_t *state) {
+    return (next_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Function to compare two clusterings: same merged vertices (to rounding) and same assignments
+int same_result(const Clustering *a, const Clustering *b) {
+    if(a->clusters != b->clusters) return 0;
+    for(uint32_t k = 0; k < a->clusters; k++)
+        if(fabs(a->clat[k] - b->clat[k]) > 1e-9 || fabs(a->clon[k] - b->clon[k]) > 1e-9) return 0;
+    for(size_t i = 0; i < a->unique; i++)
+        if(a->cluster[i] != b->cluster[i]) return 0;
+    for(size_t i = 0; i < a->n; i++)
+        if(a->assign[i] != b->assign[i]) return 0;
+    return 1;
+}
+
+/*
+ * Function to time the three ways of clustering n synthetic locations:
+ * cities spread over the globe, each with routers scattered up to about
+ * 40 km around it and some sharing exact coordinates.
+ */
+void benchmark(size_t n, double radius_km, uint64_t seed) {
+    double *lat = geo_alloc(n * sizeof(double)), *lon = geo_alloc(n * sizeof(double));
+    size_t cities = n / 16 + 1;
+    double *city_lat = geo_alloc(cities * sizeof(double)), *city_lon = geo_alloc(cities * sizeof(double));
+    for(size_t k = 0; k < cities; k++) {
+        city_lat[k] = asin(2 * uniform(&seed) - 1) * 180.0 / M_PI;
+        city_lon[k] = uniform(&seed) * 360.0 - 180.0;
+    }
+    for(size_t i = 0; i < n; i++) {
+        size_t k = next_rand(&seed) % cities;
+        if(i > 0 && next_rand(&seed) % 4 == 0) {
+            size_t j = next_rand(&seed) % i;
+            lat[i] = lat[j];
+            lon[i] = lon[j];
+            continue;
+        }
+        double r = 40.0 * sqrt(uniform(&seed)) / 111.2, a = uniform(&seed) * 2 * M_PI;
+        lat[i] = city_lat[k] + r * sin(a);
+        lat[i] = lat[i] > 90 ? 90 : lat[i] < -90 ? -90 : lat[i];
+        lon[i] = city_lon[k] + r * cos(a) / fmax(cos(lat[i] * M_PI / 180.0), 0.05);
+        lon[i] = lon[i] >= 180 ? lon[i] - 360 : lon[i] < -180 ? lon[i] + 360 : lon[i];
+    }
+    free(city_lat);
+    free(city_lon);
+
+    printf("%zu locations around %zu cities, radius %.1f km, kernels: %s\n", n, cities, radius_km, geo_simd_init());
+    Clustering grid;
+    double t0 = now();
+    dedupe(&grid, lat, lon, n);
+    cluster_grid(&grid, radius_km);
+    double t1 = now();
+    assign_nearest(&grid, radius_km, 1);
+    double t2 = now();
+    printf("  grid index       : merge %8.3f s, assign %8.3f s  (%zu unique, %u merged vertices)\n", t1 - t0, t2 - t1,
+           grid.unique, grid.clusters);
+
+    if(n <= 100000) {
+        Clustering simd, scalar;
+        dedupe(&simd, lat, lon, n);
+        t0 = now();
+        cluster_pairs(&simd, radius_km, 1);
+        t1 = now();
+        printf("  all pairs, SIMD  : merge %8.3f s\n", t1 - t0);
+
+        dedupe(&scalar, lat, lon, n);
+        t0 = now();
+        cluster_pairs(&scalar, radius_km, 0);
+        t1 = now();
+        assign_nearest(&scalar, radius_km, 0);
+        t2 = now();
+        printf("  all pairs, scalar: merge %8.3f s, assign %8.3f s\n", t1 - t0, t2 - t1);
+        int same = grid.clusters == simd.clusters && memcmp(grid.cluster, simd.cluster, grid.unique * 4) == 0 &&
+                   same_result(&grid, &scalar);
+        printf("  results %s\n", same ? "identical" : "DIFFER");
+        clustering_free(&simd);
+        clustering_free(&scalar);
+    } else {
+        printf("  all pairs skipped above 100000 locations\n");
+    }
+
+    // Raw distance-matrix throughput of the row kernel against libm haversine
+    size_t rows = n < 2000 ? n : 100000000 / n > 2000 ? 2000 : 100000000 / n + 1;
+    double *row = geo_alloc(n * sizeof(double)), sink = 0, err = 0;
+    GeoPoints pts;
+    geo_points_init(&pts, lat, lon, n);
+    t0 = now();
+    for(size_t i = 0; i < rows; i++) {
+        geo_dist_row(&pts, i, 0, n, row);
+        sink += row[i / 2];
+    }
+    t1 = now();
+    for(size_t i = 0; i < rows; i++) {
+        for(size_t j = 0; j < n; j++) row[j] = haversine_km(lat[i], lon[i], lat[j], lon[j]);
+        sink += row[i / 2];
+    }
+    t2 = now();
+    for(size_t i = 0; i < rows; i += 97) {
+        geo_dist_row(&pts, i, 0, n, row);
+        for(size_t j = 0; j < n; j++) err = fmax(err, fabs(row[j] - haversine_km(lat[i], lon[i], lat[j], lon[j])));
+    }
+    printf("  distance matrix  : %.0f M pairs/s SIMD, %.0f M pairs/s libm, max difference %.2g km%s\n",
+           rows * n / (t1 - t0) / 1e6, rows * n / (t2 - t1) / 1e6, err, sink < 0 ? " " : "");
+    geo_points_free(&pts);
+    free(row);
+    clustering_free(&grid);
+    free(lat);
+    free(lon);
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-r 50] [-o merged.txt] [-a assign.txt] points.txt\n"
+            "       %s -b locations [-r 50] [-S seed]\n",
+            prog, prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *merged_path = NULL, *assign_path = NULL;
+    double radius = 50.0;
+    size_t bench = 0;
+    uint64_t seed = 1;
+    int opt;
+    while((opt = getopt(argc, argv, "r:o:a:b:S:")) != -1) {
+        switch(opt) {
+        case 'r': radius = atof(optarg); break;
+        case 'o': merged_path = optarg; break;
+        case 'a': assign_path = optarg; break;
+        case 'b': bench = strtoul(optarg, NULL, 10); break;
+        case 'S': seed = strtoull(optarg, NULL, 10); break;
+        default: usage(argv[0]);
+        }
+    }
+    if(radius <= 0) usage(argv[0]);
+    if(bench) {
+        benchmark(bench, radius, seed);
+        return 0;
+    }
+    if(optind + 1 != argc) usage(argv[0]);
+
+    double *lat, *lon;
+    size_t n = read_points(argv[optind], &lat, &lon);
+    Clustering c;
+    double t0 = now();
+    dedupe(&c, lat, lon, n);
+    cluster_grid(&c, radius);
+    assign_nearest(&c, radius, 1);
+    double t1 = now();
+    size_t unassigned = 0;
+    for(size_t i = 0; i < n; i++) unassigned += c.assign[i] < 0;
+    printf("%zu locations, %zu unique, %u merged vertices within %.1f km, %zu unassigned (%.3f s, %s kernels)\n", n,
+           c.unique, c.clusters, radius, unassigned, t1 - t0, geo_simd_init());
+
+    if(merged_path) {
+        FILE *f = fopen(merged_path, "w");
+        if(!f) {
+            perror(merged_path);
+            return 1;
+        }
+        for(uint32_t k = 0; k < c.clusters; k++) fprintf(f, "%.17g %.17g\n", c.clat[k], c.clon[k]);
+        fclose(f);
+    }
+    if(assign_path) {
+        FILE *f = fopen(assign_path, "w");
+        if(!f) {
+            perror(assign_path);
+            return 1;
+        }
+        for(size_t i = 0; i < n; i++) fprintf(f, "%d %.6f\n", c.assign[i], c.assign[i] < 0 ? -1.0 : c.assign_km[i]);
+        fclose(f);
+    }
+    clustering_free(&c);
+    free(lat);
+    free(lon);
+    return 0;
+}
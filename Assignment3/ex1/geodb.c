@@ -0,0 +1,544 @@
+/*
+ * geodb: offline IPv4 geolocation / ASN lookups for traceroute annotation.
+ *
+ * Replaces the per-hop `curl https://ipinfo.io/$ip` of traceroute_CS3205.sh.
+ * A local prefix dump is compiled into a mapped range index (see geodb.h)
+ * that answers longest-prefix-match lookups in a few memory reads.
+ *
+ * Prefix dumps are CSV with ipinfo's fields:
+ *     network,city,country,org,loc
+ *     197.234.112.0/22,Luanda,AO,AS33763 Paratus Telecommunications Limited,"-8.8368,13.2343"
+ * where network is a CIDR prefix, a single address or a "first-last" range.
+ * Nested prefixes are allowed; the most specific one wins, and for the same
+ * prefix the file given last wins.
+ *
+ * The persistent cache is a dump of /32 entries in the same format: -H
+ * collects every address already annotated in existing traceroute logs, so
+ * passing the cache as the last input makes previously resolved IPs answer
+ * exactly as before.
+ *
+ * Build: gcc -O2 -Wall -o geodb geodb.c -lm
+ * Usage: geodb [-o geo.db] prefixes.csv... [geocache.csv]   build the index
+ *        geodb -H traceroute_log.txt... >> geocache.csv       harvest resolved IPs into the cache
+ *        geodb -q geo.db ip...                                print the annotation of each address
+ *        geodb -b geo.db [lookups]                            benchmark random lookups
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include "geodb.h"
+
+#define MAX_FIELDS 8
+#define MAX_LINE 4096
+
+typedef struct {
+    uint32_t start, end;
+    uint32_t rec;
+    uint32_t seq;           // input order, later wins on equal prefixes
+    uint8_t len;
+} Prefix;
+
+// Strings interned into one blob; the hash maps text to a caller-defined value
+typedef struct {
+    char *blob;
+    size_t used, cap;
+    uint32_t *offs;         // slot -> blob offset + 1 (0 = empty)
+    uint32_t *vals;
+    size_t mask, count;
+} Intern;
+
+Prefix *prefixes;
+size_t prefix_count = 0, prefix_cap = 0;
+GeoRecord *records;
+size_t record_count = 0, record_cap = 0;
+Intern strings;             // written out; value = offset
+Intern record_keys;         // record fields -> record id (not written)
+
+static uint32_t hash_bytes(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < len; i++) h = (h ^ (uint8_t)s[i]) * 16777619u;
+    return h;
+}
+
+static void *grow(void *p, size_t *cap, size_t count, size_t elem) {
+    if(count < *cap) return p;
+    *cap = *cap ? *cap * 2 : 4096;
+    p = realloc(p, *cap * elem);
+    if(!p) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    return p;
+}
+
+static void intern_init(Intern *it) {
+    it->cap = 1 << 16;
+    it->blob = malloc(it->cap);
+    it->mask = (1 << 12) - 1;
+    it->offs = calloc(it->mask + 1, sizeof(uint32_t));
+    it->vals = calloc(it->mask + 1, sizeof(uint32_t));
+    if(!it->blob || !it->offs || !it->vals) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    it->blob[0] = 0;        // offset 0 is the empty string
+    it->used = 1;
+    it->count = 0;
+}
+
+static void intern_grow(Intern *it) {
+    size_t old_mask = it->mask;
+    uint32_t *old_offs = it->offs, *old_vals = it->vals;
+    it->mask = old_mask * 2 + 1;
+    it->offs = calloc(it->mask + 1, sizeof(uint32_t));
+    it->vals = calloc(it->mask + 1, sizeof(uint32_t));
+    if(!it->offs || !it->vals) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    for(size_t i = 0; i <= old_mask; i++) {
+        if(!old_offs[i]) continue;
+        const char *s = it->blob + old_offs[i] - 1;
+        size_t slot = hash_bytes(s, strlen(s)) & it->mask;
+        while(it->offs[slot]) slot = (slot + 1) & it->mask;
+        it->offs[slot] = old_offs[i];
+        it->vals[slot] = old_vals[i];
+    }
+    free(old_offs);
+    free(old_vals);
+}
+
+// Function to intern a string (no embedded NULs). Returns the slot value, which
+// defaults to the blob offset; *added says whether the string is new.
+static uint32_t *intern(Intern *it, const char *s, size_t len, int *added) {
+    static uint32_t empty = 0;
+    *added = 0;
+    if(len == 0) return &empty;
+    size_t slot = hash_bytes(s, len) & it->mask;
+    while(it->offs[slot]) {
+        const char *t = it->blob + it->offs[slot] - 1;
+        if(strncmp(t, s, len) == 0 && t[len] == 0) return &it->vals[slot];
+        slot = (slot + 1) & it->mask;
+    }
+    while(it->used + len + 1 > it->cap) {
+        it->cap *= 2;
+        it->blob = realloc(it->blob, it->cap);
+        if(!it->blob) {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+    }
+    uint32_t off = it->used;
+    memcpy(it->blob + off, s, len);
+    it->blob[off + len] = 0;
+    it->used += len + 1;
+    it->offs[slot] = off + 1;
+    it->vals[slot] = off;
+    *added = 1;
+    if(++it->count * 2 > it->mask) {
+        intern_grow(it);
+        int again;
+        return intern(it, s, len, &again);     // the slot moved
+    }
+    return &it->vals[slot];
+}
+
+static uint32_t intern_string(const char *s) {
+    int added;
+    return *intern(&strings, s, strlen(s), &added);
+}
+
+// Function to split a CSV line in place (double quotes may wrap fields with commas)
+static int split_csv(char *line, char **fields) {
+    int n = 0;
+    char *p = line;
+    line[strcspn(line, "\r\n")] = 0;
+    for(;;) {
+        char *out = p;
+        fields[n++] = out;
+        if(*p == '"') {
+            p++;
+            while(*p) {
+                if(*p == '"') {
+                    if(p[1] != '"') {
+                        p++;
+                        break;
+                    }
+                    p++;        // "" is a quote
+                }
+                *out++ = *p++;
+            }
+            while(*p && *p != ',') p++;
+        } else {
+            while(*p && *p != ',') *out++ = *p++;
+        }
+        int more = *p == ',';
+        *out = 0;
+        if(!more || n == MAX_FIELDS) return n;
+        p++;
+    }
+}
+
+static int parse_addr(const char *s, uint32_t *ip) {
+    struct in_addr a;
+    if(inet_pton(AF_INET, s, &a) != 1) return 0;
+    *ip = ntohl(a.s_addr);
+    return 1;
+}
+
+// Function to intern a record (city, country, org, "lat,lon") and return its id
+static uint32_t add_record(const char *city, const char *country, const char *org, const char *loc) {
+    char key[MAX_LINE];
+    int n = snprintf(key, sizeof(key), "%s\x1f%s\x1f%s\x1f%s", city, country, org, loc);
+    if(n >= (int)sizeof(key)) n = sizeof(key) - 1;
+    int added;
+    uint32_t *id = intern(&record_keys, key, n, &added);
+    if(!added && n > 0) return *id;
+
+    records = grow(records, &record_cap, record_count, sizeof(GeoRecord));
+    GeoRecord *r = &records[record_count];
+    r->city = intern_string(city);
+    r->country = intern_string(country);
+    r->org = intern_string(org);
+    r->asn = 0;
+    if(org[0] == 'A' && org[1] == 'S') r->asn = strtoul(org + 2, NULL, 10);
+    char *end;
+    r->lat = r->lon = NAN;
+    double lat = strtod(loc, &end);
+    if(end != loc && *end == ',') {
+        const char *lon_s = end + 1;
+        double lon = strtod(lon_s, &end);
+        if(end != lon_s) {
+            r->lat = lat;
+            r->lon = lon;
+        }
+    }
+    *id = record_count;
+    return record_count++;
+}
+
+static void add_prefix(uint32_t start, int len, uint32_t rec) {
+    prefixes = grow(prefixes, &prefix_cap, prefix_count, sizeof(Prefix));
+    Prefix *p = &prefixes[prefix_count];
+    uint32_t size_mask = len == 0 ? 0xffffffffu : (1u << (32 - len)) - 1;
+    p->start = start & ~size_mask;
+    p->end = p->start | size_mask;
+    p->len = len;
+    p->rec = rec;
+    p->seq = prefix_count++;
+}
+
+// Function to add "first-last" as the minimal set of CIDR prefixes
+static void add_range(uint32_t first, uint32_t last, uint32_t rec) {
+    uint64_t a = first, b = last;
+    while(a <= b) {
+        int len = 32;
+        while(len > 0) {
+            uint64_t size = 1ull << (33 - len);
+            if(a % size != 0 || a + size - 1 > b) break;
+            len--;
+        }
+        add_prefix(a, len, rec);
+        a += 1ull << (32 - len);
+    }
+}
+
+// Function to read one prefix dump
+static int load_dump(const char *path) {
+    FILE *f = fopen(path, "r");
+    if(!f) {
+        perror(path);
+        return -1;
+    }
+    char line[MAX_LINE];
+    size_t lineno = 0, bad = 0;
+    while(fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *fields[MAX_FIELDS];
+        int n = split_csv(line, fields);
+        if(n < 1 || !fields[0][0] || fields[0][0] == '#') continue;
+        const char *city = n > 1 ? fields[1] : "", *country = n > 2 ? fields[2] : "";
+        const char *org = n > 3 ? fields[3] : "", *loc = n > 4 ? fields[4] : "";
+
+        char *net = fields[0];
+        char *slash = strchr(net, '/'), *dash = strchr(net, '-');
+        uint32_t a, b = 0;
+        int len = 32;
+        if(slash) {
+            *slash = 0;
+            len = atoi(slash + 1);
+        } else if(dash) {
+            *dash = 0;
+        }
+        if(!parse_addr(net, &a) || len < 0 || len > 32 || (dash && !parse_addr(dash + 1, &b)) || (dash && b < a)) {
+            if(lineno > 1) bad++;       // the first line may be a header
+            continue;
+        }
+        uint32_t rec = add_record(city, country, org, loc);
+        if(dash) add_range(a, b, rec);
+        else add_prefix(a, len, rec);
+    }
+    fclose(f);
+    if(bad) fprintf(stderr, "%s: %zu unparsable lines skipped\n", path, bad);
+    return 0;
+}
+
+static int cmp_prefix(const void *x, const void *y) {
+    const Prefix *a = x, *b = y;
+    if(a->start != b->start) return a->start < b->start ? -1 : 1;
+    if(a->len != b->len) return a->len < b->len ? -1 : 1;       // covering prefix first
+    return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+// Output ranges: each runs from its start to the next range's start - 1
+typedef struct {
+    uint32_t start, rec;
+} Range;
+
+Range *ranges;
+size_t range_count = 0, range_cap = 0;
+
+static void set_from(uint32_t pos, uint32_t rec) {
+    if(range_count && ranges[range_count - 1].start == pos) {
+        ranges[range_count - 1].rec = rec;      // same position: the later (more specific) change wins
+        if(range_count > 1 && ranges[range_count - 2].rec == rec) range_count--;
+        return;
+    }
+    if(range_count && ranges[range_count - 1].rec == rec) return;
+    ranges = grow(ranges, &range_cap, range_count, sizeof(Range));
+    ranges[range_count++] = (Range){pos, rec};
+}
+
+// Function to flatten nested prefixes into disjoint ranges (most specific wins)
+static void flatten(void) {
+    qsort(prefixes, prefix_count, sizeof(Prefix), cmp_prefix);
+    Prefix **stack = malloc(34 * sizeof(Prefix *) + prefix_count * sizeof(Prefix *));
+    if(!stack) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    size_t sp = 0;
+    set_from(0, GEO_NONE);
+    for(size_t i = 0; i <= prefix_count; i++) {
+        // Close every open prefix that ends before the next one starts
+        while(sp && (i == prefix_count || stack[sp - 1]->end < prefixes[i].start)) {
+            uint32_t end = stack[--sp]->end;
+            if(end != 0xffffffffu) set_from(end + 1, sp ? stack[sp - 1]->rec : GEO_NONE);
+        }
+        if(i == prefix_count) break;
+        set_from(prefixes[i].start, prefixes[i].rec);
+        stack[sp++] = &prefixes[i];
+    }
+    free(stack);
+}
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+static int write_index(const char *path) {
+    uint32_t *dir = malloc(GEO_DIR_SIZE * sizeof(uint32_t));
+    if(!dir) {
+        perror("Memory allocation failed");
+        return -1;
+    }
+    uint32_t *starts = malloc(range_count * sizeof(uint32_t)), *recs = malloc(range_count * sizeof(uint32_t));
+    if(!starts || !recs) {
+        perror("Memory allocation failed");
+        return -1;
+    }
+    for(size_t i = 0; i < range_count; i++) {
+        starts[i] = ranges[i].start;
+        recs[i] = ranges[i].rec;
+    }
+    size_t r = 0;
+    for(uint32_t h = 0; h < GEO_DIR_SIZE - 1; h++) {
+        while(r + 1 < range_count && starts[r + 1] <= h << 16) r++;
+        dir[h] = r;
+    }
+    dir[GEO_DIR_SIZE - 1] = range_count - 1;
+
+    GeoHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, GEO_MAGIC, 8);
+    hdr.range_count = range_count;
+    hdr.record_count = record_count;
+    hdr.dir_off = align8(sizeof(hdr));
+    hdr.starts_off = align8(hdr.dir_off + GEO_DIR_SIZE * 4);
+    hdr.recs_off = align8(hdr.starts_off + range_count * 4);
+    hdr.records_off = align8(hdr.recs_off + range_count * 4);
+    hdr.str_off = align8(hdr.records_off + record_count * sizeof(GeoRecord));
+    hdr.str_size = strings.used;
+
+    FILE *f = fopen(path, "wb");
+    if(!f) {
+        perror(path);
+        free(dir);
+        free(starts);
+        free(recs);
+        return -1;
+    }
+    static const char zeros[8];
+    struct { const void *data; size_t len; uint64_t off; } parts[] = {
+        {&hdr, sizeof(hdr), 0},
+        {dir, GEO_DIR_SIZE * 4, hdr.dir_off},
+        {starts, range_count * 4, hdr.starts_off},
+        {recs, range_count * 4, hdr.recs_off},
+        {records, record_count * sizeof(GeoRecord), hdr.records_off},
+        {strings.blob, strings.used, hdr.str_off},
+    };
+    size_t pos = 0;
+    int ok = 1;
+    for(size_t i = 0; ok && i < sizeof(parts) / sizeof(parts[0]); i++) {
+        if(parts[i].off > pos) ok = fwrite(zeros, 1, parts[i].off - pos, f) == parts[i].off - pos;
+        if(ok && parts[i].len) ok = fwrite(parts[i].data, 1, parts[i].len, f) == parts[i].len;
+        pos = parts[i].off + parts[i].len;
+    }
+    if(fclose(f) != 0) ok = 0;
+    free(dir);
+    free(starts);
+    free(recs);
+    if(!ok) {
+        perror("Write failed");
+        return -1;
+    }
+    return 0;
+}
+
+static int build(const char *out, char **files, int count) {
+    intern_init(&strings);
+    intern_init(&record_keys);
+    for(int i = 0; i < count; i++) {
+        if(load_dump(files[i]) < 0) return 1;
+    }
+    size_t input = prefix_count;
+    flatten();
+    if(write_index(out) < 0) return 1;
+    printf("%zu prefixes -> %s: %zu ranges, %zu records, %zu string bytes\n", input, out, range_count, record_count,
+           strings.used);
+    return 0;
+}
+
+// Function to print every "ip (City, CC, Org, loc: lat,lon)" of traceroute logs as /32 cache entries
+static int harvest(char **files, int count) {
+    Intern seen;
+    intern_init(&seen);
+    char line[MAX_LINE];
+    for(int i = 0; i < count; i++) {
+        FILE *f = fopen(files[i], "r");
+        if(!f) {
+            perror(files[i]);
+            return 1;
+        }
+        while(fgets(line, sizeof(line), f)) {
+            for(char *p = strstr(line, " ("); p; p = strstr(p + 2, " (")) {
+                // The address right before the annotation
+                char *ip_end = p, *ip_start = p;
+                while(ip_start > line && (ip_start[-1] == '.' || (ip_start[-1] >= '0' && ip_start[-1] <= '9'))) ip_start--;
+                char ip[16];
+                uint32_t addr;
+                if(ip_end - ip_start >= (long)sizeof(ip)) continue;
+                memcpy(ip, ip_start, ip_end - ip_start);
+                ip[ip_end - ip_start] = 0;
+                if(!parse_addr(ip, &addr)) continue;
+
+                // Annotation text up to the matching ')' (organisations may contain parentheses)
+                char *s = p + 2, *e = s;
+                int depth = 1;
+                for(; *e && depth; e++) {
+                    if(*e == '(') depth++;
+                    else if(*e == ')') depth--;
+                }
+                if(depth) continue;
+                char text[MAX_LINE];
+                snprintf(text, sizeof(text), "%.*s", (int)(e - 1 - s), s);
+                char *loc = strstr(text, "loc:");
+                char *c1 = strchr(text, ','), *c2 = c1 ? strchr(c1 + 1, ',') : NULL;
+                if(!loc || !c2 || c2 > loc) continue;       // "Local / IIT Madras / Reserved" and the like
+                char *org_end = loc;
+                while(org_end > c2 + 1 && (org_end[-1] == ' ' || org_end[-1] == ',')) org_end--;
+                *c1 = *c2 = *org_end = 0;
+                char *country = c1 + 1, *org = c2 + 1, *coords = loc + 4;
+                while(*country == ' ') country++;
+                while(*org == ' ') org++;
+                while(*coords == ' ') coords++;
+                if(!text[0] && !country[0] && !org[0] && !coords[0]) continue;     // failed lookup
+
+                int added;
+                intern(&seen, ip, strlen(ip), &added);
+                if(!added) continue;
+                printf("%s/32,%s,%s,\"%s\",\"%s\"\n", ip, text, country, org, coords);
+            }
+        }
+        fclose(f);
+    }
+    return 0;
+}
+
+static int query(const char *path, char **ips, int count) {
+    GeoDb db;
+    if(geo_open(path, &db) < 0) return 1;
+    char buf[MAX_LINE];
+    for(int i = 0; i < count; i++) {
+        uint32_t ip;
+        if(!parse_addr(ips[i], &ip)) {
+            fprintf(stderr, "%s: not an IPv4 address\n", ips[i]);
+            continue;
+        }
+        printf("%s\n", geo_format(&db, geo_lookup(&db, ip), buf, sizeof(buf)));
+    }
+    geo_close(&db);
+    return 0;
+}
+
+static int benchmark(const char *path, long lookups) {
+    GeoDb db;
+    if(geo_open(path, &db) < 0) return 1;
+    uint64_t x = 88172645463325252ull, found = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(long i = 0; i < lookups; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        found += geo_lookup(&db, (uint32_t)x) != NULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%ld lookups in %.3f s: %.1f M lookups/s (%llu covered, %u ranges)\n", lookups, secs, lookups / secs / 1e6,
+           (unsigned long long)found, db.hdr->range_count);
+    geo_close(&db);
+    return 0;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-o geo.db] prefixes.csv... [geocache.csv]\n", prog);
+    fprintf(stderr, "       %s -H traceroute_log.txt... >> geocache.csv\n", prog);
+    fprintf(stderr, "       %s -q geo.db ip...\n", prog);
+    fprintf(stderr, "       %s -b geo.db [lookups]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *out = "geo.db";
+    int mode = 0, opt;
+    while((opt = getopt(argc, argv, "o:Hqb")) != -1) {
+        switch(opt) {
+        case 'o': out = optarg; break;
+        case 'H': case 'q': case 'b': mode = opt; break;
+        default: usage(argv[0]);
+        }
+    }
+    if(optind >= argc) usage(argv[0]);
+    if(mode == 'H') return harvest(argv + optind, argc - optind);
+    if(mode == 'q') {
+        if(argc - optind < 2) usage(argv[0]);
+        return query(argv[optind], argv + optind + 1, argc - optind - 1);
+    }
+    if(mode == 'b') return benchmark(argv[optind], optind + 1 < argc ? atol(argv[optind + 1]) : 10000000);
+    return build(out, argv + optind, argc - optind);
+}
@@ -0,0 +1,138 @@
+/*
+ * geodb.h: offline IPv4 geolocation / ASN index shared by the Assignment 3 tools.
+ *
+ * geodb flattens a prefix dump (nested CIDRs, most specific wins) into
+ * disjoint address ranges, each pointing at a deduplicated record. After a
+ * header the file holds:
+ *
+ *   dir     uint32_t[65537]      range holding the first address of every /16,
+ *                                then range_count - 1
+ *   starts  uint32_t[range_count] first address of each range, ascending
+ *   recs    uint32_t[range_count] record of each range, GEO_NONE for gaps
+ *   records GeoRecord[record_count]
+ *   strings NUL-terminated,       offset 0 = ""
+ *
+ * The ranges cover the whole address space from 0. A lookup is one
+ * directory read plus a binary search over the few ranges inside that /16,
+ * all in the mapped file.
+ */
+
+#ifndef GEODB_H
+#define GEODB_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define GEO_MAGIC "GEODB01\0"
+#define GEO_NONE 0xffffffffu
+#define GEO_DIR_SIZE 65537
+
+typedef struct {
+    char magic[8];
+    uint32_t range_count, record_count;
+    uint64_t dir_off, starts_off, recs_off, records_off, str_off, str_size;
+} GeoHeader;
+
+typedef struct {
+    uint32_t city, country, org;    // string offsets; org as ipinfo writes it ("AS123 Name")
+    uint32_t asn;                   // 0 if unknown
+    float lat, lon;                 // NAN if unknown
+} GeoRecord;
+
+typedef struct {
+    const GeoHeader *hdr;
+    const uint32_t *dir, *starts, *recs;
+    const GeoRecord *records;
+    const char *strings;
+    size_t size;
+} GeoDb;
+
+static inline const char *geo_str(const GeoDb *db, uint32_t off) {
+    return off < db->hdr->str_size ? db->strings + off : "";
+}
+
+// Function to find the record of a host-order address (NULL if no prefix covers it)
+static inline const GeoRecord *geo_lookup(const GeoDb *db, uint32_t ip) {
+    // Last range starting at or before ip, among those overlapping its /16
+    uint32_t lo = db->dir[ip >> 16], hi = db->dir[(ip >> 16) + 1] + 1;
+    while(hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(db->starts[mid] <= ip) lo = mid;
+        else hi = mid;
+    }
+    uint32_t rec = db->recs[lo];
+    return rec == GEO_NONE ? NULL : &db->records[rec];
+}
+
+// Function to format a record the way traceroute_CS3205.sh annotates a hop
+static inline const char *geo_format(const GeoDb *db, const GeoRecord *r, char *buf, size_t size) {
+    if(!r) {
+        snprintf(buf, size, "(, , , loc: )");
+    } else if(isnan(r->lat)) {
+        snprintf(buf, size, "(%s, %s, %s, loc: )", geo_str(db, r->city), geo_str(db, r->country), geo_str(db, r->org));
+    } else {
+        snprintf(buf, size, "(%s, %s, %s, loc: %.4f,%.4f)", geo_str(db, r->city), geo_str(db, r->country),
+                 geo_str(db, r->org), r->lat, r->lon);
+    }
+    return buf;
+}
+
+// Function to map an index file. Returns 0 on success, -1 (with a message) otherwise.
+static inline int geo_open(const char *path, GeoDb *db) {
+    memset(db, 0, sizeof(*db));
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(GeoHeader)) {
+        fprintf(stderr, "%s: not a geolocation index\n", path);
+        close(fd);
+        return -1;
+    }
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        perror("mmap failed");
+        return -1;
+    }
+    const GeoHeader *h = p;
+    size_t size = st.st_size;
+    int ok = memcmp(h->magic, GEO_MAGIC, 8) == 0 && h->range_count > 0 &&
+             h->dir_off + GEO_DIR_SIZE * 4ull <= size &&
+             h->starts_off + h->range_count * 4ull <= size && h->recs_off + h->range_count * 4ull <= size &&
+             h->records_off + h->record_count * (uint64_t)sizeof(GeoRecord) <= size &&
+             h->str_off + h->str_size <= size && h->str_size > 0 &&
+             h->dir_off % 4 == 0 && h->starts_off % 4 == 0 && h->recs_off % 4 == 0 && h->records_off % 4 == 0;
+    if(ok) {
+        const uint32_t *dir = (const uint32_t *)((const char *)p + h->dir_off);
+        ok = dir[GEO_DIR_SIZE - 1] == h->range_count - 1;
+    }
+    if(!ok) {
+        fprintf(stderr, "%s: not a geolocation index (or truncated)\n", path);
+        munmap(p, size);
+        return -1;
+    }
+    db->hdr = h;
+    db->dir = (const uint32_t *)((const char *)p + h->dir_off);
+    db->starts = (const uint32_t *)((const char *)p + h->starts_off);
+    db->recs = (const uint32_t *)((const char *)p + h->recs_off);
+    db->records = (const GeoRecord *)((const char *)p + h->records_off);
+    db->strings = (const char *)p + h->str_off;
+    db->size = size;
+    return 0;
+}
+
+static inline void geo_close(GeoDb *db) {
+    if(db->hdr) munmap((void *)db->hdr, db->size);
+    memset(db, 0, sizeof(*db));
+}
+
+#endif
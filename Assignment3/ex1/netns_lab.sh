@@ -0,0 +1,60 @@
+#!/bin/bash
+# Local test network for trprobe: host -> r1 -> (r2a | r2b) -> r3 -> dst
+# r1 balances per flow over the two middle routers (ECMP with an L4 hash),
+# so a fixed flow sees one path and trprobe -V sees both.
+# Usage: sudo ./netns_lab.sh up | down | run [trprobe options]
+
+NODES="trh trr1 trr2a trr2b trr3 trdst"
+
+link() {    # link <ns1> <addr1> <ns2> <addr2>
+    ip link add "$1-$3" netns "$1" type veth peer name "$3-$1" netns "$3"
+    ip -n "$1" addr add "$2/24" dev "$1-$3"
+    ip -n "$3" addr add "$4/24" dev "$3-$1"
+    ip -n "$1" link set "$1-$3" up
+    ip -n "$3" link set "$3-$1" up
+}
+
+up() {
+    for ns in $NODES; do
+        ip netns add "$ns"
+        ip -n "$ns" link set lo up
+        ip netns exec "$ns" sysctl -qw net.ipv4.ip_forward=1 net.ipv4.icmp_ratelimit=0
+    done
+    link trh 10.90.1.2 trr1 10.90.1.1
+    link trr1 10.90.2.1 trr2a 10.90.2.2
+    link trr1 10.90.3.1 trr2b 10.90.3.2
+    link trr2a 10.90.4.1 trr3 10.90.4.2
+    link trr2b 10.90.5.1 trr3 10.90.5.2
+    link trr3 10.90.6.1 trdst 10.90.6.2
+    ip -n trdst addr add 10.90.6.3/24 dev trdst-trr3
+
+    ip -n trh route add default via 10.90.1.1
+    ip netns exec trr1 sysctl -qw net.ipv4.fib_multipath_hash_policy=1
+    ip -n trr1 route add 10.90.6.0/24 nexthop via 10.90.2.2 nexthop via 10.90.3.2
+    ip -n trr2a route add default via 10.90.2.1
+    ip -n trr2a route add 10.90.6.0/24 via 10.90.4.2
+    ip -n trr2b route add default via 10.90.3.1
+    ip -n trr2b route add 10.90.6.0/24 via 10.90.5.2
+    ip -n trr3 route add default via 10.90.4.1
+    ip -n trdst route add default via 10.90.6.1
+}
+
+down() {
+    for ns in $NODES; do
+        ip netns del "$ns" 2>/dev/null
+    done
+}
+
+case "$1" in
+up) up ;;
+down) down ;;
+run)
+    shift
+    # 10.90.7.1 is unrouted: r1 answers !N, rate-limited by the kernel like a real router would
+    ip netns exec trh ./trprobe "$@" Lab=10.90.6.2 Lab2=10.90.6.3 Unrouted=10.90.7.1
+    ;;
+*)
+    echo "Usage: $0 up | down | run [trprobe options]"
+    exit 1
+    ;;
+esac
@@ -0,0 +1,396 @@
+/*
+ * topostore: keep the discovered router topology in a persistent graph store (../ex2/topostore.h).
+ *
+ * Replaces rebuilding the graph from the raw log on every notebook run
+ * (find_edges, Network._build_network). Runs from trparse tables
+ * (trtable.h) not yet in the store are folded into link observations:
+ * along every probe's path, consecutive answering hops u -> v give one
+ * observation, with the RTT difference for the min / average (positive
+ * differences only, as in find_edges). Routers carry their address, ASN and
+ * coordinates; local and unlocated hops sit at the vantage point (IIT
+ * Madras), as in parse_traceroute_logs.
+ *
+ * Each batch is appended to the store's delta segment, which is cheap, and
+ * once enough records are pending a forked child merges them into the base
+ * while this process returns. Readers (this tool, the ex2 tools through
+ * -v topo.tgs, numpy) map the base in place and fold any pending records in
+ * memory. -g builds a synthetic store of a given size to time appending,
+ * merging and opening it.
+ *
+ * Build: gcc -O2 -Wall -o topostore topostore.c -lm
+ * Usage: topostore [-s topo.tgs] [-t time] [-m merge_at] [-M] [-p [-n top]] [table.trt...]
+ *        topostore [-s topo.tgs] -g routers [-d degree]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include "trtable.h"
+#include "../ex2/graph.h"
+
+#define VANTAGE_LAT 12.99151    // IIT Madras, as IITM_lat_lon in task1.ipynb
+#define VANTAGE_LON 80.23362
+#define MAX_PROBES 256          // probes per hop (TrProbe.probe is a byte)
+
+// Growable array of delta records
+typedef struct {
+    TsRecord *data;
+    size_t count, cap;
+} Records;
+
+// Open-addressing map from a 64-bit key to a record index
+typedef struct {
+    uint64_t *keys;
+    uint32_t *vals;                 // index + 1, 0 = empty
+    size_t mask, count;
+} Index;
+
+Records batch;
+Index node_index, edge_index, run_index;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return x;
+}
+
+static void index_put(Index *ix, uint64_t key, uint32_t val);
+
+static void index_grow(Index *ix) {
+    Index old = *ix;
+    ix->mask = old.mask ? old.mask * 2 + 1 : 1023;
+    ix->count = 0;
+    ix->keys = calloc(ix->mask + 1, sizeof(uint64_t));
+    ix->vals = calloc(ix->mask + 1, sizeof(uint32_t));
+    if(!ix->keys || !ix->vals) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    for(size_t i = 0; old.vals && i <= old.mask; i++) {
+        if(old.vals[i]) index_put(ix, old.keys[i], old.vals[i] - 1);
+    }
+    free(old.keys);
+    free(old.vals);
+}
+
+static size_t index_slot(const Index *ix, uint64_t key) {
+    size_t slot = mix(key) & ix->mask;
+    while(ix->vals[slot] && ix->keys[slot] != key) slot = (slot + 1) & ix->mask;
+    return slot;
+}
+
+static void index_put(Index *ix, uint64_t key, uint32_t val) {
+    if((ix->count + 1) * 2 > ix->mask) index_grow(ix);
+    size_t slot = index_slot(ix, key);
+    if(!ix->vals[slot]) ix->count++;
+    ix->keys[slot] = key;
+    ix->vals[slot] = val + 1;
+}
+
+static long index_get(Index *ix, uint64_t key) {
+    if(!ix->vals) index_grow(ix);
+    size_t slot = index_slot(ix, key);
+    return ix->vals[slot] ? (long)ix->vals[slot] - 1 : -1;
+}
+
+static TsRecord *push_record(uint32_t kind, uint32_t stamp) {
+    if(batch.count == batch.cap) {
+        batch.cap = batch.cap ? batch.cap * 2 : 4096;
+        batch.data = realloc(batch.data, batch.cap * sizeof(TsRecord));
+        if(!batch.data) {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+    }
+    TsRecord *r = &batch.data[batch.count++];
+    memset(r, 0, sizeof(*r));
+    r->kind = kind;
+    r->time = stamp;
+    return r;
+}
+
+static void observe_node(const TrTable *t, const TrProbe *pr, uint32_t stamp) {
+    if(index_get(&node_index, pr->ip) >= 0) return;
+    const TrGeo *g = &t->geos[pr->geo < t->hdr->geo_count ? pr->geo : 0];
+    index_put(&node_index, pr->ip, batch.count);
+    TsRecord *r = push_record(TS_REC_NODE, stamp);
+    r->src = pr->ip;
+    r->asn = g->asn;
+    if((g->flags & TR_GEO_LOCAL) || !(g->flags & TR_GEO_HAS_LOC)) {
+        r->flags = g->flags & TR_GEO_LOCAL ? TS_NODE_LOCAL : TS_NODE_NO_LOC;
+        r->lat = VANTAGE_LAT;
+        r->lon = VANTAGE_LON;
+    } else {
+        r->lat = g->lat;
+        r->lon = g->lon;
+    }
+}
+
+static void observe_link(uint32_t src, uint32_t dst, float rtt_diff, uint32_t stamp) {
+    uint64_t key = (uint64_t)src << 32 | dst;
+    long i = index_get(&edge_index, key);
+    if(i < 0) {
+        i = batch.count;
+        index_put(&edge_index, key, i);
+        TsRecord *r = push_record(TS_REC_EDGE, stamp);
+        r->src = src;
+        r->dst = dst;
+    }
+    TsRecord *r = &batch.data[i];
+    r->count++;
+    if(rtt_diff > 0) {
+        r->rtt_min = r->rtt_count && r->rtt_min < rtt_diff ? r->rtt_min : rtt_diff;
+        r->rtt_sum += rtt_diff;
+        r->rtt_count++;
+    }
+}
+
+/*
+ * Function to turn the runs of a table that the store has not seen into
+ * records. Returns the number of new runs, or -1 if the table cannot be read.
+ */
+long ingest(const char *path, const TsStore *known, uint32_t stamp, long *skipped) {
+    TrTable t;
+    if(tr_open(path, &t) < 0) return -1;
+    static uint32_t last_ip[MAX_PROBES];
+    static float last_rtt[MAX_PROBES];
+    static uint8_t seen[MAX_PROBES];
+    long added = 0;
+    for(uint32_t i = 0; i < t.hdr->run_count; i++) {
+        const TrRun *run = &t.runs[i];
+        uint64_t key = tr_run_key(&t, run);
+        if(ts_has_run(known, key) || index_get(&run_index, key) >= 0) {
+            (*skipped)++;
+            continue;
+        }
+        index_put(&run_index, key, batch.count);
+        TsRecord *r = push_record(TS_REC_RUN, stamp);
+        r->src = key >> 32;
+        r->dst = (uint32_t)key;
+        added++;
+
+        // Follow each probe's path: its previous answering hop links to this one
+        memset(seen, 0, sizeof(seen));
+        for(uint32_t k = run->first_probe; k < run->first_probe + run->probe_count && k < t.hdr->probe_count; k++) {
+            const TrProbe *pr = &t.probes[k];
+            if(!(pr->flags & TR_PROBE_REPLY)) continue;
+            observe_node(&t, pr, stamp);
+            if(seen[pr->probe] && last_ip[pr->probe] != pr->ip)
+                observe_link(last_ip[pr->probe], pr->ip, pr->rtt_ms - last_rtt[pr->probe], stamp);
+            seen[pr->probe] = 1;
+            last_ip[pr->probe] = pr->ip;
+            last_rtt[pr->probe] = pr->rtt_ms;
+        }
+    }
+    tr_close(&t);
+    return added;
+}
+
+// Function to finish the batch: checksums, then one append to the delta segment
+long flush_batch(const char *store_path) {
+    for(size_t i = 0; i < batch.count; i++) batch.data[i].check = ts_check(&batch.data[i]);
+    long pending = ts_append(store_path, batch.data, batch.count);
+    batch.count = 0;
+    return pending;
+}
+
+// Function to merge in a detached child, so the caller is not held up
+void merge_in_background(const char *store_path) {
+    signal(SIGCHLD, SIG_IGN);
+    fflush(stdout);     // else the child flushes a copy of what is still buffered
+    fflush(stderr);
+    pid_t pid = fork();
+    if(pid < 0) {
+        perror("fork failed");
+        return;
+    }
+    if(pid > 0) {
+        printf("Merging into %s in the background (pid %d)\n", store_path, (int)pid);
+        return;
+    }
+    // Let a caller waiting on our output finish; messages from the merge go nowhere
+    setsid();
+    if(!freopen("/dev/null", "w", stdout) || !freopen("/dev/null", "w", stderr)) _exit(1);
+    _exit(ts_compact(store_path, 0) < 0);
+}
+
+static const TsEdgeAttr *sort_attr;
+
+static int cmp_count_desc(const void *a, const void *b) {
+    uint32_t x = sort_attr[*(const uint32_t *)a].count, y = sort_attr[*(const uint32_t *)b].count;
+    return x > y ? -1 : x < y;
+}
+
+// Function to print the store summary and its most observed links
+int print_store(const char *store_path, int top) {
+    TsStore s;
+    double t0 = now();
+    if(ts_open(store_path, &s) < 0) return -1;
+    double t1 = now();
+    uint32_t n = s.hdr->node_count, m = s.hdr->slot_count, located = 0, observed = 0;
+    for(uint32_t u = 0; u < n; u++) located += !(s.flags[u] & (TS_NODE_LOCAL | TS_NODE_NO_LOC));
+    for(uint32_t i = 0; i < m; i++) observed += s.attr[i].count > 0;
+    printf("%s: %u routers (%u located), %u links (%u directions observed), %u runs, %.1f MB\n", store_path, n,
+           located, m / 2, observed, s.hdr->run_count, s.size / 1048576.0);
+    if(s.pending) printf("Opened in %.3f ms (%zu pending delta records folded in memory)\n", (t1 - t0) * 1e3, s.pending);
+    else printf("Opened in %.3f ms (mapped in place)\n", (t1 - t0) * 1e3);
+
+    uint32_t *order = malloc((observed ? observed : 1) * sizeof(uint32_t)), *from = malloc((m ? m : 1) * sizeof(uint32_t));
+    if(!order || !from) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    uint32_t k = 0;
+    for(uint32_t u = 0; u < n; u++) {
+        for(uint32_t i = s.off[u]; i < s.off[u + 1]; i++) {
+            from[i] = u;
+            if(s.attr[i].count) order[k++] = i;
+        }
+    }
+    sort_attr = s.attr;
+    qsort(order, k, sizeof(uint32_t), cmp_count_desc);
+    if(top > 0 && k > 0) {
+        printf("\nMost observed links:\n%-15s    %-15s %8s %9s %9s %8s  %s\n", "From", "To", "Probes", "Min RTT",
+               "Avg RTT", "km", "Last seen");
+    }
+    for(uint32_t j = 0; j < k && j < (uint32_t)top; j++) {
+        uint32_t i = order[j];
+        const TsEdgeAttr *a = &s.attr[i];
+        char src[16], dst[16], when[32];
+        time_t seen = a->last_seen;
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M", localtime(&seen));
+        printf("%-15s -> %-15s %8u", tr_ip(s.ip[from[i]], src), tr_ip(s.ip[s.adj[i]], dst), a->count);
+        if(a->rtt_count) printf(" %6.2f ms %6.2f ms", a->rtt_min, a->rtt_avg);
+        else printf(" %9s %9s", "-", "-");
+        printf(" %8.0f  %s\n", s.km[i], when);
+    }
+    free(order);
+    free(from);
+    ts_close(&s);
+    return 0;
+}
+
+/*
+ * Function to fill a store with a synthetic topology (graph.h generator,
+ * made-up addresses and RTTs) and time appending it, opening it with the
+ * records pending, merging, and opening the merged base.
+ */
+int synthetic(const char *store_path, uint32_t routers, unsigned degree) {
+    Graph g;
+    graph_generate(&g, routers, degree, 1);
+    uint32_t stamp = 1700000000;
+    uint64_t state = 7;
+    for(uint32_t u = 0; u < g.n; u++) {
+        TsRecord *r = push_record(TS_REC_NODE, stamp);
+        r->src = 0x0a000000u + u;
+        r->asn = 64512 + u % 1000;
+        r->lat = g.lat[u];
+        r->lon = g.lon[u];
+    }
+    for(uint32_t u = 0; u < g.n; u++) {
+        for(uint32_t i = g.off[u]; i < g.off[u + 1]; i++) {
+            if(g.adj[i] < u) continue;
+            TsRecord *r = push_record(TS_REC_EDGE, stamp + graph_rand(&state) % 86400);
+            r->src = 0x0a000000u + u;
+            r->dst = 0x0a000000u + g.adj[i];
+            r->count = r->rtt_count = 1 + graph_rand(&state) % 30;
+            r->rtt_min = g.w[i] / 100.0f + 0.1f;
+            r->rtt_sum = r->rtt_count * (r->rtt_min + 2 * graph_uniform(&state));
+        }
+    }
+    graph_free(&g);
+    size_t records = batch.count;
+
+    double t0 = now();
+    if(flush_batch(store_path) < 0) return -1;
+    double t1 = now();
+    TsStore s;
+    if(ts_open(store_path, &s) < 0) return -1;
+    double t2 = now();
+    printf("%zu records appended in %.3f s; opened with them pending (merged in memory) in %.3f s: %u routers, "
+           "%u links\n",
+           records, t1 - t0, t2 - t1, s.hdr->node_count, s.hdr->slot_count / 2);
+    ts_close(&s);
+    t0 = now();
+    long folded = ts_compact(store_path, 1);
+    t1 = now();
+    if(folded < 0) return -1;
+    printf("Merged %ld records into the base in %.3f s\n", folded, t1 - t0);
+    t0 = now();
+    if(ts_open(store_path, &s) < 0) return -1;
+    t1 = now();
+    uint64_t sum = 0;
+    for(uint32_t i = 0; i < s.hdr->slot_count; i++) sum += s.adj[i];
+    t2 = now();
+    printf("Opened the %.1f MB base in %.3f ms (first full pass over the links: %.3f s%s)\n", s.size / 1048576.0,
+           (t1 - t0) * 1e3, t2 - t1, sum ? "" : " ");
+    ts_close(&s);
+    return 0;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-s topo.tgs] [-t time] [-m merge_at] [-M] [-p [-n top]] [table.trt...]\n"
+            "       %s [-s topo.tgs] -g routers [-d degree]\n",
+            prog, prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *store_path = "topo.tgs";
+    uint32_t time_now = time(NULL), routers = 0;
+    long merge_at = 100000;
+    int top = 20, print = 0, merge_now = 0, opt;
+    unsigned degree = 16;
+    while((opt = getopt(argc, argv, "s:t:m:Mpn:g:d:")) != -1) {
+        switch(opt) {
+        case 's': store_path = optarg; break;
+        case 't': time_now = strtoul(optarg, NULL, 10); break;
+        case 'm': merge_at = atol(optarg); break;
+        case 'M': merge_now = 1; break;
+        case 'p': print = 1; break;
+        case 'n': top = atoi(optarg); break;
+        case 'g': routers = strtoul(optarg, NULL, 10); break;
+        case 'd': degree = atoi(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if(routers) return synthetic(store_path, routers, degree) < 0;
+    if(optind == argc && !merge_now && !print) usage(argv[0]);
+
+    if(optind < argc) {
+        TsStore known;
+        if(ts_open(store_path, &known) < 0) return 1;
+        long runs = 0, skipped = 0;
+        for(int i = optind; i < argc; i++) {
+            long added = ingest(argv[i], &known, time_now, &skipped);
+            if(added < 0) return 1;
+            runs += added;
+        }
+        size_t records = batch.count, pending_before = known.pending;
+        ts_close(&known);
+        long pending = records ? flush_batch(store_path) : (long)pending_before;
+        if(pending < 0) return 1;
+        printf("%ld new runs (%ld already stored): %zu records appended, %ld pending\n", runs, skipped, records,
+               pending);
+        if(!merge_now && pending >= merge_at && pending > 0) merge_in_background(store_path);
+    }
+    if(merge_now) {
+        long folded = ts_compact(store_path, 1);
+        if(folded < 0) return 1;
+        printf("Merged %ld records into %s\n", folded, store_path);
+    }
+    if(print && print_store(store_path, top) < 0) return 1;
+    return 0;
+}
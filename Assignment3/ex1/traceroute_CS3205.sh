@@ -3,6 +3,8 @@
 
 DEST=$1
 IPINFO_API_TOKEN=${2:-"9493b211526d3f"}
+# Offline index built by geodb (e.g. ./geodb -o geo.db prefixes.csv geocache.csv); ipinfo is only used without it
+GEO_DB=${GEO_DB:-geo.db}
 
 if [ -z "$DEST" ]; then
     echo "Usage: $0 <destination> [ipinfo_api_token]"
@@ -26,6 +28,8 @@ traceroute -n "$DEST" | while read -r line; do
            [[ "$ip" =~ ^172\.(1[6-9]|2[0-9]|3[0-1])\. ]] || \
            [[ "$ip" =~ ^255\. ]]; then
             GEO="(Local / IIT Madras / Reserved)"
+        elif [ -x ./geodb ] && [ -f "$GEO_DB" ]; then
+            GEO=$(./geodb -q "$GEO_DB" "$ip")
         else
             INFO=$(curl -s --max-time 2 "https://ipinfo.io/$ip?token=$IPINFO_API_TOKEN")
             CITY=$(echo "$INFO" | grep '"city"' | cut -d '"' -f4)
@@ -0,0 +1,510 @@
+/*
+ * trlb: incremental load-balancing and transit-router analysis over traceroute tables.
+ *
+ * Replaces detect_load_balancing / find_frequent_routers, which re-read the
+ * whole log on every call. trlb keeps its aggregates in a state file and
+ * only folds in runs it has not seen yet (keyed by destination, run
+ * number and probe rows, see tr_run_key), reading them in place from trparse tables (trtable.h). A
+ * continuous pipeline converts each new batch of runs with trparse and
+ * hands the table to trlb; re-feeding a table that grew is fine too, as
+ * known runs are skipped without touching their probes.
+ *
+ * For every destination and hop it tracks the interfaces that answered,
+ * over all runs and probes:
+ *   per-packet  some run saw 2+ interfaces at this hop (within one flow when
+ *               the log comes from trprobe without -V)
+ *   per-flow    every run saw one interface, but runs disagree
+ * Transit routers (not local, not the destination) are ranked by path
+ * coverage: how many destinations, and what share of all runs, cross them.
+ *
+ * Build: gcc -O2 -Wall -o trlb trlb.c
+ * Usage: trlb [-s trlb.state] [-n top] [table.trt...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "trtable.h"
+
+#define STATE_MAGIC "TRLBST02"
+#define MAX_HOP_IFACES 64           // distinct interfaces remembered per hop within one run
+
+typedef struct {
+    uint32_t country, host;         // state string offsets
+    uint32_t runs;
+} Dest;
+
+typedef struct {
+    uint64_t key;                   // tr_run_key
+    uint32_t dest, run_no;
+} RunKey;
+
+typedef struct {
+    uint32_t dest, hop;
+    uint32_t runs;                  // runs with a reply at this hop
+    uint32_t multi_runs;            // runs with 2+ interfaces at this hop
+    uint32_t ifaces;
+} HopStat;
+
+typedef struct {
+    uint32_t dest, hop, ip;
+    uint32_t probes, runs;
+} Iface;
+
+typedef struct {
+    uint32_t ip;
+    uint32_t dests, runs, probes;
+    uint32_t city, country, org;    // state string offsets
+    uint32_t asn, local;
+} Router;
+
+typedef struct {
+    uint32_t ip, dest, runs;
+} RouterDest;
+
+typedef struct {
+    char magic[8];
+    uint32_t dest_count, run_count, hop_count, iface_count, router_count, pair_count;
+    uint64_t str_size;
+} StateHeader;
+
+// Growable array of fixed-size elements
+typedef struct {
+    void *data;
+    size_t count, cap, elem;
+} Vec;
+
+// Open-addressing map from a 64-bit key to an array index
+typedef struct {
+    uint64_t *keys;
+    uint32_t *vals;                 // index + 1, 0 = empty
+    size_t mask, count;
+} Index;
+
+Vec dests = {NULL, 0, 0, sizeof(Dest)};
+Vec runs = {NULL, 0, 0, sizeof(RunKey)};
+Vec hops = {NULL, 0, 0, sizeof(HopStat)};
+Vec ifaces = {NULL, 0, 0, sizeof(Iface)};
+Vec routers = {NULL, 0, 0, sizeof(Router)};
+Vec pairs = {NULL, 0, 0, sizeof(RouterDest)};
+Vec strings = {NULL, 0, 0, 1};
+Index dest_index, run_index, hop_index, iface_index, router_index, pair_index, string_index;
+
+static void *vec_push(Vec *v, size_t n) {
+    while(v->count + n > v->cap) {
+        v->cap = v->cap ? v->cap * 2 : 1024;
+        v->data = realloc(v->data, v->cap * v->elem);
+        if(!v->data) {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+    }
+    void *p = (char *)v->data + v->elem * v->count;
+    v->count += n;
+    return p;
+}
+
+#define AT(vec, type, i) (&((type *)(vec).data)[i])
+
+static uint64_t mix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    return k;
+}
+
+static uint64_t hash_string(const char *s) {
+    uint64_t h = 1469598103934665603ull;
+    while(*s) h = (h ^ (uint8_t)*s++) * 1099511628211ull;
+    return h;
+}
+
+static void index_put(Index *ix, uint64_t key, uint32_t val);
+
+static void index_grow(Index *ix) {
+    Index old = *ix;
+    ix->mask = old.mask ? old.mask * 2 + 1 : 1023;
+    ix->count = 0;
+    ix->keys = calloc(ix->mask + 1, sizeof(uint64_t));
+    ix->vals = calloc(ix->mask + 1, sizeof(uint32_t));
+    if(!ix->keys || !ix->vals) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    for(size_t i = 0; old.vals && i <= old.mask; i++) {
+        if(old.vals[i]) index_put(ix, old.keys[i], old.vals[i] - 1);
+    }
+    free(old.keys);
+    free(old.vals);
+}
+
+// Function to find the slot of a key (empty slot if absent)
+static size_t index_slot(const Index *ix, uint64_t key) {
+    size_t slot = mix(key) & ix->mask;
+    while(ix->vals[slot] && ix->keys[slot] != key) slot = (slot + 1) & ix->mask;
+    return slot;
+}
+
+static void index_put(Index *ix, uint64_t key, uint32_t val) {
+    if((ix->count + 1) * 2 > ix->mask) index_grow(ix);
+    size_t slot = index_slot(ix, key);
+    if(!ix->vals[slot]) ix->count++;
+    ix->keys[slot] = key;
+    ix->vals[slot] = val + 1;
+}
+
+// Function to look a key up. Returns the array index or -1.
+static long index_get(Index *ix, uint64_t key) {
+    if(!ix->vals) index_grow(ix);
+    size_t slot = index_slot(ix, key);
+    return ix->vals[slot] ? (long)ix->vals[slot] - 1 : -1;
+}
+
+// Function to intern a string into the state blob (hash collisions checked by comparison)
+static uint32_t state_string(const char *s) {
+    if(!strings.count) *(char *)vec_push(&strings, 1) = 0;      // offset 0 = ""
+    if(!*s) return 0;
+    uint64_t h = hash_string(s);
+    for(uint64_t probe = h;; probe++) {
+        long off = index_get(&string_index, probe);
+        if(off < 0) break;
+        if(strcmp((char *)strings.data + off, s) == 0) return off;
+    }
+    size_t len = strlen(s) + 1;
+    uint32_t off = strings.count;
+    memcpy(vec_push(&strings, len), s, len);
+    uint64_t probe = h;
+    while(index_get(&string_index, probe) >= 0) probe++;
+    index_put(&string_index, probe, off);
+    return off;
+}
+
+static const char *str(uint32_t off) {
+    return off < strings.count ? (const char *)strings.data + off : "";
+}
+
+static uint64_t dest_key(uint32_t country, uint32_t host) {
+    return (uint64_t)country << 32 | host;
+}
+
+// Function to rebuild every index after loading a state file
+static void rebuild_indexes(void) {
+    for(size_t i = 0; i < strings.count;) {
+        const char *s = (const char *)strings.data + i;
+        if(*s) {
+            uint64_t probe = hash_string(s);
+            while(index_get(&string_index, probe) >= 0) probe++;
+            index_put(&string_index, probe, i);
+        }
+        i += strlen(s) + 1;
+    }
+    for(size_t i = 0; i < dests.count; i++) {
+        Dest *d = AT(dests, Dest, i);
+        index_put(&dest_index, dest_key(d->country, d->host), i);
+    }
+    for(size_t i = 0; i < runs.count; i++) {
+        RunKey *r = AT(runs, RunKey, i);
+        index_put(&run_index, r->key, i);
+    }
+    for(size_t i = 0; i < hops.count; i++) {
+        HopStat *h = AT(hops, HopStat, i);
+        index_put(&hop_index, (uint64_t)h->dest << 8 | h->hop, i);
+    }
+    for(size_t i = 0; i < ifaces.count; i++) {
+        Iface *f = AT(ifaces, Iface, i);
+        index_put(&iface_index, ((uint64_t)f->dest << 8 | f->hop) << 32 | f->ip, i);
+    }
+    for(size_t i = 0; i < routers.count; i++) index_put(&router_index, AT(routers, Router, i)->ip, i);
+    for(size_t i = 0; i < pairs.count; i++) {
+        RouterDest *p = AT(pairs, RouterDest, i);
+        index_put(&pair_index, (uint64_t)p->ip << 32 | p->dest, i);
+    }
+}
+
+static int read_vec(FILE *f, Vec *v, size_t count) {
+    if(count == 0) return 0;
+    void *p = vec_push(v, count);
+    return fread(p, v->elem, count, f) == count ? 0 : -1;
+}
+
+// Function to load the state file (a missing file is an empty state)
+static int load_state(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if(!f) return 0;
+    StateHeader h;
+    if(fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, STATE_MAGIC, 8) != 0 ||
+       read_vec(f, &dests, h.dest_count) || read_vec(f, &runs, h.run_count) || read_vec(f, &hops, h.hop_count) ||
+       read_vec(f, &ifaces, h.iface_count) || read_vec(f, &routers, h.router_count) ||
+       read_vec(f, &pairs, h.pair_count) || read_vec(f, &strings, h.str_size) ||
+       (strings.count && ((char *)strings.data)[strings.count - 1] != 0)) {
+        fprintf(stderr, "%s: corrupt state file\n", path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    rebuild_indexes();
+    return 0;
+}
+
+// Function to write the state next to the old one and swap it in
+static int save_state(const char *path) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if(!f) {
+        perror(tmp);
+        return -1;
+    }
+    StateHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, STATE_MAGIC, 8);
+    h.dest_count = dests.count;
+    h.run_count = runs.count;
+    h.hop_count = hops.count;
+    h.iface_count = ifaces.count;
+    h.router_count = routers.count;
+    h.pair_count = pairs.count;
+    h.str_size = strings.count;
+    Vec *all[] = {&dests, &runs, &hops, &ifaces, &routers, &pairs, &strings};
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    for(size_t i = 0; ok && i < sizeof(all) / sizeof(all[0]); i++) {
+        if(all[i]->count) ok = fwrite(all[i]->data, all[i]->elem, all[i]->count, f) == all[i]->count;
+    }
+    if(fclose(f) != 0) ok = 0;
+    if(!ok || rename(tmp, path) < 0) {
+        perror("Saving state failed");
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to find (or add) the router of a probe. Probes whose lookup failed carry an
+// empty annotation, so a router keeps the first non-empty one, whichever run brings it.
+static Router *get_router(const TrTable *t, const TrProbe *pr) {
+    const TrGeo *g = &t->geos[pr->geo < t->hdr->geo_count ? pr->geo : 0];
+    long i = index_get(&router_index, pr->ip);
+    if(i >= 0) {
+        Router *r = AT(routers, Router, i);
+        int known = r->city || r->country || r->org || r->asn || r->local;
+        if(!known && (*tr_str(t, g->city) || *tr_str(t, g->country) || *tr_str(t, g->org) || g->asn || g->flags & TR_GEO_LOCAL)) {
+            r->city = state_string(tr_str(t, g->city));
+            r->country = state_string(tr_str(t, g->country));
+            r->org = state_string(tr_str(t, g->org));
+            r->asn = g->asn;
+            r->local = (g->flags & TR_GEO_LOCAL) != 0;
+        }
+        return r;
+    }
+    uint32_t city = state_string(tr_str(t, g->city)), country = state_string(tr_str(t, g->country));
+    uint32_t org = state_string(tr_str(t, g->org));
+    index_put(&router_index, pr->ip, routers.count);
+    Router *r = vec_push(&routers, 1);
+    *r = (Router){pr->ip, 0, 0, 0, city, country, org, g->asn, (g->flags & TR_GEO_LOCAL) != 0};
+    return r;
+}
+
+// Function to fold one run into the aggregates
+static void add_run(const TrTable *t, const TrRun *run, uint32_t dest) {
+    uint32_t path[256];         // transit routers of this run, once each
+    int path_len = 0;
+    const TrProbe *pr = &t->probes[run->first_probe], *end = pr + run->probe_count;
+    while(pr < end) {
+        // One hop: its probes are consecutive
+        uint32_t hop = pr->hop, seen[MAX_HOP_IFACES];
+        int nseen = 0;
+        for(; pr < end && pr->hop == hop; pr++) {
+            if(!(pr->flags & TR_PROBE_REPLY)) continue;
+            uint64_t key = ((uint64_t)dest << 8 | hop) << 32 | pr->ip;
+            long i = index_get(&iface_index, key);
+            if(i < 0) {
+                i = ifaces.count;
+                index_put(&iface_index, key, i);
+                *(Iface *)vec_push(&ifaces, 1) = (Iface){dest, hop, pr->ip, 0, 0};
+            }
+            Iface *f = AT(ifaces, Iface, i);
+            f->probes++;
+            Router *r = get_router(t, pr);
+            r->probes++;
+
+            int k = 0;
+            while(k < nseen && seen[k] != pr->ip) k++;
+            if(k < nseen || nseen == MAX_HOP_IFACES) continue;
+            seen[nseen++] = pr->ip;
+            f->runs++;
+            if(!r->local && pr->ip != run->dest_ip && !(pr->flags & TR_PROBE_DEST)) {
+                int j = 0;
+                while(j < path_len && path[j] != pr->ip) j++;
+                if(j == path_len && path_len < 256) path[path_len++] = pr->ip;
+            }
+        }
+        if(!nseen) continue;
+
+        long h = index_get(&hop_index, (uint64_t)dest << 8 | hop);
+        if(h < 0) {
+            h = hops.count;
+            index_put(&hop_index, (uint64_t)dest << 8 | hop, h);
+            *(HopStat *)vec_push(&hops, 1) = (HopStat){dest, hop, 0, 0, 0};
+        }
+        HopStat *hs = AT(hops, HopStat, h);
+        hs->runs++;
+        if(nseen >= 2) hs->multi_runs++;
+    }
+
+    for(int j = 0; j < path_len; j++) {
+        Router *r = AT(routers, Router, index_get(&router_index, path[j]));
+        r->runs++;
+        uint64_t key = (uint64_t)path[j] << 32 | dest;
+        long p = index_get(&pair_index, key);
+        if(p < 0) {
+            p = pairs.count;
+            index_put(&pair_index, key, p);
+            *(RouterDest *)vec_push(&pairs, 1) = (RouterDest){path[j], dest, 0};
+            r->dests++;
+        }
+        AT(pairs, RouterDest, p)->runs++;
+    }
+}
+
+// Function to fold every new run of a table. Returns the number of runs added.
+static long ingest(const char *path) {
+    TrTable t;
+    if(tr_open(path, &t) < 0) return -1;
+    long added = 0;
+    for(uint32_t d = 0; d < t.hdr->dest_count; d++) {
+        const TrDest *td = &t.dests[d];
+        uint32_t country = state_string(tr_str(&t, td->country)), host = state_string(tr_str(&t, td->host));
+        long dest = index_get(&dest_index, dest_key(country, host));
+        if(dest < 0) {
+            dest = dests.count;
+            index_put(&dest_index, dest_key(country, host), dest);
+            *(Dest *)vec_push(&dests, 1) = (Dest){country, host, 0};
+        }
+        for(uint32_t r = td->first_run; r < td->first_run + td->run_count && r < t.hdr->run_count; r++) {
+            const TrRun *run = &t.runs[r];
+            if((uint64_t)run->first_probe + run->probe_count > t.hdr->probe_count) continue;
+            uint64_t key = tr_run_key(&t, run);
+            if(index_get(&run_index, key) >= 0) continue;
+            index_put(&run_index, key, runs.count);
+            *(RunKey *)vec_push(&runs, 1) = (RunKey){key, dest, run->run_no};
+            AT(dests, Dest, dest)->runs++;
+            add_run(&t, run, dest);
+            added++;
+        }
+    }
+    tr_close(&t);
+    return added;
+}
+
+static int cmp_hops(const void *a, const void *b) {
+    const HopStat *x = a, *y = b;
+    int c = strcmp(str(AT(dests, Dest, x->dest)->host), str(AT(dests, Dest, y->dest)->host));
+    if(c) return c;
+    return (int)x->hop - (int)y->hop;
+}
+
+static int cmp_ifaces(const void *a, const void *b) {
+    const Iface *x = a, *y = b;
+    if(x->dest != y->dest) return x->dest < y->dest ? -1 : 1;
+    if(x->hop != y->hop) return x->hop < y->hop ? -1 : 1;
+    return (int)y->probes - (int)x->probes;
+}
+
+static int cmp_routers(const void *a, const void *b) {
+    const Router *x = *(const Router *const *)a, *y = *(const Router *const *)b;
+    if(x->dests != y->dests) return x->dests > y->dests ? -1 : 1;
+    if(x->runs != y->runs) return x->runs > y->runs ? -1 : 1;
+    return x->ip < y->ip ? -1 : x->ip > y->ip;
+}
+
+static void report(int top) {
+    char ip[16];
+    printf("Destinations: %zu, runs: %zu, interfaces seen: %zu\n", dests.count, runs.count, ifaces.count);
+
+    // Sorted copies; the state arrays keep their order (the indexes point into them)
+    HopStat *hs = malloc(hops.count * sizeof(HopStat) + 1);
+    Iface *fs = malloc(ifaces.count * sizeof(Iface) + 1);
+    const Router **rs = malloc(routers.count * sizeof(Router *) + 1);
+    if(!hs || !fs || !rs) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    size_t nh = 0, nr = 0;
+    for(size_t i = 0; i < hops.count; i++) {
+        if(AT(hops, HopStat, i)->ifaces >= 2) hs[nh++] = *AT(hops, HopStat, i);
+    }
+    memcpy(fs, ifaces.data, ifaces.count * sizeof(Iface));
+    qsort(hs, nh, sizeof(HopStat), cmp_hops);
+    qsort(fs, ifaces.count, sizeof(Iface), cmp_ifaces);
+
+    size_t per_packet = 0;
+    for(size_t i = 0; i < nh; i++) per_packet += hs[i].multi_runs > 0;
+    printf("\nLoad-balanced hops: %zu (%zu per-packet, %zu per-flow)\n", nh, per_packet, nh - per_packet);
+    for(size_t i = 0; i < nh; i++) {
+        const Dest *d = AT(dests, Dest, hs[i].dest);
+        printf("%s | %s | hop %u: %s, %u interfaces, %u/%u runs with 2+\n", str(d->country), str(d->host), hs[i].hop,
+               hs[i].multi_runs ? "per-packet" : "per-flow", hs[i].ifaces, hs[i].multi_runs, hs[i].runs);
+        // The interfaces of this hop are contiguous in the sorted copy; find them by binary search
+        size_t lo = 0, hi = ifaces.count;
+        while(lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if(fs[mid].dest < hs[i].dest || (fs[mid].dest == hs[i].dest && fs[mid].hop < hs[i].hop)) lo = mid + 1;
+            else hi = mid;
+        }
+        for(; lo < ifaces.count && fs[lo].dest == hs[i].dest && fs[lo].hop == hs[i].hop; lo++) {
+            const Router *r = AT(routers, Router, index_get(&router_index, fs[lo].ip));
+            printf("  %-15s | %-30.30s | %s, %s | %u probes, %u runs\n", tr_ip(fs[lo].ip, ip), str(r->org),
+                   str(r->city), str(r->country), fs[lo].probes, fs[lo].runs);
+        }
+    }
+
+    for(size_t i = 0; i < routers.count; i++) {
+        if(AT(routers, Router, i)->runs) rs[nr++] = AT(routers, Router, i);
+    }
+    qsort(rs, nr, sizeof(Router *), cmp_routers);
+    printf("\nTransit routers by path coverage (top %d of %zu):\n", top, nr);
+    printf("%-15s %6s %8s  %-25s %s\n", "IP", "Dests", "Runs", "Location", "ISP");
+    for(size_t i = 0; i < nr && (int)i < top; i++) {
+        char loc[64];
+        snprintf(loc, sizeof(loc), "%s, %s", str(rs[i]->city), str(rs[i]->country));
+        printf("%-15s %6u %7.1f%%  %-25s %s\n", tr_ip(rs[i]->ip, ip), rs[i]->dests,
+               runs.count ? 100.0 * rs[i]->runs / runs.count : 0.0, loc, str(rs[i]->org));
+    }
+    free(hs);
+    free(fs);
+    free(rs);
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-s trlb.state] [-n top] [table.trt...]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *state_path = "trlb.state";
+    int top = 20, opt;
+    while((opt = getopt(argc, argv, "s:n:")) != -1) {
+        switch(opt) {
+        case 's': state_path = optarg; break;
+        case 'n': top = atoi(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if(load_state(state_path) < 0) return 1;
+    size_t known = runs.count;
+    for(int i = optind; i < argc; i++) {
+        long added = ingest(argv[i]);
+        if(added < 0) return 1;
+        printf("%s: %ld new runs\n", argv[i], added);
+    }
+    // Interface counts per hop are derived, so they stay right however runs arrive
+    for(size_t i = 0; i < hops.count; i++) AT(hops, HopStat, i)->ifaces = 0;
+    for(size_t i = 0; i < ifaces.count; i++) {
+        Iface *f = AT(ifaces, Iface, i);
+        AT(hops, HopStat, index_get(&hop_index, (uint64_t)f->dest << 8 | f->hop))->ifaces++;
+    }
+    if(runs.count != known && save_state(state_path) < 0) return 1;
+    report(top);
+    return 0;
+}
@@ -0,0 +1,735 @@
+/*
+ * trparse: traceroute_log.txt -> indexed binary table (see trtable.h).
+ *
+ * The log is mmap'ed and scanned once by a hand-written tokenizer (no
+ * regexes): every probe of every hop becomes one fixed-size row holding the
+ * run, destination, hop, probe number, IPv4 address, RTT and an interned geo
+ * annotation. Rows are grouped per destination so later tools can jump to a
+ * destination through the index and read its runs in place.
+ *
+ * Build: gcc -O2 -Wall -o trparse trparse.c -lm
+ * Usage: trparse [-o table.trt] traceroute_log.txt...   build a table
+ *        trparse -s table.trt                           router RTT statistics (1(a), 1(b))
+ *        trparse -d <host> table.trt                    print the runs of one destination
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "trtable.h"
+
+// Growable array of fixed-size elements
+typedef struct {
+    void *data;
+    size_t count, cap, elem;
+} Vec;
+
+// Strings interned into one blob; the hash maps text to a caller-defined value
+typedef struct {
+    char *blob;
+    size_t used, cap;
+    uint32_t *offs;         // slot -> blob offset + 1 (0 = empty)
+    uint32_t *vals;
+    size_t mask, count;
+} Intern;
+
+typedef struct {
+    uint32_t country, host; // string offsets
+    uint32_t runs;
+} DestInfo;
+
+Vec probes = {NULL, 0, 0, sizeof(TrProbe)};
+Vec runs = {NULL, 0, 0, sizeof(TrRun)};
+Vec geos = {NULL, 0, 0, sizeof(TrGeo)};
+Vec dests = {NULL, 0, 0, sizeof(DestInfo)};
+Intern strings;             // written out; value = offset
+Intern geo_keys;            // raw annotation text -> geo id (not written)
+Intern dest_keys;           // "country|host" -> dest id (not written)
+
+static void *vec_push(Vec *v) {
+    if(v->count == v->cap) {
+        v->cap = v->cap ? v->cap * 2 : 1024;
+        v->data = realloc(v->data, v->cap * v->elem);
+        if(!v->data) {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+    }
+    return (char *)v->data + v->elem * v->count++;
+}
+
+static uint32_t hash_bytes(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < len; i++) h = (h ^ (uint8_t)s[i]) * 16777619u;
+    return h;
+}
+
+static void intern_init(Intern *it) {
+    it->cap = 1 << 16;
+    it->blob = malloc(it->cap);
+    it->mask = (1 << 12) - 1;
+    it->offs = calloc(it->mask + 1, sizeof(uint32_t));
+    it->vals = calloc(it->mask + 1, sizeof(uint32_t));
+    if(!it->blob || !it->offs || !it->vals) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    it->blob[0] = 0;        // offset 0 is the empty string
+    it->used = 1;
+    it->count = 0;
+}
+
+static void intern_grow(Intern *it) {
+    size_t old_mask = it->mask;
+    uint32_t *old_offs = it->offs, *old_vals = it->vals;
+    it->mask = old_mask * 2 + 1;
+    it->offs = calloc(it->mask + 1, sizeof(uint32_t));
+    it->vals = calloc(it->mask + 1, sizeof(uint32_t));
+    if(!it->offs || !it->vals) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    for(size_t i = 0; i <= old_mask; i++) {
+        if(!old_offs[i]) continue;
+        const char *s = it->blob + old_offs[i] - 1;
+        size_t slot = hash_bytes(s, strlen(s)) & it->mask;
+        while(it->offs[slot]) slot = (slot + 1) & it->mask;
+        it->offs[slot] = old_offs[i];
+        it->vals[slot] = old_vals[i];
+    }
+    free(old_offs);
+    free(old_vals);
+}
+
+// Function to intern a string. Returns the slot value; *added says whether it is new
+// (the caller then sets the value, which defaults to the blob offset).
+static uint32_t *intern(Intern *it, const char *s, size_t len, int *added) {
+    *added = 0;
+    if(len == 0 && it == &strings) {
+        static uint32_t empty = 0;
+        return &empty;
+    }
+    size_t slot = hash_bytes(s, len) & it->mask;
+    while(it->offs[slot]) {
+        const char *t = it->blob + it->offs[slot] - 1;
+        if(strncmp(t, s, len) == 0 && t[len] == 0) return &it->vals[slot];
+        slot = (slot + 1) & it->mask;
+    }
+    if(it->used + len + 1 > it->cap) {
+        while(it->used + len + 1 > it->cap) it->cap *= 2;
+        it->blob = realloc(it->blob, it->cap);
+        if(!it->blob) {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+    }
+    uint32_t off = it->used;
+    memcpy(it->blob + off, s, len);
+    it->blob[off + len] = 0;
+    it->used += len + 1;
+    it->offs[slot] = off + 1;
+    it->vals[slot] = off;
+    *added = 1;
+    if(++it->count * 2 > it->mask) {
+        intern_grow(it);
+        // Slot moved: look the value up again
+        int again;
+        uint32_t *v = intern(it, s, len, &again);
+        *added = 1;
+        return v;
+    }
+    return &it->vals[slot];
+}
+
+static uint32_t intern_string(const char *s, size_t len) {
+    int added;
+    while(len && (s[len - 1] == ' ')) len--;
+    while(len && *s == ' ') s++, len--;
+    return *intern(&strings, s, len, &added);
+}
+
+// Function to parse a dotted IPv4 address. Returns the characters used, 0 if none.
+static size_t parse_ipv4(const char *p, const char *end, uint32_t *ip) {
+    const char *s = p;
+    uint32_t v = 0;
+    for(int part = 0; part < 4; part++) {
+        if(part) {
+            if(p >= end || *p != '.') return 0;
+            p++;
+        }
+        uint32_t octet = 0;
+        int digits = 0;
+        while(p < end && *p >= '0' && *p <= '9' && digits < 4) octet = octet * 10 + (*p++ - '0'), digits++;
+        if(digits == 0 || digits > 3 || octet > 255) return 0;
+        v = v << 8 | octet;
+    }
+    if(p < end && ((*p >= '0' && *p <= '9') || *p == '.')) return 0;
+    *ip = v;
+    return p - s;
+}
+
+// Function to parse a decimal like "-8.8368" or "31.638". Returns the characters used.
+static size_t parse_decimal(const char *p, const char *end, double *out) {
+    const char *s = p;
+    int neg = 0;
+    if(p < end && *p == '-') neg = 1, p++;
+    double v = 0, scale = 1;
+    const char *digits = p;
+    while(p < end && *p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+    if(p < end && *p == '.') {
+        p++;
+        while(p < end && *p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0'), scale *= 10;
+    }
+    if(p == digits) return 0;
+    *out = (neg ? -v : v) / scale;
+    return p - s;
+}
+
+// Function to find text inside [p, end)
+static const char *find(const char *p, const char *end, const char *what) {
+    size_t n = strlen(what);
+    while(end - p >= (long)n) {
+        const char *q = memchr(p, what[0], end - p - n + 1);
+        if(!q) return NULL;
+        if(memcmp(q, what, n) == 0) return q;
+        p = q + 1;
+    }
+    return NULL;
+}
+
+// Function to intern a geo annotation: the text between the parentheses
+static uint32_t intern_geo(const char *s, const char *end) {
+    int added;
+    uint32_t *id = intern(&geo_keys, s, end - s, &added);
+    if(!added) return *id;
+    *id = geos.count;
+    TrGeo *g = vec_push(&geos);
+    memset(g, 0, sizeof(*g));
+    g->lat = g->lon = NAN;
+
+    const char *loc = NULL;
+    for(const char *q = find(s, end, "loc:"); q; q = find(q + 1, end, "loc:")) loc = q;
+    if(!loc) {
+        // "(Local / IIT Madras / Reserved)" and other free text
+        if(find(s, end, "Local")) g->flags |= TR_GEO_LOCAL;
+        g->org = intern_string(s, end - s);
+        return *id;
+    }
+    // "City, CC, AS123 Org, Inc., loc: lat,lon": city and country are the first two fields,
+    // the organisation is everything up to ", loc:" (it may contain commas)
+    const char *org_end = loc;
+    while(org_end > s && (org_end[-1] == ' ' || org_end[-1] == ',')) org_end--;
+    const char *c1 = memchr(s, ',', org_end - s);
+    const char *c2 = c1 ? memchr(c1 + 1, ',', org_end - c1 - 1) : NULL;
+    if(c1) g->city = intern_string(s, c1 - s);
+    if(c2) g->country = intern_string(c1 + 1, c2 - c1 - 1);
+    else if(c1) g->country = intern_string(c1 + 1, org_end - c1 - 1);
+    if(c2) {
+        const char *o = c2 + 1;
+        while(o < org_end && *o == ' ') o++;
+        if(org_end - o > 2 && o[0] == 'A' && o[1] == 'S' && o[2] >= '0' && o[2] <= '9') {
+            o += 2;
+            while(o < org_end && *o >= '0' && *o <= '9') g->asn = g->asn * 10 + (*o++ - '0');
+        }
+        if(o < org_end) g->org = intern_string(o, org_end - o);
+    }
+    double lat, lon;
+    const char *p = loc + 4;
+    while(p < end && *p == ' ') p++;
+    size_t n = parse_decimal(p, end, &lat);
+    if(n && p + n < end && p[n] == ',' && parse_decimal(p + n + 1, end, &lon)) {
+        g->lat = lat;
+        g->lon = lon;
+        g->flags |= TR_GEO_HAS_LOC;
+    }
+    return *id;
+}
+
+// Function to skip a parenthesised annotation (which may nest). Returns its end.
+static const char *annotation_end(const char *p, const char *end) {
+    int depth = 0;
+    for(; p < end; p++) {
+        if(*p == '(') depth++;
+        else if(*p == ')' && --depth == 0) return p;
+    }
+    return end;
+}
+
+static uint32_t find_dest(const char *country, size_t clen, const char *host, size_t hlen) {
+    char key[512];
+    int n = snprintf(key, sizeof(key), "%.*s|%.*s", (int)clen, country, (int)hlen, host);
+    if(n >= (int)sizeof(key)) n = sizeof(key) - 1;
+    int added;
+    uint32_t *id = intern(&dest_keys, key, n, &added);
+    if(added) {
+        *id = dests.count;
+        DestInfo *d = vec_push(&dests);
+        d->country = intern_string(country, clen);
+        d->host = intern_string(host, hlen);
+        d->runs = 0;
+    }
+    return *id;
+}
+
+static TrRun *start_run(uint32_t dest, uint32_t run_no) {
+    TrRun *r = vec_push(&runs);
+    memset(r, 0, sizeof(*r));
+    r->dest = dest;
+    r->run_no = run_no;
+    r->first_probe = probes.count;
+    ((DestInfo *)dests.data)[dest].runs++;
+    return r;
+}
+
+// Function to parse one hop line: "N  ip (geo)  rtt ms  rtt ms ip2 (geo)  rtt ms" with '*' for timeouts
+static void parse_hop(const char *p, const char *end, uint32_t hop) {
+    TrRun *run = &((TrRun *)runs.data)[runs.count - 1];
+    uint32_t ip = 0, geo = 0;
+    int have_ip = 0, probe = 0;
+    while(p < end) {
+        while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        if(p >= end) break;
+        if(*p == '*') {
+            TrProbe *pr = vec_push(&probes);
+            memset(pr, 0, sizeof(*pr));
+            pr->run = runs.count - 1;
+            pr->dest = run->dest;
+            pr->rtt_ms = NAN;
+            pr->hop = hop;
+            pr->probe = probe++;
+            p++;
+            continue;
+        }
+        if(*p == '(') {
+            const char *close = annotation_end(p, end);
+            geo = intern_geo(p + 1, close);
+            p = close + 1;
+            continue;
+        }
+        uint32_t addr;
+        size_t n = parse_ipv4(p, end, &addr);
+        if(n) {
+            ip = addr;
+            geo = 0;
+            have_ip = 1;
+            p += n;
+            continue;
+        }
+        double rtt;
+        n = parse_decimal(p, end, &rtt);
+        if(n && have_ip) {
+            p += n;
+            while(p < end && *p == ' ') p++;
+            if(end - p >= 2 && p[0] == 'm' && p[1] == 's') p += 2;
+            TrProbe *pr = vec_push(&probes);
+            pr->run = runs.count - 1;
+            pr->dest = run->dest;
+            pr->ip = ip;
+            pr->geo = geo;
+            pr->rtt_ms = rtt;
+            pr->hop = hop;
+            pr->probe = probe++;
+            pr->flags = TR_PROBE_REPLY | (ip == run->dest_ip ? TR_PROBE_DEST : 0);
+            continue;
+        }
+        // "!H" style annotations and anything unknown
+        while(p < end && *p != ' ') p++;
+    }
+    run->probe_count = probes.count - run->first_probe;
+    if(hop > run->hop_count) run->hop_count = hop;
+}
+
+// Function to parse a whole log held in memory
+static void parse_log(const char *p, const char *end) {
+    int run_open = 0;       // a run header was seen and its traceroute line not yet
+    while(p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        if(!eol) eol = end;
+        const char *s = p;
+        p = eol + 1;
+        while(s < eol && (*s == ' ' || *s == '\t')) s++;
+
+        if(eol - s > 7 && memcmp(s, "=======", 7) == 0) {
+            // "======= Country | host | Run N  ======="
+            s += 7;
+            while(s < eol && *s == ' ') s++;
+            const char *bar1 = memchr(s, '|', eol - s);
+            const char *bar2 = bar1 ? memchr(bar1 + 1, '|', eol - bar1 - 1) : NULL;
+            if(!bar2) continue;
+            const char *host = bar1 + 1;
+            while(*host == ' ') host++;
+            const char *host_end = bar2;
+            while(host_end > host && host_end[-1] == ' ') host_end--;
+            const char *country_end = bar1;
+            while(country_end > s && country_end[-1] == ' ') country_end--;
+            const char *r = find(bar2, eol, "Run");
+            double run_no = 0;
+            if(r) {
+                r += 3;
+                while(r < eol && *r == ' ') r++;
+                parse_decimal(r, eol, &run_no);
+            }
+            start_run(find_dest(s, country_end - s, host, host_end - host), (uint32_t)run_no);
+            run_open = 1;
+        } else if(eol - s > 14 && memcmp(s, "traceroute to ", 14) == 0) {
+            // "traceroute to host (ip (geo)), 30 hops max" starts the hops of the current run
+            const char *host = s + 14;
+            const char *host_end = memchr(host, ' ', eol - host);
+            if(!host_end) host_end = eol;
+            if(!run_open) {
+                // Plain traceroute output without our run headers
+                uint32_t dest = find_dest("", 0, host, host_end - host);
+                start_run(dest, ((DestInfo *)dests.data)[dest].runs + 1);
+            }
+            run_open = 0;
+            const char *paren = memchr(host_end, '(', eol - host_end);
+            uint32_t ip;
+            if(paren && parse_ipv4(paren + 1, eol, &ip)) ((TrRun *)runs.data)[runs.count - 1].dest_ip = ip;
+        } else if(s < eol && *s >= '0' && *s <= '9' && runs.count) {
+            double hop;
+            size_t n = parse_decimal(s, eol, &hop);
+            if(n && s + n < eol && (s[n] == ' ' || s[n] == '\t') && hop >= 1 && hop <= 255) {
+                parse_hop(s + n, eol, (uint32_t)hop);
+            }
+        }
+    }
+}
+
+static int cmp_dest_ids(const void *a, const void *b) {
+    const DestInfo *d = dests.data;
+    const DestInfo *x = &d[*(const uint32_t *)a], *y = &d[*(const uint32_t *)b];
+    int c = strcmp(strings.blob + x->host, strings.blob + y->host);
+    return c ? c : strcmp(strings.blob + x->country, strings.blob + y->country);
+}
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+// Function to write the table: destinations sorted by host, runs and probes grouped under them
+static int write_table(const char *path) {
+    uint32_t nd = dests.count;
+    const DestInfo *info = dests.data;
+    uint32_t *order = malloc(nd * sizeof(uint32_t) + 1), *rank = malloc(nd * sizeof(uint32_t) + 1);
+    TrDest *out_dests = calloc(nd + 1, sizeof(TrDest));
+    TrRun *out_runs = malloc(runs.count * sizeof(TrRun) + 1);
+    TrProbe *out_probes = malloc(probes.count * sizeof(TrProbe) + 1);
+    if(!order || !rank || !out_dests || !out_runs || !out_probes) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    for(uint32_t i = 0; i < nd; i++) order[i] = i;
+    qsort(order, nd, sizeof(uint32_t), cmp_dest_ids);
+    for(uint32_t i = 0; i < nd; i++) rank[order[i]] = i;
+
+    // Counting sort of the runs by destination rank keeps each destination's runs in log order
+    uint32_t next_run = 0;
+    for(uint32_t i = 0; i < nd; i++) {
+        out_dests[i].country = info[order[i]].country;
+        out_dests[i].host = info[order[i]].host;
+        out_dests[i].first_run = next_run;
+        next_run += info[order[i]].runs;
+    }
+    uint32_t *fill = calloc(nd + 1, sizeof(uint32_t));
+    if(!fill) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    const TrRun *in_runs = runs.data;
+    uint32_t *run_slot = malloc(runs.count * sizeof(uint32_t) + 1);
+    if(!run_slot) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    for(size_t i = 0; i < runs.count; i++) {
+        uint32_t d = rank[in_runs[i].dest];
+        run_slot[i] = out_dests[d].first_run + fill[d]++;
+    }
+    for(uint32_t i = 0; i < nd; i++) out_dests[i].run_count = info[order[i]].runs;
+
+    // Invert run_slot, then lay the probes out in output run order
+    uint32_t *src_run = malloc(runs.count * sizeof(uint32_t) + 1);
+    if(!src_run) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    for(size_t i = 0; i < runs.count; i++) src_run[run_slot[i]] = i;
+    const TrProbe *in_probes = probes.data;
+    uint32_t next_probe = 0;
+    for(size_t o = 0; o < runs.count; o++) {
+        const TrRun *r = &in_runs[src_run[o]];
+        uint32_t d = rank[r->dest];
+        if(out_dests[d].first_run == o) out_dests[d].first_probe = next_probe;
+        out_runs[o] = *r;
+        out_runs[o].dest = d;
+        out_runs[o].first_probe = next_probe;
+        for(uint32_t k = 0; k < r->probe_count; k++) {
+            TrProbe pr = in_probes[r->first_probe + k];
+            pr.run = o;
+            pr.dest = d;
+            out_probes[next_probe++] = pr;
+        }
+        out_dests[d].probe_count += r->probe_count;
+    }
+
+    TrHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TR_MAGIC, 8);
+    h.version = TR_VERSION;
+    h.dest_count = nd;
+    h.run_count = runs.count;
+    h.probe_count = probes.count;
+    h.geo_count = geos.count;
+    h.dest_off = align8(sizeof(h));
+    h.run_off = align8(h.dest_off + nd * sizeof(TrDest));
+    h.probe_off = align8(h.run_off + runs.count * sizeof(TrRun));
+    h.geo_off = align8(h.probe_off + probes.count * sizeof(TrProbe));
+    h.str_off = align8(h.geo_off + geos.count * sizeof(TrGeo));
+    h.str_size = strings.used;
+
+    FILE *f = fopen(path, "wb");
+    if(!f) {
+        perror(path);
+        return -1;
+    }
+    static const char zeros[8];
+    size_t pos = 0;
+#define PUT(ptr, len) do { size_t n = (len); if(n && fwrite(ptr, 1, n, f) != n) goto fail; pos += n; } while(0)
+#define PAD(to) do { size_t pad = (to) - pos; PUT(zeros, pad); } while(0)
+    PUT(&h, sizeof(h));
+    PAD(h.dest_off);
+    PUT(out_dests, nd * sizeof(TrDest));
+    PAD(h.run_off);
+    PUT(out_runs, runs.count * sizeof(TrRun));
+    PAD(h.probe_off);
+    PUT(out_probes, probes.count * sizeof(TrProbe));
+    PAD(h.geo_off);
+    PUT(geos.data, geos.count * sizeof(TrGeo));
+    PAD(h.str_off);
+    PUT(strings.blob, strings.used);
+#undef PUT
+#undef PAD
+    if(fclose(f) != 0) {
+        perror(path);
+        return -1;
+    }
+    free(order);
+    free(rank);
+    free(fill);
+    free(run_slot);
+    free(src_run);
+    free(out_dests);
+    free(out_runs);
+    free(out_probes);
+    return 0;
+fail:
+    perror("Write failed");
+    fclose(f);
+    return -1;
+}
+
+// Function to build a table from log files
+static int build(const char *out, char **files, int count) {
+    intern_init(&strings);
+    intern_init(&geo_keys);
+    intern_init(&dest_keys);
+    TrGeo *none = vec_push(&geos);      // geo 0: no annotation
+    memset(none, 0, sizeof(*none));
+    none->lat = none->lon = NAN;
+
+    size_t bytes = 0;
+    for(int i = 0; i < count; i++) {
+        int fd = open(files[i], O_RDONLY);
+        if(fd < 0) {
+            perror(files[i]);
+            return 1;
+        }
+        struct stat st;
+        if(fstat(fd, &st) < 0) {
+            perror(files[i]);
+            close(fd);
+            return 1;
+        }
+        if(!S_ISREG(st.st_mode)) {
+            // Pipe or <(...): no size to map, read it all instead
+            size_t len = 0, cap = 1 << 16;
+            char *buf = malloc(cap);
+            ssize_t got;
+            while(buf && (got = read(fd, buf + len, cap - len)) != 0) {
+                if(got < 0) {
+                    perror(files[i]);
+                    return 1;
+                }
+                len += got;
+                if(len == cap) buf = realloc(buf, cap *= 2);
+            }
+            close(fd);
+            if(!buf) {
+                perror("Memory allocation failed");
+                return 1;
+            }
+            parse_log(buf, buf + len);
+            free(buf);
+            bytes += len;
+            continue;
+        }
+        if(st.st_size == 0) {
+            close(fd);
+            continue;
+        }
+        const char *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(p == MAP_FAILED) {
+            perror("mmap failed");
+            return 1;
+        }
+        madvise((void *)p, st.st_size, MADV_SEQUENTIAL);
+        parse_log(p, p + st.st_size);
+        munmap((void *)p, st.st_size);
+        bytes += st.st_size;
+    }
+    if(write_table(out) < 0) return 1;
+    printf("%zu bytes -> %s: %zu destinations, %zu runs, %zu probes, %zu geo annotations\n",
+           bytes, out, dests.count, runs.count, probes.count, geos.count - 1);
+    return 0;
+}
+
+// Per-router RTT accumulator for -s
+typedef struct {
+    uint32_t ip;
+    uint32_t count;
+    double sum, sumsq;
+} RouterStats;
+
+static int cmp_router_std(const void *a, const void *b) {
+    const RouterStats *x = a, *y = b;
+    double vx = x->sumsq / x->count - (x->sum / x->count) * (x->sum / x->count);
+    double vy = y->sumsq / y->count - (y->sum / y->count) * (y->sum / y->count);
+    return (vy > vx) - (vy < vx);
+}
+
+// Function to print 1(a)/1(b) straight from the table
+static int print_stats(const char *path) {
+    TrTable t;
+    if(tr_open(path, &t) < 0) return 1;
+    size_t cap = 1024, count = 0, replies = 0;
+    RouterStats *stats = calloc(cap, sizeof(RouterStats));
+    uint32_t *slots = calloc(cap * 2, sizeof(uint32_t));    // ip hash -> index + 1
+    if(!stats || !slots) {
+        perror("Memory allocation failed");
+        return 1;
+    }
+    for(uint32_t i = 0; i < t.hdr->probe_count; i++) {
+        const TrProbe *pr = &t.probes[i];
+        if(!(pr->flags & TR_PROBE_REPLY)) continue;
+        replies++;
+        size_t mask = cap * 2 - 1, slot = (pr->ip * 2654435761u) & mask;
+        while(slots[slot] && stats[slots[slot] - 1].ip != pr->ip) slot = (slot + 1) & mask;
+        if(!slots[slot]) {
+            if(count == cap) {
+                // Grow and rehash
+                cap *= 2;
+                stats = realloc(stats, cap * sizeof(RouterStats));
+                free(slots);
+                slots = calloc(cap * 2, sizeof(uint32_t));
+                if(!stats || !slots) {
+                    perror("Memory allocation failed");
+                    return 1;
+                }
+                mask = cap * 2 - 1;
+                for(size_t k = 0; k < count; k++) {
+                    size_t s = (stats[k].ip * 2654435761u) & mask;
+                    while(slots[s]) s = (s + 1) & mask;
+                    slots[s] = k + 1;
+                }
+                slot = (pr->ip * 2654435761u) & mask;
+                while(slots[slot]) slot = (slot + 1) & mask;
+            }
+            stats[count] = (RouterStats){pr->ip, 0, 0, 0};
+            slots[slot] = ++count;
+        }
+        RouterStats *rs = &stats[slots[slot] - 1];
+        rs->count++;
+        rs->sum += pr->rtt_ms;
+        rs->sumsq += (double)pr->rtt_ms * pr->rtt_ms;
+    }
+
+    printf("Destinations: %u, runs: %u, probes: %u\n", t.hdr->dest_count, t.hdr->run_count, t.hdr->probe_count);
+    printf("Total valid RTT entries: %zu\n", replies);
+    printf("Number of unique router IPs: %zu\n", count);
+    qsort(stats, count, sizeof(RouterStats), cmp_router_std);
+    printf("\nTop 5 routers by RTT standard deviation:\n");
+    printf("%-16s | %-14s | %-20s | %-17s\n", "Router IP", "Average RTT", "Standard Deviation", "Measurement Count");
+    for(size_t i = 0; i < count && i < 5; i++) {
+        char buf[16];
+        double mean = stats[i].sum / stats[i].count;
+        double var = stats[i].sumsq / stats[i].count - mean * mean;
+        printf("%-16s | %11.2f ms | %17.2f ms | %17u\n", tr_ip(stats[i].ip, buf), mean, sqrt(var > 0 ? var : 0),
+               stats[i].count);
+    }
+    free(stats);
+    free(slots);
+    tr_close(&t);
+    return 0;
+}
+
+// Function to print every run of one destination, found through the index
+static int print_dest(const char *path, const char *host) {
+    TrTable t;
+    if(tr_open(path, &t) < 0) return 1;
+    const TrDest *d = tr_find_dest(&t, host);
+    if(!d) {
+        fprintf(stderr, "%s: no destination %s\n", path, host);
+        tr_close(&t);
+        return 1;
+    }
+    for(uint32_t r = d->first_run; r < d->first_run + d->run_count; r++) {
+        const TrRun *run = &t.runs[r];
+        char buf[16];
+        printf("%s | %s | Run %u -> %s, %u hops\n", tr_str(&t, d->country), tr_str(&t, d->host), run->run_no,
+               tr_ip(run->dest_ip, buf), run->hop_count);
+        uint32_t last_hop = 0;
+        for(uint32_t i = run->first_probe; i < run->first_probe + run->probe_count; i++) {
+            const TrProbe *pr = &t.probes[i];
+            if(pr->hop != last_hop) printf("%s%2u ", last_hop ? "\n" : "", pr->hop);
+            last_hop = pr->hop;
+            if(!(pr->flags & TR_PROBE_REPLY)) {
+                printf(" *");
+                continue;
+            }
+            const TrGeo *g = &t.geos[pr->geo];
+            if(g->flags & TR_GEO_LOCAL) printf(" %s [local] %.3f ms", tr_ip(pr->ip, buf), pr->rtt_ms);
+            else printf(" %s [%s, %s, AS%u] %.3f ms", tr_ip(pr->ip, buf), tr_str(&t, g->city), tr_str(&t, g->country),
+                        g->asn, pr->rtt_ms);
+        }
+        printf("\n");
+    }
+    tr_close(&t);
+    return 0;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-o table.trt] traceroute_log.txt...\n", prog);
+    fprintf(stderr, "       %s -s table.trt\n", prog);
+    fprintf(stderr, "       %s -d <host> table.trt\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *out = "traceroute.trt", *host = NULL;
+    int stats = 0, opt;
+    while((opt = getopt(argc, argv, "o:sd:")) != -1) {
+        switch(opt) {
+        case 'o': out = optarg; break;
+        case 's': stats = 1; break;
+        case 'd': host = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if(optind >= argc) usage(argv[0]);
+    if(stats) return print_stats(argv[optind]);
+    if(host) return print_dest(argv[optind], host);
+    return build(out, argv + optind, argc - optind);
+}
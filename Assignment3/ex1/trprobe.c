@@ -0,0 +1,472 @@
+/*
+ * trprobe: parallel Paris-style traceroute, writing traceroute_log.txt.
+ *
+ * Replaces the get_traces.ipynb / traceroute_CS3205.sh loop: all targets of
+ * a run are probed at once from one raw socket, and ICMP replies are matched
+ * back to their probe through an in-memory table instead of one traceroute
+ * process per destination.
+ *
+ * Probes are 60-byte UDP datagrams with a hand-built IP header. As in Paris
+ * traceroute the flow identifier (addresses, ports) stays constant for every
+ * probe to a destination, so per-flow load balancers keep them on one path;
+ * the probe number travels in the UDP checksum (the payload is adjusted to
+ * produce it) and comes back in the quoted header of the ICMP reply. With -V
+ * the destination port changes on every probe like classic traceroute, which
+ * exposes per-flow balancing as well.
+ *
+ * The source port identifies the destination (base + index) and the
+ * checksum the run, TTL and probe, so late replies from an earlier run are
+ * never mistaken for current ones.
+ *
+ * Hops are annotated offline from a geodb index (-g geo.db) instead of one
+ * ipinfo request per hop; without it public addresses get the script's
+ * empty annotation.
+ *
+ * Build: gcc -O2 -Wall -o trprobe trprobe.c -lm
+ * Usage: trprobe [-r runs] [-m max_ttl] [-q probes] [-w wait_ms] [-N window] [-R pps] [-p sport]
+ *                [-V] [-g geo.db] [-o traceroute_log.txt] (-t targets.txt | Country=host...)
+ *        targets.txt holds one "Country,host" per line. Needs root (raw sockets).
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include "geodb.h"
+
+#define MAX_TARGETS 4096
+#define MAX_TTL 64
+#define MAX_PROBES 10               // per hop
+#define PROBE_SIZE 60               // IP + UDP + payload, as traceroute's default
+#define DEST_PORT 33434
+#define SLOT_BITS 10                // checksum = (run % 63) << SLOT_BITS | probe slot
+
+typedef struct {
+    int64_t sent_us;                // 0 = not sent
+    int64_t rtt_us;                 // -1 = no reply
+    uint32_t from;                  // replying address (network order)
+    char flag[4];                   // "!H" style annotation, "" if none
+} Probe;
+
+typedef struct {
+    char country[64];
+    char host[256];
+    struct in_addr addr, src;       // destination and the source address the route picks
+    int resolved;
+    // Per-run state
+    Probe probes[MAX_TTL + 1][MAX_PROBES];
+    int next_ttl, next_probe;
+    int stop_ttl;                   // last hop to report (destination or unreachable reached)
+    int settled_ttl;                // every probe up to here answered or timed out
+    // Log text of every run so far
+    char *log;
+    size_t log_len, log_cap;
+} Target;
+
+Target *targets;
+int target_count = 0;
+int runs = 10, max_ttl = 30, probes_per_hop = 3, wait_ms = 3000, window = 16, rate = 500;
+int base_sport = 50000, vary_flow = 0;
+GeoDb geo;
+int have_geo = 0;
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Function to append formatted text to a target's log
+static void log_printf(Target *t, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void log_printf(Target *t, const char *fmt, ...) {
+    va_list ap;
+    for(;;) {
+        va_start(ap, fmt);
+        int n = vsnprintf(t->log + t->log_len, t->log_cap - t->log_len, fmt, ap);
+        va_end(ap);
+        if(n < 0) return;
+        if(t->log_len + n < t->log_cap) {
+            t->log_len += n;
+            return;
+        }
+        t->log_cap = (t->log_cap + n + 1) * 2;
+        t->log = realloc(t->log, t->log_cap);
+        if(!t->log) {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+    }
+}
+
+// Function to annotate an address the way traceroute_CS3205.sh does
+static const char *annotate(struct in_addr addr) {
+    uint32_t ip = ntohl(addr.s_addr);
+    if((ip >> 24) == 10 || (ip >> 16) == (192 << 8 | 168) || (ip >> 20) == (172 << 4 | 1) || (ip >> 24) == 255) {
+        return "(Local / IIT Madras / Reserved)";
+    }
+    static char buf[512];
+    return geo_format(&geo, have_geo ? geo_lookup(&geo, ip) : NULL, buf, sizeof(buf));
+}
+
+static uint16_t checksum_fold(uint32_t sum) {
+    while(sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    return sum;
+}
+
+static uint32_t checksum_add(uint32_t sum, const void *data, size_t len) {
+    const uint8_t *p = data;
+    for(size_t i = 0; i + 1 < len; i += 2) sum += p[i] << 8 | p[i + 1];
+    if(len & 1) sum += p[len - 1] << 8;
+    return sum;
+}
+
+// Function to build a probe whose UDP checksum equals `id` (Paris traceroute)
+static void build_probe(uint8_t *pkt, const Target *t, int ttl, uint16_t sport, uint16_t dport, uint16_t id) {
+    memset(pkt, 0, PROBE_SIZE);
+    struct iphdr *ip = (struct iphdr *)pkt;
+    struct udphdr *udp = (struct udphdr *)(pkt + sizeof(*ip));
+    uint8_t *payload = pkt + sizeof(*ip) + sizeof(*udp);
+    ip->version = 4;
+    ip->ihl = 5;
+    ip->tot_len = htons(PROBE_SIZE);
+    ip->id = htons(id);
+    ip->ttl = ttl;
+    ip->protocol = IPPROTO_UDP;
+    ip->saddr = t->src.s_addr;
+    ip->daddr = t->addr.s_addr;     // the kernel fills in the IP checksum
+    udp->source = htons(sport);
+    udp->dest = htons(dport);
+    udp->len = htons(PROBE_SIZE - sizeof(*ip));
+
+    // Sum of everything except the first payload word, then pick that word so the
+    // complemented total comes out as id
+    uint32_t sum = 0;
+    sum = checksum_add(sum, &ip->saddr, 4);
+    sum = checksum_add(sum, &ip->daddr, 4);
+    sum += IPPROTO_UDP + (PROBE_SIZE - sizeof(*ip));
+    sum = checksum_add(sum, udp, sizeof(*udp));
+    uint16_t partial = checksum_fold(sum);
+    uint16_t word = checksum_fold((uint32_t)(uint16_t)~id + (uint16_t)~partial);
+    payload[0] = word >> 8;
+    payload[1] = word & 0xff;
+    udp->check = htons(id);
+}
+
+// Function to send the next probe of a target
+static void send_probe(int sock, Target *t, int index, int run) {
+    int ttl = t->next_ttl, q = t->next_probe;
+    int slot = (ttl - 1) * probes_per_hop + q + 1;
+    uint16_t id = (run % 63) << SLOT_BITS | slot;      // never 0 or 0xffff
+    uint16_t dport = vary_flow ? DEST_PORT + slot : DEST_PORT;
+    uint8_t pkt[PROBE_SIZE];
+    build_probe(pkt, t, ttl, base_sport + index, dport, id);
+
+    struct sockaddr_in to = {0};
+    to.sin_family = AF_INET;
+    to.sin_addr = t->addr;
+    Probe *p = &t->probes[ttl][q];
+    p->sent_us = now_us();
+    if(sendto(sock, pkt, sizeof(pkt), 0, (struct sockaddr *)&to, sizeof(to)) < 0) {
+        perror("sendto failed");
+        p->sent_us = -1;            // counts as timed out
+    }
+    if(++t->next_probe == probes_per_hop) {
+        t->next_probe = 0;
+        t->next_ttl++;
+    }
+}
+
+static const char *unreach_flag(int code) {
+    switch(code) {
+    case ICMP_NET_UNREACH: return "!N";
+    case ICMP_HOST_UNREACH: return "!H";
+    case ICMP_PROT_UNREACH: return "!P";
+    case ICMP_FRAG_NEEDED: return "!F";
+    case ICMP_SR_FAILED: return "!S";
+    case ICMP_NET_ANO: case ICMP_HOST_ANO: case ICMP_PKT_FILTERED: return "!X";
+    }
+    return "!?";
+}
+
+// Function to match one ICMP reply against the probe table
+static void handle_reply(const uint8_t *buf, ssize_t len, struct in_addr from, int run, int64_t now) {
+    if(len < (ssize_t)sizeof(struct iphdr)) return;
+    const struct iphdr *outer = (const struct iphdr *)buf;
+    size_t off = outer->ihl * 4;
+    if(len < (ssize_t)(off + 8 + sizeof(struct iphdr) + 8)) return;
+    const struct icmphdr *icmp = (const struct icmphdr *)(buf + off);
+    if(icmp->type != ICMP_TIME_EXCEEDED && icmp->type != ICMP_DEST_UNREACH) return;
+    const struct iphdr *inner = (const struct iphdr *)(buf + off + 8);
+    if(inner->protocol != IPPROTO_UDP || len < (ssize_t)(off + 8 + inner->ihl * 4 + 8)) return;
+    const struct udphdr *udp = (const struct udphdr *)(buf + off + 8 + inner->ihl * 4);
+
+    int index = ntohs(udp->source) - base_sport;
+    if(index < 0 || index >= target_count || targets[index].addr.s_addr != inner->daddr) return;
+    uint16_t id = ntohs(udp->check);
+    int slot = id & ((1 << SLOT_BITS) - 1);
+    if((id >> SLOT_BITS) != run % 63 || slot < 1 || slot > max_ttl * probes_per_hop) return;
+    Target *t = &targets[index];
+    int ttl = (slot - 1) / probes_per_hop + 1, q = (slot - 1) % probes_per_hop;
+    Probe *p = &t->probes[ttl][q];
+    if(p->sent_us <= 0 || p->rtt_us >= 0) return;       // not ours, or a duplicate
+
+    p->rtt_us = now - p->sent_us;
+    p->from = from.s_addr;
+    int reached = from.s_addr == t->addr.s_addr;
+    if(icmp->type == ICMP_DEST_UNREACH) {
+        if(icmp->code != ICMP_PORT_UNREACH) snprintf(p->flag, sizeof(p->flag), "%s", unreach_flag(icmp->code));
+        reached = 1;
+    }
+    if(reached && ttl < t->stop_ttl) t->stop_ttl = ttl;
+}
+
+// Function to move settled_ttl past hops whose probes are all answered or expired
+static void settle(Target *t, int64_t now) {
+    while(t->settled_ttl < t->stop_ttl) {
+        int ttl = t->settled_ttl + 1;
+        if(ttl >= t->next_ttl) return;      // not all sent yet
+        for(int q = 0; q < probes_per_hop; q++) {
+            Probe *p = &t->probes[ttl][q];
+            if(p->rtt_us < 0 && p->sent_us > 0 && now - p->sent_us < (int64_t)wait_ms * 1000) return;
+        }
+        t->settled_ttl = ttl;
+    }
+}
+
+// Function to write one run of a target in traceroute -n format, annotated like the script
+static void format_run(Target *t, int run) {
+    log_printf(t, "\n\n======= %s | %s | Run %d  =======\n", t->country, t->host, run);
+    log_printf(t, "Traceroute to %s\n", t->host);
+    log_printf(t, "--------------------------------------------------------------\n");
+    if(!t->resolved) return;
+    log_printf(t, "traceroute to %s (%s %s), %d hops max, %d byte packets\n", t->host, inet_ntoa(t->addr),
+               annotate(t->addr), max_ttl, PROBE_SIZE);
+    for(int ttl = 1; ttl <= t->stop_ttl; ttl++) {
+        log_printf(t, "%d ", ttl);
+        uint32_t last = 0;
+        for(int q = 0; q < probes_per_hop; q++) {
+            Probe *p = &t->probes[ttl][q];
+            if(p->rtt_us < 0) {
+                log_printf(t, " *");
+                continue;
+            }
+            if(p->from != last) {
+                struct in_addr a = {p->from};
+                log_printf(t, " %s %s", inet_ntoa(a), annotate(a));
+                last = p->from;
+            }
+            log_printf(t, "  %.3f ms", p->rtt_us / 1000.0);
+            if(p->flag[0]) log_printf(t, " %s", p->flag);
+        }
+        log_printf(t, "\n");
+    }
+}
+
+// Function to trace every target once, all at the same time
+static void trace_run(int send_sock, int icmp_sock, int run) {
+    for(int i = 0; i < target_count; i++) {
+        Target *t = &targets[i];
+        for(int ttl = 0; ttl <= MAX_TTL; ttl++) {
+            for(int q = 0; q < MAX_PROBES; q++) t->probes[ttl][q] = (Probe){0, -1, 0, ""};
+        }
+        t->next_ttl = 1;
+        t->next_probe = 0;
+        t->stop_ttl = max_ttl;
+        t->settled_ttl = t->resolved ? 0 : max_ttl;
+    }
+
+    int64_t gap_us = 1000000 / rate, next_send = now_us();
+    int cursor = 0;
+    for(;;) {
+        int64_t now = now_us();
+        int busy = 0, sendable = 0;
+        for(int i = 0; i < target_count; i++) {
+            settle(&targets[i], now);
+            if(targets[i].settled_ttl < targets[i].stop_ttl) busy = 1;
+        }
+        if(!busy) break;
+
+        // Send at most one probe per gap, round-robin over targets with room in their window
+        if(now >= next_send) {
+            for(int k = 0; k < target_count; k++) {
+                int i = (cursor + k) % target_count;
+                Target *t = &targets[i];
+                if(t->next_ttl <= t->stop_ttl && t->next_ttl <= t->settled_ttl + window) {
+                    send_probe(send_sock, t, i, run);
+                    cursor = i + 1;
+                    sendable = 1;
+                    break;
+                }
+            }
+            next_send = sendable ? (next_send + gap_us > now ? next_send + gap_us : now + gap_us) : now + 1000;
+        }
+
+        int timeout = (int)((next_send - now_us()) / 1000);
+        struct pollfd pfd = {icmp_sock, POLLIN, 0};
+        if(poll(&pfd, 1, timeout > 0 ? timeout : 0) > 0) {
+            uint8_t buf[1500];
+            struct sockaddr_in from;
+            socklen_t flen = sizeof(from);
+            ssize_t len;
+            while((len = recvfrom(icmp_sock, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &flen)) > 0) {
+                handle_reply(buf, len, from.sin_addr, run, now_us());
+                flen = sizeof(from);
+            }
+        }
+    }
+    for(int i = 0; i < target_count; i++) format_run(&targets[i], run);
+}
+
+// Function to add a target ("Country=host", "Country,host" or just a host)
+static void add_target(const char *spec) {
+    if(target_count == MAX_TARGETS) {
+        fprintf(stderr, "Too many targets (max %d)\n", MAX_TARGETS);
+        exit(1);
+    }
+    Target *t = &targets[target_count];
+    const char *sep = strpbrk(spec, "=,");
+    if(sep) {
+        snprintf(t->country, sizeof(t->country), "%.*s", (int)(sep - spec), spec);
+        spec = sep + 1;
+    }
+    while(*spec == ' ') spec++;
+    snprintf(t->host, sizeof(t->host), "%s", spec);
+    t->host[strcspn(t->host, " \r\n")] = 0;
+    if(!t->host[0]) return;
+    if(!sep) snprintf(t->country, sizeof(t->country), "%.63s", t->host);
+    target_count++;
+}
+
+static void load_targets(const char *path) {
+    FILE *f = fopen(path, "r");
+    if(!f) {
+        perror(path);
+        exit(1);
+    }
+    char line[512];
+    while(fgets(line, sizeof(line), f)) {
+        if(line[0] == '#' || line[0] == '\n') continue;
+        add_target(line);
+    }
+    fclose(f);
+}
+
+// Function to resolve a target and find the source address its route uses
+static void resolve_target(Target *t) {
+    struct addrinfo hints = {0}, *res;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    int err = getaddrinfo(t->host, NULL, &hints, &res);
+    if(err) {
+        fprintf(stderr, "%s: %s\n", t->host, gai_strerror(err));
+        return;
+    }
+    t->addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+    freeaddrinfo(res);
+
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in sa = {0};
+    sa.sin_family = AF_INET;
+    sa.sin_addr = t->addr;
+    sa.sin_port = htons(DEST_PORT);
+    socklen_t len = sizeof(sa);
+    if(s < 0 || connect(s, (struct sockaddr *)&sa, sizeof(sa)) < 0 || getsockname(s, (struct sockaddr *)&sa, &len) < 0) {
+        perror(t->host);
+        if(s >= 0) close(s);
+        return;
+    }
+    close(s);
+    t->src = sa.sin_addr;
+    t->resolved = 1;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-r runs] [-m max_ttl] [-q probes] [-w wait_ms] [-N window] [-R pps] [-p sport]\n"
+                    "       [-V] [-g geo.db] [-o traceroute_log.txt] (-t targets.txt | Country=host...)\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = "traceroute_log.txt", *targets_path = NULL;
+    int opt;
+    targets = calloc(MAX_TARGETS, sizeof(Target));
+    if(!targets) {
+        perror("Memory allocation failed");
+        return 1;
+    }
+    while((opt = getopt(argc, argv, "r:m:q:w:N:R:p:Vg:o:t:")) != -1) {
+        switch(opt) {
+        case 'r': runs = atoi(optarg); break;
+        case 'm': max_ttl = atoi(optarg); break;
+        case 'q': probes_per_hop = atoi(optarg); break;
+        case 'w': wait_ms = atoi(optarg); break;
+        case 'N': window = atoi(optarg); break;
+        case 'R': rate = atoi(optarg); break;
+        case 'p': base_sport = atoi(optarg); break;
+        case 'V': vary_flow = 1; break;
+        case 'g':
+            if(geo_open(optarg, &geo) < 0) return 1;
+            have_geo = 1;
+            break;
+        case 'o': out_path = optarg; break;
+        case 't': targets_path = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if(targets_path) load_targets(targets_path);
+    for(int i = optind; i < argc; i++) add_target(argv[i]);
+    if(target_count == 0) usage(argv[0]);
+    if(max_ttl < 1 || max_ttl > MAX_TTL || probes_per_hop < 1 || probes_per_hop > MAX_PROBES ||
+       max_ttl * probes_per_hop >= 1 << SLOT_BITS || runs < 1 || window < 1 || rate < 1 || wait_ms < 1 ||
+       base_sport < 1024 || base_sport + target_count > 65535) {
+        fprintf(stderr, "Invalid options\n");
+        return 1;
+    }
+
+    int send_sock = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);     // implies IP_HDRINCL
+    int icmp_sock = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    if(send_sock < 0 || icmp_sock < 0) {
+        perror("Raw socket creation failed (needs root or CAP_NET_RAW)");
+        return 1;
+    }
+    int rcvbuf = 4 << 20;
+    setsockopt(icmp_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    for(int i = 0; i < target_count; i++) resolve_target(&targets[i]);
+
+    for(int run = 1; run <= runs; run++) {
+        int64_t start = now_us();
+        trace_run(send_sock, icmp_sock, run);
+        printf("Run %d: %d targets traced in %.2f s\n", run, target_count, (now_us() - start) / 1e6);
+    }
+
+    // Same layout as get_traces.ipynb: every run of a target together, targets in input order
+    FILE *f = fopen(out_path, "w");
+    if(!f) {
+        perror(out_path);
+        return 1;
+    }
+    for(int i = 0; i < target_count; i++) {
+        fwrite(targets[i].log, 1, targets[i].log_len, f);
+        free(targets[i].log);
+    }
+    fclose(f);
+    printf("All traceroutes completed. Logs saved to %s\n", out_path);
+    close(send_sock);
+    close(icmp_sock);
+    if(have_geo) geo_close(&geo);
+    free(targets);
+    return 0;
+}
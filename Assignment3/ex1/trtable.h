@@ -0,0 +1,188 @@
+/*
+ * trtable.h: binary traceroute table shared by the Assignment 3 tools.
+ *
+ * trparse turns traceroute_log.txt into one file holding, after a header:
+ *
+ *   dests   TrDest[dest_count]    sorted by host, each owning a contiguous
+ *                                 range of runs and of probes (the index)
+ *   runs    TrRun[run_count]      grouped by destination, in run order
+ *   probes  TrProbe[probe_count]  one row per probe, in run/hop/probe order
+ *   geos    TrGeo[geo_count]      interned annotations, geo 0 = none
+ *   strings NUL-terminated,       offset 0 = ""
+ *
+ * Every section is 8-byte aligned and the file is used in place: tr_open
+ * maps it and checks the layout, nothing is parsed or copied.
+ */
+
+#ifndef TRTABLE_H
+#define TRTABLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TR_MAGIC "TRTABLE1"
+#define TR_VERSION 1
+
+#define TR_GEO_LOCAL 1      // "(Local / IIT Madras / Reserved)"
+#define TR_GEO_HAS_LOC 2    // lat/lon present
+
+#define TR_PROBE_REPLY 1    // 0 for a '*' (ip, geo and rtt unset)
+#define TR_PROBE_DEST 2     // reply came from the destination address
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t dest_count, run_count, probe_count, geo_count;
+    uint32_t reserved;
+    uint64_t dest_off, run_off, probe_off, geo_off, str_off, str_size;
+} TrHeader;
+
+typedef struct {
+    uint32_t country, host;         // string offsets
+    uint32_t first_run, run_count;
+    uint32_t first_probe, probe_count;
+} TrDest;
+
+typedef struct {
+    uint32_t dest;
+    uint32_t run_no;                // "Run N" from the log header
+    uint32_t dest_ip;               // resolved address, host byte order
+    uint32_t first_probe, probe_count;
+    uint16_t hop_count;
+    uint16_t reserved;
+} TrRun;
+
+typedef struct {
+    uint32_t run, dest;
+    uint32_t ip;                    // host byte order
+    uint32_t geo;
+    float rtt_ms;
+    uint8_t hop, probe;             // hop from 1, probe from 0
+    uint16_t flags;
+} TrProbe;
+
+typedef struct {
+    uint32_t city, country, org;    // string offsets, org without the AS number
+    uint32_t asn;
+    float lat, lon;
+    uint32_t flags;
+} TrGeo;
+
+typedef struct {
+    const TrHeader *hdr;
+    const TrDest *dests;
+    const TrRun *runs;
+    const TrProbe *probes;
+    const TrGeo *geos;
+    const char *strings;
+    size_t size;
+} TrTable;
+
+static inline const char *tr_str(const TrTable *t, uint32_t off) {
+    return off < t->hdr->str_size ? t->strings + off : "";
+}
+
+// Function to format a host-order IPv4 address
+static inline const char *tr_ip(uint32_t ip, char buf[16]) {
+    snprintf(buf, 16, "%u.%u.%u.%u", ip >> 24, (ip >> 16) & 255, (ip >> 8) & 255, ip & 255);
+    return buf;
+}
+
+// Function to find a destination by host name (binary search over the index)
+static inline const TrDest *tr_find_dest(const TrTable *t, const char *host) {
+    uint32_t lo = 0, hi = t->hdr->dest_count;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        int c = strcmp(tr_str(t, t->dests[mid].host), host);
+        if(c == 0) return &t->dests[mid];
+        if(c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+static inline uint64_t tr_hash_bytes(uint64_t h, const void *p, size_t n) {
+    for(size_t i = 0; i < n; i++) h = (h ^ ((const uint8_t *)p)[i]) * 0x100000001b3ull;
+    return h;
+}
+
+// Function to key a run by what it measured: destination, run number and every probe row
+// (hop, probe, address, RTT). Each measurement batch restarts at "Run 1", so the run number
+// alone cannot tell a new batch from one already folded in; a table re-parsed from a grown
+// log still gives the same key for the same run.
+static inline uint64_t tr_run_key(const TrTable *t, const TrRun *run) {
+    const TrDest *d = &t->dests[run->dest];
+    const char *country = tr_str(t, d->country), *host = tr_str(t, d->host);
+    uint64_t h = tr_hash_bytes(0xcbf29ce484222325ull, country, strlen(country) + 1);
+    h = tr_hash_bytes(h, host, strlen(host) + 1);
+    h = tr_hash_bytes(h, &run->run_no, sizeof(run->run_no));
+    h = tr_hash_bytes(h, &run->dest_ip, sizeof(run->dest_ip));
+    for(uint32_t k = run->first_probe; k < (uint64_t)run->first_probe + run->probe_count && k < t->hdr->probe_count; k++) {
+        const TrProbe *p = &t->probes[k];
+        uint32_t rtt;
+        memcpy(&rtt, &p->rtt_ms, sizeof(rtt));
+        uint32_t row[3] = {(uint32_t)p->hop << 16 | (uint32_t)p->probe << 8 | p->flags, p->ip, rtt};
+        h = tr_hash_bytes(h, row, sizeof(row));
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    return h ^ h >> 33;
+}
+
+static inline int tr_section_ok(uint64_t off, uint64_t count, size_t elem, size_t size) {
+    return off % 8 == 0 && off <= size && count <= (size - off) / elem;
+}
+
+// Function to map a table file. Returns 0 on success, -1 (with a message) otherwise.
+static inline int tr_open(const char *path, TrTable *t) {
+    memset(t, 0, sizeof(*t));
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(TrHeader)) {
+        fprintf(stderr, "%s: not a traceroute table\n", path);
+        close(fd);
+        return -1;
+    }
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        perror("mmap failed");
+        return -1;
+    }
+    const TrHeader *h = p;
+    size_t size = st.st_size;
+    if(memcmp(h->magic, TR_MAGIC, 8) != 0 || h->version != TR_VERSION ||
+       !tr_section_ok(h->dest_off, h->dest_count, sizeof(TrDest), size) ||
+       !tr_section_ok(h->run_off, h->run_count, sizeof(TrRun), size) ||
+       !tr_section_ok(h->probe_off, h->probe_count, sizeof(TrProbe), size) ||
+       !tr_section_ok(h->geo_off, h->geo_count, sizeof(TrGeo), size) ||
+       !tr_section_ok(h->str_off, h->str_size, 1, size) || h->geo_count == 0 || h->str_size == 0) {
+        fprintf(stderr, "%s: not a traceroute table (or truncated)\n", path);
+        munmap(p, size);
+        return -1;
+    }
+    t->hdr = h;
+    t->dests = (const TrDest *)((const char *)p + h->dest_off);
+    t->runs = (const TrRun *)((const char *)p + h->run_off);
+    t->probes = (const TrProbe *)((const char *)p + h->probe_off);
+    t->geos = (const TrGeo *)((const char *)p + h->geo_off);
+    t->strings = (const char *)p + h->str_off;
+    t->size = size;
+    return 0;
+}
+
+static inline void tr_close(TrTable *t) {
+    if(t->hdr) munmap((void *)t->hdr, t->size);
+    memset(t, 0, sizeof(*t));
+}
+
+#endif
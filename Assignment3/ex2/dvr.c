@@ -0,0 +1,438 @@
+/*
+ * dvr: distance-vector routing in synchronous rounds over a CSR topology.
+ *
+ * The DVR option of ex2 (vector exchanges, convergence rounds). Every
+ * router holds a distance and next hop to every destination. In each round
+ * a router reads the vectors its neighbours changed in the previous round
+ * and updates its own table (Bellman-Ford); routers are split across
+ * threads, which read one copy of all tables and write the other, so a
+ * round needs no locks, only a barrier. Only changed entries travel: a
+ * router whose table did not change sends nothing.
+ *
+ * Loop avoidance (-m):
+ *   none    every route is advertised to every neighbour
+ *   split   split horizon: a route is not advertised back to its next hop
+ *   poison  poison reverse: it is, as unreachable
+ * Rounds here have no timers, so an omitted route counts as withdrawn and
+ * both schemes pick the same routes; they differ in entries sent. Neither
+ * prevents loops of three or more routers, which is what -I (isolate a
+ * router) and -F / -f (fail links after convergence) make visible: costs
+ * climb until they pass the infinity of -i km (count to infinity).
+ *
+ * Memory is about 16 * n * n bytes (two copies of the distance and next
+ * hop tables), so this is meant for up to a few thousand routers.
+ *
+ * Build: gcc -O2 -Wall -pthread -o dvr dvr.c -lm
+ * Usage: dvr [-v vertices.txt] [-T 0.3] [-R km] [-n routers] [-d degree] [-S seed] [-j threads]
+ *            [-m none|split|poison] [-i infinity_km] [-r max_rounds]
+ *            [-F u-v]... [-f failures] [-I router] [-c]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "graph.h"
+
+#define NO_HOP UINT32_MAX
+#define MAX_TABLE_BYTES (4ull << 30)
+#define MAX_FAILURES 64
+
+enum { MODE_NONE, MODE_SPLIT, MODE_POISON };
+
+typedef struct {
+    float *dist;            // [router * n + dest]
+    uint32_t *next;         // next-hop router, NO_HOP if unreachable
+    uint64_t *dirty;        // changed entries of each row, n bits per router
+    uint8_t *changed;       // row has a dirty bit
+} Tables;
+
+typedef struct {
+    uint32_t first, last;   // routers [first, last)
+    uint32_t *list;         // scratch: touched destinations
+    uint8_t *mark;
+    uint64_t vectors, entries, updates;
+    int any;
+} Worker;
+
+typedef struct {
+    uint32_t rounds;
+    uint64_t vectors, entries, updates;
+    int converged;
+} RunStats;
+
+Graph g;
+Tables tab[2];
+int cur;                    // tab[cur] holds the latest tables
+size_t words;               // dirty words per row
+uint8_t *down;              // per directed link entry
+int mode = MODE_SPLIT;
+float infinity = 100000.0f;
+int nthreads;
+Worker *workers;
+pthread_barrier_t barrier;
+volatile int stop;
+
+static void *alloc_zero(size_t size) {
+    void *p = calloc(1, size ? size : 1);
+    if(!p) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    return p;
+}
+
+// Function to give the cost router u advertises to neighbour v for dest d (infinity if none)
+static inline float advert(const Tables *t, uint32_t u, uint32_t v, uint32_t d) {
+    size_t i = (size_t)u * g.n + d;
+    if(mode != MODE_NONE && t->next[i] == v) return infinity;
+    return t->dist[i];
+}
+
+// Function to recompute router v's route to d from all its working links
+static void rescan(const Tables *in, Tables *out, uint32_t v, uint32_t d) {
+    float best = infinity;
+    uint32_t hop = NO_HOP;
+    for(uint32_t e = g.off[v]; e < g.off[v + 1]; e++) {
+        if(down[e]) continue;
+        float c = advert(in, g.adj[e], v, d) + g.w[e];
+        if(c < best) {
+            best = c;
+            hop = g.adj[e];
+        }
+    }
+    out->dist[(size_t)v * g.n + d] = best;
+    out->next[(size_t)v * g.n + d] = hop;
+}
+
+// Function to run one round for router v: read in (previous round), write out
+static void update_router(Worker *w, const Tables *in, Tables *out, uint32_t v) {
+    size_t row = (size_t)v * g.n;
+    float *dist = out->dist + row;
+    uint32_t *next = out->next + row;
+    // out still holds the round before last; only rows that changed since then are stale
+    if(in->changed[v]) {
+        memcpy(dist, in->dist + row, g.n * sizeof(float));
+        memcpy(next, in->next + row, g.n * sizeof(uint32_t));
+    }
+    memset(out->dirty + v * words, 0, words * sizeof(uint64_t));
+    out->changed[v] = 0;
+
+    uint32_t touched = 0, rescans = 0;
+    for(uint32_t e = g.off[v]; e < g.off[v + 1]; e++) {
+        uint32_t u = g.adj[e];
+        if(down[e] || !in->changed[u]) continue;
+        w->vectors++;
+        const uint64_t *bits = in->dirty + u * words;
+        for(size_t k = 0; k < words; k++) {
+            for(uint64_t b = bits[k]; b; b &= b - 1) {
+                uint32_t d = k * 64 + __builtin_ctzll(b);
+                size_t i = (size_t)u * g.n + d;
+                // Split horizon leaves the entry out; without timers the omission reads as a withdrawal
+                if(mode != MODE_SPLIT || in->next[i] != v) w->entries++;
+                if(d == v) continue;
+                float c = advert(in, u, v, d) + g.w[e];
+                if(c > infinity) c = infinity;
+                if(next[d] == u) {
+                    // Our route goes through u: follow it, and look for a better one if it got worse
+                    if(c > dist[d] && !(w->mark[d] & 2)) {
+                        w->mark[d] |= 2;
+                        rescans++;
+                    }
+                    dist[d] = c;
+                } else if(c < dist[d]) {
+                    dist[d] = c;
+                    next[d] = u;
+                } else {
+                    continue;
+                }
+                if(!(w->mark[d] & 1)) {
+                    w->mark[d] |= 1;
+                    w->list[touched++] = d;
+                }
+            }
+        }
+    }
+    if(rescans) {
+        for(uint32_t k = 0; k < touched; k++) {
+            if(w->mark[w->list[k]] & 2) rescan(in, out, v, w->list[k]);
+        }
+    }
+
+    for(uint32_t k = 0; k < touched; k++) {
+        uint32_t d = w->list[k];
+        w->mark[d] = 0;
+        if(dist[d] >= infinity) {
+            dist[d] = infinity;
+            next[d] = NO_HOP;
+        }
+        if(dist[d] != in->dist[row + d] || next[d] != in->next[row + d]) {
+            out->dirty[v * words + d / 64] |= 1ull << (d % 64);
+            out->changed[v] = 1;
+            w->updates++;
+        }
+    }
+    w->any |= out->changed[v];
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    for(;;) {
+        pthread_barrier_wait(&barrier);     // round starts (or stop)
+        if(stop) return NULL;
+        const Tables *in = &tab[cur];
+        Tables *out = &tab[cur ^ 1];
+        for(uint32_t v = w->first; v < w->last; v++) update_router(w, in, out, v);
+        pthread_barrier_wait(&barrier);     // round done
+    }
+}
+
+// Function to run rounds until no table changes (or max_rounds)
+static RunStats converge(uint32_t max_rounds) {
+    RunStats rs = {0, 0, 0, 0, 0};
+    while(rs.rounds < max_rounds) {
+        for(int i = 0; i < nthreads; i++) workers[i].any = 0;
+        pthread_barrier_wait(&barrier);
+        pthread_barrier_wait(&barrier);
+        cur ^= 1;
+        rs.rounds++;
+        int any = 0;
+        for(int i = 0; i < nthreads; i++) any |= workers[i].any;
+        if(!any) {
+            rs.converged = 1;
+            break;
+        }
+    }
+    for(int i = 0; i < nthreads; i++) {
+        rs.vectors += workers[i].vectors;
+        rs.entries += workers[i].entries;
+        rs.updates += workers[i].updates;
+        workers[i].vectors = workers[i].entries = workers[i].updates = 0;
+    }
+    return rs;
+}
+
+// Function to take link u-v down and let both ends drop and replace routes through it
+static void fail_link(uint32_t u, uint32_t v) {
+    uint32_t e = graph_find(&g, u, v), r = graph_find(&g, v, u);
+    if(e == g.m || r == g.m) return;
+    down[e] = down[r] = 1;
+    Tables *t = &tab[cur];
+    uint32_t ends[2][2] = {{u, v}, {v, u}};
+    for(int k = 0; k < 2; k++) {
+        uint32_t x = ends[k][0], y = ends[k][1];
+        for(uint32_t d = 0; d < g.n; d++) {
+            size_t i = (size_t)x * g.n + d;
+            if(t->next[i] != y) continue;
+            rescan(t, t, x, d);
+            if(t->dist[i] >= infinity) {
+                t->dist[i] = infinity;
+                t->next[i] = NO_HOP;
+            }
+            t->dirty[x * words + d / 64] |= 1ull << (d % 64);
+            t->changed[x] = 1;
+        }
+    }
+}
+
+// Function to check every table against Dijkstra from each router
+static void check_tables(void) {
+    typedef struct { double d; uint32_t v; } Item;
+    double *dist = alloc_zero(g.n * sizeof(double));
+    Item *heap = alloc_zero(((size_t)g.m + 1) * sizeof(Item));
+    const Tables *t = &tab[cur];
+    uint64_t bad = 0;
+    for(uint32_t s = 0; s < g.n; s++) {
+        for(uint32_t i = 0; i < g.n; i++) dist[i] = INFINITY;
+        size_t count = 0;
+        dist[s] = 0;
+        heap[count++] = (Item){0, s};
+        while(count) {
+            Item top = heap[0], last = heap[--count];
+            size_t i = 0, c;
+            while((c = 2 * i + 1) < count) {
+                if(c + 1 < count && heap[c + 1].d < heap[c].d) c++;
+                if(last.d <= heap[c].d) break;
+                heap[i] = heap[c];
+                i = c;
+            }
+            heap[i] = last;
+            if(top.d > dist[top.v]) continue;
+            for(uint32_t e = g.off[top.v]; e < g.off[top.v + 1]; e++) {
+                double nd = top.d + g.w[e];
+                if(down[e] || nd >= dist[g.adj[e]]) continue;
+                dist[g.adj[e]] = nd;
+                for(i = count++; i > 0 && heap[(i - 1) / 2].d > nd; i = (i - 1) / 2) heap[i] = heap[(i - 1) / 2];
+                heap[i] = (Item){nd, g.adj[e]};
+            }
+        }
+        for(uint32_t d = 0; d < g.n; d++) {
+            double want = dist[d] >= infinity ? infinity : dist[d], got = t->dist[(size_t)s * g.n + d];
+            if(fabs(want - got) > 1e-3 * (want > 1 ? want : 1)) bad++;
+        }
+    }
+    printf("Check against Dijkstra: %llu of %llu entries differ\n", (unsigned long long)bad,
+           (unsigned long long)g.n * g.n);
+    free(dist);
+    free(heap);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *what, RunStats rs, double wall) {
+    uint64_t unreachable = 0;
+    for(size_t i = 0; i < (size_t)g.n * g.n; i++) unreachable += tab[cur].next[i] == NO_HOP;
+    printf("%s: %s after %u rounds, %llu vectors exchanged (%llu entries), %llu route changes, "
+           "%llu unreachable entries (%.3f s)\n",
+           what, rs.converged ? "converged" : "NOT converged", rs.rounds, (unsigned long long)rs.vectors,
+           (unsigned long long)rs.entries, (unsigned long long)rs.updates, (unsigned long long)unreachable, wall);
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-v vertices.txt] [-T 0.3] [-R km] [-n routers] [-d degree] [-S seed] [-j threads]\n"
+            "          [-m none|split|poison] [-i infinity_km] [-r max_rounds]\n"
+            "          [-F u-v]... [-f failures] [-I router] [-c]\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *vertices = NULL;
+    double T = 0.3, radius = 0;
+    uint32_t routers = 2000, max_rounds = 100000, isolate = 0;
+    unsigned degree = 8, failures = 0, nfixed = 0;
+    uint32_t fixed[MAX_FAILURES][2];
+    uint64_t seed = 1;
+    int check = 0, opt;
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    while((opt = getopt(argc, argv, "v:T:R:n:d:S:j:m:i:r:F:f:I:c")) != -1) {
+        switch(opt) {
+        case 'v': vertices = optarg; break;
+        case 'T': T = atof(optarg); break;
+        case 'R': radius = atof(optarg); break;
+        case 'n': routers = strtoul(optarg, NULL, 10); break;
+        case 'd': degree = atoi(optarg); break;
+        case 'S': seed = strtoull(optarg, NULL, 10); break;
+        case 'j': nthreads = atoi(optarg); break;
+        case 'm':
+            if(strcmp(optarg, "none") == 0) mode = MODE_NONE;
+            else if(strcmp(optarg, "split") == 0) mode = MODE_SPLIT;
+            else if(strcmp(optarg, "poison") == 0) mode = MODE_POISON;
+            else usage(argv[0]);
+            break;
+        case 'i': infinity = atof(optarg); break;
+        case 'r': max_rounds = strtoul(optarg, NULL, 10); break;
+        case 'F':
+            if(nfixed == MAX_FAILURES || sscanf(optarg, "%u-%u", &fixed[nfixed][0], &fixed[nfixed][1]) != 2)
+                usage(argv[0]);
+            nfixed++;
+            break;
+        case 'f': failures = atoi(optarg); break;
+        case 'I': isolate = strtoul(optarg, NULL, 10); break;
+        case 'c': check = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+    if(optind != argc || (!vertices && routers < 2)) usage(argv[0]);
+    if(nthreads < 1) nthreads = 1;
+
+    graph_open(&g, vertices, T, radius, routers, degree, seed);
+    printf("Topology: %u routers, %u links, %d thread(s), %s\n", g.n, g.m / 2, nthreads,
+           mode == MODE_NONE ? "no loop avoidance" : mode == MODE_SPLIT ? "split horizon" : "poison reverse");
+    if(16ull * g.n * g.n > MAX_TABLE_BYTES) {
+        fprintf(stderr, "%u routers need %.1f GB of tables\n", g.n, 16.0 * g.n * g.n / 1e9);
+        return 1;
+    }
+    if(g.n == 0) return 0;
+    if((uint32_t)nthreads > g.n) nthreads = g.n;
+
+    // Each router starts knowing only itself, marked changed so round 1 announces it
+    words = (g.n + 63) / 64;
+    for(int k = 0; k < 2; k++) {
+        tab[k].dist = alloc_zero((size_t)g.n * g.n * sizeof(float));
+        tab[k].next = alloc_zero((size_t)g.n * g.n * sizeof(uint32_t));
+        tab[k].dirty = alloc_zero((size_t)g.n * words * sizeof(uint64_t));
+        tab[k].changed = alloc_zero(g.n);
+        for(size_t i = 0; i < (size_t)g.n * g.n; i++) {
+            tab[k].dist[i] = infinity;
+            tab[k].next[i] = NO_HOP;
+        }
+        for(uint32_t v = 0; v < g.n; v++) {
+            tab[k].dist[(size_t)v * g.n + v] = 0;
+            tab[k].next[(size_t)v * g.n + v] = v;
+        }
+    }
+    for(uint32_t v = 0; v < g.n; v++) {
+        tab[0].dirty[v * words + v / 64] |= 1ull << (v % 64);
+        tab[0].changed[v] = 1;
+    }
+    down = alloc_zero(g.m);
+
+    workers = alloc_zero(nthreads * sizeof(Worker));
+    pthread_barrier_init(&barrier, NULL, nthreads + 1);
+    pthread_t *threads = alloc_zero(nthreads * sizeof(pthread_t));
+    for(int i = 0; i < nthreads; i++) {
+        workers[i].first = (uint64_t)g.n * i / nthreads;
+        workers[i].last = (uint64_t)g.n * (i + 1) / nthreads;
+        workers[i].list = alloc_zero(g.n * sizeof(uint32_t));
+        workers[i].mark = alloc_zero(g.n);
+        if(pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) {
+            perror("Thread creation failed");
+            return 1;
+        }
+    }
+
+    double t0 = now();
+    RunStats rs = converge(max_rounds);
+    report("Initial", rs, now() - t0);
+    if(check) check_tables();
+
+    // Failures: explicit links, a whole router, then random links
+    char what[128];
+    for(unsigned k = 0; k < nfixed; k++) {
+        if(fixed[k][0] < 1 || fixed[k][1] < 1 || fixed[k][0] > g.n || fixed[k][1] > g.n ||
+           graph_find(&g, fixed[k][0] - 1, fixed[k][1] - 1) == g.m) {
+            fprintf(stderr, "No link %u-%u\n", fixed[k][0], fixed[k][1]);
+            continue;
+        }
+        fail_link(fixed[k][0] - 1, fixed[k][1] - 1);
+        t0 = now();
+        rs = converge(max_rounds);
+        snprintf(what, sizeof(what), "Link %u-%u down", fixed[k][0], fixed[k][1]);
+        report(what, rs, now() - t0);
+    }
+    if(isolate >= 1 && isolate <= g.n) {
+        uint32_t x = isolate - 1;
+        for(uint32_t e = g.off[x]; e < g.off[x + 1]; e++) {
+            if(!down[e]) fail_link(x, g.adj[e]);
+        }
+        t0 = now();
+        rs = converge(max_rounds);
+        snprintf(what, sizeof(what), "Router %u isolated", isolate);
+        report(what, rs, now() - t0);
+    }
+    for(unsigned k = 0; k < failures && g.m; k++) {
+        uint32_t e = graph_rand(&seed) % g.m, u = 0;
+        if(down[e]) continue;
+        while(g.off[u + 1] <= e) u++;
+        fail_link(u, g.adj[e]);
+        t0 = now();
+        rs = converge(max_rounds);
+        snprintf(what, sizeof(what), "Link %u-%u (%.0f km) down", u + 1, g.adj[e] + 1, g.w[e]);
+        report(what, rs, now() - t0);
+    }
+    if(check && (nfixed || isolate || failures)) check_tables();
+
+    stop = 1;
+    pthread_barrier_wait(&barrier);
+    for(int i = 0; i < nthreads; i++) pthread_join(threads[i], NULL);
+    return 0;
+}
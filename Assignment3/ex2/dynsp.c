@@ -0,0 +1,362 @@
+/*
+ * dynsp: shortest-path trees kept up to date across link changes.
+ *
+ * In task2.ipynb a changed topology means a new Network and a dijkstra
+ * from every router. dynsp keeps, for each tracked source, the distance,
+ * parent and first hop of every router (a forwarding table), and repairs
+ * them in place when a link's cost changes, in the manner of Ramalingam
+ * and Reps:
+ *   cheaper link    relax across it and propagate, Dijkstra-style, only
+ *                   through routers whose distance improves
+ *   dearer / down   if the link is a tree edge, the routers below it lose
+ *                   their routes: each takes its best offer from routers
+ *                   outside that subtree, then Dijkstra runs inside it
+ * Links not on a tree cost nothing to change. (Reps' version keeps the
+ * whole shortest-path DAG, so routers with an equal-cost second parent are
+ * not even touched; with float costs such ties are rare.)
+ *
+ * The experiment is a series of link flaps (-e: a random link goes down,
+ * then comes back) and cost changes (-w: a random link's cost is scaled by
+ * 0.5-2x), applied to every tracked source. dynsp reports the routers
+ * touched per change and the time per change against a full recomputation;
+ * -c checks every tree against a fresh Dijkstra after each change.
+ *
+ * Build: gcc -O2 -Wall -o dynsp dynsp.c -lm
+ * Usage: dynsp [-v vertices.txt] [-T 0.3] [-R km] [-n routers] [-d degree] [-S seed]
+ *              [-s sources] [-e flaps] [-w cost_changes] [-c]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include "graph.h"
+
+#define NONE UINT32_MAX
+#define MAX_TREE_BYTES (2ull << 30)
+
+typedef struct {
+    uint32_t source;
+    double *dist;
+    uint32_t *parent;       // NONE for the source and unreachable routers
+    uint32_t *first;        // first hop from the source, NONE likewise
+} Tree;
+
+// Indexed 4-ary min-heap over the current tree's distances
+typedef struct {
+    uint32_t *heap, *pos;   // pos[v] = index in heap, NONE if not queued
+    const double *key;
+    uint32_t size;
+} QuadHeap;
+
+Graph g;
+Tree *trees;
+uint32_t tree_count;
+QuadHeap q;
+uint32_t *stamp, *queue;    // affected-set marks and scratch
+uint32_t epoch;
+uint64_t touched;           // routers whose route was recomputed
+
+static void heap_up(uint32_t i) {
+    uint32_t v = q.heap[i];
+    double k = q.key[v];
+    while(i > 0) {
+        uint32_t parent = (i - 1) / 4, pv = q.heap[parent];
+        if(q.key[pv] <= k) break;
+        q.heap[i] = pv;
+        q.pos[pv] = i;
+        i = parent;
+    }
+    q.heap[i] = v;
+    q.pos[v] = i;
+}
+
+// Function to queue v, or move it up after its distance dropped
+static void heap_update(uint32_t v) {
+    if(q.pos[v] == NONE) {
+        q.pos[v] = q.size;
+        q.heap[q.size++] = v;
+    }
+    heap_up(q.pos[v]);
+}
+
+static uint32_t heap_pop(void) {
+    uint32_t top = q.heap[0], v = q.heap[--q.size], i = 0;
+    double k = q.key[v];
+    for(;;) {
+        uint32_t c = 4 * i + 1, best = c;
+        if(c >= q.size) break;
+        uint32_t end = c + 4 < q.size ? c + 4 : q.size;
+        double bk = q.key[q.heap[c]];
+        for(uint32_t j = c + 1; j < end; j++) {
+            if(q.key[q.heap[j]] < bk) {
+                bk = q.key[q.heap[j]];
+                best = j;
+            }
+        }
+        if(k <= bk) break;
+        q.heap[i] = q.heap[best];
+        q.pos[q.heap[i]] = i;
+        i = best;
+    }
+    if(q.size) {
+        q.heap[i] = v;
+        q.pos[v] = i;
+    }
+    q.pos[top] = NONE;
+    return top;
+}
+
+// Function to settle queued routers in distance order, relaxing links (down links have infinite cost)
+static void propagate(Tree *t) {
+    while(q.size) {
+        uint32_t x = heap_pop();
+        touched++;
+        if(x != t->source) t->first[x] = t->parent[x] == t->source ? x : t->first[t->parent[x]];
+        for(uint32_t e = g.off[x]; e < g.off[x + 1]; e++) {
+            uint32_t y = g.adj[e];
+            double nd = t->dist[x] + g.w[e];
+            if(nd < t->dist[y]) {
+                t->dist[y] = nd;
+                t->parent[y] = x;
+                heap_update(y);
+            }
+        }
+    }
+}
+
+static void full_dijkstra(Tree *t) {
+    for(uint32_t v = 0; v < g.n; v++) {
+        t->dist[v] = INFINITY;
+        t->parent[v] = t->first[v] = NONE;
+    }
+    q.key = t->dist;
+    t->dist[t->source] = 0;
+    heap_update(t->source);
+    propagate(t);
+}
+
+// Function to repair a tree after link a-b (entry ab from a, ba from b) got cheaper
+static void link_decreased(Tree *t, uint32_t a, uint32_t b, uint32_t ab, uint32_t ba) {
+    q.key = t->dist;
+    if(t->dist[a] + g.w[ab] < t->dist[b]) {
+        t->dist[b] = t->dist[a] + g.w[ab];
+        t->parent[b] = a;
+        heap_update(b);
+    } else if(t->dist[b] + g.w[ba] < t->dist[a]) {
+        t->dist[a] = t->dist[b] + g.w[ba];
+        t->parent[a] = b;
+        heap_update(a);
+    }
+    propagate(t);
+}
+
+// Function to repair a tree after link a-b got dearer or went down
+static void link_increased(Tree *t, uint32_t a, uint32_t b) {
+    uint32_t top;
+    if(t->parent[b] == a) top = b;
+    else if(t->parent[a] == b) top = a;
+    else return;    // not a tree edge: no route used it
+
+    // The subtree below the link, found through parent pointers
+    uint32_t count = 0;
+    epoch++;
+    stamp[top] = epoch;
+    queue[count++] = top;
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t x = queue[i];
+        for(uint32_t e = g.off[x]; e < g.off[x + 1]; e++) {
+            uint32_t z = g.adj[e];
+            if(t->parent[z] == x && stamp[z] != epoch) {
+                stamp[z] = epoch;
+                queue[count++] = z;
+            }
+        }
+    }
+    for(uint32_t i = 0; i < count; i++) {
+        t->dist[queue[i]] = INFINITY;
+        t->parent[queue[i]] = t->first[queue[i]] = NONE;
+    }
+
+    // Best offer from outside the subtree, then Dijkstra within it
+    q.key = t->dist;
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t x = queue[i];
+        for(uint32_t e = g.off[x]; e < g.off[x + 1]; e++) {
+            uint32_t y = g.adj[e];
+            if(stamp[y] == epoch) continue;
+            double nd = t->dist[y] + g.w[e];
+            if(nd < t->dist[x]) {
+                t->dist[x] = nd;
+                t->parent[x] = y;
+            }
+        }
+        if(t->parent[x] != NONE) heap_update(x);
+    }
+    propagate(t);
+}
+
+// Function to set the cost of link u-v and repair every tree
+static void set_cost(uint32_t u, uint32_t v, float w) {
+    uint32_t uv = graph_find(&g, u, v), vu = graph_find(&g, v, u);
+    float old = g.w[uv];
+    g.w[uv] = g.w[vu] = w;
+    for(uint32_t k = 0; k < tree_count; k++) {
+        if(w < old) link_decreased(&trees[k], u, v, uv, vu);
+        else if(w > old) link_increased(&trees[k], u, v);
+    }
+}
+
+// Function to compare every tree with a fresh Dijkstra. Returns the number of wrong entries.
+static uint64_t check_trees(Tree *scratch) {
+    uint64_t bad = 0;
+    for(uint32_t k = 0; k < tree_count; k++) {
+        const Tree *t = &trees[k];
+        scratch->source = t->source;
+        full_dijkstra(scratch);
+        for(uint32_t v = 0; v < g.n; v++) {
+            double want = scratch->dist[v], got = t->dist[v];
+            if(isinf(want) != isinf(got) || (!isinf(want) && fabs(want - got) > 1e-6 * (want > 1 ? want : 1))) {
+                bad++;
+                continue;
+            }
+            // The parent link must lie on a shortest path, and the first hop follow the parents
+            uint32_t p = t->parent[v];
+            if(v == t->source || isinf(want)) continue;
+            uint32_t e = p == NONE ? g.m : graph_find(&g, p, v);
+            if(e == g.m || fabs(t->dist[p] + g.w[e] - got) > 1e-6 * (want > 1 ? want : 1) ||
+               t->first[v] != (p == t->source ? v : t->first[p]))
+                bad++;
+        }
+    }
+    return bad;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-v vertices.txt] [-T 0.3] [-R km] [-n routers] [-d degree] [-S seed]\n"
+            "          [-s sources] [-e flaps] [-w cost_changes] [-c]\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *vertices = NULL;
+    double T = 0.3, radius = 0;
+    uint32_t routers = 10000, sources = 0, flaps = 1000, changes = 0;
+    uint64_t seed = 1;
+    unsigned degree = 8;
+    int check = 0, opt;
+    while((opt = getopt(argc, argv, "v:T:R:n:d:S:s:e:w:c")) != -1) {
+        switch(opt) {
+        case 'v': vertices = optarg; break;
+        case 'T': T = atof(optarg); break;
+        case 'R': radius = atof(optarg); break;
+        case 'n': routers = strtoul(optarg, NULL, 10); break;
+        case 'd': degree = atoi(optarg); break;
+        case 'S': seed = strtoull(optarg, NULL, 10); break;
+        case 's': sources = strtoul(optarg, NULL, 10); break;
+        case 'e': flaps = strtoul(optarg, NULL, 10); break;
+        case 'w': changes = strtoul(optarg, NULL, 10); break;
+        case 'c': check = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+    if(optind != argc || (!vertices && routers < 2)) usage(argv[0]);
+
+    graph_open(&g, vertices, T, radius, routers, degree, seed);
+    if(g.m == 0) {
+        fprintf(stderr, "No links\n");
+        return 1;
+    }
+    // Every router as a source (all-pairs) if the trees fit, otherwise an evenly spaced sample
+    size_t per_tree = (size_t)g.n * (sizeof(double) + 2 * sizeof(uint32_t));
+    if(sources == 0 || sources > g.n) sources = (uint64_t)g.n * per_tree <= MAX_TREE_BYTES ? g.n : 256;
+    if((uint64_t)sources * per_tree > MAX_TREE_BYTES) {
+        fprintf(stderr, "%u trees of %u routers do not fit in memory; use -s\n", sources, g.n);
+        return 1;
+    }
+    tree_count = sources;
+    trees = graph_alloc((tree_count + 1) * sizeof(Tree));
+    for(uint32_t k = 0; k <= tree_count; k++) {     // the extra one is scratch for -c
+        trees[k].source = (uint64_t)k * g.n / tree_count % g.n;
+        trees[k].dist = graph_alloc(g.n * sizeof(double));
+        trees[k].parent = graph_alloc(g.n * sizeof(uint32_t));
+        trees[k].first = graph_alloc(g.n * sizeof(uint32_t));
+    }
+    q.heap = graph_alloc(g.n * sizeof(uint32_t));
+    q.pos = graph_alloc(g.n * sizeof(uint32_t));
+    memset(q.pos, 0xff, g.n * sizeof(uint32_t));
+    stamp = calloc(g.n, sizeof(uint32_t));
+    queue = graph_alloc(g.n * sizeof(uint32_t));
+    if(!stamp) {
+        perror("Memory allocation failed");
+        return 1;
+    }
+
+    double t0 = now();
+    for(uint32_t k = 0; k < tree_count; k++) full_dijkstra(&trees[k]);
+    double full = now() - t0;
+    printf("Topology: %u routers, %u links; %u source trees built in %.3f s (%.1f us per tree)\n", g.n, g.m / 2,
+           tree_count, full, full * 1e6 / tree_count);
+
+    // Events: each flap is a failure and a repair of the same link, then the cost changes
+    uint64_t events = 2ull * flaps + changes, bad = 0;
+    uint64_t touched_fail = 0, touched_repair = 0, touched_cost = 0;
+    double time_fail = 0, time_repair = 0, time_cost = 0;
+    for(uint64_t i = 0; i < events; i++) {
+        uint32_t e = graph_rand(&seed) % g.m, u = 0;
+        while(g.off[u + 1] <= e) u++;
+        uint32_t v = g.adj[e];
+        float w = g.w[e];
+
+        if(i < 2ull * flaps) {
+            touched = 0;
+            t0 = now();
+            set_cost(u, v, INFINITY);
+            time_fail += now() - t0;
+            touched_fail += touched;
+            if(check) bad += check_trees(&trees[tree_count]);
+            touched = 0;
+            t0 = now();
+            set_cost(u, v, w);
+            time_repair += now() - t0;
+            touched_repair += touched;
+            i++;
+        } else {
+            touched = 0;
+            t0 = now();
+            set_cost(u, v, w * (0.5 + 1.5 * graph_uniform(&seed)));
+            time_cost += now() - t0;
+            touched_cost += touched;
+        }
+        if(check) bad += check_trees(&trees[tree_count]);
+    }
+
+    double per_tree_us = full * 1e6 / tree_count;
+    printf("\n%-13s %7s %16s %14s %10s\n", "Change", "Count", "Routers/tree", "us/tree", "Speedup");
+    struct {
+        const char *name;
+        uint64_t count, touched;
+        double time;
+    } rows[] = {{"link down", flaps, touched_fail, time_fail},
+                {"link up", flaps, touched_repair, time_repair},
+                {"cost change", changes, touched_cost, time_cost}};
+    for(int r = 0; r < 3; r++) {
+        if(!rows[r].count) continue;
+        double n = (double)rows[r].count * tree_count, us = rows[r].time * 1e6 / n;
+        printf("%-13s %7llu %16.1f %14.3f %9.0fx\n", rows[r].name, (unsigned long long)rows[r].count,
+               rows[r].touched / n, us, us > 0 ? per_tree_us / us : 0.0);
+    }
+    printf("(a full recomputation touches %u routers and takes %.1f us per tree)\n", g.n, per_tree_us);
+    if(check) printf("Check against Dijkstra after every change: %llu wrong entries\n", (unsigned long long)bad);
+    return 0;
+}
@@ -0,0 +1,371 @@
+/*
+ * geoindex.h: batch great-circle distances and radius queries over router coordinates.
+ *
+ * Points are kept as unit vectors in struct-of-arrays form (x[], y[], z[]),
+ * so the trigonometry of the haversine formula is paid once per point. For
+ * a pair, the straight-line chord c between the vectors gives the
+ * distance 2R asin(c / 2), the same value as the haversine formula
+ * (a = c^2 / 4). Radius tests compare c^2 with a threshold and need no
+ * asin at all.
+ *
+ * The kernels come in AVX-512, AVX2 and scalar versions, picked at run time
+ * from what the CPU supports (asin is a rational approximation, accurate to
+ * a few ulp).
+ *
+ * GeoGrid buckets points into latitude bands one search radius high, each
+ * split into longitude cells about one radius wide at the band's
+ * poleward edge. A radius query reads only the cells a spherical cap
+ * can touch, with their points stored contiguously for the kernels.
+ */
+
+#ifndef GEOINDEX_H
+#define GEOINDEX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <immintrin.h>
+
+#define GEO_EARTH_RADIUS_KM 6371.0
+
+typedef struct {
+    size_t n;
+    double *x, *y, *z;
+} GeoPoints;
+
+typedef struct {
+    double radius_km, band_deg;
+    uint32_t bands;
+    uint32_t *band_cells, *band_first;  // cells per band, first cell of each band
+    uint32_t *cell_start;               // points of cell c: [cell_start[c], cell_start[c + 1])
+    uint32_t *index;                    // original point of each sorted slot
+    GeoPoints sorted;                   // unit vectors in cell order
+} GeoGrid;
+
+static inline void *geo_alloc(size_t size) {
+    void *p = malloc(size ? size : 1);
+    if(!p) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    return p;
+}
+
+static inline void geo_points_init(GeoPoints *p, const double *lat, const double *lon, size_t n) {
+    p->n = n;
+    p->x = geo_alloc(n * sizeof(double));
+    p->y = geo_alloc(n * sizeof(double));
+    p->z = geo_alloc(n * sizeof(double));
+    for(size_t i = 0; i < n; i++) {
+        double a = lat[i] * M_PI / 180.0, b = lon[i] * M_PI / 180.0;
+        p->x[i] = cos(a) * cos(b);
+        p->y[i] = cos(a) * sin(b);
+        p->z[i] = sin(a);
+    }
+}
+
+static inline void geo_points_free(GeoPoints *p) {
+    free(p->x);
+    free(p->y);
+    free(p->z);
+    memset(p, 0, sizeof(*p));
+}
+
+// Squared chord between two points radius_km apart
+static inline double geo_chord2(double radius_km) {
+    double c = 2.0 * sin(radius_km / (2.0 * GEO_EARTH_RADIUS_KM));
+    return c * c;
+}
+
+// asin(s) for s in [0, 1] (fdlibm's rational approximation on [0, 0.5], reflected above)
+#define GEO_ASIN_P(t) ((t) * (1.66666666666666657415e-01 + (t) * (-3.25565818622400915405e-01 + \
+    (t) * (2.01212532134862925881e-01 + (t) * (-4.00555345006794114027e-02 + \
+    (t) * (7.91534994289814532176e-04 + (t) * 3.47933107596021167570e-05))))))
+#define GEO_ASIN_Q(t) (1.0 + (t) * (-2.40339491173441421878e+00 + (t) * (2.02094576023350569471e+00 + \
+    (t) * (-6.88283971605453293030e-01 + (t) * 7.70381505559019352791e-02))))
+
+// Rounds exactly like the vector kernels (same fused operations), so every path gives identical bits
+static inline double geo_asin(double s) {
+    int high = s > 0.5;
+    double u = high ? sqrt((1.0 - s) * 0.5) : s, t = u * u;
+    double r = fma(u, GEO_ASIN_P(t) / GEO_ASIN_Q(t), u);
+    return high ? fma(-2.0, r, M_PI_2) : r;
+}
+
+static inline double geo_dist_scalar(const GeoPoints *p, size_t i, size_t j) {
+    double dx = p->x[j] - p->x[i], dy = p->y[j] - p->y[i], dz = p->z[j] - p->z[i];
+    double s = 0.5 * sqrt(fma(dz, dz, fma(dy, dy, dx * dx)));
+    return 2.0 * GEO_EARTH_RADIUS_KM * geo_asin(s > 1.0 ? 1.0 : s);
+}
+
+static void geo_row_scalar(const GeoPoints *p, size_t i, size_t from, size_t to, double *out) {
+    for(size_t j = from; j < to; j++) out[j - from] = geo_dist_scalar(p, i, j);
+}
+
+// Horner steps shared by the vector versions
+#define GEO_POLY_STEP(mul, add, acc, t, c) acc = add(mul(acc, t), set1(c))
+
+__attribute__((target("avx2,fma"))) static void geo_row_avx2(const GeoPoints *p, size_t i, size_t from, size_t to,
+                                                             double *out) {
+#define set1 _mm256_set1_pd
+    __m256d xi = set1(p->x[i]), yi = set1(p->y[i]), zi = set1(p->z[i]);
+    __m256d half = set1(0.5), one = set1(1.0), r2 = set1(2.0 * GEO_EARTH_RADIUS_KM);
+    size_t j = from;
+    for(; j + 4 <= to; j += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(p->x + j), xi);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(p->y + j), yi);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(p->z + j), zi);
+        __m256d c2 = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+        __m256d s = _mm256_min_pd(_mm256_mul_pd(half, _mm256_sqrt_pd(c2)), one);
+        __m256d high = _mm256_cmp_pd(s, half, _CMP_GT_OQ);
+        __m256d u = _mm256_blendv_pd(s, _mm256_sqrt_pd(_mm256_mul_pd(_mm256_sub_pd(one, s), half)), high);
+        __m256d t = _mm256_mul_pd(u, u);
+        __m256d P = set1(3.47933107596021167570e-05), Q = set1(7.70381505559019352791e-02);
+        GEO_POLY_STEP(_mm256_mul_pd, _mm256_add_pd, P, t, 7.91534994289814532176e-04);
+        GEO_POLY_STEP(_mm256_mul_pd, _mm256_add_pd, P, t, -4.00555345006794114027e-02);
+        GEO_POLY_STEP(_mm256_mul_pd, _mm256_add_pd, P, t, 2.01212532134862925881e-01);
+        GEO_POLY_STEP(_mm256_mul_pd, _mm256_add_pd, P, t, -3.25565818622400915405e-01);
+        GEO_POLY_STEP(_mm256_mul_pd, _mm256_add_pd, P, t, 1.66666666666666657415e-01);
+        P = _mm256_mul_pd(P, t);
+        GEO_POLY_STEP(_mm256_mul_pd, _mm256_add_pd, Q, t, -6.88283971605453293030e-01);
+        GEO_POLY_STEP(_mm256_mul_pd, _mm256_add_pd, Q, t, 2.02094576023350569471e+00);
+        GEO_POLY_STEP(_mm256_mul_pd, _mm256_add_pd, Q, t, -2.40339491173441421878e+00);
+        GEO_POLY_STEP(_mm256_mul_pd, _mm256_add_pd, Q, t, 1.0);
+        __m256d r = _mm256_fmadd_pd(u, _mm256_div_pd(P, Q), u);
+        r = _mm256_blendv_pd(r, _mm256_fnmadd_pd(set1(2.0), r, set1(M_PI_2)), high);
+        _mm256_storeu_pd(out + (j - from), _mm256_mul_pd(r2, r));
+    }
+    geo_row_scalar(p, i, j, to, out + (j - from));
+#undef set1
+}
+
+__attribute__((target("avx512f"))) static void geo_row_avx512(const GeoPoints *p, size_t i, size_t from, size_t to,
+                                                              double *out) {
+#define set1 _mm512_set1_pd
+    __m512d xi = set1(p->x[i]), yi = set1(p->y[i]), zi = set1(p->z[i]);
+    __m512d half = set1(0.5), one = set1(1.0), r2 = set1(2.0 * GEO_EARTH_RADIUS_KM);
+    size_t j = from;
+    for(; j + 8 <= to; j += 8) {
+        __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(p->x + j), xi);
+        __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(p->y + j), yi);
+        __m512d dz = _mm512_sub_pd(_mm512_loadu_pd(p->z + j), zi);
+        __m512d c2 = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+        __m512d s = _mm512_min_pd(_mm512_mul_pd(half, _mm512_sqrt_pd(c2)), one);
+        __mmask8 high = _mm512_cmp_pd_mask(s, half, _CMP_GT_OQ);
+        __m512d u = _mm512_mask_sqrt_pd(s, high, _mm512_mul_pd(_mm512_sub_pd(one, s), half));
+        __m512d t = _mm512_mul_pd(u, u);
+        __m512d P = set1(3.47933107596021167570e-05), Q = set1(7.70381505559019352791e-02);
+        GEO_POLY_STEP(_mm512_mul_pd, _mm512_add_pd, P, t, 7.91534994289814532176e-04);
+        GEO_POLY_STEP(_mm512_mul_pd, _mm512_add_pd, P, t, -4.00555345006794114027e-02);
+        GEO_POLY_STEP(_mm512_mul_pd, _mm512_add_pd, P, t, 2.01212532134862925881e-01);
+        GEO_POLY_STEP(_mm512_mul_pd, _mm512_add_pd, P, t, -3.25565818622400915405e-01);
+        GEO_POLY_STEP(_mm512_mul_pd, _mm512_add_pd, P, t, 1.66666666666666657415e-01);
+        P = _mm512_mul_pd(P, t);
+        GEO_POLY_STEP(_mm512_mul_pd, _mm512_add_pd, Q, t, -6.88283971605453293030e-01);
+        GEO_POLY_STEP(_mm512_mul_pd, _mm512_add_pd, Q, t, 2.02094576023350569471e+00);
+        GEO_POLY_STEP(_mm512_mul_pd, _mm512_add_pd, Q, t, -2.40339491173441421878e+00);
+        GEO_POLY_STEP(_mm512_mul_pd, _mm512_add_pd, Q, t, 1.0);
+        __m512d r = _mm512_fmadd_pd(u, _mm512_div_pd(P, Q), u);
+        r = _mm512_mask_mov_pd(r, high, _mm512_fnmadd_pd(set1(2.0), r, set1(M_PI_2)));
+        _mm512_storeu_pd(out + (j - from), _mm512_mul_pd(r2, r));
+    }
+    geo_row_scalar(p, i, j, to, out + (j - from));
+#undef set1
+}
+
+// Function to test points [from, to) against a squared chord; writes their indices, returns the count
+static size_t geo_within_scalar(const GeoPoints *p, double x, double y, double z, size_t from, size_t to,
+                                double chord2, uint32_t *out) {
+    size_t count = 0;
+    for(size_t j = from; j < to; j++) {
+        double dx = p->x[j] - x, dy = p->y[j] - y, dz = p->z[j] - z;
+        if(dx * dx + dy * dy + dz * dz <= chord2) out[count++] = j;
+    }
+    return count;
+}
+
+__attribute__((target("avx2,fma"))) static size_t geo_within_avx2(const GeoPoints *p, double x, double y, double z,
+                                                                  size_t from, size_t to, double chord2,
+                                                                  uint32_t *out) {
+    __m256d vx = _mm256_set1_pd(x), vy = _mm256_set1_pd(y), vz = _mm256_set1_pd(z), lim = _mm256_set1_pd(chord2);
+    size_t count = 0, j = from;
+    for(; j + 4 <= to; j += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(p->x + j), vx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(p->y + j), vy);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(p->z + j), vz);
+        __m256d c2 = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+        for(unsigned m = _mm256_movemask_pd(_mm256_cmp_pd(c2, lim, _CMP_LE_OQ)); m; m &= m - 1)
+            out[count++] = j + __builtin_ctz(m);
+    }
+    return count + geo_within_scalar(p, x, y, z, j, to, chord2, out + count);
+}
+
+__attribute__((target("avx512f"))) static size_t geo_within_avx512(const GeoPoints *p, double x, double y, double z,
+                                                                   size_t from, size_t to, double chord2,
+                                                                   uint32_t *out) {
+    __m512d vx = _mm512_set1_pd(x), vy = _mm512_set1_pd(y), vz = _mm512_set1_pd(z), lim = _mm512_set1_pd(chord2);
+    size_t count = 0, j = from;
+    for(; j + 8 <= to; j += 8) {
+        __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(p->x + j), vx);
+        __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(p->y + j), vy);
+        __m512d dz = _mm512_sub_pd(_mm512_loadu_pd(p->z + j), vz);
+        __m512d c2 = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+        for(unsigned m = _mm512_cmp_pd_mask(c2, lim, _CMP_LE_OQ); m; m &= m - 1) out[count++] = j + __builtin_ctz(m);
+    }
+    return count + geo_within_scalar(p, x, y, z, j, to, chord2, out + count);
+}
+
+typedef void (*GeoRowFn)(const GeoPoints *, size_t, size_t, size_t, double *);
+typedef size_t (*GeoWithinFn)(const GeoPoints *, double, double, double, size_t, size_t, double, uint32_t *);
+
+static GeoRowFn geo_row_fn;
+static GeoWithinFn geo_within_fn;
+
+// Function to pick the kernels for this CPU (GEO_SIMD=avx2 or scalar caps the choice). Returns their name.
+static inline const char *geo_simd_init(void) {
+    const char *force = getenv("GEO_SIMD");
+    int level = force && strcmp(force, "scalar") == 0 ? 0 : force && strcmp(force, "avx2") == 0 ? 1 : 2;
+    __builtin_cpu_init();
+    if(level >= 2 && __builtin_cpu_supports("avx512f")) {
+        geo_row_fn = geo_row_avx512;
+        geo_within_fn = geo_within_avx512;
+        return "avx512";
+    }
+    if(level >= 1 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        geo_row_fn = geo_row_avx2;
+        geo_within_fn = geo_within_avx2;
+        return "avx2";
+    }
+    geo_row_fn = geo_row_scalar;
+    geo_within_fn = geo_within_scalar;
+    return "scalar";
+}
+
+// Function to write the distances in km from point i to points [from, to)
+static inline void geo_dist_row(const GeoPoints *p, size_t i, size_t from, size_t to, double *out) {
+    if(!geo_row_fn) geo_simd_init();
+    geo_row_fn(p, i, from, to, out);
+}
+
+static inline uint32_t geo_band(const GeoGrid *gr, double lat) {
+    double b = floor((lat + 90.0) / gr->band_deg);
+    return b < 0 ? 0 : b >= gr->bands ? gr->bands - 1 : (uint32_t)b;
+}
+
+static inline uint32_t geo_cell_in_band(const GeoGrid *gr, uint32_t band, double lon) {
+    lon = fmod(lon + 180.0, 360.0);
+    if(lon < 0) lon += 360.0;
+    uint32_t c = (uint32_t)(lon / 360.0 * gr->band_cells[band]);
+    return c >= gr->band_cells[band] ? gr->band_cells[band] - 1 : c;
+}
+
+static int geo_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Function to index n points for radius queries of up to radius_km
+static inline void geo_grid_build(GeoGrid *gr, const double *lat, const double *lon, size_t n, double radius_km) {
+    memset(gr, 0, sizeof(*gr));
+    gr->radius_km = radius_km;
+    gr->band_deg = radius_km / GEO_EARTH_RADIUS_KM * 180.0 / M_PI;
+    if(gr->band_deg < 180.0 / 65536) gr->band_deg = 180.0 / 65536;
+    if(gr->band_deg > 180.0) gr->band_deg = 180.0;
+    gr->bands = (uint32_t)ceil(180.0 / gr->band_deg);
+    gr->band_cells = geo_alloc(gr->bands * sizeof(uint32_t));
+    gr->band_first = geo_alloc((gr->bands + 1) * sizeof(uint32_t));
+    uint64_t cells = 0;
+    for(uint32_t b = 0; b < gr->bands; b++) {
+        double lo = -90.0 + b * gr->band_deg, hi = lo + gr->band_deg;
+        double edge = fabs(lo) > fabs(hi) ? fabs(lo) : fabs(hi), c = cos((edge > 90 ? 90 : edge) * M_PI / 180.0);
+        double width = gr->band_deg / (c > 1e-9 ? c : 1e-9);
+        uint32_t k = width >= 360.0 ? 1 : (uint32_t)(360.0 / width);
+        gr->band_cells[b] = k < 1 ? 1 : k > 65536 ? 65536 : k;
+        gr->band_first[b] = cells;
+        cells += gr->band_cells[b];
+    }
+    gr->band_first[gr->bands] = cells;
+
+    // Sort points by cell, then lay their unit vectors out in that order
+    uint64_t *key = geo_alloc(n * sizeof(uint64_t));
+    for(size_t i = 0; i < n; i++) {
+        uint32_t b = geo_band(gr, lat[i]);
+        key[i] = (uint64_t)(gr->band_first[b] + geo_cell_in_band(gr, b, lon[i])) << 32 | i;
+    }
+    qsort(key, n, sizeof(uint64_t), geo_cmp_u64);
+    gr->cell_start = calloc(cells + 1, sizeof(uint32_t));
+    gr->index = geo_alloc(n * sizeof(uint32_t));
+    if(!gr->cell_start) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    double *slat = geo_alloc(n * sizeof(double)), *slon = geo_alloc(n * sizeof(double));
+    for(size_t i = 0; i < n; i++) {
+        gr->index[i] = (uint32_t)key[i];
+        slat[i] = lat[gr->index[i]];
+        slon[i] = lon[gr->index[i]];
+        gr->cell_start[(key[i] >> 32) + 1]++;
+    }
+    for(uint64_t c = 0; c < cells; c++) gr->cell_start[c + 1] += gr->cell_start[c];
+    geo_points_init(&gr->sorted, slat, slon, n);
+    free(slat);
+    free(slon);
+    free(key);
+}
+
+static inline void geo_grid_free(GeoGrid *gr) {
+    free(gr->band_cells);
+    free(gr->band_first);
+    free(gr->cell_start);
+    free(gr->index);
+    geo_points_free(&gr->sorted);
+    memset(gr, 0, sizeof(*gr));
+}
+
+/*
+ * Function to find the points within radius_km (at most the grid's radius)
+ * of (lat, lon). Writes their original indices to *out, grown as needed
+ * (*cap entries), and returns how many there are.
+ */
+static inline size_t geo_grid_query(const GeoGrid *gr, double lat, double lon, double radius_km, uint32_t **out,
+                                    size_t *cap) {
+    if(!geo_within_fn) geo_simd_init();
+    double theta = radius_km / GEO_EARTH_RADIUS_KM, deg = theta * 180.0 / M_PI;
+    double a = lat * M_PI / 180.0, b = lon * M_PI / 180.0;
+    double x = cos(a) * cos(b), y = cos(a) * sin(b), z = sin(a), chord2 = geo_chord2(radius_km);
+    // Longitude half-width of the cap; the whole circle when it reaches a pole
+    double s = sin(theta) / cos(a), dlon = fabs(lat) + deg >= 90.0 || s >= 1.0 ? 180.0 : asin(s) * 180.0 / M_PI;
+    size_t count = 0;
+    for(uint32_t band = geo_band(gr, lat - deg), last = geo_band(gr, lat + deg); band <= last; band++) {
+        uint32_t k = gr->band_cells[band], first, span;
+        if(dlon >= 180.0) {
+            first = 0;
+            span = k;
+        } else {
+            first = geo_cell_in_band(gr, band, lon - dlon);
+            uint32_t end = geo_cell_in_band(gr, band, lon + dlon);
+            span = (end + k - first) % k + 1;
+        }
+        for(uint32_t i = 0; i < span; i++) {
+            uint64_t c = gr->band_first[band] + (first + i) % k;
+            size_t from = gr->cell_start[c], to = gr->cell_start[c + 1];
+            if(from == to) continue;
+            if(count + (to - from) > *cap) {
+                while(count + (to - from) > *cap) *cap = *cap ? *cap * 2 : 256;
+                *out = realloc(*out, *cap * sizeof(uint32_t));
+                if(!*out) {
+                    perror("Memory allocation failed");
+                    exit(1);
+                }
+            }
+            size_t found = geo_within_fn(&gr->sorted, x, y, z, from, to, chord2, *out + count);
+            for(size_t j = 0; j < found; j++) (*out)[count + j] = gr->index[(*out)[count + j]];
+            count += found;
+        }
+    }
+    return count;
+}
+
+#endif
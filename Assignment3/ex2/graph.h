@@ -0,0 +1,356 @@
+/*
+ * graph.h: router topology in CSR form, shared by the Assignment 3 ex2 tools.
+ *
+ * Routers are numbered 0..n-1 (router i + 1 in task2.ipynb). Links are
+ * undirected and stored once per direction:
+ *
+ *   off  uint32_t[n + 1]  adjacency of router u is adj[off[u] .. off[u+1])
+ *   adj  uint32_t[m]      neighbour, ascending within each router
+ *   w    float[m]         link cost = great-circle distance in km
+ *   lat, lon double[n]    router coordinates in degrees
+ *
+ * A topology comes either from a vertices file written by the notebook
+ * ("ip lat lon" per line) turned into the notebook's graph (every pair
+ * linked, or only pairs within a radius, a fraction T dropped at random),
+ * or from a topology store (topostore.h: the measured links, used in place),
+ * or from a synthetic generator
+ * for large experiments: routers scattered over the globe, each linked to
+ * a few routers nearby and the odd long-haul link, connected by construction.
+ */
+
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "geoindex.h"
+#include "topostore.h"
+
+#define EARTH_RADIUS_KM 6371.0
+
+typedef struct {
+    uint32_t n, m;          // routers, directed link entries (2 per link)
+    uint32_t *off, *adj;
+    float *w;
+    double *lat, *lon;
+    TsStore store;          // when loaded from a store, the arrays point into its image
+} Graph;
+
+typedef struct {
+    uint32_t u, v;
+    float w;
+} GraphEdge;
+
+static inline void *graph_alloc(size_t size) {
+    void *p = malloc(size ? size : 1);
+    if(!p) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    return p;
+}
+
+// splitmix64: small seeded generator so experiments are repeatable
+static inline uint64_t graph_rand(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static inline double graph_uniform(uint64_t *state) {
+    return (graph_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static inline double haversine_km(double lat1, double lon1, double lat2, double lon2) {
+    double to_rad = M_PI / 180.0;
+    double dlat = (lat2 - lat1) * to_rad, dlon = (lon2 - lon1) * to_rad;
+    double a = sin(dlat / 2) * sin(dlat / 2) + cos(lat1 * to_rad) * cos(lat2 * to_rad) * sin(dlon / 2) * sin(dlon / 2);
+    return 2 * EARTH_RADIUS_KM * asin(sqrt(a > 1 ? 1 : a));
+}
+
+static int graph_cmp_entry(const void *a, const void *b) {
+    const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Function to build the CSR form from undirected edges (self-loops dropped,
+ * duplicates keep their cheapest cost). Takes ownership of lat/lon.
+ */
+static inline void graph_build(Graph *g, uint32_t n, double *lat, double *lon, const GraphEdge *edges, size_t count) {
+    memset(&g->store, 0, sizeof(g->store));
+    g->n = n;
+    g->lat = lat;
+    g->lon = lon;
+    g->off = graph_alloc((n + 1) * sizeof(uint32_t));
+    memset(g->off, 0, (n + 1) * sizeof(uint32_t));
+    for(size_t i = 0; i < count; i++) {
+        if(edges[i].u == edges[i].v) continue;
+        g->off[edges[i].u + 1]++;
+        g->off[edges[i].v + 1]++;
+    }
+    for(uint32_t u = 0; u < n; u++) g->off[u + 1] += g->off[u];
+    if((uint64_t)count * 2 > UINT32_MAX) {
+        fprintf(stderr, "Too many links for 32-bit offsets\n");
+        exit(1);
+    }
+
+    // Each entry is (neighbour << 32 | cost bits) so sorting a router's list orders by neighbour, then cost
+    uint64_t *entry = graph_alloc((size_t)g->off[n] * sizeof(uint64_t));
+    uint32_t *fill = graph_alloc(n * sizeof(uint32_t));
+    memcpy(fill, g->off, n * sizeof(uint32_t));
+    for(size_t i = 0; i < count; i++) {
+        const GraphEdge *e = &edges[i];
+        if(e->u == e->v) continue;
+        uint32_t bits;
+        memcpy(&bits, &e->w, sizeof(bits));     // non-negative floats order like their bits
+        entry[fill[e->u]++] = (uint64_t)e->v << 32 | bits;
+        entry[fill[e->v]++] = (uint64_t)e->u << 32 | bits;
+    }
+    free(fill);
+
+    g->adj = graph_alloc((size_t)g->off[n] * sizeof(uint32_t));
+    g->w = graph_alloc((size_t)g->off[n] * sizeof(float));
+    uint32_t m = 0;
+    for(uint32_t u = 0; u < n; u++) {
+        uint32_t begin = g->off[u], end = g->off[u + 1];
+        qsort(entry + begin, end - begin, sizeof(uint64_t), graph_cmp_entry);
+        g->off[u] = m;
+        for(uint32_t i = begin; i < end; i++) {
+            uint32_t v = entry[i] >> 32, bits = (uint32_t)entry[i];
+            if(m > g->off[u] && g->adj[m - 1] == v) continue;
+            g->adj[m] = v;
+            memcpy(&g->w[m], &bits, sizeof(float));
+            m++;
+        }
+    }
+    g->off[n] = m;
+    g->m = m;
+    free(entry);
+}
+
+// Function to read a vertices file ("ip lat lon" per line, '#' comments). Returns the router count.
+static inline uint32_t graph_read_vertices(const char *path, double **lat_out, double **lon_out) {
+    FILE *f = fopen(path, "r");
+    if(!f) {
+        perror(path);
+        exit(1);
+    }
+    size_t n = 0, cap = 1024;
+    double *lat = graph_alloc(cap * sizeof(double)), *lon = graph_alloc(cap * sizeof(double));
+    char line[512], ip[128];
+    while(fgets(line, sizeof(line), f)) {
+        double a, b;
+        if(line[0] == '#' || sscanf(line, "%127s %lf %lf", ip, &a, &b) != 3) continue;
+        if(n == cap) {
+            cap *= 2;
+            lat = realloc(lat, cap * sizeof(double));
+            lon = realloc(lon, cap * sizeof(double));
+            if(!lat || !lon) {
+                perror("Memory allocation failed");
+                exit(1);
+            }
+        }
+        lat[n] = a;
+        lon[n] = b;
+        n++;
+    }
+    fclose(f);
+    *lat_out = lat;
+    *lon_out = lon;
+    return n;
+}
+
+// Function to build the notebook's topology: every pair linked, each kept with probability 1 - T
+static inline void graph_complete(Graph *g, uint32_t n, double *lat, double *lon, double T, uint64_t seed) {
+    size_t count = 0, cap = (size_t)n * (n - (n > 0)) / 2;
+    GraphEdge *edges = graph_alloc(cap * sizeof(GraphEdge));
+    double *row = graph_alloc(n * sizeof(double));
+    GeoPoints pts;
+    geo_points_init(&pts, lat, lon, n);
+    for(uint32_t i = 0; i < n; i++) {
+        geo_dist_row(&pts, i, i + 1, n, row);
+        for(uint32_t j = i + 1; j < n; j++) {
+            double d = row[j - i - 1];
+            // As in _build_network, a zero distance means "no link"
+            if(graph_uniform(&seed) > T && d > 0) edges[count++] = (GraphEdge){i, j, (float)d};
+        }
+    }
+    geo_points_free(&pts);
+    free(row);
+    graph_build(g, n, lat, lon, edges, count);
+    free(edges);
+}
+
+/*
+ * Function to build the notebook's topology restricted to routers at most
+ * radius_km apart, found through a GeoGrid instead of testing every pair.
+ * Each link is still kept with probability 1 - T, decided from a hash of
+ * the pair so the result does not depend on query order.
+ */
+static inline void graph_radius(Graph *g, uint32_t n, double *lat, double *lon, double radius_km, double T,
+                                uint64_t seed) {
+    GeoGrid grid;
+    GeoPoints pts;
+    geo_grid_build(&grid, lat, lon, n, radius_km);
+    geo_points_init(&pts, lat, lon, n);
+    size_t count = 0, cap = 1024, hits_cap = 0;
+    GraphEdge *edges = graph_alloc(cap * sizeof(GraphEdge));
+    uint32_t *hits = NULL;
+    for(uint32_t i = 0; i < n; i++) {
+        size_t found = geo_grid_query(&grid, lat[i], lon[i], radius_km, &hits, &hits_cap);
+        for(size_t k = 0; k < found; k++) {
+            uint32_t j = hits[k];
+            if(j <= i) continue;
+            uint64_t state = seed ^ ((uint64_t)i << 32 | j);
+            double d = geo_dist_scalar(&pts, i, j);
+            if(graph_uniform(&state) <= T || d <= 0) continue;
+            if(count == cap) {
+                cap *= 2;
+                edges = realloc(edges, cap * sizeof(GraphEdge));
+                if(!edges) {
+                    perror("Memory allocation failed");
+                    exit(1);
+                }
+            }
+            edges[count++] = (GraphEdge){i, j, (float)d};
+        }
+    }
+    free(hits);
+    geo_points_free(&pts);
+    geo_grid_free(&grid);
+    graph_build(g, n, lat, lon, edges, count);
+    free(edges);
+}
+
+static inline uint64_t graph_cell_key(double lat, double lon) {
+    // 1-degree latitude bands, alternating longitude direction so neighbours in the order stay close
+    uint64_t band = (uint64_t)(lat + 90.0);
+    double x = (lon + 180.0) / 360.0;
+    if(band & 1) x = 1.0 - x;
+    return band << 32 | (uint64_t)(x * 4294967295.0);
+}
+
+static int graph_cmp_key(const void *a, const void *b) {
+    const uint64_t *x = a, *y = b;
+    return x[0] < y[0] ? -1 : x[0] > y[0];
+}
+
+/*
+ * Function to generate a synthetic topology of n routers with about the
+ * given average degree. Routers are uniform over the sphere and numbered
+ * along a banded sweep; each links to the next router in the sweep (so the
+ * graph is connected) and to random routers among the next 64, and one
+ * link in a hundred goes to a random router anywhere.
+ */
+static inline void graph_generate(Graph *g, uint32_t n, unsigned degree, uint64_t seed) {
+    uint64_t (*key)[2] = graph_alloc((size_t)n * sizeof(*key));
+    double *lat = graph_alloc(n * sizeof(double)), *lon = graph_alloc(n * sizeof(double));
+    for(uint32_t i = 0; i < n; i++) {
+        double a = asin(2 * graph_uniform(&seed) - 1) * 180.0 / M_PI, b = graph_uniform(&seed) * 360.0 - 180.0;
+        lat[i] = a;
+        lon[i] = b;
+        key[i][0] = graph_cell_key(a, b);
+        key[i][1] = i;
+    }
+    qsort(key, n, sizeof(*key), graph_cmp_key);
+    double *slat = graph_alloc(n * sizeof(double)), *slon = graph_alloc(n * sizeof(double));
+    for(uint32_t i = 0; i < n; i++) {
+        slat[i] = lat[key[i][1]];
+        slon[i] = lon[key[i][1]];
+    }
+    free(lat);
+    free(lon);
+    free(key);
+
+    // Each link adds 2 to the degree sum; an odd degree gets its last half link with probability 1/2
+    unsigned extra = degree > 2 ? degree / 2 - 1 : 0, half = degree > 2 && degree % 2;
+    size_t count = 0;
+    GraphEdge *edges = graph_alloc((size_t)n * (extra + half + 1) * sizeof(GraphEdge));
+    for(uint32_t i = 0; i < n; i++) {
+        for(unsigned k = 0; k <= extra + half; k++) {
+            uint32_t j;
+            if(k == 0) {
+                if(i + 1 == n) continue;
+                j = i + 1;
+            } else if(k > extra && graph_rand(&seed) % 2) {
+                continue;
+            } else if(graph_rand(&seed) % 100 == 0) {
+                j = graph_rand(&seed) % n;
+            } else {
+                j = i + 1 + graph_rand(&seed) % 64;
+                if(j >= n) continue;
+            }
+            edges[count++] = (GraphEdge){i, j, (float)haversine_km(slat[i], slon[i], slat[j], slon[j])};
+        }
+    }
+    graph_build(g, n, slat, slon, edges, count);
+    free(edges);
+}
+
+static inline void graph_free(Graph *g) {
+    if(g->store.hdr) {
+        ts_close(&g->store);
+        memset(g, 0, sizeof(*g));
+        return;
+    }
+    free(g->off);
+    free(g->adj);
+    free(g->w);
+    free(g->lat);
+    free(g->lon);
+    memset(g, 0, sizeof(*g));
+}
+
+// Function to find the entry of link u -> v (m if absent)
+static inline uint32_t graph_find(const Graph *g, uint32_t u, uint32_t v) {
+    uint32_t lo = g->off[u], hi = g->off[u + 1], end = hi;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if(g->adj[mid] < v) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < end && g->adj[lo] == v ? lo : g->m;
+}
+
+/*
+ * Function to load a topology store: the graph is the store's image itself
+ * (link costs are the km column), with pending delta segments folded in.
+ */
+static inline void graph_load_store(Graph *g, const char *path) {
+    memset(g, 0, sizeof(*g));
+    if(ts_open(path, &g->store) < 0) exit(1);
+    g->n = g->store.hdr->node_count;
+    g->m = g->store.hdr->slot_count;
+    g->off = g->store.off;
+    g->adj = g->store.adj;
+    g->w = g->store.km;
+    g->lat = g->store.lat;
+    g->lon = g->store.lon;
+}
+
+/*
+ * Function to load the topology selected on a tool's command line: a
+ * topology store as is, or a vertices file (notebook graph with drop
+ * fraction T, only links up to radius_km long if that is positive) if one
+ * is given, otherwise n synthetic routers of the given degree.
+ */
+static inline void graph_open(Graph *g, const char *vertices, double T, double radius_km, uint32_t n, unsigned degree,
+                              uint64_t seed) {
+    if(vertices && ts_is_store(vertices)) {
+        graph_load_store(g, vertices);
+    } else if(vertices) {
+        double *lat, *lon;
+        uint32_t count = graph_read_vertices(vertices, &lat, &lon);
+        if(radius_km > 0) graph_radius(g, count, lat, lon, radius_km, T, seed);
+        else graph_complete(g, count, lat, lon, T, seed);
+    } else {
+        graph_generate(g, n, degree, seed);
+    }
+}
+
+#endif
@@ -0,0 +1,373 @@
+/*
+ * lsasim: discrete-event simulation of link-state (LSA) flooding.
+ *
+ * Native counterpart of Network.flood_lsas in task2.ipynb for large
+ * topologies (graph.h). Routers are plain arrays indexed by router id; an
+ * LSA is one immutable record (origin, sequence number, link list) that
+ * every router's LSDB points at instead of copying. Deliveries are events
+ * in a binary heap ordered by arrival time, where a link's delay is its
+ * propagation time (distance / 200 km per ms in fibre) plus a per-hop
+ * processing time. A router installs an LSA newer than its LSDB entry and
+ * floods it on every other link, exactly like process_lsa / flood_lsas;
+ * older or equal copies are dropped. A copy sent to a router that already
+ * holds the LSA is counted when sent and never queued, as nothing can
+ * change before it arrives. With -u every link takes one time unit, so
+ * arrival times are the notebook's synchronous rounds.
+ *
+ * Every router originates an LSA at time 0. LSAs of different origins never
+ * interact, so each origin's flood runs to completion on its own and the
+ * queue only ever holds one wavefront. The LSDBs of all originators
+ * take n * n entries, so on large topologies only a sample of originators
+ * (-s) is simulated; the total for all originators is also given exactly,
+ * since each router forwards an LSA once to all but the link it came on.
+ * With -f, links then fail one at a time after the network has converged:
+ * both ends originate a new LSA (sequence number + 1) without the link,
+ * and the cost of spreading it is reported per failure.
+ *
+ * Build: gcc -O2 -Wall -o lsasim lsasim.c -lm
+ * Usage: lsasim [-v vertices.txt] [-T 0.3] [-R km] [-n routers] [-d degree] [-S seed]
+ *               [-s originators] [-u] [-p proc_ms] [-f failures]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include "graph.h"
+
+#define FIBRE_KM_PER_MS 200.0
+#define MAX_LSDB_ENTRIES (1u << 28)     // routers * tracked originators
+
+typedef struct {
+    double t;
+    uint32_t to, from;
+    uint32_t lsa;
+    uint32_t hops;                      // links crossed since origination
+} Event;
+
+typedef struct {
+    uint32_t origin, seq;
+    uint32_t links, count;              // range of the link pool
+} Lsa;
+
+typedef struct {
+    uint32_t to;
+    float w;
+} PoolLink;
+
+typedef struct {
+    uint64_t messages, installs, duplicates;
+    double last_install, last_message;
+    uint32_t rounds;                    // most links crossed by any message
+} FloodStats;
+
+Graph g;
+int unit_delay = 0;
+double proc_ms = 0.1;
+
+Event *heap;
+size_t heap_count, heap_cap;
+
+Lsa *lsas;
+size_t lsa_count, lsa_cap;
+PoolLink *pool;                         // link lists of all LSAs
+size_t pool_count, pool_cap;
+
+uint8_t *down;                          // per directed link entry
+int32_t *slot_of;                       // originator -> LSDB slot, -1 if not tracked
+uint32_t slot_count, slot_cap;
+uint32_t *lsdb;                         // [slot * n + router] = LSA index + 1, 0 = none
+
+uint64_t events_processed;
+
+static void *grow(void *p, size_t *cap, size_t need, size_t elem) {
+    if(need <= *cap) return p;
+    while(*cap < need) *cap = *cap ? *cap * 2 : 1024;
+    p = realloc(p, *cap * elem);
+    if(!p) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    return p;
+}
+
+static void heap_push(Event e) {
+    heap = grow(heap, &heap_cap, heap_count + 1, sizeof(Event));
+    size_t i = heap_count++;
+    while(i > 0) {
+        size_t parent = (i - 1) / 2;
+        if(heap[parent].t <= e.t) break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = e;
+}
+
+static Event heap_pop(void) {
+    Event top = heap[0], last = heap[--heap_count];
+    size_t i = 0;
+    for(;;) {
+        size_t child = 2 * i + 1;
+        if(child >= heap_count) break;
+        if(child + 1 < heap_count && heap[child + 1].t < heap[child].t) child++;
+        if(last.t <= heap[child].t) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+static double link_delay(uint32_t e) {
+    return unit_delay ? 1.0 : g.w[e] / FIBRE_KM_PER_MS + proc_ms;
+}
+
+// Function to send an LSA from router u on every working link except the one to `except`
+static void flood(uint32_t u, uint32_t except, uint32_t lsa, double t, uint32_t hops, FloodStats *st) {
+    const Lsa *l = &lsas[lsa];
+    const uint32_t *row = &lsdb[(size_t)slot_of[l->origin] * g.n];
+    for(uint32_t e = g.off[u]; e < g.off[u + 1]; e++) {
+        uint32_t v = g.adj[e];
+        if(down[e] || v == except) continue;
+        st->messages++;
+        double arrival = t + link_delay(e);
+        if(row[v] && lsas[row[v] - 1].seq >= l->seq) {
+            // v already holds this LSA, so the copy will be dropped: account for it without an event
+            st->duplicates++;
+            if(arrival > st->last_message) st->last_message = arrival;
+            if(hops + 1 > st->rounds) st->rounds = hops + 1;
+            continue;
+        }
+        heap_push((Event){arrival, v, u, lsa, hops + 1});
+    }
+}
+
+// Function to create an LSA for router u from its working links
+static uint32_t make_lsa(uint32_t u, uint32_t seq) {
+    lsas = grow(lsas, &lsa_cap, lsa_count + 1, sizeof(Lsa));
+    pool = grow(pool, &pool_cap, pool_count + (g.off[u + 1] - g.off[u]), sizeof(PoolLink));
+    Lsa *l = &lsas[lsa_count];
+    *l = (Lsa){u, seq, pool_count, 0};
+    for(uint32_t e = g.off[u]; e < g.off[u + 1]; e++) {
+        if(down[e]) continue;
+        pool[pool_count++] = (PoolLink){g.adj[e], g.w[e]};
+        l->count++;
+    }
+    return lsa_count++;
+}
+
+static uint32_t track(uint32_t u) {
+    if(slot_of[u] < 0) {
+        if(slot_count == slot_cap) {
+            fprintf(stderr, "Out of LSDB slots\n");
+            exit(1);
+        }
+        slot_of[u] = slot_count++;
+    }
+    return slot_of[u];
+}
+
+// Function to originate an LSA at router u: install it locally and send it out
+static void originate(uint32_t u, uint32_t lsa, double t, FloodStats *st) {
+    lsdb[(size_t)track(u) * g.n + u] = lsa + 1;
+    st->installs++;
+    flood(u, UINT32_MAX, lsa, t, 0, st);
+}
+
+// Function to run events until the network is quiet
+static void run(FloodStats *st) {
+    while(heap_count) {
+        Event ev = heap_pop();
+        events_processed++;
+        const Lsa *l = &lsas[ev.lsa];
+        uint32_t *entry = &lsdb[(size_t)slot_of[l->origin] * g.n + ev.to];
+        if(ev.t > st->last_message) st->last_message = ev.t;
+        if(ev.hops > st->rounds) st->rounds = ev.hops;
+        if(*entry && lsas[*entry - 1].seq >= l->seq) {
+            st->duplicates++;
+            continue;
+        }
+        *entry = ev.lsa + 1;
+        st->installs++;
+        if(ev.t > st->last_install) st->last_install = ev.t;
+        flood(ev.to, ev.from, ev.lsa, ev.t, ev.hops, st);
+    }
+}
+
+// Function to count messages of a flood from every router (exact, no simulation)
+static uint64_t full_flood_messages(uint32_t *components) {
+    // Per component C: |C| originators, each reaching all of C once: sum(deg - 1) + 1 messages
+    uint32_t *comp = graph_alloc(g.n * sizeof(uint32_t)), *queue = graph_alloc(g.n * sizeof(uint32_t));
+    memset(comp, 0xff, g.n * sizeof(uint32_t));
+    uint64_t total = 0;
+    *components = 0;
+    for(uint32_t s = 0; s < g.n; s++) {
+        if(comp[s] != UINT32_MAX) continue;
+        size_t head = 0, tail = 0;
+        uint64_t sum = 0;
+        comp[s] = *components;
+        queue[tail++] = s;
+        while(head < tail) {
+            uint32_t u = queue[head++];
+            sum += g.off[u + 1] - g.off[u];
+            for(uint32_t e = g.off[u]; e < g.off[u + 1]; e++) {
+                if(comp[g.adj[e]] == UINT32_MAX) {
+                    comp[g.adj[e]] = *components;
+                    queue[tail++] = g.adj[e];
+                }
+            }
+        }
+        total += tail * (sum - tail + 1);
+        (*components)++;
+    }
+    free(comp);
+    free(queue);
+    return total;
+}
+
+static const char *time_unit(void) {
+    return unit_delay ? "rounds" : "ms";
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-v vertices.txt] [-T 0.3] [-R km] [-n routers] [-d degree] [-S seed]\n"
+            "          [-s originators] [-u] [-p proc_ms] [-f failures]\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *vertices = NULL;
+    double T = 0.3, radius = 0;
+    uint32_t routers = 100000, sample = 0;
+    unsigned degree = 8, failures = 0;
+    uint64_t seed = 1;
+    int opt;
+    while((opt = getopt(argc, argv, "v:T:R:n:d:S:s:up:f:")) != -1) {
+        switch(opt) {
+        case 'v': vertices = optarg; break;
+        case 'T': T = atof(optarg); break;
+        case 'R': radius = atof(optarg); break;
+        case 'n': routers = strtoul(optarg, NULL, 10); break;
+        case 'd': degree = atoi(optarg); break;
+        case 'S': seed = strtoull(optarg, NULL, 10); break;
+        case 's': sample = strtoul(optarg, NULL, 10); break;
+        case 'u': unit_delay = 1; break;
+        case 'p': proc_ms = atof(optarg); break;
+        case 'f': failures = atoi(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if(optind != argc || (!vertices && routers < 2)) usage(argv[0]);
+
+    double t0 = now();
+    graph_open(&g, vertices, T, radius, routers, degree, seed);
+    uint32_t components;
+    uint64_t exact = full_flood_messages(&components);
+    printf("Topology: %u routers, %u links, average degree %.2f, %u component(s) (built in %.2f s)\n", g.n, g.m / 2,
+           g.n ? (double)g.m / g.n : 0.0, components, now() - t0);
+    if(g.n == 0) return 0;
+
+    // Originators: all of them if their LSDBs fit, otherwise an evenly spaced sample
+    if(sample == 0 || sample > g.n) sample = (uint64_t)g.n * g.n <= MAX_LSDB_ENTRIES ? g.n : 64;
+    slot_cap = sample + 2 * failures;
+    if((uint64_t)slot_cap * g.n > MAX_LSDB_ENTRIES) {
+        fprintf(stderr, "%u originators x %u routers do not fit in memory; use -s\n", slot_cap, g.n);
+        return 1;
+    }
+    lsdb = calloc((size_t)slot_cap * g.n, sizeof(uint32_t));
+    down = calloc(g.m ? g.m : 1, 1);
+    slot_of = graph_alloc(g.n * sizeof(int32_t));
+    if(!lsdb || !down) {
+        perror("Memory allocation failed");
+        return 1;
+    }
+    memset(slot_of, 0xff, g.n * sizeof(int32_t));
+    uint32_t *seq = calloc(g.n, sizeof(uint32_t));      // current sequence number per router
+    uint32_t *current = graph_alloc(g.n * sizeof(uint32_t));    // its latest LSA
+    if(!seq) {
+        perror("Memory allocation failed");
+        return 1;
+    }
+
+    FloodStats st = {0};
+    t0 = now();
+    uint64_t offset = graph_rand(&seed) % g.n;
+    for(uint32_t k = 0; k < sample; k++) {
+        uint32_t u = (offset + (uint64_t)k * g.n / sample) % g.n;
+        current[u] = make_lsa(u, ++seq[u]);
+        originate(u, current[u], 0.0, &st);
+        run(&st);
+    }
+    double wall = now() - t0;
+
+    printf("\nInitial flooding (%u of %u originators simulated):\n", sample, g.n);
+    printf("  LSA messages:       %llu (%llu installed, %llu duplicates dropped)\n", (unsigned long long)st.messages,
+           (unsigned long long)st.installs, (unsigned long long)st.duplicates);
+    printf("  Messages per LSA:   %.1f\n", (double)st.messages / sample);
+    printf("  Rounds (max hops):  %u\n", st.rounds);
+    printf("  Converged at:       %.3f %s (last duplicate at %.3f)\n", st.last_install, time_unit(), st.last_message);
+    printf("  LSDB size:          %.1f entries per router for these originators\n", (double)st.installs / g.n);
+    printf("  Messages, all %u originators (exact): %llu\n", g.n, (unsigned long long)exact);
+    printf("  Simulated %llu events in %.2f s (%.1f M events/s)\n", (unsigned long long)events_processed, wall,
+           wall > 0 ? events_processed / wall / 1e6 : 0.0);
+
+    double clock = st.last_message;
+    if(failures && g.m == 0) {
+        printf("\nNo links to fail, -f ignored\n");
+        failures = 0;
+    }
+    for(unsigned f = 0; f < failures; f++) {
+        // Pick a working link; its reverse entry fails with it
+        uint32_t e, u, tries = 0;
+        do {
+            e = graph_rand(&seed) % g.m;
+        } while(down[e] && ++tries < 1000000);
+        if(down[e]) break;
+        uint32_t lo = 0, hi = g.n;
+        while(hi - lo > 1) {
+            uint32_t mid = (lo + hi) / 2;
+            if(g.off[mid] <= e) lo = mid;
+            else hi = mid;
+        }
+        u = lo;
+        uint32_t v = g.adj[e];
+        down[e] = down[graph_find(&g, v, u)] = 1;
+
+        // Ends that were not sampled are taken as converged on their current LSA first
+        uint32_t ends[2] = {u, v};
+        for(int i = 0; i < 2; i++) {
+            uint32_t x = ends[i];
+            if(slot_of[x] >= 0) continue;
+            uint32_t s = track(x);
+            seq[x]++;
+            current[x] = make_lsa(x, seq[x]);
+            for(uint32_t r = 0; r < g.n; r++) lsdb[(size_t)s * g.n + r] = current[x] + 1;
+        }
+
+        FloodStats fs = {0};
+        fs.last_install = fs.last_message = clock;
+        events_processed = 0;
+        t0 = now();
+        for(int i = 0; i < 2; i++) {
+            current[ends[i]] = make_lsa(ends[i], ++seq[ends[i]]);
+            originate(ends[i], current[ends[i]], clock, &fs);
+        }
+        run(&fs);
+        printf("\nLink %u-%u (%.0f km) failed: %llu messages, %llu installs, %u rounds, converged after %.3f %s "
+               "(%.3f ms wall)\n",
+               u + 1, v + 1, g.w[e], (unsigned long long)fs.messages, (unsigned long long)fs.installs, fs.rounds,
+               fs.last_install - clock, time_unit(), (now() - t0) * 1e3);
+        clock = fs.last_message;
+    }
+    return 0;
+}
@@ -0,0 +1,424 @@
+/*
+ * routes: all-pairs forwarding tables and path queries over a CSR topology.
+ *
+ * Network.dijkstra / get_forwarding_table / get_routing_path in task2.ipynb
+ * run a heapq Dijkstra for every query. routes runs Dijkstra once from
+ * every router, in parallel (threads take sources from a shared counter,
+ * each with an indexed 4-ary heap; on these sparse graphs it beat a radix
+ * heap over the float distances), and keeps just the first hop: entry
+ * [s][d] is the position of the outgoing link in s's adjacency list
+ * (graph.h), 1, 2 or 4 bytes wide depending on the largest degree. A path
+ * is then a walk through the routers' own tables, and its cost the sum of
+ * the link costs on the way. With -o the matrix lives in a file mapping
+ * instead of memory, for topologies whose table outgrows RAM.
+ *
+ * -b compares against the notebook's approach (a fresh binary-heap
+ * Dijkstra per query, here in C) on synthetic topologies of each size.
+ *
+ * Build: gcc -O2 -Wall -pthread -o routes routes.c -lm
+ * Usage: routes [-v vertices.txt] [-T 0.3] [-R km] [-n routers] [-d degree] [-S seed] [-j threads]
+ *               [-o table.nh] [-t router] [-p src-dst]... [-q queries]
+ *        routes -b 1000,10000,50000 [-d degree] [-j threads] [-o table.nh]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "graph.h"
+
+#define MAX_PATHS 64
+#define NOT_QUEUED UINT32_MAX
+#define DONE (UINT32_MAX - 1)
+
+// Indexed 4-ary min-heap of routers keyed by their tentative distance (decrease-key in place)
+typedef struct {
+    uint32_t *heap, *pos;   // pos[v] = index in heap, NOT_QUEUED, or DONE
+    const float *key;
+    uint32_t size;
+} QuadHeap;
+
+typedef struct {
+    uint8_t *data;
+    int width;              // bytes per entry
+    uint32_t none;          // entry for "no route"
+    size_t bytes;
+} NextHops;
+
+Graph g;
+NextHops table;
+int nthreads;
+uint32_t next_source;
+
+static inline void heap_up(QuadHeap *q, uint32_t i) {
+    uint32_t v = q->heap[i];
+    float k = q->key[v];
+    while(i > 0) {
+        uint32_t parent = (i - 1) / 4, pv = q->heap[parent];
+        if(q->key[pv] <= k) break;
+        q->heap[i] = pv;
+        q->pos[pv] = i;
+        i = parent;
+    }
+    q->heap[i] = v;
+    q->pos[v] = i;
+}
+
+static inline uint32_t heap_pop(QuadHeap *q) {
+    uint32_t top = q->heap[0], v = q->heap[--q->size], i = 0;
+    float k = q->key[v];
+    for(;;) {
+        uint32_t c = 4 * i + 1, best = c;
+        if(c >= q->size) break;
+        uint32_t end = c + 4 < q->size ? c + 4 : q->size;
+        float bk = q->key[q->heap[c]];
+        for(uint32_t j = c + 1; j < end; j++) {
+            if(q->key[q->heap[j]] < bk) {
+                bk = q->key[q->heap[j]];
+                best = j;
+            }
+        }
+        if(k <= bk) break;
+        q->heap[i] = q->heap[best];
+        q->pos[q->heap[i]] = i;
+        i = best;
+    }
+    if(q->size) {
+        q->heap[i] = v;
+        q->pos[v] = i;
+    }
+    q->pos[top] = DONE;
+    return top;
+}
+
+static inline uint32_t nh_get(uint32_t s, uint32_t d) {
+    size_t i = (size_t)s * g.n + d;
+    switch(table.width) {
+    case 1: return table.data[i];
+    case 2: return ((uint16_t *)table.data)[i];
+    default: return ((uint32_t *)table.data)[i];
+    }
+}
+
+static inline void nh_set(uint32_t s, uint32_t d, uint32_t slot) {
+    size_t i = (size_t)s * g.n + d;
+    switch(table.width) {
+    case 1: table.data[i] = slot; break;
+    case 2: ((uint16_t *)table.data)[i] = slot; break;
+    default: ((uint32_t *)table.data)[i] = slot;
+    }
+}
+
+// Function to fill row s of the table: Dijkstra from s, remembering the first link of each path
+static void build_row(uint32_t s, QuadHeap *q, float *dist, uint32_t *first) {
+    for(uint32_t v = 0; v < g.n; v++) {
+        dist[v] = INFINITY;
+        first[v] = table.none;
+        q->pos[v] = NOT_QUEUED;
+    }
+    dist[s] = 0;
+    q->size = 0;
+    q->heap[q->size++] = s;
+    q->pos[s] = 0;
+    while(q->size) {
+        uint32_t u = heap_pop(q);
+        float du = dist[u];
+        for(uint32_t e = g.off[u]; e < g.off[u + 1]; e++) {
+            uint32_t v = g.adj[e];
+            float nd = du + g.w[e];
+            if(nd >= dist[v]) continue;
+            dist[v] = nd;
+            first[v] = u == s ? e - g.off[s] : first[u];
+            if(q->pos[v] == NOT_QUEUED) q->pos[v] = q->size++;
+            q->heap[q->pos[v]] = v;
+            heap_up(q, q->pos[v]);
+        }
+    }
+    for(uint32_t d = 0; d < g.n; d++) nh_set(s, d, first[d]);
+}
+
+static void *build_worker(void *arg) {
+    (void)arg;
+    float *dist = graph_alloc(g.n * sizeof(float));
+    uint32_t *first = graph_alloc(g.n * sizeof(uint32_t));
+    QuadHeap q = {graph_alloc(g.n * sizeof(uint32_t)), graph_alloc(g.n * sizeof(uint32_t)), dist, 0};
+    for(;;) {
+        uint32_t s = __atomic_fetch_add(&next_source, 1, __ATOMIC_RELAXED);
+        if(s >= g.n) break;
+        build_row(s, &q, dist, first);
+    }
+    free(q.heap);
+    free(q.pos);
+    free(dist);
+    free(first);
+    return NULL;
+}
+
+// Function to allocate the table (in memory, or mapped from a file) and fill it on all threads
+static int build_tables(const char *path) {
+    uint32_t max_degree = 0;
+    for(uint32_t u = 0; u < g.n; u++) {
+        if(g.off[u + 1] - g.off[u] > max_degree) max_degree = g.off[u + 1] - g.off[u];
+    }
+    table.width = max_degree < 0xff ? 1 : max_degree < 0xffff ? 2 : 4;
+    table.none = table.width == 4 ? UINT32_MAX : (1u << (8 * table.width)) - 1;
+    table.bytes = (size_t)g.n * g.n * table.width;
+
+    int fd = -1, flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if(path) {
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0 || ftruncate(fd, table.bytes) < 0) {
+            perror(path);
+            if(fd >= 0) close(fd);
+            return -1;
+        }
+        flags = MAP_SHARED;
+    }
+    table.data = mmap(NULL, table.bytes ? table.bytes : 1, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if(fd >= 0) close(fd);
+    if(table.data == MAP_FAILED) {
+        perror("mmap failed");
+        return -1;
+    }
+
+    next_source = 0;
+    pthread_t *threads = graph_alloc(nthreads * sizeof(pthread_t));
+    for(int i = 0; i < nthreads; i++) {
+        if(pthread_create(&threads[i], NULL, build_worker, NULL) != 0) {
+            perror("Thread creation failed");
+            return -1;
+        }
+    }
+    for(int i = 0; i < nthreads; i++) pthread_join(threads[i], NULL);
+    free(threads);
+    return 0;
+}
+
+static void free_tables(void) {
+    munmap(table.data, table.bytes ? table.bytes : 1);
+    memset(&table, 0, sizeof(table));
+}
+
+// Function to walk the tables from s to d. Returns the hop count (-1 if unreachable), path optional.
+static int walk(uint32_t s, uint32_t d, double *cost, uint32_t *path, int max_path) {
+    int hops = 0;
+    *cost = 0;
+    if(path && max_path > 0) path[0] = s;
+    for(uint32_t x = s; x != d; hops++) {
+        uint32_t slot = nh_get(x, d);
+        if(slot == table.none || (uint32_t)hops >= g.n) return -1;
+        uint32_t e = g.off[x] + slot;
+        *cost += g.w[e];
+        x = g.adj[e];
+        if(path && hops + 1 < max_path) path[hops + 1] = x;
+    }
+    return hops;
+}
+
+typedef struct {
+    double d;
+    uint32_t v;
+} BinItem;
+
+// Function to answer one query the notebook's way: a full binary-heap Dijkstra, then backtrack
+static double dijkstra_query(uint32_t s, uint32_t d, double *dist, uint32_t *pred, BinItem *heap, uint32_t *hops) {
+    for(uint32_t v = 0; v < g.n; v++) {
+        dist[v] = INFINITY;
+        pred[v] = UINT32_MAX;
+    }
+    size_t count = 0;
+    dist[s] = 0;
+    heap[count++] = (BinItem){0, s};
+    while(count) {
+        BinItem top = heap[0], last = heap[--count];
+        size_t i = 0, c;
+        while((c = 2 * i + 1) < count) {
+            if(c + 1 < count && heap[c + 1].d < heap[c].d) c++;
+            if(last.d <= heap[c].d) break;
+            heap[i] = heap[c];
+            i = c;
+        }
+        heap[i] = last;
+        if(top.d > dist[top.v]) continue;
+        for(uint32_t e = g.off[top.v]; e < g.off[top.v + 1]; e++) {
+            double nd = top.d + g.w[e];
+            if(nd >= dist[g.adj[e]]) continue;
+            dist[g.adj[e]] = nd;
+            pred[g.adj[e]] = top.v;
+            for(i = count++; i > 0 && heap[(i - 1) / 2].d > nd; i = (i - 1) / 2) heap[i] = heap[(i - 1) / 2];
+            heap[i] = (BinItem){nd, g.adj[e]};
+        }
+    }
+    *hops = 0;
+    for(uint32_t x = d; pred[x] != UINT32_MAX; x = pred[x]) (*hops)++;
+    return dist[d];
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Function to time random path queries both ways and check they agree.
+ * Dijkstra per query is slow on big graphs, so it gets at most 200 queries.
+ */
+static void time_queries(uint32_t queries, uint64_t *seed, double *walk_us, double *dijkstra_us, uint32_t *bad) {
+    uint32_t *src = graph_alloc(queries * sizeof(uint32_t)), *dst = graph_alloc(queries * sizeof(uint32_t));
+    double *cost = graph_alloc(queries * sizeof(double));
+    for(uint32_t i = 0; i < queries; i++) {
+        src[i] = graph_rand(seed) % g.n;
+        dst[i] = graph_rand(seed) % g.n;
+    }
+    uint32_t path[MAX_PATHS];
+    double t0 = now();
+    for(uint32_t i = 0; i < queries; i++) {
+        if(walk(src[i], dst[i], &cost[i], path, MAX_PATHS) < 0) cost[i] = INFINITY;
+    }
+    *walk_us = (now() - t0) * 1e6 / (queries ? queries : 1);
+
+    uint32_t slow = queries < 200 ? queries : 200;
+    double *dist = graph_alloc(g.n * sizeof(double));
+    uint32_t *pred = graph_alloc(g.n * sizeof(uint32_t));
+    BinItem *heap = graph_alloc(((size_t)g.m + 1) * sizeof(BinItem));
+    uint32_t hops;
+    *bad = 0;
+    t0 = now();
+    for(uint32_t i = 0; i < slow; i++) {
+        double want = dijkstra_query(src[i], dst[i], dist, pred, heap, &hops);
+        if(isinf(want) != isinf(cost[i]) || (!isinf(want) && fabs(want - cost[i]) > 1e-3 * (want > 1 ? want : 1)))
+            (*bad)++;
+    }
+    *dijkstra_us = (now() - t0) * 1e6 / (slow ? slow : 1);
+    free(dist);
+    free(pred);
+    free(heap);
+    free(src);
+    free(dst);
+    free(cost);
+}
+
+static void benchmark(const char *sizes, unsigned degree, const char *path) {
+    printf("%8s %9s %5s %10s %12s %11s %13s %9s\n", "Routers", "Links", "Bytes", "Table MB", "Build s",
+           "Walk us", "Dijkstra us", "Mismatch");
+    const char *p = sizes;
+    while(*p) {
+        uint32_t n = strtoul(p, (char **)&p, 10);
+        if(*p == ',') p++;
+        if(n < 2) continue;
+        uint64_t seed = n;
+        graph_generate(&g, n, degree, seed);
+        double t0 = now();
+        if(build_tables(path) < 0) exit(1);
+        double build = now() - t0;
+        double walk_us, dijkstra_us;
+        uint32_t bad;
+        time_queries(100000, &seed, &walk_us, &dijkstra_us, &bad);
+        printf("%8u %9u %5d %10.1f %12.2f %11.3f %13.1f %9u\n", g.n, g.m / 2, table.width, table.bytes / 1e6, build,
+               walk_us, dijkstra_us, bad);
+        fflush(stdout);
+        free_tables();
+        graph_free(&g);
+    }
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-v vertices.txt] [-T 0.3] [-R km] [-n routers] [-d degree] [-S seed] [-j threads]\n"
+            "          [-o table.nh] [-t router] [-p src-dst]... [-q queries]\n"
+            "       %s -b 1000,10000,50000 [-d degree] [-j threads] [-o table.nh]\n",
+            prog, prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *vertices = NULL, *out = NULL, *bench = NULL;
+    double T = 0.3, radius = 0;
+    uint32_t routers = 1000, show = 0, queries = 0, npaths = 0;
+    uint32_t paths[MAX_PATHS][2];
+    unsigned degree = 8;
+    uint64_t seed = 1;
+    int opt;
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    while((opt = getopt(argc, argv, "v:T:R:n:d:S:j:o:t:p:q:b:")) != -1) {
+        switch(opt) {
+        case 'v': vertices = optarg; break;
+        case 'T': T = atof(optarg); break;
+        case 'R': radius = atof(optarg); break;
+        case 'n': routers = strtoul(optarg, NULL, 10); break;
+        case 'd': degree = atoi(optarg); break;
+        case 'S': seed = strtoull(optarg, NULL, 10); break;
+        case 'j': nthreads = atoi(optarg); break;
+        case 'o': out = optarg; break;
+        case 't': show = strtoul(optarg, NULL, 10); break;
+        case 'p':
+            if(npaths == MAX_PATHS || sscanf(optarg, "%u-%u", &paths[npaths][0], &paths[npaths][1]) != 2)
+                usage(argv[0]);
+            npaths++;
+            break;
+        case 'q': queries = strtoul(optarg, NULL, 10); break;
+        case 'b': bench = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if(optind != argc) usage(argv[0]);
+    if(nthreads < 1) nthreads = 1;
+    if(bench) {
+        benchmark(bench, degree, out);
+        return 0;
+    }
+
+    graph_open(&g, vertices, T, radius, routers, degree, seed);
+    double t0 = now();
+    if(build_tables(out) < 0) return 1;
+    printf("Topology: %u routers, %u links; next-hop tables: %d byte(s) per entry, %.1f MB, built in %.3f s on %d "
+           "thread(s)\n",
+           g.n, g.m / 2, table.width, table.bytes / 1e6, now() - t0, nthreads);
+
+    // Router ids are 1-based on the command line and in the output, as in the notebook
+    if(show >= 1 && show <= g.n) {
+        uint32_t s = show - 1;
+        printf("\nForwarding Table for Router %u:\n%-12s%-10s%-10s\n", show, "Destination", "Next Hop", "Cost");
+        for(uint32_t d = 0; d < g.n; d++) {
+            if(d == s) continue;
+            uint32_t slot = nh_get(s, d);
+            double cost;
+            if(slot == table.none || walk(s, d, &cost, NULL, 0) < 0) {
+                printf("%-12u%-10s%-10s\n", d + 1, "-", "inf");
+            } else {
+                printf("%-12u%-10u%-10.2f\n", d + 1, g.adj[g.off[s] + slot] + 1, cost);
+            }
+        }
+    }
+    for(uint32_t i = 0; i < npaths; i++) {
+        uint32_t s = paths[i][0] - 1, d = paths[i][1] - 1, path[MAX_PATHS];
+        double cost;
+        if(s >= g.n || d >= g.n) {
+            fprintf(stderr, "No router %u or %u\n", paths[i][0], paths[i][1]);
+            continue;
+        }
+        int hops = walk(s, d, &cost, path, MAX_PATHS);
+        if(hops < 0) {
+            printf("\nNo path exists from %u to %u\n", s + 1, d + 1);
+            continue;
+        }
+        printf("\nRouting Path from %u to %u:", s + 1, d + 1);
+        for(int k = 0; k <= hops && k < MAX_PATHS; k++) printf("%s%u", k ? " → " : " ", path[k] + 1);
+        printf("%s (%d hops, %.2f km)\n", hops >= MAX_PATHS ? " ..." : "", hops, cost);
+    }
+    if(queries) {
+        double walk_us, dijkstra_us;
+        uint32_t bad;
+        time_queries(queries, &seed, &walk_us, &dijkstra_us, &bad);
+        printf("\n%u random path queries: %.3f us each by table walk, %.1f us each by Dijkstra per query "
+               "(%u cost mismatches)\n",
+               queries, walk_us, dijkstra_us, bad);
+    }
+    return 0;
+}
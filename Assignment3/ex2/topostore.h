@@ -0,0 +1,682 @@
+/*
+ * topostore.h: persistent router topology store, shared by the measurement and routing tools.
+ *
+ * A store at path P consists of:
+ *
+ *   P                the base: one image used in place after a single mmap
+ *     node columns   ip, asn, flags, last_seen uint32_t[n], lat, lon double[n]
+ *                    (routers sorted by IPv4 address; router id = row)
+ *     CSR            off uint32_t[n + 1], adj uint32_t[m], km float[m] and
+ *                    TsEdgeAttr[m] per directed entry, both directions of
+ *                    every link stored, neighbours ascending (graph.h layout)
+ *     runs           uint64_t[] keys of the traceroute runs already ingested
+ *   P.delta          append-only segment of fixed-size TsRecords (router
+ *                    attributes, aggregated link observations, run keys)
+ *   P.delta.merging  a segment being folded into the base
+ *
+ * Ingestion only appends to P.delta. A merge renames P.delta aside, folds it
+ * into a new base next to the old one and swaps it in with rename, so
+ * ingestion and readers keep going while it runs (possibly in a forked
+ * child). The base records the id of the last segment folded in, so a merge
+ * cut short is redone or skipped on the next run. Readers map the base and
+ * fold any pending segments in memory. Locks: P.lock (shared for readers,
+ * exclusive for appends and the two renames), P.merge (one merge at a time).
+ */
+
+#ifndef TOPOSTORE_H
+#define TOPOSTORE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "geoindex.h"
+
+#define TS_MAGIC "TOPOSTR1"
+#define TS_DELTA_MAGIC "TOPODLT1"
+#define TS_VERSION 1
+
+#define TS_NODE_LOCAL 1         // local / reserved hop, placed at the vantage point
+#define TS_NODE_NO_LOC 2        // no geolocation, placed at the vantage point
+
+#define TS_REC_NODE 1
+#define TS_REC_EDGE 2
+#define TS_REC_RUN 3
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_count, slot_count, run_count;     // slots: directed link entries (2 per link)
+    uint64_t merged_delta;                          // id of the last delta segment folded in
+    uint64_t ip_off, asn_off, flags_off, seen_off, lat_off, lon_off;
+    uint64_t off_off, adj_off, km_off, attr_off, run_off;
+    uint64_t size;
+} TsHeader;
+
+typedef struct {
+    float rtt_min, rtt_avg;     // ms, over the observations with a positive RTT difference
+    uint32_t count, rtt_count;  // probes seen crossing u -> v, of which with a positive RTT difference
+    uint32_t last_seen;         // unix time, 0 if never seen in this direction
+} TsEdgeAttr;
+
+typedef struct {
+    char magic[8];
+    uint64_t id;
+} TsDeltaHeader;
+
+typedef struct {
+    uint32_t kind;              // TS_REC_*
+    uint32_t time;              // unix time of the observation
+    uint32_t src, dst;          // node: ip; edge: ip -> ip; run: key high and low halves
+    uint32_t count, rtt_count;  // edge aggregates, as in TsEdgeAttr
+    double rtt_sum;
+    float rtt_min;
+    uint32_t asn, flags;        // node attributes
+    float lat, lon;
+    uint32_t reserved;
+    uint64_t check;             // FNV-1a of the fields above; a torn record fails it
+} TsRecord;
+
+typedef struct {
+    TsHeader *hdr;
+    uint32_t *ip, *asn, *flags, *seen;
+    double *lat, *lon;
+    uint32_t *off, *adj;
+    float *km;
+    TsEdgeAttr *attr;
+    uint64_t *runs;
+    size_t size;                // image length, released with munmap
+    size_t pending;             // delta records folded in when the store was opened
+} TsStore;
+
+static inline uint64_t ts_check(const TsRecord *r) {
+    const unsigned char *p = (const unsigned char *)r;
+    uint64_t h = 0xcbf29ce484222325ull;
+    for(size_t i = 0; i < offsetof(TsRecord, check); i++) h = (h ^ p[i]) * 0x100000001b3ull;
+    return h;
+}
+
+static inline size_t ts_align(size_t x) {
+    return (x + 7) & ~(size_t)7;
+}
+
+// Function to place the sections for the given counts. Returns the image size.
+static inline size_t ts_layout(TsHeader *h, uint32_t n, uint32_t m, uint32_t runs) {
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, TS_MAGIC, 8);
+    h->version = TS_VERSION;
+    h->node_count = n;
+    h->slot_count = m;
+    h->run_count = runs;
+    size_t at = ts_align(sizeof(TsHeader));
+#define TS_SECTION(field, bytes) (h->field = at, at += ts_align(bytes))
+    TS_SECTION(ip_off, (size_t)n * 4);
+    TS_SECTION(asn_off, (size_t)n * 4);
+    TS_SECTION(flags_off, (size_t)n * 4);
+    TS_SECTION(seen_off, (size_t)n * 4);
+    TS_SECTION(lat_off, (size_t)n * 8);
+    TS_SECTION(lon_off, (size_t)n * 8);
+    TS_SECTION(off_off, ((size_t)n + 1) * 4);
+    TS_SECTION(adj_off, (size_t)m * 4);
+    TS_SECTION(km_off, (size_t)m * 4);
+    TS_SECTION(attr_off, (size_t)m * sizeof(TsEdgeAttr));
+    TS_SECTION(run_off, (size_t)runs * 8);
+#undef TS_SECTION
+    h->size = at;
+    return at;
+}
+
+// Function to point a store at an image whose header has been checked
+static inline void ts_bind(TsStore *s, void *image, size_t size) {
+    char *p = image;
+    s->hdr = image;
+    s->ip = (uint32_t *)(p + s->hdr->ip_off);
+    s->asn = (uint32_t *)(p + s->hdr->asn_off);
+    s->flags = (uint32_t *)(p + s->hdr->flags_off);
+    s->seen = (uint32_t *)(p + s->hdr->seen_off);
+    s->lat = (double *)(p + s->hdr->lat_off);
+    s->lon = (double *)(p + s->hdr->lon_off);
+    s->off = (uint32_t *)(p + s->hdr->off_off);
+    s->adj = (uint32_t *)(p + s->hdr->adj_off);
+    s->km = (float *)(p + s->hdr->km_off);
+    s->attr = (TsEdgeAttr *)(p + s->hdr->attr_off);
+    s->runs = (uint64_t *)(p + s->hdr->run_off);
+    s->size = size;
+    s->pending = 0;
+}
+
+// Function to allocate a zeroed, writable image that ts_close can release
+static inline void *ts_image_alloc(size_t size) {
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED) {
+        perror("mmap failed");
+        exit(1);
+    }
+    return p;
+}
+
+static inline void ts_close(TsStore *s) {
+    if(s->hdr) munmap(s->hdr, s->size);
+    memset(s, 0, sizeof(*s));
+}
+
+static inline void ts_empty(TsStore *s) {
+    TsHeader h;
+    size_t size = ts_layout(&h, 0, 0, 0);
+    void *image = ts_image_alloc(size);
+    memcpy(image, &h, sizeof(h));
+    ts_bind(s, image, size);
+}
+
+// Function to tell whether a file starts like a store base
+static inline int ts_is_store(const char *path) {
+    char magic[8];
+    FILE *f = fopen(path, "rb");
+    int yes = f && fread(magic, 8, 1, f) == 1 && memcmp(magic, TS_MAGIC, 8) == 0;
+    if(f) fclose(f);
+    return yes;
+}
+
+/*
+ * Function to map a base privately (writes stay in this process, as the
+ * routing tools change link costs in place). A missing file is an empty
+ * store. Returns 0 on success, -1 (with a message) otherwise.
+ */
+static inline int ts_map_base(const char *path, TsStore *s) {
+    memset(s, 0, sizeof(*s));
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        if(errno != ENOENT) {
+            perror(path);
+            return -1;
+        }
+        ts_empty(s);
+        return 0;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(TsHeader)) {
+        fprintf(stderr, "%s: not a topology store\n", path);
+        close(fd);
+        return -1;
+    }
+    void *p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        perror("mmap failed");
+        return -1;
+    }
+    TsHeader want, *h = p;
+    size_t size = st.st_size;
+    if(memcmp(h->magic, TS_MAGIC, 8) != 0 || h->version != TS_VERSION ||
+       ts_layout(&want, h->node_count, h->slot_count, h->run_count) != size || h->size != size ||
+       memcmp(&want.ip_off, &h->ip_off, offsetof(TsHeader, size) - offsetof(TsHeader, ip_off)) != 0) {
+        fprintf(stderr, "%s: not a topology store (or truncated)\n", path);
+        munmap(p, size);
+        return -1;
+    }
+    ts_bind(s, p, size);
+    if(s->off[0] != 0 || s->off[h->node_count] != h->slot_count) {
+        fprintf(stderr, "%s: corrupt topology store\n", path);
+        ts_close(s);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Function to append the records of a delta segment to *recs (a missing
+ * file adds none). A torn record at the end is ignored. Sets *id to the
+ * segment id (0 if missing). Returns 0 on success, -1 otherwise.
+ */
+static inline int ts_read_delta(const char *name, uint64_t *id, TsRecord **recs, size_t *count, size_t *cap) {
+    *id = 0;
+    FILE *f = fopen(name, "rb");
+    if(!f) {
+        if(errno == ENOENT) return 0;
+        perror(name);
+        return -1;
+    }
+    TsDeltaHeader h;
+    if(fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, TS_DELTA_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s: not a topology delta\n", name);
+        fclose(f);
+        return -1;
+    }
+    *id = h.id;
+    TsRecord r;
+    while(fread(&r, sizeof(r), 1, f) == 1) {
+        if(r.check != ts_check(&r)) break;
+        if(*count == *cap) {
+            *cap = *cap ? *cap * 2 : 4096;
+            *recs = realloc(*recs, *cap * sizeof(TsRecord));
+            if(!*recs) {
+                perror("Memory allocation failed");
+                exit(1);
+            }
+        }
+        (*recs)[(*count)++] = r;
+    }
+    fclose(f);
+    return 0;
+}
+
+// Function to open and flock one of the store's lock files (-1 if it cannot be had)
+static inline int ts_lock(const char *path, const char *suffix, int op) {
+    char name[4096];
+    snprintf(name, sizeof(name), "%s%s", path, suffix);
+    int fd = open(name, O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+        perror(name);
+        return -1;
+    }
+    if(flock(fd, op) < 0) {
+        if(errno != EWOULDBLOCK) perror(name);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static inline void ts_unlock(int fd) {
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+static inline uint32_t ts_find(const uint32_t *ip, uint32_t n, uint32_t key) {
+    uint32_t lo = 0, hi = n;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if(ip[mid] < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < n && ip[lo] == key ? lo : n;
+}
+
+// Function to find a router by address (node_count if absent)
+static inline uint32_t ts_find_node(const TsStore *s, uint32_t ip) {
+    return ts_find(s->ip, s->hdr->node_count, ip);
+}
+
+// Function to find the entry of link u -> v (slot_count if absent)
+static inline uint32_t ts_find_slot(const TsStore *s, uint32_t u, uint32_t v) {
+    uint32_t lo = s->off[u], hi = s->off[u + 1], end = hi;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if(s->adj[mid] < v) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < end && s->adj[lo] == v ? lo : s->hdr->slot_count;
+}
+
+static inline int ts_has_run(const TsStore *s, uint64_t key) {
+    uint32_t lo = 0, hi = s->hdr->run_count;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if(s->runs[mid] < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < s->hdr->run_count && s->runs[lo] == key;
+}
+
+static inline void ts_combine(TsEdgeAttr *a, const TsEdgeAttr *b) {
+    if(b->rtt_count) {
+        double sum = (double)a->rtt_avg * a->rtt_count + (double)b->rtt_avg * b->rtt_count;
+        a->rtt_min = a->rtt_count && a->rtt_min < b->rtt_min ? a->rtt_min : b->rtt_min;
+        a->rtt_count += b->rtt_count;
+        a->rtt_avg = sum / a->rtt_count;
+    }
+    a->count += b->count;
+    if(b->last_seen > a->last_seen) a->last_seen = b->last_seen;
+}
+
+typedef struct {
+    uint64_t key;           // u << 32 | v in the merged numbering
+    TsEdgeAttr a;
+} TsEntry;
+
+static int ts_cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int ts_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int ts_cmp_entry(const void *a, const void *b) {
+    return ts_cmp_u64(&((const TsEntry *)a)->key, &((const TsEntry *)b)->key);
+}
+
+// Function to sort and deduplicate an array in place. Returns the new count.
+static inline size_t ts_unique(void *base, size_t count, size_t elem, int (*cmp)(const void *, const void *)) {
+    if(count == 0) return 0;
+    qsort(base, count, elem, cmp);
+    char *p = base;
+    size_t k = 1;
+    for(size_t i = 1; i < count; i++)
+        if(cmp(p + (k - 1) * elem, p + i * elem) != 0) memcpy(p + k++ * elem, p + i * elem, elem);
+    return k;
+}
+
+/*
+ * Function to walk the base links (renumbered through remap; inv maps back)
+ * and the sorted record entries together, combining equal links. Stores
+ * each router's link count in deg if given, and writes adj and attr at the
+ * offsets already placed in out if given. Returns the total.
+ */
+static inline uint32_t ts_merge_links(const TsStore *base, const uint32_t *remap, const uint32_t *inv,
+                                      const TsEntry *ent, size_t count, uint32_t n, uint32_t *deg, TsStore *out) {
+    uint32_t bn = base->hdr->node_count, total = 0;
+    size_t e = 0;
+    for(uint32_t u = 0; u < n; u++) {
+        uint32_t b = inv[u] < bn ? base->off[inv[u]] : 0, bend = inv[u] < bn ? base->off[inv[u] + 1] : 0, d = 0;
+        while(b < bend || (e < count && ent[e].key >> 32 == u)) {
+            uint64_t bkey = b < bend ? (uint64_t)u << 32 | remap[base->adj[b]] : UINT64_MAX;
+            uint64_t key = e < count && ent[e].key < bkey ? ent[e].key : bkey;
+            TsEdgeAttr a;
+            memset(&a, 0, sizeof(a));
+            if(key == bkey) a = base->attr[b++];
+            for(; e < count && ent[e].key == key; e++) ts_combine(&a, &ent[e].a);
+            if(out) {
+                out->adj[out->off[u] + d] = (uint32_t)key;
+                out->attr[out->off[u] + d] = a;
+            }
+            d++;
+        }
+        if(deg) deg[u] = d;
+        total += d;
+    }
+    return total;
+}
+
+/*
+ * Function to fold records into a store, giving a new in-memory image.
+ * Router attributes take the newest record (the later one on equal times)
+ * but keep known coordinates over a record without any. Link observations
+ * add up, and every observed direction also gets the reverse entry so links
+ * stay undirected for routing. Link lengths are recomputed from the
+ * coordinates.
+ */
+static inline void ts_merge(const TsStore *base, const TsRecord *rec, size_t count, uint64_t delta_id, TsStore *out) {
+    const TsHeader *bh = base->hdr;
+    uint32_t bn = bh->node_count;
+
+    // Routers: the base addresses and the new ones, merged in address order
+    uint32_t *fresh = geo_alloc((count * 2 + 1) * sizeof(uint32_t));
+    uint64_t *runs = geo_alloc((count + 1) * sizeof(uint64_t));
+    size_t nf = 0, nr = 0, ne = 0;
+    for(size_t i = 0; i < count; i++) {
+        if(rec[i].kind == TS_REC_NODE) fresh[nf++] = rec[i].src;
+        else if(rec[i].kind == TS_REC_EDGE) {
+            fresh[nf++] = rec[i].src;
+            fresh[nf++] = rec[i].dst;
+            ne++;
+        } else if(rec[i].kind == TS_REC_RUN) runs[nr++] = (uint64_t)rec[i].src << 32 | rec[i].dst;
+    }
+    nf = ts_unique(fresh, nf, sizeof(uint32_t), ts_cmp_u32);
+    uint32_t *ips = geo_alloc((bn + nf + 1) * sizeof(uint32_t)), *remap = geo_alloc((bn + 1) * sizeof(uint32_t));
+    uint32_t n = 0;
+    for(size_t i = 0, j = 0; i < bn || j < nf;) {
+        if(j == nf || (i < bn && base->ip[i] <= fresh[j])) {
+            if(j < nf && base->ip[i] == fresh[j]) j++;
+            remap[i] = n;
+            ips[n++] = base->ip[i++];
+        } else {
+            ips[n++] = fresh[j++];
+        }
+    }
+    free(fresh);
+
+    // Link observations in both directions, sorted by merged (u, v)
+    TsEntry *ent = geo_alloc((ne * 2 + 1) * sizeof(TsEntry));
+    size_t k = 0;
+    for(size_t i = 0; i < count; i++) {
+        const TsRecord *r = &rec[i];
+        if(r->kind != TS_REC_EDGE) continue;
+        uint32_t u = ts_find(ips, n, r->src), v = ts_find(ips, n, r->dst);
+        if(u == v) continue;
+        TsEntry fwd = {(uint64_t)u << 32 | v, {r->rtt_min, r->rtt_count ? r->rtt_sum / r->rtt_count : 0, r->count,
+                                                r->rtt_count, r->time}};
+        TsEntry rev = {(uint64_t)v << 32 | u, {0, 0, 0, 0, 0}};
+        ent[k++] = fwd;
+        ent[k++] = rev;
+    }
+    qsort(ent, k, sizeof(TsEntry), ts_cmp_entry);
+
+    // Run keys
+    nr = ts_unique(runs, nr, sizeof(uint64_t), ts_cmp_u64);
+    uint64_t *all_runs = geo_alloc((bh->run_count + nr + 1) * sizeof(uint64_t));
+    uint32_t runs_total = 0;
+    for(size_t i = 0, j = 0; i < bh->run_count || j < nr;) {
+        if(j == nr || (i < bh->run_count && base->runs[i] <= runs[j])) {
+            if(j < nr && base->runs[i] == runs[j]) j++;
+            all_runs[runs_total++] = base->runs[i++];
+        } else {
+            all_runs[runs_total++] = runs[j++];
+        }
+    }
+    free(runs);
+
+    uint32_t *inv = geo_alloc(((size_t)n + 1) * sizeof(uint32_t)), *deg = geo_alloc(((size_t)n + 1) * sizeof(uint32_t));
+    for(uint32_t u = 0; u < n; u++) inv[u] = bn;
+    for(uint32_t u = 0; u < bn; u++) inv[remap[u]] = u;
+    uint32_t m = ts_merge_links(base, remap, inv, ent, k, n, deg, NULL);
+    TsHeader h;
+    size_t size = ts_layout(&h, n, m, runs_total);
+    h.merged_delta = delta_id ? delta_id : bh->merged_delta;
+    void *image = ts_image_alloc(size);
+    memcpy(image, &h, sizeof(h));
+    ts_bind(out, image, size);
+
+    memcpy(out->ip, ips, (size_t)n * 4);
+    for(uint32_t u = 0; u < n; u++) out->flags[u] = TS_NODE_NO_LOC;
+    for(uint32_t u = 0; u < bn; u++) {
+        uint32_t v = remap[u];
+        out->asn[v] = base->asn[u];
+        out->flags[v] = base->flags[u];
+        out->seen[v] = base->seen[u];
+        out->lat[v] = base->lat[u];
+        out->lon[v] = base->lon[u];
+    }
+    for(size_t i = 0; i < count; i++) {
+        const TsRecord *r = &rec[i];
+        if(r->kind != TS_REC_NODE) continue;
+        uint32_t v = ts_find(ips, n, r->src);
+        if(r->time < out->seen[v]) continue;
+        out->seen[v] = r->time;
+        if(r->asn) out->asn[v] = r->asn;
+        // A hop that was not geolocated this time keeps the coordinates it had
+        if((r->flags & TS_NODE_NO_LOC) && !(out->flags[v] & TS_NODE_NO_LOC)) continue;
+        out->flags[v] = r->flags;
+        out->lat[v] = r->lat;
+        out->lon[v] = r->lon;
+    }
+    free(ips);
+    memcpy(out->runs, all_runs, (size_t)runs_total * 8);
+    free(all_runs);
+
+    // CSR: place each router's links, then fill them in
+    out->off[0] = 0;
+    for(uint32_t u = 0; u < n; u++) out->off[u + 1] = out->off[u] + deg[u];
+    ts_merge_links(base, remap, inv, ent, k, n, NULL, out);
+    free(deg);
+    free(inv);
+    free(ent);
+    free(remap);
+
+    GeoPoints pts;
+    geo_points_init(&pts, out->lat, out->lon, n);
+    for(uint32_t u = 0; u < n; u++)
+        for(uint32_t i = out->off[u]; i < out->off[u + 1]; i++) out->km[i] = geo_dist_scalar(&pts, u, out->adj[i]);
+    geo_points_free(&pts);
+}
+
+/*
+ * Function to open a store for reading: the base mapped in place, with any
+ * pending delta segments folded in memory. Returns 0 on success, -1 otherwise.
+ */
+static inline int ts_open(const char *path, TsStore *s) {
+    char name[4096];
+    TsRecord *recs = NULL;
+    size_t count = 0, cap = 0;
+    uint64_t id;
+    int lock = ts_lock(path, ".lock", LOCK_SH);
+    if(lock < 0) return -1;
+    if(ts_map_base(path, s) < 0) {
+        ts_unlock(lock);
+        return -1;
+    }
+    snprintf(name, sizeof(name), "%s.delta.merging", path);
+    int ok = ts_read_delta(name, &id, &recs, &count, &cap) == 0;
+    if(ok && id == s->hdr->merged_delta) count = 0;
+    snprintf(name, sizeof(name), "%s.delta", path);
+    ok = ok && ts_read_delta(name, &id, &recs, &count, &cap) == 0;
+    ts_unlock(lock);
+    if(!ok) {
+        ts_close(s);
+        free(recs);
+        return -1;
+    }
+    if(count) {
+        TsStore merged;
+        ts_merge(s, recs, count, 0, &merged);
+        ts_close(s);
+        *s = merged;
+        s->pending = count;
+    }
+    free(recs);
+    return 0;
+}
+
+static inline int ts_write_all(int fd, const void *data, size_t size) {
+    const char *p = data;
+    while(size) {
+        ssize_t w = write(fd, p, size);
+        if(w < 0) {
+            if(errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        size -= w;
+    }
+    return 0;
+}
+
+/*
+ * Function to append records to the store's delta segment, creating it
+ * (with a fresh id) if needed and dropping a torn record left by a crash.
+ * Returns the number of records now pending in it, or -1 on error.
+ */
+static inline long ts_append(const char *path, const TsRecord *recs, size_t count) {
+    char name[4096];
+    snprintf(name, sizeof(name), "%s.delta", path);
+    int lock = ts_lock(path, ".lock", LOCK_EX);
+    if(lock < 0) return -1;
+    int fd = open(name, O_WRONLY | O_APPEND);
+    if(fd < 0 && errno == ENOENT) {
+        fd = open(name, O_WRONLY | O_APPEND | O_CREAT | O_EXCL, 0644);
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        uint64_t state = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec + ((uint64_t)getpid() << 40);
+        TsDeltaHeader h;
+        memcpy(h.magic, TS_DELTA_MAGIC, 8);
+        h.id = (state ^ (state >> 31)) * 0x9e3779b97f4a7c15ull | 1;
+        if(fd >= 0 && ts_write_all(fd, &h, sizeof(h)) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) < 0) {
+        perror(name);
+        if(fd >= 0) close(fd);
+        ts_unlock(lock);
+        return -1;
+    }
+    size_t body = st.st_size - sizeof(TsDeltaHeader), whole = body / sizeof(TsRecord);
+    int ok = body % sizeof(TsRecord) == 0 || ftruncate(fd, sizeof(TsDeltaHeader) + whole * sizeof(TsRecord)) == 0;
+    ok = ok && ts_write_all(fd, recs, count * sizeof(TsRecord)) == 0 && fdatasync(fd) == 0;
+    if(!ok) perror(name);
+    close(fd);
+    ts_unlock(lock);
+    return ok ? (long)(whole + count) : -1;
+}
+
+/*
+ * Function to fold the pending delta segments into the base. With wait = 0
+ * it gives up at once if another merge holds the store. Returns the number
+ * of records folded in, or -1 on error or when busy.
+ */
+static inline long ts_compact(const char *path, int wait) {
+    char delta[4096], merging[4096], tmp[4096];
+    snprintf(delta, sizeof(delta), "%s.delta", path);
+    snprintf(merging, sizeof(merging), "%s.delta.merging", path);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int mlock = ts_lock(path, ".merge", LOCK_EX | (wait ? 0 : LOCK_NB));
+    if(mlock < 0) return -1;
+    long folded = 0;
+    for(;;) {
+        // Set the current segment aside (unless a merge cut short left one) so appends start a new one
+        int lock = ts_lock(path, ".lock", LOCK_EX);
+        if(lock < 0) break;
+        if(access(merging, F_OK) != 0) {
+            if(access(delta, F_OK) != 0) {
+                ts_unlock(lock);
+                break;
+            }
+            if(rename(delta, merging) < 0) {
+                perror(delta);
+                ts_unlock(lock);
+                folded = -1;
+                break;
+            }
+        }
+        ts_unlock(lock);
+
+        TsStore base, merged;
+        TsRecord *recs = NULL;
+        size_t count = 0, cap = 0;
+        uint64_t id;
+        if(ts_map_base(path, &base) < 0 || ts_read_delta(merging, &id, &recs, &count, &cap) < 0) {
+            free(recs);
+            folded = -1;
+            break;
+        }
+        int fresh = id != base.hdr->merged_delta, ok = 1;
+        if(fresh) {
+            ts_merge(&base, recs, count, id, &merged);
+            int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            ok = fd >= 0 && ts_write_all(fd, merged.hdr, merged.size) == 0 && fsync(fd) == 0;
+            if(fd >= 0) close(fd);
+            if(!ok) perror(tmp);
+            ts_close(&merged);
+            folded += count;
+        }
+        ts_close(&base);
+        free(recs);
+
+        // Publish the new base and retire the segment together
+        lock = ts_lock(path, ".lock", LOCK_EX);
+        if(lock < 0 || !ok || (fresh && rename(tmp, path) < 0) || unlink(merging) < 0) {
+            if(lock >= 0 && ok) perror(path);
+            if(lock >= 0) ts_unlock(lock);
+            unlink(tmp);
+            folded = -1;
+            break;
+        }
+        ts_unlock(lock);
+    }
+    ts_unlock(mlock);
+    return folded;
+}
+
+#endif